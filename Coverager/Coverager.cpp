@@ -6,17 +6,76 @@
 
     How to compile the module:
 
-        1) Copy directory with this project into the PIN toolkit root directory.
+        1) Copy directory with this project and "covdb" directory into the PIN toolkit 
+            root directory.
         2) Open Coverager.vcproj with Microsoft Visual Studio 2008 or later
             and build it.
 
     Usage:
 
-        pin.exe -t Coverager.dll -o <log_file_path> [-c] -- <some_program>
+        pin.exe -t Coverager.dll -o <log_file_path> [-c [-a]] [-cct] [-callgrind] [-hitonly] [-e] [-m <modules>] [-db 0|1] [-text 0|1] [-live [-live_size <MB>]] [-snapshot <ms>] [-epoch <ms> | -epoch_ins <M>] -- <some_program>
         
         
     "-c" option enables call tree log generation, that can be converted in Calltree 
-    Profile Format by coverage_to_callgraph.py program.
+    Profile Format by coverage_to_callgraph.py program. Call tree logs are binary, 
+    records are buffered per thread and written by the separate PIN internal thread.
+
+    "-a" option (used with "-c") enables aggregation of the call tree in memory: only 
+    unique (caller, callee) pairs with the number of calls are written into the 
+    text call tree logs at thread termination.
+
+    "-cct" option enables calling context tree profiling: each thread builds the tree
+    of call paths with number of calls and executed instructions for every node. 
+    Trees are written into the <log_file_path>.cct.<N> files at thread termination,
+    the tree merged from all of the threads is written into <log_file_path>.cct file.
+    Can't be used with "-hitonly".
+
+    "-callgrind" option enables profiling of executed instructions by routines: self
+    and inclusive costs (Ir event) with the call graph are written straight into the
+    callgrind.out.<pid> file in Calltree Profile Format, that can be explored with 
+    KCachegrind. Can't be used with "-hitonly".
+
+    "-hitonly" option enables hit-only coverage mode: each basic block is counted 
+    only once, and instrumentation is removed from the code after its first execution.
+    Routines are not counted in this mode unless "-c" option is specified.
+
+    "-e" option enables edge coverage: transitions between basic blocks are logged 
+    into the <log_file_path>.edges file, and AFL-compatible hashed edges bitmap is 
+    written into the <log_file_path>.bitmap file. Can't be used with "-hitonly".
+
+    "-m" option enables instrumentation only for the specified modules, value is a
+    comma separated list of module names or full paths, that can contain '*' and '?'
+    wildcards (for example: -m "iexplore.exe,ieframe,C:\Windows\System32\ms*.dll").
+    Use "?" list item to instrument the code that doesn't belong to any module.
+
+    "-db" option (enabled by default) controls writing of the binary coverage database 
+    <log_file_path>.db with modules, basic blocks, routines and call edges (see 
+    covdb/src/covdb.h for the format description), "-text" option (enabled by default)
+    controls writing of the same information into the .modules, .blocks and .routines 
+    text logs.
+
+    "-live" option enables crash-safe coverage: basic blocks counters, blocks and modules
+    information are allocated inside of the memory mapped <log_file_path>.live file
+    (see covdb/src/covlive.h for the format description), so they are persisted by 
+    the OS even if the target process crashes or gets killed. Use covrecover.exe to
+    convert such file into the binary coverage database. "-live_size" option sets max.
+    size of the counters arena in megabytes (64 by default), counters that don't fit 
+    into it are allocated in memory and lost on crash.
+
+    "-snapshot" option enables coverage snapshots of the running process: PIN internal
+    thread checks for <log_file_path>.snapshot control file with the specified interval
+    in milliseconds, and when it exists, the file is deleted and current coverage is
+    written into the <log_file_path>.snapshot.<N>.db binary database. Application 
+    threads are not stopped, counters of the running threads are swapped with the fresh
+    ones to take the snapshot, while routines and call edges are available only for
+    the terminated threads.
+
+    "-epoch" and "-epoch_ins" options enable phase analysis: executed basic blocks are
+    recorded separately for each epoch of the specified length in milliseconds or in 
+    millions of executed instructions. Compressed bitmaps of the blocks executed in 
+    each epoch are written into the binary database, and per-epoch summary is written
+    into the [epochs] section of the <log_file_path> log. Requires "-db" and can't be
+    used with "-hitonly".
 
     Developed by:
 
@@ -27,12 +86,32 @@
 =========================================================================
 */
 #include "pin.H"
+#include "../covdb/src/covdb.h"
+#include "../covdb/src/covlive.h"
 #include <time.h>
 #include <iostream>
 #include <fstream>
 #include <list>
 #include <map>
-#include <stack>
+#include <vector>
+#include <algorithm>
+
+#if defined(TARGET_WINDOWS)
+
+namespace WINDOWS
+{
+#include <windows.h>
+}
+
+#else
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define _snprintf snprintf
+
+#endif
 
 #define MAX_PATH 254
 
@@ -42,6 +121,86 @@
 // default output directory name
 #define OUT_DIR_NAME "."
 
+// number of basic block counters in single chunk
+#define COUNTERS_CHUNK_SHIFT 12
+#define COUNTERS_CHUNK_SIZE (1 << COUNTERS_CHUNK_SHIFT)
+#define COUNTERS_CHUNK_MASK (COUNTERS_CHUNK_SIZE - 1)
+
+// max. number of counters chunks (allows up to 16M of basic blocks)
+#define COUNTERS_MAX_CHUNKS 0x1000
+#define COUNTERS_MAX_SLOTS (COUNTERS_MAX_CHUNKS * COUNTERS_CHUNK_SIZE)
+
+#define COUNTERS_CHUNK(_slot_) ((_slot_) >> COUNTERS_CHUNK_SHIFT)
+#define COUNTERS_INDEX(_slot_) ((_slot_) & COUNTERS_CHUNK_MASK)
+
+// number of entries in per-thread direct mapped edges cache (16 KB, fits into L1 data cache)
+#define EDGE_CACHE_BITS 11
+#define EDGE_CACHE_SIZE (1 << EDGE_CACHE_BITS)
+
+// size of AFL-compatible edges bitmap
+#define EDGE_BITMAP_BITS 16
+#define EDGE_BITMAP_SIZE (1 << EDGE_BITMAP_BITS)
+
+// slot number of the "previous" block at thread startup, the last slot is reserved for it
+#define EDGE_NO_SLOT (COUNTERS_MAX_SLOTS - 1)
+
+#define EDGE_KEY(_from_, _to_) (((UINT64)(_from_) << 32) | (UINT64)(_to_))
+#define EDGE_KEY_FROM(_key_) ((UINT32)((_key_) >> 32))
+#define EDGE_KEY_TO(_key_) ((UINT32)(_key_))
+
+/*
+    Edges cache entry is packed into 64 bits: 24-bit slot numbers of the previous 
+    and current blocks (COUNTERS_MAX_SLOTS) and 16-bit saturating counter.
+*/
+#define EDGE_ENTRY_FROM(_slot_) ((UINT64)(_slot_) << 40)
+#define EDGE_ENTRY_TO(_slot_) ((UINT64)(_slot_) << 16)
+#define EDGE_ENTRY_COUNT_MAX 0xffff
+
+#define EDGE_ENTRY_KEY(_entry_) EDGE_KEY((_entry_) >> 40, ((_entry_) >> 16) & (COUNTERS_MAX_SLOTS - 1))
+#define EDGE_ENTRY_COUNT(_entry_) ((UINT32)(_entry_) & EDGE_ENTRY_COUNT_MAX)
+
+// number of records in single call tree log buffer
+#define CALL_BUFFER_SIZE 0x4000
+
+// max. number of allocated call tree log buffers
+#define CALL_BUFFERS_MAX 0x40
+
+// initial number of entries in per-thread call edges hash table
+#define CALL_EDGES_INIT_SIZE 0x400
+
+// module ID of the addresses that doesn't belong to any known module
+#define MODULE_UNKNOWN ((UINT32)-1)
+
+// initial size of callgrind routine calls hash table
+#define CALLGRIND_HASH_INIT_SIZE 0x10
+
+// max. depth of the per-thread shadow call stack
+#define SHADOW_STACK_SIZE 0x2000
+
+// number of nodes in single calling context tree arena chunk
+#define CCT_CHUNK_SHIFT 12
+#define CCT_CHUNK_SIZE (1 << CCT_CHUNK_SHIFT)
+#define CCT_CHUNK_MASK (CCT_CHUNK_SIZE - 1)
+
+// number of children that are stored inside of calling context tree node
+#define CCT_INLINE_CHILDREN 4
+
+// initial size of calling context tree node children hash table
+#define CCT_HASH_INIT_SIZE 0x10
+
+// call tree log file signature and version
+#define CALL_LOG_MAGIC "CCTLOG"
+#define CALL_LOG_VERSION 1
+
+// number of instructions that thread counts before adding them into the global epoch counter
+#define EPOCH_INS_QUANTUM 0x10000
+
+// number of epoch maps: current, retired one and the spare one
+#define EPOCH_MAPS 3
+
+// hash basic block slot number into the edge location of given size
+#define EDGE_LOCATION(_slot_, _bits_) (((UINT32)(_slot_) * 0x9e3779b1) >> (32 - (_bits_)))
+
 #define APP_NAME                                \
     "# Code Coverage Analysis Tool for PIN\r\n" \
     "# by Oleksiuk Dmitry, eSage Lab (dmitry@esagelab.com)\r\n"
@@ -72,56 +231,569 @@ KNOB<BOOL> KnobLogCallTree(
     "Enable call tree logging"
 );
 
+KNOB<BOOL> KnobCallEdges(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "a", "0", 
+    "Aggregate call tree edges instead of logging every call"
+);
+
+KNOB<BOOL> KnobCct(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "cct", "0", 
+    "Enable calling context tree profiling"
+);
+
+KNOB<BOOL> KnobCallgrind(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "callgrind", "0", 
+    "Write executed instructions profile in Calltree Profile Format"
+);
+
+KNOB<string> KnobModules(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "m", "", 
+    "Comma separated list of modules to instrument (default: all)"
+);
+
+KNOB<BOOL> KnobEdges(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "e", "0", 
+    "Enable edge coverage logging"
+);
+
+KNOB<BOOL> KnobDatabase(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "db", "1", 
+    "Write binary coverage database"
+);
+
+KNOB<BOOL> KnobText(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "text", "1", 
+    "Write modules, basic blocks and routines text logs"
+);
+
+KNOB<BOOL> KnobLive(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "live", "0", 
+    "Keep coverage counters in the crash-safe memory mapped file"
+);
+
+KNOB<UINT32> KnobLiveSize(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "live_size", "64", 
+    "Max. size of the live counters arena in megabytes"
+);
+
+KNOB<UINT32> KnobSnapshot(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "snapshot", "0", 
+    "Snapshot control file polling interval in milliseconds (0 to disable)"
+);
+
+KNOB<UINT32> KnobEpoch(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "epoch", "0", 
+    "Length of coverage epoch in milliseconds (0 to disable)"
+);
+
+KNOB<UINT32> KnobEpochIns(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "epoch_ins", "0", 
+    "Length of coverage epoch in millions of instructions (0 to disable)"
+);
+
+KNOB<BOOL> KnobHitOnly(
+    KNOB_MODE_WRITEONCE, 
+    "pintool", "hitonly", "0", 
+    "Record only the first execution of each basic block"
+);
+
 /**
  * Global variables 
  */
 
+typedef struct _CALL_RECORD
+{
+    ADDRINT Caller;
+    ADDRINT Callee;
+
+} CALL_RECORD,
+*PCALL_RECORD;
+
+typedef struct _CALL_BUFFER
+{
+    struct _CALL_BUFFER *Next;
+
+    // destination log file
+    FILE *f;
+
+    // close log file after writing of this buffer
+    bool bClose;
+
+    UINT32 Count;
+    CALL_RECORD Records[CALL_BUFFER_SIZE];
+
+} CALL_BUFFER,
+*PCALL_BUFFER;
+
+typedef struct _CALL_EDGE
+{
+    ADDRINT Caller;
+    ADDRINT Callee;
+    UINT32 Calls;
+
+} CALL_EDGE,
+*PCALL_EDGE;
+
 typedef struct _CALL_TREE_PARAMS
 {
     FILE *f;
-    std::stack<ADDRINT> Address;
+
+    // call tree logging is enabled for the thread
+    bool bEnabled;
+
+    // open addressing hash table of call edges for aggregation mode
+    PCALL_EDGE Edges;
+    UINT32 EdgesMask, EdgesCount;
+
+    // current log buffer and its free space
+    PCALL_BUFFER Buffer;
+    PCALL_RECORD Ptr, End;
 
 } CALL_TREE_PARAMS,
 *PCALL_TREE_PARAMS;
 
 typedef struct _BASIC_BLOCK_PARAMS
 {
-    UINT32 Calls;
+    ADDRINT Address;
+    UINT32 Size;
     UINT32 Instructions;
 
+    // ID of the module that was loaded at the block address during instrumentation
+    UINT32 Module;
+
 } BASIC_BLOCK_PARAMS,
 *PBASIC_BLOCK_PARAMS;
 
+typedef struct _MODULE_INFO
+{
+    std::string Path;
+
+    // image address range, end address is inclusive
+    ADDRINT Start;
+    ADDRINT End;
+
+    // PIN image ID
+    UINT32 ImageId;
+
+    // module must be instrumented
+    bool bSelected;
+
+    // sequence numbers of load and unload events, unload is 0 for loaded modules
+    UINT32 Load;
+    UINT32 Unload;
+
+} MODULE_INFO,
+*PMODULE_INFO;
+
+typedef struct _ROUTINE_CALLS
+{
+    // ID of the module that was loaded at the routine address at the first call
+    UINT32 Module;
+    UINT32 Calls;
+
+} ROUTINE_CALLS,
+*PROUTINE_CALLS;
+
 // typedefs for STL containers
-typedef std::pair<ADDRINT, UINT32> BASIC_BLOCK;
-typedef std::map<BASIC_BLOCK, BASIC_BLOCK_PARAMS> BASIC_BLOCKS;
-typedef std::map<std::string, std::pair<ADDRINT, ADDRINT>> MODULES_LIST;
-typedef std::map<ADDRINT, UINT32> ROUTINES_LIST;
-typedef std::map<THREADID, CALL_TREE_PARAMS> THREAD_CALLS;
+typedef std::pair<UINT32, std::pair<ADDRINT, UINT32>> BASIC_BLOCK;
+typedef std::map<BASIC_BLOCK, UINT32> BASIC_BLOCKS;
+typedef std::vector<BASIC_BLOCK_PARAMS> BASIC_BLOCKS_SLOTS;
+typedef std::vector<MODULE_INFO> MODULES_LIST;
+
+typedef struct _MODULE_RANGE
+{
+    // module address range, end address is inclusive
+    ADDRINT Start;
+    ADDRINT End;
+
+    // module ID, index of the module in m_ModuleList
+    UINT32 Id;
+
+} MODULE_RANGE,
+*PMODULE_RANGE;
+
+typedef std::vector<MODULE_RANGE> MODULE_RANGES;
+typedef std::pair<UINT32, ADDRINT> MODULE_ADDRESS;
+typedef std::map<MODULE_ADDRESS, UINT32> ROUTINES_LIST;
+typedef std::map<std::pair<MODULE_ADDRESS, MODULE_ADDRESS>, UINT64> CALL_EDGES_LIST;
+typedef std::map<ADDRINT, ROUTINE_CALLS> THREAD_ROUTINES;
+typedef std::map<UINT64, UINT32> EDGES_LIST;
+
+/**
+ * Entry of the per-thread edges cache, each entry is holding the counter
+ * of one (previous block, current block) pair, see EDGE_ENTRY_* macros.
+ */
+typedef UINT64 EDGE_ENTRY, *PEDGE_ENTRY;
+
+/**
+ * Calling context tree node, represents unique call path from the
+ * thread entry point to the routine.
+ */
+typedef struct _CCT_NODE
+{
+    ADDRINT Routine;
+    UINT32 Id;
+
+    struct _CCT_NODE *Parent;
+
+    // first children are stored inline, the rest of them in the hash table
+    struct _CCT_NODE *Children[CCT_INLINE_CHILDREN];
+    struct _CCT_NODE **ChildrenHash;
+    UINT32 ChildrenCount, ChildrenHashMask;
+
+    UINT64 Calls;
+    UINT64 Instructions;
+
+} CCT_NODE,
+*PCCT_NODE;
+
+typedef struct _CCT_TREE
+{
+    // arena of the nodes, node ID is an index in the arena
+    std::vector<PCCT_NODE> Chunks;
+    UINT32 NodesCount;
+
+    PCCT_NODE Root;
+
+} CCT_TREE,
+*PCCT_TREE;
+
+/**
+ * Callgrind profile: executed instructions of the routine itself
+ * and inclusive costs of the calls from this routine to the others.
+ */
+typedef struct _CALLGRIND_CALL
+{
+    UINT64 Calls;
+    UINT64 Inclusive;
+
+    // called routine and its profile of the current thread
+    ADDRINT Callee;
+    struct _CALLGRIND_ROUTINE *Routine;
+
+} CALLGRIND_CALL,
+*PCALLGRIND_CALL;
+
+typedef std::map<ADDRINT, CALLGRIND_CALL> CALLGRIND_CALLS;
+
+typedef struct _CALLGRIND_ROUTINE
+{
+    bool bResolved;
+    UINT64 Self;
+    CALLGRIND_CALLS Calls;
+
+    // open addressing hash table of the pointers to Calls entries, used by analysis routines
+    PCALLGRIND_CALL *CallsHash;
+    UINT32 CallsHashMask, CallsHashCount;
+
+} CALLGRIND_ROUTINE,
+*PCALLGRIND_ROUTINE;
+
+typedef std::map<ADDRINT, CALLGRIND_ROUTINE> CALLGRIND_ROUTINES;
+
+// (object name, name) -> compressed name ID of the callgrind profile
+typedef std::map<std::pair<std::string, std::string>, UINT32> CALLGRIND_NAMES;
+
+typedef struct _CALLGRIND_FRAME
+{
+    // routine that is executing in this frame and the call that created the frame
+    PCALLGRIND_ROUTINE Routine;
+    PCALLGRIND_CALL Call;
+
+    // value of the thread instructions counter at the routine entry
+    UINT64 Entry;
+
+} CALLGRIND_FRAME,
+*PCALLGRIND_FRAME;
+
+typedef struct _SHADOW_FRAME
+{
+    // called routine, its return address and stack pointer value that RET will see
+    ADDRINT Routine;
+    ADDRINT ReturnAddress;
+    ADDRINT StackPtr;
+
+    // calling context of the routine
+    PCCT_NODE Cct;
+
+    // callgrind profile entries of the routine
+    CALLGRIND_FRAME Callgrind;
+
+} SHADOW_FRAME,
+*PSHADOW_FRAME;
+
+typedef struct _SHADOW_STACK_STATS
+{
+    // frames that was dropped without return (longjmp, exceptions, call/pop thunks)
+    UINT64 Unwound;
+
+    // returns to the address that doesn't match the frame return address
+    UINT64 Mismatches;
+
+    // returns without the corresponding call
+    UINT64 Unmatched;
+
+    // calls that wasn't tracked because of the stack overflow
+    UINT64 Overflows;
+
+} SHADOW_STACK_STATS,
+*PSHADOW_STACK_STATS;
+
+// routine address -> (module name, routine name)
+typedef std::map<ADDRINT, std::pair<std::string, std::string>> ROUTINES_NAMES;
+
+/**
+ * Per-thread counters shard, analysis routines are updating only 
+ * the shard of the current thread, so they don't need any locking.
+ * Shards are merged into the global lists at thread termination.
+ */
+typedef struct _THREAD_PARAMS
+{
+    THREADID ThreadIndex;
+
+    // basic blocks counters of this thread, indexed by slot number, chunks are swapped by snapshots
+    UINT32 *Counters[COUNTERS_MAX_CHUNKS];
+
+    // routines counters of this thread and value of m_ModulesEpoch they belongs to
+    THREAD_ROUTINES Routines;
+    UINT32 ModulesEpoch;
+
+    /*
+        Edges coverage stuff: direct mapped cache is indexed by AFL-style
+        hash of the previous and current blocks and contains the counters
+        of recently executed edges, evicted counters are going to the 
+        exact edges list of the thread. Previous block is kept as cache
+        entry without counter, with its location in the low bits.
+    */
+    PEDGE_ENTRY EdgeCache;
+    UINT64 EdgePrev, EdgeMissPrev;
+    EDGES_LIST Edges;
+
+    // call tree logging stuff
+    CALL_TREE_PARAMS CallTree;
+
+    // calling context tree of the thread and its current node
+    CCT_TREE Cct;
+    PCCT_NODE CctCurrent;
+
+    // callgrind profile of the thread
+    CALLGRIND_ROUTINES Callgrind;
+
+    /*
+        Shadow call stack: preallocated array of frames, the first one
+        belongs to the thread start and never removed.
+    */
+    PSHADOW_FRAME Frames;
+    UINT32 Depth;
+    SHADOW_STACK_STATS ShadowStats;
+
+    // executed instructions counter and its value at the last call or return
+    UINT64 Instructions, CallgrindLast;
+
+    // executed instructions that are not added into the global epoch counter yet
+    UINT32 EpochInstructions;
+
+} THREAD_PARAMS,
+*PTHREAD_PARAMS;
+
+typedef std::map<THREADID, PTHREAD_PARAMS> THREADS_LIST;
+
+typedef struct _EPOCH_MAP
+{
+    // executed basic blocks flags, indexed by slot number
+    UINT8 *Flags;
+
+    // epoch start and end time in milliseconds and total instructions at the end
+    UINT64 Start, End, Instructions;
+
+} EPOCH_MAP,
+*PEPOCH_MAP;
+
+typedef struct _EPOCH_INFO
+{
+    UINT64 Start, End, Instructions;
+
+    // number of executed blocks and blocks that were not executed in previous epochs
+    UINT32 Blocks, NewBlocks;
+
+    // ascending slot numbers of executed blocks, packed with CallLogPackValue()
+    std::vector<UINT8> Slots;
+
+} EPOCH_INFO,
+*PEPOCH_INFO;
+
+typedef std::vector<EPOCH_INFO> EPOCHS_LIST;
 
 // total number of threads, including main thread
 UINT64 m_ThreadCount = 0; 
 
-// list of bbl's
+// bbl -> slot number map, used only at instrumentation time
 BASIC_BLOCKS m_BasicBlocks;
 
-// list of executable modules
+// list of bbl's, indexed by slot number
+BASIC_BLOCKS_SLOTS m_BasicBlocksSlots;
+
+// merged basic blocks counters, indexed by slot number
+UINT32 *m_Counters[COUNTERS_MAX_CHUNKS];
+
+// executed basic blocks map for hit-only mode, indexed by slot number
+UINT8 *m_HitMap[COUNTERS_MAX_CHUNKS];
+
+// merged edges counters
+EDGES_LIST m_Edges;
+
+// calling context tree merged from all of the threads
+CCT_TREE m_Cct;
+
+// callgrind profile merged from all of the threads and names of its routines
+CALLGRIND_ROUTINES m_Callgrind;
+ROUTINES_NAMES m_RoutinesNames;
+
+// queue of call tree log buffers to write and list of free buffers
+PCALL_BUFFER m_CallBuffersHead = NULL, m_CallBuffersTail = NULL;
+PCALL_BUFFER m_CallBuffersFree = NULL;
+
+// lock for the buffers lists and lock of the log files writing
+PIN_LOCK m_CallBuffersLock, m_CallLogWriteLock;
+
+// signaled when there is some buffers to write
+PIN_SEMAPHORE m_CallLogEvent;
+
+// call tree log writer thread and its termination flag, that is set by PrepareForFini()
+PIN_THREAD_UID m_CallLogThreadId;
+volatile bool m_CallLogStop = false;
+BOOL m_CallLogStopped = false;
+
+// call tree log statistics
+UINT64 m_CallEdgesCount = 0;
+UINT32 m_CallBuffersCount = 0;
+UINT64 m_CallRecordsCount = 0;
+UINT64 m_CallBuffersStalls = 0;
+
+// snapshot writer thread and its stop event
+PIN_THREAD_UID m_SnapshotThreadId;
+PIN_SEMAPHORE m_SnapshotEvent;
+volatile bool m_SnapshotStop = false;
+
+// number of written coverage snapshots
+UINT32 m_SnapshotsCount = 0;
+
+// (chunk number, counters) of the threads counters chunks that were swapped by the last snapshot
+std::vector<std::pair<UINT32, UINT32 *> > m_SnapshotRetired;
+
+// shadow call stacks statistics
+SHADOW_STACK_STATS m_ShadowStats;
+
+// list of executable modules indexed by module ID, every image load gets a new ID
 MODULES_LIST m_ModuleList; 
 
-// list of routines
+// PIN image ID -> module ID map for the loaded images
+std::map<UINT32, UINT32> m_ImageModules;
+
+// number of module load and unload events
+UINT32 m_ModuleEvents = 0, m_ModuleUnloads = 0;
+
+/*
+    Address ranges of the loaded modules sorted by start address, the table
+    is immutable and replaced on every module load or unload, so analysis 
+    routines can use it without locking. Old tables are never freed because
+    other threads might be still using them. Epoch is incremented on every 
+    table change.
+*/
+MODULE_RANGES * volatile m_LiveRanges = NULL;
+volatile UINT32 m_ModulesEpoch = 0;
+
+// list of routines, (module ID, address) -> calls
 ROUTINES_LIST m_RoutinesList; 
 
-// list of call tree logging stuff for each thread
-THREAD_CALLS m_ThreadCalls;
+// call edges merged from all of the threads, (caller, callee) -> calls
+CALL_EDGES_LIST m_CallEdges;
+
+// list of running threads
+THREADS_LIST m_ThreadsList;
+
+// lock for m_ThreadsList and merging of the per-thread counters
+PIN_LOCK m_ThreadsLock;
+
+// TLS key and tool register that are holding PTHREAD_PARAMS of the current thread
+TLS_KEY m_ThreadKey;
+REG m_ThreadReg;
 
-// list of full paths for loaded modules
-std::list<std::string> m_ModulePathList;
+// list of modules name patterns to instrument (lower case)
+std::list<std::string> m_ModuleFilter;
+
+// instrument the code that doesn't belong to any module
+BOOL m_ModuleFilterUnknown = false;
 
 // started process information
 std::string m_CommandLine = "";
 INT m_ProcessId = 0;
 
 time_t m_StartTime;
+
+/*
+    Executed blocks flags of the current epoch, the map is replaced by EpochSwap().
+    Previous map stays untouched during the next epoch, so analysis routines that 
+    are still holding the old pointer never write into the reused memory, then it's
+    compressed by the epochs thread and becomes the spare one.
+*/
+EPOCH_MAP * volatile m_EpochMap = NULL;
+PEPOCH_MAP m_EpochRetired = NULL, m_EpochPending = NULL, m_EpochSpare = NULL;
+UINT32 m_EpochMapsCount = 0;
+
+// flags of the current epoch map, the only value that is used by the analysis routines
+UINT8 * volatile m_EpochFlags = NULL;
+
+// finished epochs and slots that were executed in any of them
+EPOCHS_LIST m_Epochs;
+std::vector<bool> m_EpochSeen;
+
+// lock for epochs swapping and global instructions counter
+PIN_LOCK m_EpochLock;
+UINT64 m_EpochInstructions = 0, m_EpochNextSwap = 0;
+
+// time based epochs swapping thread and its stop event
+PIN_THREAD_UID m_EpochThreadId;
+PIN_SEMAPHORE m_EpochEvent;
+volatile bool m_EpochStop = false;
+
+UINT64 m_EpochClockStart = 0;
+
+/*
+    Mapped live counters file (-live option), chunks directory and the arena
+    are protected by m_ThreadsLock.
+*/
+PCOVLIVE_HEADER m_Live = NULL;
+
+#if defined(TARGET_WINDOWS)
+
+WINDOWS::HANDLE m_hLiveFile = NULL, m_hLiveMapping = NULL;
+
+#endif
+
+// mapped chunk address -> chunks directory entry number
+std::map<VOID *, UINT32> m_LiveChunks;
+
+// freed per-thread counters chunks of the live file, that can be reused
+std::vector<UINT32 *> m_LiveFree;
+
+// blocks information chunks of the live file, indexed by counters chunk number
+PCOVLIVE_BLOCK m_LiveBlocks[COUNTERS_MAX_CHUNKS];
+
+// number of chunks that didn't fit into the live file
+UINT32 m_LiveOverflows = 0;
 //--------------------------------------------------------------------------------------
 /**
  *  Print out help message.
@@ -136,209 +808,2814 @@ INT32 Usage(VOID)
     return -1;
 }
 //--------------------------------------------------------------------------------------
-VOID CountBbl(ADDRINT Address, UINT32 Size, UINT32 Instructions)
+VOID PrintLogFileHeader(FILE *f)
 {
-    BASIC_BLOCK Block = std::make_pair(Address, Size);    
-
-    if (m_BasicBlocks.find(Block) == m_BasicBlocks.end())
-    {
-        BASIC_BLOCK_PARAMS Params;
-        Params.Calls = 1;
-        Params.Instructions = Instructions;    
-
-        // allocate a new basic block
-        m_BasicBlocks[Block] = Params;
-    }
-    else
-    {
-        // update basic block information
-        m_BasicBlocks[Block].Calls += 1;
-    }    
-}
-//--------------------------------------------------------------------------------------
-// This function is called before every instruction is executed
-VOID CountRoutine(ADDRINT Address)
-{    
-    m_RoutinesList[Address] += 1;
+    fprintf(f, "#\r\n");
+    fprintf(f, APP_NAME);
+    fprintf(f, "#\r\n");
+    fprintf(f, "# Program command line: %s\r\n", m_CommandLine.c_str());
+    fprintf(f, "# Process ID: %d\r\n", m_ProcessId);
+    fprintf(f, "#\r\n");
 }
 //--------------------------------------------------------------------------------------
-VOID InstRetHandler(ADDRINT Address)
+std::string NameFromPath(std::string &Path)
 {
-    // lookup for the current thread info
-    THREADID ThreadIndex = PIN_ThreadId();
-    if (m_ThreadCalls.find(ThreadIndex) != m_ThreadCalls.end())
-    {
-        if (m_ThreadCalls[ThreadIndex].Address.top() != 0)
-        {
-            m_ThreadCalls[ThreadIndex].Address.pop();
-        }
-    }
+    size_t Pos = Path.rfind("\\");
+    return std::string(Path.substr(Pos + 1));
 }
 //--------------------------------------------------------------------------------------
-VOID InstCallHandler(ADDRINT Address, ADDRINT BranchTargetAddress)
+/**
+ *  Create and map the live counters file of given size, the file is
+ *  filled with zeros by the OS.
+ */
+BOOL LiveOpen(const char *lpszPath, UINT64 Size)
 {
-    if (BranchTargetAddress)
-    {
-        // log routine information
-        CountRoutine(BranchTargetAddress);      
+    VOID *Data = NULL;
 
-        // lookup for the current thread info
-        THREADID ThreadIndex = PIN_ThreadId();
-        if (m_ThreadCalls.find(ThreadIndex) != m_ThreadCalls.end())
+#if defined(TARGET_WINDOWS)
+
+    m_hLiveFile = WINDOWS::CreateFileA(
+        lpszPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, 
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (m_hLiveFile == (WINDOWS::HANDLE)-1)
+    {
+        m_hLiveFile = NULL;
+        return false;
+    }
+
+    m_hLiveMapping = WINDOWS::CreateFileMappingA(
+        m_hLiveFile, NULL, PAGE_READWRITE, 
+        (WINDOWS::DWORD)(Size >> 32), (WINDOWS::DWORD)Size, NULL
+    );
+    if (m_hLiveMapping == NULL)
+    {
+        WINDOWS::CloseHandle(m_hLiveFile);
+        m_hLiveFile = NULL;
+        return false;
+    }
+
+    Data = WINDOWS::MapViewOfFile(m_hLiveMapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (Data == NULL)
+    {
+        WINDOWS::CloseHandle(m_hLiveMapping);
+        WINDOWS::CloseHandle(m_hLiveFile);
+        m_hLiveFile = m_hLiveMapping = NULL;
+        return false;
+    }
+
+#else
+
+    int fd = open(lpszPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    if (ftruncate(fd, (off_t)Size) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // mapping stays valid after the file closing
+    Data = mmap(NULL, (size_t)Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (Data == MAP_FAILED)
+    {
+        return false;
+    }
+
+#endif
+
+    m_Live = (PCOVLIVE_HEADER)Data;
+    m_Live->Version = COVLIVE_VERSION;
+    m_Live->ProcessId = m_ProcessId;
+    m_Live->ChunkSlots = COUNTERS_CHUNK_SIZE;
+    m_Live->Size = Size;
+
+    // arena starts at the first page after the header
+    m_Live->Used = (sizeof(COVLIVE_HEADER) + COVLIVE_ALIGN - 1) & ~((UINT64)COVLIVE_ALIGN - 1);
+    m_Live->State = COVLIVE_STATE_RUNNING;
+
+    // signature is written last, reader ignores the file without it
+    memcpy(m_Live->Signature, COVLIVE_SIGNATURE, sizeof(m_Live->Signature));
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Mark the live counters file as consistent and unmap it.
+ */
+VOID LiveClose(VOID)
+{
+    if (m_Live == NULL)
+    {
+        return;
+    }
+
+    m_Live->State = COVLIVE_STATE_FINISHED;
+    m_Live->Commit += 1;
+
+#if defined(TARGET_WINDOWS)
+
+    WINDOWS::FlushViewOfFile(m_Live, 0);
+    WINDOWS::UnmapViewOfFile(m_Live);
+    WINDOWS::CloseHandle(m_hLiveMapping);
+    WINDOWS::CloseHandle(m_hLiveFile);
+    m_hLiveFile = m_hLiveMapping = NULL;
+
+#else
+
+    UINT64 Size = m_Live->Size;
+    msync(m_Live, (size_t)Size, MS_SYNC);
+    munmap(m_Live, (size_t)Size);
+
+#endif
+
+    m_Live = NULL;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Publish the entry that was written into the live counters file header.
+ *  Entry data must be completely written before the count increment, 
+ *  stores to volatile fields are not reordered by the compiler and x86 CPU.
+ */
+VOID LiveCommit(volatile COVDB_UINT32 *Count)
+{
+    *Count += 1;
+    m_Live->Commit += 1;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Allocate a zero filled chunk inside of the live counters file arena,
+ *  returns NULL if there is no free space left. Must be called with 
+ *  m_ThreadsLock acquired.
+ */
+VOID *LiveChunkAlloc(UINT32 Type, UINT32 Index, size_t Size)
+{
+    UINT64 AlignedSize = (Size + COVLIVE_ALIGN - 1) & ~((UINT64)COVLIVE_ALIGN - 1);
+
+    if (m_Live->ChunksCount >= COVLIVE_MAX_CHUNKS || 
+        m_Live->Size - m_Live->Used < AlignedSize)
+    {
+        if (m_LiveOverflows == 0)
+        {
+            cerr << "WARNING: Live counters file is full, increase -live_size value" << endl;
+        }
+
+        m_LiveOverflows += 1;
+        return NULL;
+    }
+
+    UINT32 Entry = m_Live->ChunksCount;
+    VOID *Chunk = (UINT8 *)m_Live + m_Live->Used;
+
+    m_Live->Chunks[Entry].Type = Type;
+    m_Live->Chunks[Entry].Index = Index;
+    m_Live->Chunks[Entry].Offset = m_Live->Used;
+    m_Live->Used += AlignedSize;
+
+    LiveCommit(&m_Live->ChunksCount);
+
+    m_LiveChunks[Chunk] = Entry;
+    return Chunk;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Write module information into the live counters file, modules
+ *  are stored by module ID.
+ */
+VOID LiveModuleWrite(UINT32 ModuleId)
+{
+    if (m_Live == NULL || ModuleId >= COVLIVE_MAX_MODULES || ModuleId != m_Live->ModulesCount)
+    {
+        return;
+    }
+
+    PCOVLIVE_MODULE Entry = &m_Live->Modules[ModuleId];
+    PMODULE_INFO Module = &m_ModuleList[ModuleId];
+
+    Entry->Start = Module->Start;
+    Entry->End = Module->End;
+    Entry->Load = Module->Load;
+    Entry->Unload = Module->Unload;
+
+    strncpy(Entry->Path, Module->Path.c_str(), COVLIVE_PATH_SIZE - 1);
+
+    LiveCommit(&m_Live->ModulesCount);
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Allocate epoch map with the flags for all of the possible slots, 
+ *  untouched pages of zero filled allocation are not committed by the OS.
+ */
+PEPOCH_MAP EpochMapAlloc(VOID)
+{
+    PEPOCH_MAP Map = new EPOCH_MAP;
+
+    Map->Flags = (UINT8 *)calloc(COUNTERS_MAX_SLOTS, sizeof(UINT8));
+    if (Map->Flags == NULL)
+    {
+        cerr << "ERROR: Unable to allocate epoch map" << endl;
+        PIN_ExitProcess(-1);
+    }
+
+    Map->Start = Map->End = Map->Instructions = 0;
+    m_EpochMapsCount += 1;
+
+    return Map;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Allocate zero filled chunk of basic block counters or hit flags, 
+ *  it's allocated in the live counters file when it's available.
+ *  Must be called with m_ThreadsLock acquired.
+ */
+VOID *CountersChunkAlloc(size_t ItemSize, UINT32 Type, UINT32 Index)
+{
+    if (m_Live)
+    {
+        if (Type == COVLIVE_CHUNK_COUNTERS && m_LiveFree.size() > 0)
+        {
+            // reuse counters chunk of terminated thread, it's allready zeroed
+            UINT32 *Chunk = m_LiveFree.back();
+            m_LiveFree.pop_back();
+
+            m_Live->Chunks[m_LiveChunks[Chunk]].Index = Index;
+            return Chunk;
+        }
+
+        VOID *Chunk = LiveChunkAlloc(Type, Index, COUNTERS_CHUNK_SIZE * ItemSize);
+        if (Chunk)
+        {
+            return Chunk;
+        }
+    }
+
+    VOID *Chunk = malloc(COUNTERS_CHUNK_SIZE * ItemSize);
+    if (Chunk == NULL)
+    {
+        cerr << "ERROR: Unable to allocate counters chunk" << endl;
+        PIN_ExitProcess(-1);
+    }
+
+    memset(Chunk, 0, COUNTERS_CHUNK_SIZE * ItemSize);
+    return Chunk;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Free per-thread counters chunk, counters must be merged allready.
+ *  Must be called with m_ThreadsLock acquired.
+ */
+VOID CountersChunkFree(UINT32 *Chunk)
+{
+    if (m_Live && m_LiveChunks.find(Chunk) != m_LiveChunks.end())
+    {
+        m_LiveFree.push_back(Chunk);
+        return;
+    }
+
+    free(Chunk);
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Get slot number of the basic block counter, allocates a new one if
+ *  the block was not instrumented yet. Returns COUNTERS_MAX_SLOTS when
+ *  there is no free slots left.
+ */
+UINT32 BasicBlockSlot(UINT32 Module, ADDRINT Address, UINT32 Size, UINT32 Instructions)
+{
+    // the same address might belong to different modules over time
+    BASIC_BLOCK Block = std::make_pair(Module, std::make_pair(Address, Size));
+
+    BASIC_BLOCKS::iterator it = m_BasicBlocks.find(Block);
+    if (it != m_BasicBlocks.end())
+    {
+        // basic block was allready instrumented in some other trace
+        return (*it).second;
+    }
+
+    UINT32 Slot = (UINT32)m_BasicBlocksSlots.size();
+    if (Slot >= COUNTERS_MAX_SLOTS)
+    {
+        return COUNTERS_MAX_SLOTS;
+    }
+
+    if (COUNTERS_INDEX(Slot) == 0)
+    {
+        PIN_GetLock(&m_ThreadsLock, PIN_ThreadId() + 1);
+
+        if (KnobHitOnly.Value())
+        {
+            // hit-only mode has no counters, only the executed blocks map
+            m_HitMap[COUNTERS_CHUNK(Slot)] = (UINT8 *)CountersChunkAlloc(
+                sizeof(UINT8), COVLIVE_CHUNK_HITS, COUNTERS_CHUNK(Slot)
+            );
+        }
+        else
+        {
+            // allocate a new chunk of counters for all of the running threads
+            for (THREADS_LIST::iterator it = m_ThreadsList.begin(); it != m_ThreadsList.end(); it++)
+            {
+                (*it).second->Counters[COUNTERS_CHUNK(Slot)] = (UINT32 *)CountersChunkAlloc(
+                    sizeof(UINT32), COVLIVE_CHUNK_COUNTERS, COUNTERS_CHUNK(Slot)
+                );
+            }
+
+            m_Counters[COUNTERS_CHUNK(Slot)] = (UINT32 *)CountersChunkAlloc(
+                sizeof(UINT32), COVLIVE_CHUNK_COUNTERS, COUNTERS_CHUNK(Slot)
+            );
+        }
+
+        if (m_Live)
+        {
+            // allocate blocks information chunk for the recovery
+            m_LiveBlocks[COUNTERS_CHUNK(Slot)] = (PCOVLIVE_BLOCK)LiveChunkAlloc(
+                COVLIVE_CHUNK_BLOCKS, COUNTERS_CHUNK(Slot), COUNTERS_CHUNK_SIZE * sizeof(COVLIVE_BLOCK)
+            );
+        }
+
+        PIN_ReleaseLock(&m_ThreadsLock);
+    }
+
+    BASIC_BLOCK_PARAMS Params;
+    Params.Address = Address;
+    Params.Size = Size;
+    Params.Instructions = Instructions;
+    Params.Module = Module;
+
+    m_BasicBlocksSlots.push_back(Params);
+    m_BasicBlocks[Block] = Slot;
+
+    if (m_Live)
+    {
+        PIN_GetLock(&m_ThreadsLock, PIN_ThreadId() + 1);
+
+        if (m_LiveBlocks[COUNTERS_CHUNK(Slot)])
+        {
+            PCOVLIVE_BLOCK Entry = &m_LiveBlocks[COUNTERS_CHUNK(Slot)][COUNTERS_INDEX(Slot)];
+
+            Entry->Address = Address;
+            Entry->Module = Module;
+            Entry->Size = Size;
+            Entry->Instructions = Instructions;
+        }
+
+        /*
+            Commit the slot even if its blocks chunk wasn't allocated because 
+            of the full live counters file, otherwise all of the following slots 
+            would be lost. Recovery skips the slots without blocks information.
+        */
+        if (Slot >= m_Live->SlotsCount)
+        {
+            m_Live->SlotsCount = Slot + 1;
+            m_Live->Commit += 1;
+        }
+
+        PIN_ReleaseLock(&m_ThreadsLock);
+    }
+
+    return Slot;
+}
+//--------------------------------------------------------------------------------------
+VOID PIN_FAST_ANALYSIS_CALL CountBbl(PTHREAD_PARAMS Thread, UINT32 Slot)
+{
+    Thread->Counters[COUNTERS_CHUNK(Slot)][COUNTERS_INDEX(Slot)] += 1;
+}
+//--------------------------------------------------------------------------------------
+ADDRINT PIN_FAST_ANALYSIS_CALL EdgeCacheLookup(PTHREAD_PARAMS Thread, UINT32 Slot, UINT32 Location)
+{
+    UINT64 Prev = Thread->EdgePrev;
+    PEDGE_ENTRY Entry = &Thread->EdgeCache[Location ^ (UINT32)Prev];
+
+    UINT64 Edge = (Prev & ~(UINT64)EDGE_ENTRY_COUNT_MAX) | EDGE_ENTRY_TO(Slot);
+
+    /*
+        Update the counter if this edge is in the cache and the counter is not
+        saturated: difference of the entry and counter-less edge value is the 
+        counter value only when the slot numbers are matching.
+    */
+    ADDRINT bHit = (*Entry - Edge < EDGE_ENTRY_COUNT_MAX);
+    *Entry += bHit;
+
+    // save previous block for EdgeCacheMiss()
+    Thread->EdgeMissPrev = Prev;
+    Thread->EdgePrev = EDGE_ENTRY_FROM(Slot) | (Location >> 1);
+
+    return !bHit;
+}
+//--------------------------------------------------------------------------------------
+inline VOID EdgeCacheEvict(PTHREAD_PARAMS Thread, EDGE_ENTRY Entry)
+{
+    if (EDGE_ENTRY_COUNT(Entry) > 0)
+    {
+        // move the counter into the thread edges list
+        Thread->Edges[EDGE_ENTRY_KEY(Entry)] += EDGE_ENTRY_COUNT(Entry);
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID PIN_FAST_ANALYSIS_CALL EdgeCacheMiss(PTHREAD_PARAMS Thread, UINT32 Slot, UINT32 Location)
+{
+    UINT64 Prev = Thread->EdgeMissPrev;
+    PEDGE_ENTRY Entry = &Thread->EdgeCache[Location ^ (UINT32)Prev];
+
+    // evict the previous edge or saturated counter of this one
+    EdgeCacheEvict(Thread, *Entry);
+
+    *Entry = (Prev & ~(UINT64)EDGE_ENTRY_COUNT_MAX) | EDGE_ENTRY_TO(Slot) | 1;
+}
+//--------------------------------------------------------------------------------------
+VOID PIN_FAST_ANALYSIS_CALL EpochHitBbl(UINT32 Slot)
+{
+    m_EpochFlags[Slot] = 1;
+}
+//--------------------------------------------------------------------------------------
+ADDRINT PIN_FAST_ANALYSIS_CALL IsBblNotHit(UINT32 Slot)
+{
+    return m_HitMap[COUNTERS_CHUNK(Slot)][COUNTERS_INDEX(Slot)] == 0;
+}
+//--------------------------------------------------------------------------------------
+VOID HitBbl(UINT32 Slot, ADDRINT Address, UINT32 Size)
+{
+    m_HitMap[COUNTERS_CHUNK(Slot)][COUNTERS_INDEX(Slot)] = 1;
+
+    /*
+        Remove all of the traces that contain this basic block from the code 
+        cache, not only the one that was executed: the same block might be 
+        a part of several traces. They will be instrumented again without
+        this basic block at the next execution.
+    */
+    CODECACHE_InvalidateRange(Address, Address + Size - 1);
+}
+//--------------------------------------------------------------------------------------
+UINT32 BasicBlockCalls(UINT32 Slot)
+{
+    if (KnobHitOnly.Value())
+    {
+        return m_HitMap[COUNTERS_CHUNK(Slot)][COUNTERS_INDEX(Slot)];
+    }
+
+    return m_Counters[COUNTERS_CHUNK(Slot)][COUNTERS_INDEX(Slot)];
+}
+//--------------------------------------------------------------------------------------
+bool ModuleRangeLess(const MODULE_RANGE &First, const MODULE_RANGE &Second)
+{
+    return First.Start < Second.Start;
+}
+//--------------------------------------------------------------------------------------
+VOID ModuleRangesUpdate(VOID)
+{
+    MODULE_RANGES *Ranges = new MODULE_RANGES;
+
+    for (UINT32 i = 0; i < m_ModuleList.size(); i++) 
+    {
+        if (m_ModuleList[i].Unload == 0)
+        {
+            MODULE_RANGE Range;
+
+            Range.Start = m_ModuleList[i].Start;
+            Range.End = m_ModuleList[i].End;
+            Range.Id = i;
+
+            Ranges->push_back(Range);
+        }
+    }
+
+    std::sort(Ranges->begin(), Ranges->end(), ModuleRangeLess);
+
+    // publish the new table
+    m_LiveRanges = Ranges;
+    m_ModulesEpoch += 1;
+}
+//--------------------------------------------------------------------------------------
+BOOL LookupModule(ADDRINT Address, UINT32 *ModuleId, ADDRINT *Offset)
+{
+    MODULE_RANGES *Ranges = m_LiveRanges;
+    if (Ranges == NULL)
+    {
+        return false;
+    }
+
+    size_t Low = 0, High = Ranges->size();
+
+    // find the last range that starts at or below of the given address
+    while (Low < High)
+    {
+        size_t Middle = Low + (High - Low) / 2;
+
+        if ((*Ranges)[Middle].Start <= Address)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    if (Low > 0 && Address <= (*Ranges)[Low - 1].End)
+    {
+        *ModuleId = (*Ranges)[Low - 1].Id;
+
+        if (Offset)
+        {
+            *Offset = Address - (*Ranges)[Low - 1].Start;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+//--------------------------------------------------------------------------------------
+UINT32 ModuleByImage(IMG Image)
+{
+    if (IMG_Valid(Image))
+    {
+        std::map<UINT32, UINT32>::iterator it = m_ImageModules.find(IMG_Id(Image));
+        if (it != m_ImageModules.end())
+        {
+            return (*it).second;
+        }
+    }
+
+    return MODULE_UNKNOWN;
+}
+//--------------------------------------------------------------------------------------
+MODULE_ADDRESS ModuleAddress(ADDRINT Address)
+{
+    MODULE_ADDRESS Result = std::make_pair(MODULE_UNKNOWN, Address);
+
+    // absolute address is used for the code that doesn't belong to any module
+    LookupModule(Address, &Result.first, &Result.second);
+
+    return Result;
+}
+//--------------------------------------------------------------------------------------
+PCALL_BUFFER CallBufferAlloc(VOID)
+{
+    while (true)
+    {
+        PCALL_BUFFER Buffer = NULL;
+
+        PIN_GetLock(&m_CallBuffersLock, PIN_ThreadId() + 1);
+
+        if (m_CallBuffersFree)
+        {
+            // use existing free buffer
+            Buffer = m_CallBuffersFree;
+            m_CallBuffersFree = Buffer->Next;
+        }
+        else if (m_CallBuffersCount < CALL_BUFFERS_MAX || m_CallLogStop)
+        {
+            // there is no limit when writer thread is stopped at exit, Fini() writes the rest of buffers
+            if ((Buffer = (PCALL_BUFFER)malloc(sizeof(CALL_BUFFER))) != NULL)
+            {
+                m_CallBuffersCount += 1;
+            }
+        }
+
+        if (Buffer == NULL)
+        {
+            // writer thread can't keep up, wait for free buffer
+            m_CallBuffersStalls += 1;
+        }
+
+        PIN_ReleaseLock(&m_CallBuffersLock);
+
+        if (Buffer)
+        {
+            Buffer->Next = NULL;
+            Buffer->f = NULL;
+            Buffer->bClose = false;
+            Buffer->Count = 0;
+
+            return Buffer;
+        }
+
+        PIN_SemaphoreSet(&m_CallLogEvent);
+        PIN_Sleep(1);
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID CallBufferFlush(PCALL_TREE_PARAMS CallTree, bool bClose)
+{
+    PCALL_BUFFER Buffer = CallTree->Buffer;
+
+    Buffer->f = CallTree->f;
+    Buffer->bClose = bClose;
+    Buffer->Count = (UINT32)(CallTree->Ptr - Buffer->Records);
+
+    PIN_GetLock(&m_CallBuffersLock, PIN_ThreadId() + 1);
+
+    // add buffer into the writing queue
+    if (m_CallBuffersTail)
+    {
+        m_CallBuffersTail->Next = Buffer;
+    }
+    else
+    {
+        m_CallBuffersHead = Buffer;
+    }
+
+    m_CallBuffersTail = Buffer;
+    m_CallRecordsCount += Buffer->Count;
+
+    PIN_ReleaseLock(&m_CallBuffersLock);
+
+    // wake up writer thread
+    PIN_SemaphoreSet(&m_CallLogEvent);
+
+    if (bClose)
+    {
+        // log file is owned by the writer thread now
+        CallTree->f = NULL;
+        CallTree->Buffer = NULL;
+        CallTree->Ptr = CallTree->End = NULL;
+    }
+    else
+    {
+        CallTree->Buffer = CallBufferAlloc();
+        CallTree->Ptr = CallTree->Buffer->Records;
+        CallTree->End = CallTree->Buffer->Records + CALL_BUFFER_SIZE;
+    }
+}
+//--------------------------------------------------------------------------------------
+UINT32 CallLogPackValue(UINT8 *Data, ADDRINT Value, ADDRINT PrevValue)
+{
+    UINT32 Size = 0;
+
+    // zigzag encoding of the signed delta
+    ADDRDELTA Delta = (ADDRDELTA)(Value - PrevValue);
+    ADDRINT Packed = (ADDRINT)((Delta << 1) ^ (Delta >> (sizeof(ADDRDELTA) * 8 - 1)));
+
+    // variable length encoding, 7 bits per byte
+    while (Packed >= 0x80)
+    {
+        Data[Size++] = (UINT8)(Packed | 0x80);
+        Packed >>= 7;
+    }
+
+    Data[Size++] = (UINT8)Packed;
+
+    return Size;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Decode the value that was packed with CallLogPackValue(), Pos is 
+ *  updated to point to the next value.
+ */
+ADDRINT CallLogUnpackValue(const UINT8 *Data, size_t *Pos, ADDRINT PrevValue)
+{
+    ADDRINT Packed = 0;
+    UINT32 Shift = 0;
+
+    while (Data[*Pos] & 0x80)
+    {
+        Packed |= (ADDRINT)(Data[*Pos] & 0x7f) << Shift;
+        Shift += 7;
+        *Pos += 1;
+    }
+
+    Packed |= (ADDRINT)Data[*Pos] << Shift;
+    *Pos += 1;
+
+    ADDRDELTA Delta = (ADDRDELTA)((Packed >> 1) ^ (ADDRINT)(-(ADDRDELTA)(Packed & 1)));
+    return PrevValue + Delta;
+}
+//--------------------------------------------------------------------------------------
+VOID CallLogWrite(PCALL_BUFFER Buffer)
+{
+    /*
+        Each buffer is written as separate chunk:
+
+            <records_count:UINT32> <packed_size:UINT32> <packed_records>
+
+        Every record is encoded as delta of caller and callee addresses
+        from the previous record of the chunk, zigzag'ed and packed into
+        7-bit variable length integers.
+    */
+    static UINT8 Data[CALL_BUFFER_SIZE * sizeof(CALL_RECORD) * 2];
+    UINT32 Size = 0;
+
+    ADDRINT PrevCaller = 0, PrevCallee = 0;
+
+    for (UINT32 i = 0; i < Buffer->Count; i++)
+    {
+        PCALL_RECORD Record = &Buffer->Records[i];
+
+        Size += CallLogPackValue(Data + Size, Record->Caller, PrevCaller);
+        Size += CallLogPackValue(Data + Size, Record->Callee, PrevCallee);
+
+        PrevCaller = Record->Caller;
+        PrevCallee = Record->Callee;
+    }
+
+    if (Buffer->Count > 0)
+    {
+        fwrite(&Buffer->Count, sizeof(UINT32), 1, Buffer->f);
+        fwrite(&Size, sizeof(UINT32), 1, Buffer->f);
+        fwrite(Data, 1, Size, Buffer->f);
+    }
+
+    if (Buffer->bClose)
+    {
+        fclose(Buffer->f);
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID CallLogDrain(VOID)
+{
+    // only one thread can write the logs at the same time to keep the records order
+    PIN_GetLock(&m_CallLogWriteLock, PIN_ThreadId() + 1);
+    PIN_GetLock(&m_CallBuffersLock, PIN_ThreadId() + 1);
+
+    // take all of the queued buffers
+    PCALL_BUFFER Buffer = m_CallBuffersHead;
+    m_CallBuffersHead = m_CallBuffersTail = NULL;
+
+    PIN_ReleaseLock(&m_CallBuffersLock);
+
+    while (Buffer)
+    {
+        PCALL_BUFFER Next = Buffer->Next;
+
+        CallLogWrite(Buffer);
+
+        PIN_GetLock(&m_CallBuffersLock, PIN_ThreadId() + 1);
+
+        // return buffer into the free list
+        Buffer->Next = m_CallBuffersFree;
+        m_CallBuffersFree = Buffer;
+
+        PIN_ReleaseLock(&m_CallBuffersLock);
+
+        Buffer = Next;
+    }
+
+    PIN_ReleaseLock(&m_CallLogWriteLock);
+}
+//--------------------------------------------------------------------------------------
+VOID CallLogWriterThread(VOID *Param)
+{
+    while (!m_CallLogStop)
+    {
+        PIN_SemaphoreTimedWait(&m_CallLogEvent, 100);
+        PIN_SemaphoreClear(&m_CallLogEvent);
+
+        CallLogDrain();
+    }
+}
+//--------------------------------------------------------------------------------------
+inline UINT32 CallEdgeHash(ADDRINT Caller, ADDRINT Callee)
+{
+    return (UINT32)(Caller * 0x9e3779b1) ^ (UINT32)(Callee * 0x85ebca6b);
+}
+//--------------------------------------------------------------------------------------
+PCALL_EDGE CallEdgesAlloc(UINT32 Size)
+{
+    PCALL_EDGE Edges = (PCALL_EDGE)malloc(Size * sizeof(CALL_EDGE));
+    if (Edges == NULL)
+    {
+        cerr << "ERROR: Unable to allocate call edges table" << endl;
+        PIN_ExitProcess(-1);
+    }
+
+    // callee address of the empty entry is zero
+    memset(Edges, 0, Size * sizeof(CALL_EDGE));
+    return Edges;
+}
+//--------------------------------------------------------------------------------------
+VOID CallEdgesGrow(PCALL_TREE_PARAMS CallTree)
+{
+    UINT32 Size = (CallTree->EdgesMask + 1) * 2;
+    PCALL_EDGE Edges = CallEdgesAlloc(Size);
+
+    // rehash all of the existing edges into the new table
+    for (UINT32 i = 0; i <= CallTree->EdgesMask; i++)
+    {
+        PCALL_EDGE Edge = &CallTree->Edges[i];
+
+        if (Edge->Callee)
+        {
+            UINT32 Index = CallEdgeHash(Edge->Caller, Edge->Callee) & (Size - 1);
+
+            while (Edges[Index].Callee)
+            {
+                Index = (Index + 1) & (Size - 1);
+            }
+
+            Edges[Index] = *Edge;
+        }
+    }
+
+    free(CallTree->Edges);
+
+    CallTree->Edges = Edges;
+    CallTree->EdgesMask = Size - 1;
+}
+//--------------------------------------------------------------------------------------
+VOID CallEdgeAdd(PCALL_TREE_PARAMS CallTree, ADDRINT Caller, ADDRINT Callee)
+{
+    UINT32 Index = CallEdgeHash(Caller, Callee) & CallTree->EdgesMask;
+
+    // linear probing
+    while (true)
+    {
+        PCALL_EDGE Edge = &CallTree->Edges[Index];
+
+        if (Edge->Caller == Caller && Edge->Callee == Callee)
+        {
+            Edge->Calls += 1;
+            return;
+        }
+
+        if (Edge->Callee == 0)
+        {
+            // allocate a new entry
+            Edge->Caller = Caller;
+            Edge->Callee = Callee;
+            Edge->Calls = 1;
+            break;
+        }
+
+        Index = (Index + 1) & CallTree->EdgesMask;
+    }
+
+    // keep load factor below 1/2
+    if ((CallTree->EdgesCount += 1) * 2 > CallTree->EdgesMask)
+    {
+        CallEdgesGrow(CallTree);
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID CallEdgesWrite(PCALL_TREE_PARAMS CallTree, THREADID ThreadIndex)
+{
+    char szLogName[MAX_PATH];
+
+    std::string LogCommon = KnobOutputDir.Value();
+    LogCommon += "/";        
+    LogCommon += KnobOutputFile.Value();
+
+    sprintf(szLogName, "%s.%d", LogCommon.c_str(), ThreadIndex);
+
+    // create call tree log file for this thread
+    FILE *f = fopen(szLogName, "wb+");
+    if (f)
+    {
+        PrintLogFileHeader(f);
+        fprintf(f, "# Call tree log file for thread %d\r\n#\r\n", ThreadIndex);
+        fprintf(f, "# <caller>:<callee>:<calls>\r\n#\r\n");
+
+        // enumerate unique call edges
+        for (UINT32 i = 0; i <= CallTree->EdgesMask; i++)
+        {
+            PCALL_EDGE Edge = &CallTree->Edges[i];
+
+            if (Edge->Callee)
+            {
+                fprintf(f, "0x%.8x:0x%.8x:%d\r\n", Edge->Caller, Edge->Callee, Edge->Calls);
+            }
+        }
+
+        fclose(f);
+    }
+
+    PIN_GetLock(&m_ThreadsLock, ThreadIndex + 1);
+
+    m_CallEdgesCount += CallTree->EdgesCount;
+
+    // merge call edges of the thread for coverage database
+    for (UINT32 i = 0; i <= CallTree->EdgesMask && KnobDatabase.Value(); i++)
+    {
+        PCALL_EDGE Edge = &CallTree->Edges[i];
+
+        if (Edge->Callee)
+        {
+            MODULE_ADDRESS Caller = ModuleAddress(Edge->Caller);
+            MODULE_ADDRESS Callee = ModuleAddress(Edge->Callee);
+
+            m_CallEdges[std::make_pair(Caller, Callee)] += Edge->Calls;
+        }
+    }
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+
+    free(CallTree->Edges);
+
+    CallTree->Edges = NULL;
+    CallTree->EdgesMask = CallTree->EdgesCount = 0;
+    CallTree->bEnabled = false;
+}
+//--------------------------------------------------------------------------------------
+PCCT_NODE CctNodeById(PCCT_TREE Tree, UINT32 Id)
+{
+    return &Tree->Chunks[Id >> CCT_CHUNK_SHIFT][Id & CCT_CHUNK_MASK];
+}
+//--------------------------------------------------------------------------------------
+PCCT_NODE CctNodeAlloc(PCCT_TREE Tree, PCCT_NODE Parent, ADDRINT Routine)
+{
+    if ((Tree->NodesCount & CCT_CHUNK_MASK) == 0)
+    {
+        // allocate a new arena chunk
+        PCCT_NODE Chunk = (PCCT_NODE)malloc(CCT_CHUNK_SIZE * sizeof(CCT_NODE));
+        if (Chunk == NULL)
+        {
+            cerr << "ERROR: Unable to allocate calling context tree nodes" << endl;
+            PIN_ExitProcess(-1);
+        }
+
+        Tree->Chunks.push_back(Chunk);
+    }
+
+    PCCT_NODE Node = CctNodeById(Tree, Tree->NodesCount);
+
+    memset(Node, 0, sizeof(CCT_NODE));
+    Node->Routine = Routine;
+    Node->Id = Tree->NodesCount;
+    Node->Parent = Parent;
+
+    Tree->NodesCount += 1;
+
+    return Node;
+}
+//--------------------------------------------------------------------------------------
+VOID CctInit(PCCT_TREE Tree)
+{
+    Tree->NodesCount = 0;
+    Tree->Root = CctNodeAlloc(Tree, NULL, 0);
+}
+//--------------------------------------------------------------------------------------
+VOID CctFree(PCCT_TREE Tree)
+{
+    for (UINT32 i = 0; i < Tree->NodesCount; i++)
+    {
+        PCCT_NODE Node = CctNodeById(Tree, i);
+
+        if (Node->ChildrenHash)
+        {
+            free(Node->ChildrenHash);
+        }
+    }
+
+    for (std::vector<PCCT_NODE>::iterator it = Tree->Chunks.begin(); it != Tree->Chunks.end(); it++)
+    {
+        free(*it);
+    }
+
+    Tree->Chunks.clear();
+    Tree->NodesCount = 0;
+    Tree->Root = NULL;
+}
+//--------------------------------------------------------------------------------------
+VOID CctHashInsert(PCCT_NODE *Hash, UINT32 Mask, PCCT_NODE Child)
+{
+    UINT32 Index = (UINT32)(Child->Routine * 0x9e3779b1) & Mask;
+
+    // linear probing
+    while (Hash[Index])
+    {
+        Index = (Index + 1) & Mask;
+    }
+
+    Hash[Index] = Child;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Find child node for the given routine, allocates a new one if it's not exists.
+ */
+PCCT_NODE CctChild(PCCT_TREE Tree, PCCT_NODE Node, ADDRINT Routine)
+{
+    UINT32 i = 0;
+
+    for (i = 0; i < Node->ChildrenCount && i < CCT_INLINE_CHILDREN; i++)
+    {
+        if (Node->Children[i]->Routine == Routine)
+        {
+            return Node->Children[i];
+        }
+    }
+
+    if (Node->ChildrenHash)
+    {
+        UINT32 Index = (UINT32)(Routine * 0x9e3779b1) & Node->ChildrenHashMask;
+
+        while (Node->ChildrenHash[Index])
+        {
+            if (Node->ChildrenHash[Index]->Routine == Routine)
+            {
+                return Node->ChildrenHash[Index];
+            }
+
+            Index = (Index + 1) & Node->ChildrenHashMask;
+        }
+    }
+
+    PCCT_NODE Child = CctNodeAlloc(Tree, Node, Routine);
+
+    if (Node->ChildrenCount < CCT_INLINE_CHILDREN)
+    {
+        Node->Children[Node->ChildrenCount] = Child;
+    }
+    else
+    {
+        UINT32 HashCount = Node->ChildrenCount - CCT_INLINE_CHILDREN + 1;
+
+        if (Node->ChildrenHash == NULL || HashCount * 2 > Node->ChildrenHashMask)
+        {
+            // allocate a new or grow existing hash table
+            UINT32 Size = Node->ChildrenHash ? (Node->ChildrenHashMask + 1) * 2 : CCT_HASH_INIT_SIZE;
+            PCCT_NODE *Hash = (PCCT_NODE *)malloc(Size * sizeof(PCCT_NODE));
+            if (Hash == NULL)
+            {
+                cerr << "ERROR: Unable to allocate calling context tree nodes" << endl;
+                PIN_ExitProcess(-1);
+            }
+
+            memset(Hash, 0, Size * sizeof(PCCT_NODE));
+
+            if (Node->ChildrenHash)
+            {
+                for (UINT32 n = 0; n <= Node->ChildrenHashMask; n++)
+                {
+                    if (Node->ChildrenHash[n])
+                    {
+                        CctHashInsert(Hash, Size - 1, Node->ChildrenHash[n]);
+                    }
+                }
+
+                free(Node->ChildrenHash);
+            }
+
+            Node->ChildrenHash = Hash;
+            Node->ChildrenHashMask = Size - 1;
+        }
+
+        CctHashInsert(Node->ChildrenHash, Node->ChildrenHashMask, Child);
+    }
+
+    Node->ChildrenCount += 1;
+
+    return Child;
+}
+//--------------------------------------------------------------------------------------
+VOID CctMerge(PCCT_TREE Dst, PCCT_TREE Src)
+{
+    // node ID's are allocated in creation order, so parent is always before its children
+    std::vector<PCCT_NODE> DstNodes(Src->NodesCount);
+
+    for (UINT32 i = 0; i < Src->NodesCount; i++)
+    {
+        PCCT_NODE Node = CctNodeById(Src, i);
+        PCCT_NODE DstNode = Dst->Root;
+
+        if (Node->Parent)
+        {
+            DstNode = CctChild(Dst, DstNodes[Node->Parent->Id], Node->Routine);
+        }
+
+        DstNode->Calls += Node->Calls;
+        DstNode->Instructions += Node->Instructions;
+
+        DstNodes[i] = DstNode;
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID CctWrite(PCCT_TREE Tree, const char *lpszLogName, const char *lpszDescription)
+{
+    FILE *f = fopen(lpszLogName, "wb+");
+    if (f)
+    {
+        PrintLogFileHeader(f);
+        fprintf(f, "# %s\r\n#\r\n", lpszDescription);
+        fprintf(f, "# <node>:<parent_node>:<routine>:<calls>:<instructions>\r\n#\r\n");
+
+        for (UINT32 i = 0; i < Tree->NodesCount; i++)
+        {
+            PCCT_NODE Node = CctNodeById(Tree, i);
+
+            // dump single node information
+            fprintf(
+                f, "%d:%d:0x%.8x:%llu:%llu\r\n", 
+                Node->Id, Node->Parent ? Node->Parent->Id : 0, Node->Routine, 
+                (unsigned long long)Node->Calls, (unsigned long long)Node->Instructions
+            );
+        }
+
+        fclose(f);
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID CctThreadEnd(PTHREAD_PARAMS Thread)
+{
+    char szLogName[MAX_PATH], szDescription[MAX_PATH];
+
+    std::string LogCommon = KnobOutputDir.Value();
+    LogCommon += "/";        
+    LogCommon += KnobOutputFile.Value();
+
+    sprintf(szLogName, "%s.cct.%d", LogCommon.c_str(), Thread->ThreadIndex);
+    sprintf(szDescription, "Calling context tree log file for thread %d", Thread->ThreadIndex);
+
+    CctWrite(&Thread->Cct, szLogName, szDescription);
+
+    PIN_GetLock(&m_ThreadsLock, Thread->ThreadIndex + 1);
+
+    // merge tree of the thread into the process tree
+    CctMerge(&m_Cct, &Thread->Cct);
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+
+    CctFree(&Thread->Cct);
+    Thread->CctCurrent = NULL;
+}
+//--------------------------------------------------------------------------------------
+VOID PIN_FAST_ANALYSIS_CALL CctCountIns(PTHREAD_PARAMS Thread, UINT32 Instructions)
+{
+    Thread->CctCurrent->Instructions += Instructions;
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindResolve(ADDRINT Address)
+{
+    char szName[MAX_PATH];
+
+    // IMG_* and RTN_* functions don't work in Fini, so resolve names at the first call
+    PIN_LockClient();
+
+    if (m_RoutinesNames.find(Address) == m_RoutinesNames.end())
+    {
+        std::string ModuleName = "?", RoutineName;
+
+        IMG Image = IMG_FindByAddress(Address);
+        if (IMG_Valid(Image))
+        {
+            std::string ImagePath = IMG_Name(Image);
+            ModuleName = NameFromPath(ImagePath);
+        }
+
+        RTN Routine = RTN_FindByAddress(Address);
+        if (RTN_Valid(Routine) && RTN_Address(Routine) == Address)
+        {
+            RoutineName = RTN_Name(Routine);
+        }
+        else if (RTN_Valid(Routine))
+        {
+            sprintf(szName, "%s+0x%x", RTN_Name(Routine).c_str(), Address - RTN_Address(Routine));
+            RoutineName = szName;
+        }
+        else if (IMG_Valid(Image))
+        {
+            sprintf(szName, "%s+%x", ModuleName.c_str(), Address - IMG_LowAddress(Image));
+            RoutineName = szName;
+        }
+        else
+        {
+            sprintf(szName, "?%#x", Address);
+            RoutineName = szName;
+        }
+
+        m_RoutinesNames[Address] = std::make_pair(ModuleName, RoutineName);
+    }
+
+    PIN_UnlockClient();
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindInit(PTHREAD_PARAMS Thread)
+{
+    PCALLGRIND_FRAME Frame = &Thread->Frames[0].Callgrind;
+
+    // instructions that was executed before the first call are going to the thread start
+    Frame->Routine = &Thread->Callgrind[0];
+    Frame->Call = NULL;
+    Frame->Entry = 0;
+
+    Thread->Instructions = Thread->CallgrindLast = 0;
+}
+//--------------------------------------------------------------------------------------
+inline VOID CallgrindAccount(PTHREAD_PARAMS Thread)
+{
+    // attribute instructions executed since the last call or return to the current routine
+    Thread->Frames[Thread->Depth - 1].Callgrind.Routine->Self += Thread->Instructions - Thread->CallgrindLast;
+    Thread->CallgrindLast = Thread->Instructions;
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindHashInsert(PCALLGRIND_CALL *Hash, UINT32 Mask, PCALLGRIND_CALL Call)
+{
+    UINT32 Index = (UINT32)(Call->Callee * 0x9e3779b1) & Mask;
+
+    // linear probing
+    while (Hash[Index])
+    {
+        Index = (Index + 1) & Mask;
+    }
+
+    Hash[Index] = Call;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Add a new call from the routine, Calls entries and routines profiles of 
+ *  the thread are never moved, so their pointers are cached in the hash table.
+ */
+PCALLGRIND_CALL CallgrindCallAdd(PTHREAD_PARAMS Thread, PCALLGRIND_ROUTINE Caller, ADDRINT Callee)
+{
+    PCALLGRIND_CALL Call = &Caller->Calls[Callee];
+
+    Call->Callee = Callee;
+    Call->Routine = &Thread->Callgrind[Callee];
+
+    if (!Call->Routine->bResolved)
+    {
+        CallgrindResolve(Callee);
+        Call->Routine->bResolved = true;
+    }
+
+    if (Caller->CallsHash == NULL || (Caller->CallsHashCount + 1) * 2 > Caller->CallsHashMask)
+    {
+        // allocate a new or grow existing hash table
+        UINT32 Size = Caller->CallsHash ? (Caller->CallsHashMask + 1) * 2 : CALLGRIND_HASH_INIT_SIZE;
+        PCALLGRIND_CALL *Hash = (PCALLGRIND_CALL *)malloc(Size * sizeof(PCALLGRIND_CALL));
+        if (Hash == NULL)
+        {
+            cerr << "ERROR: Unable to allocate callgrind calls table" << endl;
+            PIN_ExitProcess(-1);
+        }
+
+        memset(Hash, 0, Size * sizeof(PCALLGRIND_CALL));
+
+        if (Caller->CallsHash)
+        {
+            for (UINT32 i = 0; i <= Caller->CallsHashMask; i++)
+            {
+                if (Caller->CallsHash[i])
+                {
+                    CallgrindHashInsert(Hash, Size - 1, Caller->CallsHash[i]);
+                }
+            }
+
+            free(Caller->CallsHash);
+        }
+
+        Caller->CallsHash = Hash;
+        Caller->CallsHashMask = Size - 1;
+    }
+
+    CallgrindHashInsert(Caller->CallsHash, Caller->CallsHashMask, Call);
+    Caller->CallsHashCount += 1;
+
+    return Call;
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindCall(PTHREAD_PARAMS Thread, ADDRINT Callee, PCALLGRIND_FRAME Frame)
+{
+    PCALLGRIND_ROUTINE Caller = Thread->Frames[Thread->Depth - 1].Callgrind.Routine;
+    PCALLGRIND_CALL Call = NULL;
+
+    CallgrindAccount(Thread);
+
+    if (Caller->CallsHash)
+    {
+        UINT32 Index = (UINT32)(Callee * 0x9e3779b1) & Caller->CallsHashMask;
+
+        while (Caller->CallsHash[Index])
+        {
+            if (Caller->CallsHash[Index]->Callee == Callee)
+            {
+                Call = Caller->CallsHash[Index];
+                break;
+            }
+
+            Index = (Index + 1) & Caller->CallsHashMask;
+        }
+    }
+
+    if (Call == NULL)
+    {
+        // first call of this routine from the caller
+        Call = CallgrindCallAdd(Thread, Caller, Callee);
+    }
+
+    Call->Calls += 1;
+
+    Frame->Call = Call;
+    Frame->Routine = Call->Routine;
+    Frame->Entry = Thread->Instructions;
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindReturn(PTHREAD_PARAMS Thread, PCALLGRIND_FRAME Frame)
+{
+    // must be called before the frame removal from the stack
+    CallgrindAccount(Thread);
+
+    Frame->Call->Inclusive += Thread->Instructions - Frame->Entry;
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindThreadEnd(PTHREAD_PARAMS Thread)
+{
+    // complete the calls that are still on the stack
+    while (Thread->Depth > 1)
+    {
+        CallgrindReturn(Thread, &Thread->Frames[Thread->Depth - 1].Callgrind);
+        Thread->Depth -= 1;
+    }
+
+    CallgrindAccount(Thread);
+
+    PIN_GetLock(&m_ThreadsLock, Thread->ThreadIndex + 1);
+
+    // merge profile of the thread into the process profile
+    for (CALLGRIND_ROUTINES::iterator it = Thread->Callgrind.begin(); it != Thread->Callgrind.end(); it++)
+    {
+        CALLGRIND_ROUTINE &Routine = m_Callgrind[(*it).first];
+
+        Routine.Self += (*it).second.Self;
+
+        for (CALLGRIND_CALLS::iterator it_c = (*it).second.Calls.begin(); it_c != (*it).second.Calls.end(); it_c++)
+        {
+            CALLGRIND_CALL &Call = Routine.Calls[(*it_c).first];
+
+            Call.Calls += (*it_c).second.Calls;
+            Call.Inclusive += (*it_c).second.Inclusive;
+        }
+    }
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+
+    for (CALLGRIND_ROUTINES::iterator it = Thread->Callgrind.begin(); it != Thread->Callgrind.end(); it++)
+    {
+        if ((*it).second.CallsHash)
+        {
+            free((*it).second.CallsHash);
+        }
+    }
+
+    Thread->Callgrind.clear();
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindWriteName(FILE *f, const char *lpszType, CALLGRIND_NAMES &Ids, const std::string &Object, const std::string &Name)
+{
+    // use name compression: full name is written only for the first time
+    CALLGRIND_NAMES::iterator it = Ids.find(std::make_pair(Object, Name));
+    if (it != Ids.end())
+    {
+        fprintf(f, "%s=(%d)\n", lpszType, (*it).second);
+    }
+    else
+    {
+        UINT32 Id = (UINT32)Ids.size() + 1;
+
+        fprintf(f, "%s=(%d) %s\n", lpszType, Id, Name.c_str());
+        Ids[std::make_pair(Object, Name)] = Id;
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID CallgrindWrite(const char *lpszLogName)
+{
+    // functions with the same name in different objects must have different IDs
+    CALLGRIND_NAMES ObjectIds, FunctionIds;
+
+    FILE *f = fopen(lpszLogName, "wb+");
+    if (f == NULL)
+    {
+        return;
+    }
+
+    fprintf(f, "# callgrind format\n");
+    fprintf(f, "version: 1\n");
+    fprintf(f, "creator: Code Coverage Analysis Tool for PIN\n");
+    fprintf(f, "pid: %d\n", m_ProcessId);
+    fprintf(f, "cmd: %s\n", m_CommandLine.c_str());
+    fprintf(f, "positions: line\n");
+    fprintf(f, "events: Ir\n\n");
+
+    for (CALLGRIND_ROUTINES::iterator it = m_Callgrind.begin(); it != m_Callgrind.end(); it++)
+    {
+        std::string ModuleName = "?", RoutineName = "(thread start)";
+
+        if ((*it).first != 0)
+        {
+            ModuleName = m_RoutinesNames[(*it).first].first;
+            RoutineName = m_RoutinesNames[(*it).first].second;
+        }
+
+        CallgrindWriteName(f, "ob", ObjectIds, "", ModuleName);
+        CallgrindWriteName(f, "fn", FunctionIds, ModuleName, RoutineName);
+        fprintf(f, "0 %llu\n", (unsigned long long)(*it).second.Self);
+
+        // enumerate calls from current routine to the others
+        for (CALLGRIND_CALLS::iterator it_c = (*it).second.Calls.begin(); it_c != (*it).second.Calls.end(); it_c++)
+        {
+            std::pair<std::string, std::string> &Callee = m_RoutinesNames[(*it_c).first];
+
+            CallgrindWriteName(f, "cob", ObjectIds, "", Callee.first);
+            CallgrindWriteName(f, "cfn", FunctionIds, Callee.first, Callee.second);
+            fprintf(f, "calls=%llu 0\n", (unsigned long long)(*it_c).second.Calls);
+            fprintf(f, "0 %llu\n", (unsigned long long)(*it_c).second.Inclusive);
+        }
+
+        fprintf(f, "\n");
+    }
+
+    fclose(f);
+}
+//--------------------------------------------------------------------------------------
+VOID PIN_FAST_ANALYSIS_CALL CountIns(PTHREAD_PARAMS Thread, UINT32 Instructions)
+{
+    Thread->Instructions += Instructions;
+}
+//--------------------------------------------------------------------------------------
+VOID MergeRoutines(PTHREAD_PARAMS Thread)
+{
+    // merge routines counters of the thread into the global list
+    for (THREAD_ROUTINES::iterator it = Thread->Routines.begin(); it != Thread->Routines.end(); it++)
+    {
+        m_RoutinesList[std::make_pair((*it).second.Module, (*it).first)] += (*it).second.Calls;
+    }
+
+    Thread->Routines.clear();
+}
+//--------------------------------------------------------------------------------------
+VOID RoutinesRetire(PTHREAD_PARAMS Thread)
+{
+    UINT32 Epoch = m_ModulesEpoch;
+
+    // some module was loaded or unloaded, routines addresses might belong to the other modules now
+    PIN_GetLock(&m_ThreadsLock, Thread->ThreadIndex + 1);
+    MergeRoutines(Thread);
+    PIN_ReleaseLock(&m_ThreadsLock);
+
+    Thread->ModulesEpoch = Epoch;
+}
+//--------------------------------------------------------------------------------------
+BOOL ShadowStackInit(PTHREAD_PARAMS Thread)
+{
+    Thread->Frames = (PSHADOW_FRAME)malloc(SHADOW_STACK_SIZE * sizeof(SHADOW_FRAME));
+    if (Thread->Frames == NULL)
+    {
+        return false;
+    }
+
+    memset(&Thread->ShadowStats, 0, sizeof(SHADOW_STACK_STATS));
+
+    // frame of the thread start, stack pointer value is above of any real frame
+    Thread->Frames[0].Routine = 0;
+    Thread->Frames[0].ReturnAddress = 0;
+    Thread->Frames[0].StackPtr = (ADDRINT)-1;
+    Thread->Frames[0].Cct = Thread->CctCurrent;
+    Thread->Depth = 1;
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+inline VOID ShadowStackPop(PTHREAD_PARAMS Thread)
+{
+    if (KnobCallgrind.Value())
+    {
+        CallgrindReturn(Thread, &Thread->Frames[Thread->Depth - 1].Callgrind);
+    }
+
+    Thread->Depth -= 1;
+
+    if (Thread->CctCurrent)
+    {
+        // return to the caller context
+        Thread->CctCurrent = Thread->Frames[Thread->Depth - 1].Cct;
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID ShadowStackUnwind(PTHREAD_PARAMS Thread, ADDRINT StackPtr)
+{
+    /*
+        Stack grows down, so frames with the return address below of the 
+        current stack pointer belongs to the routines that was left without
+        RET: longjmp(), exceptions unwinding, call/pop thunks, etc.
+    */
+    while (Thread->Depth > 1 && Thread->Frames[Thread->Depth - 1].StackPtr < StackPtr)
+    {
+        ShadowStackPop(Thread);
+        Thread->ShadowStats.Unwound += 1;
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID InstRetHandler(PTHREAD_PARAMS Thread, ADDRINT BranchTargetAddress, ADDRINT StackPtr)
+{
+    if (Thread->CallTree.bEnabled)
+    {
+        PSHADOW_FRAME Frame = &Thread->Frames[Thread->Depth - 1];
+
+        if (Frame->StackPtr != StackPtr)
+        {
+            // resync the stack by removing the frames of unwound routines
+            ShadowStackUnwind(Thread, StackPtr);
+            Frame = &Thread->Frames[Thread->Depth - 1];
+        }
+
+        if (Thread->Depth > 1 && Frame->StackPtr == StackPtr)
+        {
+            if (Frame->ReturnAddress != BranchTargetAddress)
+            {
+                // return address was modified, but it's still the return from this routine
+                Thread->ShadowStats.Mismatches += 1;
+            }
+
+            ShadowStackPop(Thread);
+        }
+        else
+        {
+            /*
+                Return from the routine that was called from not instrumented code, 
+                or entered with JMP/PUSH+RET: there is no frame for it.
+            */
+            Thread->ShadowStats.Unmatched += 1;
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID InstCallHandler(PTHREAD_PARAMS Thread, ADDRINT ReturnAddress, ADDRINT BranchTargetAddress, ADDRINT StackPtr)
+{
+    if (BranchTargetAddress)
+    {
+        if (Thread->ModulesEpoch != m_ModulesEpoch)
+        {
+            RoutinesRetire(Thread);
+        }
+
+        // log routine information
+        PROUTINE_CALLS Routine = &Thread->Routines[BranchTargetAddress];
+        if (Routine->Calls == 0 && !LookupModule(BranchTargetAddress, &Routine->Module, NULL))
+        {
+            Routine->Module = MODULE_UNKNOWN;
+        }
+
+        Routine->Calls += 1;
+
+        if (Thread->CallTree.bEnabled)
+        {
+            // CALL instruction will store return address just below of the current stack pointer
+            StackPtr -= sizeof(ADDRINT);
+
+            if (Thread->Frames[Thread->Depth - 1].StackPtr <= StackPtr)
+            {
+                // previous routines was unwound without return
+                ShadowStackUnwind(Thread, StackPtr + 1);
+            }
+
+            ADDRINT Caller = Thread->Frames[Thread->Depth - 1].Routine;
+
+            if (Thread->CallTree.Edges)
+            {
+                // update call tree edge counter
+                CallEdgeAdd(&Thread->CallTree, Caller, BranchTargetAddress);
+            }
+            else if (Thread->CallTree.f)
+            {
+                // log call tree branch
+                PCALL_RECORD Record = Thread->CallTree.Ptr++;
+                Record->Caller = Caller;
+                Record->Callee = BranchTargetAddress;
+
+                if (Thread->CallTree.Ptr == Thread->CallTree.End)
+                {
+                    // pass filled buffer to the writer thread
+                    CallBufferFlush(&Thread->CallTree, false);
+                }
+            }
+
+            if (Thread->Depth == SHADOW_STACK_SIZE)
+            {
+                // too deep recursion, don't track this call
+                Thread->ShadowStats.Overflows += 1;
+                return;
+            }
+
+            PSHADOW_FRAME Frame = &Thread->Frames[Thread->Depth];
+
+            if (KnobCallgrind.Value())
+            {
+                CallgrindCall(Thread, BranchTargetAddress, &Frame->Callgrind);
+            }
+
+            if (Thread->CctCurrent)
+            {
+                // enter the callee context
+                Thread->CctCurrent = CctChild(&Thread->Cct, Thread->CctCurrent, BranchTargetAddress);
+                Thread->CctCurrent->Calls += 1;
+            }
+
+            // push target routine to the top of call stack
+            Frame->Routine = BranchTargetAddress;
+            Frame->ReturnAddress = ReturnAddress;
+            Frame->StackPtr = StackPtr;
+            Frame->Cct = Thread->CctCurrent;
+
+            Thread->Depth += 1;
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+BOOL MatchPattern(const char *Pattern, const char *String)
+{
+    // case insensitive match with '*' and '?' wildcards support
+    while (*Pattern)
+    {
+        if (*Pattern == '*')
+        {
+            for (const char *Ptr = String; ; Ptr++)
+            {
+                if (MatchPattern(Pattern + 1, Ptr))
+                {
+                    return true;
+                }
+
+                if (*Ptr == '\0')
+                {
+                    return false;
+                }
+            }
+        }
+
+        if (*String == '\0' || 
+            (*Pattern != '?' && tolower((unsigned char)*Pattern) != tolower((unsigned char)*String)))
+        {
+            return false;
+        }
+
+        Pattern += 1;
+        String += 1;
+    }
+
+    return *String == '\0';
+}
+//--------------------------------------------------------------------------------------
+BOOL ModuleIsSelected(std::string &ImagePath)
+{
+    if (m_ModuleFilter.size() == 0)
+    {
+        // instrument all modules if filter is not specified, or none of them for "-m ?"
+        return !m_ModuleFilterUnknown;
+    }
+
+    std::string ImageName = NameFromPath(ImagePath);
+    std::string ImageBaseName = ImageName.substr(0, ImageName.rfind("."));
+
+    for (std::list<std::string>::iterator it = m_ModuleFilter.begin(); it != m_ModuleFilter.end(); it++)
+    {
+        const char *Pattern = (*it).c_str();
+
+        if ((*it).find_first_of("\\/") != std::string::npos)
+        {
+            // match full image path
+            if (MatchPattern(Pattern, ImagePath.c_str()))
+            {
+                return true;
+            }
+        }
+        else if (MatchPattern(Pattern, ImageName.c_str()) || 
+                 MatchPattern(Pattern, ImageBaseName.c_str()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+//--------------------------------------------------------------------------------------
+BOOL TraceIsSelected(UINT32 Module)
+{
+    if (m_ModuleFilter.size() == 0 && !m_ModuleFilterUnknown)
+    {
+        // filter is not specified, instrument everything
+        return true;
+    }
+
+    if (Module == MODULE_UNKNOWN)
+    {
+        // code that doesn't belong to any module
+        return m_ModuleFilterUnknown;
+    }
+
+    return m_ModuleList[Module].bSelected;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Get current time in milliseconds since the process start.
+ */
+UINT64 EpochClock(VOID)
+{
+    UINT64 Now = 0;
+
+#if defined(TARGET_WINDOWS)
+
+    Now = WINDOWS::GetTickCount();
+
+#else
+
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    Now = (UINT64)Time.tv_sec * 1000 + Time.tv_nsec / 1000000;
+
+#endif
+
+    return Now - m_EpochClockStart;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Compress executed blocks flags of the finished epoch into the epochs list
+ *  and clear the map for reuse. Called by the epochs thread or by Fini() after
+ *  its termination, so the epochs list doesn't need any locking.
+ */
+VOID EpochRetire(PEPOCH_MAP Map)
+{
+    EPOCH_INFO Epoch;
+    Epoch.Start = Map->Start;
+    Epoch.End = Map->End;
+    Epoch.Instructions = Map->Instructions;
+    Epoch.Blocks = Epoch.NewBlocks = 0;
+
+    m_Epochs.push_back(Epoch);
+
+    PEPOCH_INFO Info = &m_Epochs.back();
+    ADDRINT PrevSlot = 0;
+
+    // flags can be set only for the slots of allocated counters chunks
+    for (UINT32 i = 0; i < COUNTERS_MAX_CHUNKS && m_Counters[i]; i++)
+    {
+        UINT8 *Flags = Map->Flags + i * COUNTERS_CHUNK_SIZE;
+
+        for (UINT32 n = 0; n < COUNTERS_CHUNK_SIZE; n++)
+        {
+            if (Flags[n] == 0)
+            {
+                continue;
+            }
+
+            UINT32 Slot = i * COUNTERS_CHUNK_SIZE + n;
+            UINT8 Data[0x10];
+
+            if (Slot >= m_EpochSeen.size())
+            {
+                m_EpochSeen.resize((i + 1) * COUNTERS_CHUNK_SIZE, false);
+            }
+
+            if (!m_EpochSeen[Slot])
+            {
+                m_EpochSeen[Slot] = true;
+                Info->NewBlocks += 1;
+            }
+
+            UINT32 Size = CallLogPackValue(Data, Slot, PrevSlot);
+            Info->Slots.insert(Info->Slots.end(), Data, Data + Size);
+            Info->Blocks += 1;
+
+            PrevSlot = Slot;
+        }
+
+        memset(Flags, 0, COUNTERS_CHUNK_SIZE);
+    }
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Start a new epoch, only the maps pointers are swapped here, compression of 
+ *  the finished epoch is done by the epochs thread. Returns FALSE if the spare 
+ *  map is not available yet. Must be called with m_EpochLock acquired.
+ */
+BOOL EpochSwap(VOID)
+{
+    PEPOCH_MAP Map = m_EpochSpare;
+    UINT64 Now = EpochClock();
+
+    if (Map == NULL)
+    {
+        // epochs thread is still compressing the map, try again later
+        return false;
+    }
+
+    m_EpochSpare = NULL;
+
+    Map->Start = Now;
+    Map->End = Map->Instructions = 0;
+
+    // previous epoch was finished one epoch ago, nobody is writing into its map
+    m_EpochPending = m_EpochRetired;
+
+    m_EpochRetired = m_EpochMap;
+    m_EpochRetired->End = Now;
+    m_EpochRetired->Instructions = m_EpochInstructions;
+
+    m_EpochMap = Map;
+    m_EpochFlags = Map->Flags;
+
+    if (KnobEpochIns.Value() > 0)
+    {
+        // wake up epochs thread to prepare the next spare map, time based 
+        // epochs are swapped by the epochs thread itself
+        PIN_SemaphoreSet(&m_EpochEvent);
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+ADDRINT PIN_FAST_ANALYSIS_CALL EpochCountIns(PTHREAD_PARAMS Thread, UINT32 Instructions)
+{
+    Thread->EpochInstructions += Instructions;
+
+    return Thread->EpochInstructions >= EPOCH_INS_QUANTUM;
+}
+//--------------------------------------------------------------------------------------
+VOID EpochInsFlush(PTHREAD_PARAMS Thread)
+{
+    PIN_GetLock(&m_EpochLock, Thread->ThreadIndex + 1);
+
+    m_EpochInstructions += Thread->EpochInstructions;
+    Thread->EpochInstructions = 0;
+
+    if (m_EpochInstructions >= m_EpochNextSwap && !m_EpochStop && EpochSwap())
+    {
+        m_EpochNextSwap = m_EpochInstructions + (UINT64)KnobEpochIns.Value() * 1000000;
+    }
+
+    PIN_ReleaseLock(&m_EpochLock);
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Swaps time based epochs and compresses finished epochs of both modes.
+ */
+VOID EpochThread(VOID *Param)
+{
+    while (!m_EpochStop)
+    {
+        if (KnobEpoch.Value() > 0)
+        {
+            PIN_SemaphoreTimedWait(&m_EpochEvent, KnobEpoch.Value());
+        }
+        else
+        {
+            PIN_SemaphoreWait(&m_EpochEvent);
+        }
+
+        // event is checked after the state was read, so it's never missed
+        PIN_SemaphoreClear(&m_EpochEvent);
+
+        PIN_GetLock(&m_EpochLock, PIN_ThreadId() + 1);
+
+        if (KnobEpoch.Value() > 0 && !m_EpochStop)
+        {
+            EpochSwap();
+        }
+
+        PEPOCH_MAP Map = m_EpochPending;
+        m_EpochPending = NULL;
+
+        // there is nothing to compress yet after the first swap
+        BOOL bAlloc = Map == NULL && m_EpochSpare == NULL && m_EpochMapsCount < EPOCH_MAPS;
+
+        PIN_ReleaseLock(&m_EpochLock);
+
+        if (Map)
+        {
+            // analysis routines are not blocked while compressing
+            EpochRetire(Map);
+        }
+        else if (bAlloc)
+        {
+            Map = EpochMapAlloc();
+        }
+
+        if (Map)
+        {
+            PIN_GetLock(&m_EpochLock, PIN_ThreadId() + 1);
+            m_EpochSpare = Map;
+            PIN_ReleaseLock(&m_EpochLock);
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Finish the current epoch and compress all of the remaining maps, 
+ *  epochs thread must be terminated allready.
+ */
+VOID EpochFini(VOID)
+{
+    PIN_GetLock(&m_EpochLock, PIN_ThreadId() + 1);
+    PIN_GetLock(&m_ThreadsLock, PIN_ThreadId() + 1);
+
+    // add executed instructions of the threads that are still alive
+    for (THREADS_LIST::iterator it = m_ThreadsList.begin(); it != m_ThreadsList.end(); it++)
+    {
+        m_EpochInstructions += (*it).second->EpochInstructions;
+        (*it).second->EpochInstructions = 0;
+    }
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+
+    m_EpochStop = true;
+
+    if (m_EpochPending)
+    {
+        EpochRetire(m_EpochPending);
+    }
+
+    if (m_EpochRetired)
+    {
+        EpochRetire(m_EpochRetired);
+    }
+
+    m_EpochMap->End = EpochClock();
+    m_EpochMap->Instructions = m_EpochInstructions;
+
+    EpochRetire(m_EpochMap);
+
+    PIN_ReleaseLock(&m_EpochLock);
+}
+//--------------------------------------------------------------------------------------
+VOID Trace(TRACE TraceInfo, VOID *v)
+{
+    // module that is loaded at the trace address now
+    UINT32 Module = ModuleByImage(IMG_FindByAddress(TRACE_Address(TraceInfo)));
+
+    if (!TraceIsSelected(Module))
+    {
+        // don't instrument modules that are not in the filter list
+        return;
+    }
+
+    // in hit-only mode calls are instrumented only for call tree logging
+    BOOL bInstrumentCalls = !KnobHitOnly.Value() || KnobLogCallTree.Value() || 
+                            KnobCct.Value() || KnobCallgrind.Value();
+
+    // Visit every basic block in the trace
+    for (BBL Bbl = TRACE_BblHead(TraceInfo); BBL_Valid(Bbl); Bbl = BBL_Next(Bbl))
+    {
+        // Forward pass over all instructions in bbl
+        for (INS Ins = BBL_InsHead(Bbl); bInstrumentCalls && INS_Valid(Ins); Ins = INS_Next(Ins))
+        {
+            // check for the CALL
+            if (INS_IsCall(Ins))
+            {
+                INS_InsertCall(
+                    Ins, IPOINT_BEFORE, 
+                    (AFUNPTR)InstCallHandler,
+                    IARG_REG_VALUE, m_ThreadReg,
+                    IARG_ADDRINT, INS_NextAddress(Ins),
+                    IARG_BRANCH_TARGET_ADDR,
+                    IARG_REG_VALUE, REG_STACK_PTR,
+                    IARG_END
+                );
+            }
+
+            // check for the RET
+            if (INS_IsRet(Ins))
+            {
+                INS_InsertCall(
+                    Ins, IPOINT_BEFORE, 
+                    (AFUNPTR)InstRetHandler,
+                    IARG_REG_VALUE, m_ThreadReg,
+                    IARG_BRANCH_TARGET_ADDR,
+                    IARG_REG_VALUE, REG_STACK_PTR,
+                    IARG_END
+                );
+            }
+        }
+
+        // allocate counter slot for this basic block
+        UINT32 Slot = BasicBlockSlot(Module, BBL_Address(Bbl), BBL_Size(Bbl), BBL_NumIns(Bbl));
+        if (Slot >= COUNTERS_MAX_SLOTS)
+        {
+            continue;
+        }
+
+        if (KnobHitOnly.Value())
+        {
+            if (m_HitMap[COUNTERS_CHUNK(Slot)][COUNTERS_INDEX(Slot)] == 0)
+            {
+                // record the first execution of basic block that wasn't executed yet
+                BBL_InsertIfCall(
+                    Bbl, IPOINT_BEFORE, 
+                    (AFUNPTR)IsBblNotHit, 
+                    IARG_FAST_ANALYSIS_CALL,
+                    IARG_UINT32, Slot, 
+                    IARG_END
+                );
+
+                BBL_InsertThenCall(
+                    Bbl, IPOINT_BEFORE, 
+                    (AFUNPTR)HitBbl, 
+                    IARG_UINT32, Slot, 
+                    IARG_ADDRINT, BBL_Address(Bbl),
+                    IARG_UINT32, BBL_Size(Bbl),
+                    IARG_END
+                );
+            }
+
+            continue;
+        }
+
+        // Insert a call to CountBbl() before every basic bloc, passing the counter slot number
+        BBL_InsertCall(
+            Bbl, IPOINT_BEFORE, 
+            (AFUNPTR)CountBbl, 
+            IARG_FAST_ANALYSIS_CALL,
+            IARG_REG_VALUE, m_ThreadReg,
+            IARG_UINT32, Slot, 
+            IARG_END
+        );
+
+        if (m_EpochMap)
+        {
+            // mark basic block as executed in the current epoch
+            BBL_InsertCall(
+                Bbl, IPOINT_BEFORE, 
+                (AFUNPTR)EpochHitBbl, 
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_UINT32, Slot, 
+                IARG_END
+            );
+        }
+
+        if (KnobEpochIns.Value() > 0)
+        {
+            // count executed instructions for the epochs swapping
+            BBL_InsertIfCall(
+                Bbl, IPOINT_BEFORE, 
+                (AFUNPTR)EpochCountIns, 
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_REG_VALUE, m_ThreadReg,
+                IARG_UINT32, BBL_NumIns(Bbl), 
+                IARG_END
+            );
+
+            BBL_InsertThenCall(
+                Bbl, IPOINT_BEFORE, 
+                (AFUNPTR)EpochInsFlush, 
+                IARG_REG_VALUE, m_ThreadReg,
+                IARG_END
+            );
+        }
+
+        if (KnobCct.Value())
+        {
+            // count executed instructions for the current calling context
+            BBL_InsertCall(
+                Bbl, IPOINT_BEFORE, 
+                (AFUNPTR)CctCountIns, 
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_REG_VALUE, m_ThreadReg,
+                IARG_UINT32, BBL_NumIns(Bbl), 
+                IARG_END
+            );
+        }
+
+        if (KnobCallgrind.Value())
+        {
+            // count executed instructions for callgrind profile
+            BBL_InsertCall(
+                Bbl, IPOINT_BEFORE, 
+                (AFUNPTR)CountIns, 
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_REG_VALUE, m_ThreadReg,
+                IARG_UINT32, BBL_NumIns(Bbl), 
+                IARG_END
+            );
+        }
+
+        if (KnobEdges.Value() && Slot != EDGE_NO_SLOT)
+        {
+            // log transition from the previous basic block to this one
+            BBL_InsertIfCall(
+                Bbl, IPOINT_BEFORE, 
+                (AFUNPTR)EdgeCacheLookup, 
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_REG_VALUE, m_ThreadReg,
+                IARG_UINT32, Slot, 
+                IARG_UINT32, EDGE_LOCATION(Slot, EDGE_CACHE_BITS),
+                IARG_END
+            );
+
+            BBL_InsertThenCall(
+                Bbl, IPOINT_BEFORE, 
+                (AFUNPTR)EdgeCacheMiss, 
+                IARG_FAST_ANALYSIS_CALL,
+                IARG_REG_VALUE, m_ThreadReg,
+                IARG_UINT32, Slot, 
+                IARG_UINT32, EDGE_LOCATION(Slot, EDGE_CACHE_BITS),
+                IARG_END
+            );
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+VOID MergeThreadCounters(PTHREAD_PARAMS Thread)
+{
+    // merge basic blocks counters of the thread into the global ones
+    for (UINT32 i = 0; i < COUNTERS_MAX_CHUNKS && Thread->Counters[i]; i++)
+    {
+        for (UINT32 n = 0; n < COUNTERS_CHUNK_SIZE; n++)
+        {
+            m_Counters[i][n] += Thread->Counters[i][n];
+        }
+
+        memset(Thread->Counters[i], 0, COUNTERS_CHUNK_SIZE * sizeof(UINT32));
+    }
+
+    MergeRoutines(Thread);
+
+    if (Thread->EdgeCache)
+    {
+        // flush edges cache of the thread
+        for (UINT32 i = 0; i < EDGE_CACHE_SIZE; i++)
         {
-            // log call tree branch
-            fprintf(
-                m_ThreadCalls[ThreadIndex].f, "0x%.8x:0x%.8x\r\n", 
-                m_ThreadCalls[ThreadIndex].Address.top(), BranchTargetAddress
-            );
+            EdgeCacheEvict(Thread, Thread->EdgeCache[i]);
+
+            Thread->EdgeCache[i] &= ~(UINT64)EDGE_ENTRY_COUNT_MAX;
+        }
 
-            // push target routine address to the top of call stack
-            m_ThreadCalls[ThreadIndex].Address.push(BranchTargetAddress);
+        // merge edges counters of the thread into the global list
+        for (EDGES_LIST::iterator it = Thread->Edges.begin(); it != Thread->Edges.end(); it++)
+        {
+            // skip transitions from the thread entry point
+            if (EDGE_KEY_FROM((*it).first) != EDGE_NO_SLOT)
+            {
+                m_Edges[(*it).first] += (*it).second;
+            }
         }
+
+        Thread->Edges.clear();
     }
+
+    // merge shadow call stack statistics
+    m_ShadowStats.Unwound += Thread->ShadowStats.Unwound;
+    m_ShadowStats.Mismatches += Thread->ShadowStats.Mismatches;
+    m_ShadowStats.Unmatched += Thread->ShadowStats.Unmatched;
+    m_ShadowStats.Overflows += Thread->ShadowStats.Overflows;
+
+    memset(&Thread->ShadowStats, 0, sizeof(SHADOW_STACK_STATS));
 }
 //--------------------------------------------------------------------------------------
-VOID Trace(TRACE TraceInfo, VOID *v)
+VOID ThreadStart(THREADID ThreadIndex, CONTEXT *Context, INT32 Flags, VOID *v)
 {
-    // Visit every basic block in the trace
-    for (BBL Bbl = TRACE_BblHead(TraceInfo); BBL_Valid(Bbl); Bbl = BBL_Next(Bbl))
+    PTHREAD_PARAMS Thread = new THREAD_PARAMS;
+    Thread->ThreadIndex = ThreadIndex;
+    Thread->CallTree.f = NULL;
+    Thread->CallTree.bEnabled = false;
+    Thread->CallTree.Edges = NULL;
+    Thread->CallTree.EdgesMask = Thread->CallTree.EdgesCount = 0;
+    Thread->CctCurrent = NULL;
+    Thread->Frames = NULL;
+    Thread->Depth = 0;
+    Thread->ModulesEpoch = m_ModulesEpoch;
+    Thread->EpochInstructions = 0;
+
+    if (KnobCct.Value())
     {
-        // Forward pass over all instructions in bbl
-        for (INS Ins = BBL_InsHead(Bbl); INS_Valid(Ins); Ins = INS_Next(Ins))
+        // initialize calling context tree of the thread
+        CctInit(&Thread->Cct);
+        Thread->CctCurrent = Thread->Cct.Root;
+    }
+    Thread->EdgeCache = NULL;
+
+    if (KnobEdges.Value())
+    {
+        Thread->EdgeCache = (PEDGE_ENTRY)malloc(EDGE_CACHE_SIZE * sizeof(EDGE_ENTRY));
+        if (Thread->EdgeCache == NULL)
         {
-            // check for the CALL
-            if (INS_IsCall(Ins))
+            cerr << "ERROR: Unable to allocate edges cache" << endl;
+            PIN_ExitProcess(-1);
+        }
+
+        for (UINT32 i = 0; i < EDGE_CACHE_SIZE; i++)
+        {
+            // use the edge that can't match any of the real ones
+            Thread->EdgeCache[i] = EDGE_ENTRY_FROM(EDGE_NO_SLOT) | EDGE_ENTRY_TO(EDGE_NO_SLOT);
+        }
+
+        Thread->EdgePrev = Thread->EdgeMissPrev = EDGE_ENTRY_FROM(EDGE_NO_SLOT);
+    }
+
+    memset(Thread->Counters, 0, sizeof(Thread->Counters));
+
+    if (KnobLogCallTree.Value() && KnobCallEdges.Value())
+    {
+        // allocate call edges table for aggregation
+        Thread->CallTree.Edges = CallEdgesAlloc(CALL_EDGES_INIT_SIZE);
+        Thread->CallTree.EdgesMask = CALL_EDGES_INIT_SIZE - 1;
+        Thread->CallTree.bEnabled = true;
+    }
+    else if (KnobLogCallTree.Value())
+    {
+        char szLogName[MAX_PATH];
+
+        std::string LogCommon = KnobOutputDir.Value();
+        LogCommon += "/";        
+        LogCommon += KnobOutputFile.Value();
+
+        sprintf(szLogName, "%s.%d", LogCommon.c_str(), ThreadIndex);
+
+        // create call tree log file for this thread
+        Thread->CallTree.f = fopen(szLogName, "wb+");
+        if (Thread->CallTree.f)
+        {
+            UINT32 Version = CALL_LOG_VERSION;
+
+            fwrite(CALL_LOG_MAGIC, 1, sizeof(CALL_LOG_MAGIC) - 1, Thread->CallTree.f);
+            fwrite(&Version, sizeof(UINT32), 1, Thread->CallTree.f);
+
+            Thread->CallTree.Buffer = CallBufferAlloc();
+            Thread->CallTree.Ptr = Thread->CallTree.Buffer->Records;
+            Thread->CallTree.End = Thread->CallTree.Buffer->Records + CALL_BUFFER_SIZE;
+
+            Thread->CallTree.bEnabled = true;
+        }
+    }    
+
+    if (KnobCct.Value() || KnobCallgrind.Value())
+    {
+        // profiling needs call stack tracking
+        Thread->CallTree.bEnabled = true;
+    }
+
+    if (Thread->CallTree.bEnabled && !ShadowStackInit(Thread))
+    {
+        cerr << "ERROR: Unable to allocate shadow call stack" << endl;
+        PIN_ExitProcess(-1);
+    }
+
+    if (KnobCallgrind.Value())
+    {
+        CallgrindInit(Thread);
+    }
+
+    // make thread information available for the analysis routines
+    PIN_SetThreadData(m_ThreadKey, Thread, ThreadIndex);
+    PIN_SetContextReg(Context, m_ThreadReg, (ADDRINT)Thread);
+
+    PIN_GetLock(&m_ThreadsLock, ThreadIndex + 1);
+
+    // allocate counters for allready instrumented basic blocks
+    for (UINT32 i = 0; i < COUNTERS_MAX_CHUNKS && m_Counters[i] && !KnobHitOnly.Value(); i++)
+    {
+        Thread->Counters[i] = (UINT32 *)CountersChunkAlloc(sizeof(UINT32), COVLIVE_CHUNK_COUNTERS, i);
+    }
+
+    m_ThreadsList[ThreadIndex] = Thread;
+    m_ThreadCount += 1;
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+}
+//--------------------------------------------------------------------------------------
+VOID ThreadEnd(THREADID ThreadIndex, const CONTEXT *Context, INT32 Code, VOID *v)
+{
+    PTHREAD_PARAMS Thread = (PTHREAD_PARAMS)PIN_GetThreadData(m_ThreadKey, ThreadIndex);
+    if (Thread == NULL)
+    {
+        return;
+    }
+
+    if (KnobEpochIns.Value() > 0)
+    {
+        // add the rest of executed instructions into the global counter
+        EpochInsFlush(Thread);
+    }
+
+    PIN_GetLock(&m_ThreadsLock, ThreadIndex + 1);
+
+    MergeThreadCounters(Thread);
+    m_ThreadsList.erase(ThreadIndex);
+
+    for (UINT32 i = 0; i < COUNTERS_MAX_CHUNKS && Thread->Counters[i]; i++)
+    {
+        CountersChunkFree(Thread->Counters[i]);
+    }
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+
+    if (Thread->CallTree.Edges)
+    {
+        // write aggregated call tree log file
+        CallEdgesWrite(&Thread->CallTree, ThreadIndex);
+    }
+    else if (Thread->CallTree.f)
+    {
+        // write the rest of records and close call tree log file
+        CallBufferFlush(&Thread->CallTree, true);
+    }
+
+    if (Thread->CctCurrent)
+    {
+        // write and merge calling context tree
+        CctThreadEnd(Thread);
+    }
+
+    if (KnobCallgrind.Value())
+    {
+        // merge callgrind profile
+        CallgrindThreadEnd(Thread);
+    }
+
+    if (Thread->EdgeCache)
+    {
+        free(Thread->EdgeCache);
+    }
+
+    if (Thread->Frames)
+    {
+        free(Thread->Frames);
+    }
+
+    PIN_SetThreadData(m_ThreadKey, NULL, ThreadIndex);
+    delete Thread;
+}
+//--------------------------------------------------------------------------------------
+VOID ImageLoad(IMG Image, VOID *v)
+{
+    MODULE_INFO Module;
+
+    // get image characteristics
+    Module.Path = std::string(IMG_Name(Image));
+    Module.Start = IMG_LowAddress(Image);
+    Module.End = IMG_HighAddress(Image);
+    Module.ImageId = IMG_Id(Image);
+    Module.bSelected = ModuleIsSelected(Module.Path);
+    Module.Load = ++m_ModuleEvents;
+    Module.Unload = 0;
+
+    // add image information into the list
+    m_ImageModules[Module.ImageId] = (UINT32)m_ModuleList.size();
+    m_ModuleList.push_back(Module);
+
+    LiveModuleWrite((UINT32)m_ModuleList.size() - 1);
+    ModuleRangesUpdate();
+}
+//--------------------------------------------------------------------------------------
+VOID ImageUnload(IMG Image, VOID *v)
+{
+    std::map<UINT32, UINT32>::iterator it = m_ImageModules.find(IMG_Id(Image));
+    if (it == m_ImageModules.end())
+    {
+        return;
+    }
+
+    // module stays in the list, but its address range can be used by the others now
+    m_ModuleList[(*it).second].Unload = ++m_ModuleEvents;
+    m_ModuleUnloads += 1;
+
+    if (m_Live && (*it).second < m_Live->ModulesCount)
+    {
+        m_Live->Modules[(*it).second].Unload = m_ModuleEvents;
+        m_Live->Commit += 1;
+    }
+
+    m_ImageModules.erase(it);
+
+    ModuleRangesUpdate();
+}
+//--------------------------------------------------------------------------------------
+VOID DatabaseColumn(
+    std::vector<COVDB_COLUMN> &Columns, std::vector<const VOID *> &Data,
+    UINT32 Table, UINT32 Column, UINT32 ElementSize, size_t Count, const VOID *Ptr)
+{
+    COVDB_COLUMN Entry;
+
+    memset(&Entry, 0, sizeof(Entry));
+    Entry.Table = Table;
+    Entry.Column = Column;
+    Entry.ElementSize = ElementSize;
+    Entry.Count = Count;
+
+    Columns.push_back(Entry);
+    Data.push_back(Ptr);
+}
+
+#define DATABASE_COLUMN(_table_, _column_, _vector_)                            \
+                                                                                \
+    DatabaseColumn(                                                             \
+        Columns, Data, (_table_), (_column_), sizeof((_vector_)[0]),            \
+        (_vector_).size(), (_vector_).size() > 0 ? &(_vector_)[0] : NULL        \
+    )
+//--------------------------------------------------------------------------------------
+VOID DatabaseString(std::vector<char> &Strings, const std::string &String)
+{
+    Strings.insert(Strings.end(), String.begin(), String.end());
+    Strings.push_back('\0');
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Write binary coverage database, Counts is optional vector of basic blocks
+ *  counters indexed by slot number, merged counters are used by default.
+ *  When lpszLogName is NULL, database image is built in the memory and returned 
+ *  in Image and Size arguments.
+ */
+BOOL DatabaseConvert(
+    const char *lpszLogName, UINT64 Time, const std::vector<UINT64> *Counts,
+    COVDB_UINT8 **Image, COVDB_UINT64 *Size)
+{
+    std::vector<COVDB_COLUMN> Columns;
+    std::vector<const VOID *> Data;
+    std::vector<char> Strings;
+
+    // command line is the first string in the pool
+    DatabaseString(Strings, m_CommandLine);
+
+    std::vector<COVDB_UINT64> ModulesStart, ModulesEnd;
+    std::vector<COVDB_UINT32> ModulesLoad, ModulesUnload, ModulesPath;
+
+    for (UINT32 i = 0; i < m_ModuleList.size(); i++) 
+    {
+        ModulesStart.push_back(m_ModuleList[i].Start);
+        ModulesEnd.push_back(m_ModuleList[i].End);
+        ModulesLoad.push_back(m_ModuleList[i].Load);
+        ModulesUnload.push_back(m_ModuleList[i].Unload);
+        ModulesPath.push_back((COVDB_UINT32)Strings.size());
+
+        DatabaseString(Strings, m_ModuleList[i].Path);
+    }
+
+    std::vector<COVDB_UINT32> BlocksModule, BlocksSize, BlocksInstructions;
+    std::vector<COVDB_UINT64> BlocksOffset, BlocksCount;
+
+    // slot number -> blocks table row
+    std::vector<COVDB_UINT32> SlotRows(m_BasicBlocksSlots.size(), COVDB_MODULE_UNKNOWN);
+
+    // basic blocks list is sorted by module ID and address
+    for (BASIC_BLOCKS::iterator it = m_BasicBlocks.begin(); it != m_BasicBlocks.end(); it++)
+    {
+        UINT64 Calls = Counts ? (*Counts)[(*it).second] : BasicBlockCalls((*it).second);
+        PBASIC_BLOCK_PARAMS Params = &m_BasicBlocksSlots[(*it).second];
+
+        if (Calls > 0)
+        {
+            ADDRINT Offset = Params->Address;
+
+            if (Params->Module != MODULE_UNKNOWN)
             {
-                INS_InsertCall(
-                    Ins, IPOINT_BEFORE, 
-                    (AFUNPTR)InstCallHandler,
-                    IARG_INST_PTR,
-                    IARG_BRANCH_TARGET_ADDR,
-                    IARG_END
-                );
+                Offset -= m_ModuleList[Params->Module].Start;
             }
 
-            // check for the RET
-            if (INS_IsRet(Ins))
+            SlotRows[(*it).second] = (COVDB_UINT32)BlocksModule.size();
+
+            BlocksModule.push_back(Params->Module);
+            BlocksOffset.push_back(Offset);
+            BlocksSize.push_back(Params->Size);
+            BlocksInstructions.push_back(Params->Instructions);
+            BlocksCount.push_back(Calls);
+        }
+    }
+
+    std::vector<COVDB_UINT32> RoutinesModule;
+    std::vector<COVDB_UINT64> RoutinesOffset, RoutinesCount;
+
+    // routines list is sorted by module ID and address
+    for (ROUTINES_LIST::iterator it = m_RoutinesList.begin(); it != m_RoutinesList.end(); it++)
+    {
+        ADDRINT Offset = (*it).first.second;
+
+        if ((*it).first.first != MODULE_UNKNOWN)
+        {
+            Offset -= m_ModuleList[(*it).first.first].Start;
+        }
+
+        RoutinesModule.push_back((*it).first.first);
+        RoutinesOffset.push_back(Offset);
+        RoutinesCount.push_back((*it).second);
+    }
+
+    std::vector<COVDB_UINT32> CallsCallerModule, CallsCalleeModule;
+    std::vector<COVDB_UINT64> CallsCallerOffset, CallsCalleeOffset, CallsCount;
+
+    // call edges are allready using module relative addresses
+    for (CALL_EDGES_LIST::iterator it = m_CallEdges.begin(); it != m_CallEdges.end(); it++)
+    {
+        CallsCallerModule.push_back((*it).first.first.first);
+        CallsCallerOffset.push_back((*it).first.first.second);
+        CallsCalleeModule.push_back((*it).first.second.first);
+        CallsCalleeOffset.push_back((*it).first.second.second);
+        CallsCount.push_back((*it).second);
+    }
+
+    DATABASE_COLUMN(COVDB_TABLE_STRINGS, COVDB_STRINGS_DATA, Strings);
+
+    DATABASE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_START, ModulesStart);
+    DATABASE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_END, ModulesEnd);
+    DATABASE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_LOAD, ModulesLoad);
+    DATABASE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_UNLOAD, ModulesUnload);
+    DATABASE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_PATH, ModulesPath);
+
+    DATABASE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_MODULE, BlocksModule);
+    DATABASE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_OFFSET, BlocksOffset);
+    DATABASE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_SIZE, BlocksSize);
+    DATABASE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_INSTRUCTIONS, BlocksInstructions);
+    DATABASE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_COUNT, BlocksCount);
+
+    DATABASE_COLUMN(COVDB_TABLE_ROUTINES, COVDB_ROUTINES_MODULE, RoutinesModule);
+    DATABASE_COLUMN(COVDB_TABLE_ROUTINES, COVDB_ROUTINES_OFFSET, RoutinesOffset);
+    DATABASE_COLUMN(COVDB_TABLE_ROUTINES, COVDB_ROUTINES_COUNT, RoutinesCount);
+
+    if (KnobLogCallTree.Value() && KnobCallEdges.Value())
+    {
+        DATABASE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLER_MODULE, CallsCallerModule);
+        DATABASE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLER_OFFSET, CallsCallerOffset);
+        DATABASE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLEE_MODULE, CallsCalleeModule);
+        DATABASE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLEE_OFFSET, CallsCalleeOffset);
+        DATABASE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_COUNT, CallsCount);
+    }
+
+    std::vector<COVDB_UINT64> EpochsStart, EpochsEnd, EpochsInstructions, EpochsData;
+    std::vector<COVDB_UINT32> EpochsBlocks, EpochsNew, EpochsSize;
+    std::vector<COVDB_UINT8> EpochsBitmaps;
+
+    // epochs are written only into the final database
+    for (UINT32 i = 0; i < m_Epochs.size() && Counts == NULL; i++)
+    {
+        PEPOCH_INFO Epoch = &m_Epochs[i];
+        std::vector<COVDB_UINT32> Rows;
+        ADDRINT Slot = 0, PrevRow = 0;
+
+        for (size_t Pos = 0; Pos < Epoch->Slots.size();)
+        {
+            Slot = CallLogUnpackValue(&Epoch->Slots[0], &Pos, Slot);
+
+            if (Slot < SlotRows.size() && SlotRows[Slot] != COVDB_MODULE_UNKNOWN)
             {
-                INS_InsertCall(
-                    Ins, IPOINT_BEFORE, 
-                    (AFUNPTR)InstRetHandler,
-                    IARG_INST_PTR,
-                    IARG_END
-                );
+                Rows.push_back(SlotRows[Slot]);
             }
         }
 
-        // Insert a call to CountBbl() before every basic bloc, passing the number of instructions
-        BBL_InsertCall(
-            Bbl, IPOINT_BEFORE, 
-            (AFUNPTR)CountBbl, 
-            IARG_INST_PTR,
-            (UINT32)IARG_UINT32, BBL_Size(Bbl), 
-            IARG_UINT32, BBL_NumIns(Bbl), 
-            IARG_END
-        );
+        // encode ascending row numbers of executed blocks
+        std::sort(Rows.begin(), Rows.end());
+
+        EpochsStart.push_back(Epoch->Start);
+        EpochsEnd.push_back(Epoch->End);
+        EpochsInstructions.push_back(Epoch->Instructions);
+        EpochsBlocks.push_back(Epoch->Blocks);
+        EpochsNew.push_back(Epoch->NewBlocks);
+        EpochsData.push_back(EpochsBitmaps.size());
+
+        for (UINT32 n = 0; n < Rows.size(); n++)
+        {
+            UINT8 Data[0x10];
+            UINT32 Size = CallLogPackValue(Data, Rows[n], PrevRow);
+
+            EpochsBitmaps.insert(EpochsBitmaps.end(), Data, Data + Size);
+            PrevRow = Rows[n];
+        }
+
+        EpochsSize.push_back((COVDB_UINT32)(EpochsBitmaps.size() - EpochsData.back()));
+    }
+
+    if (EpochsStart.size() > 0)
+    {
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS, COVDB_EPOCHS_START, EpochsStart);
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS, COVDB_EPOCHS_END, EpochsEnd);
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS, COVDB_EPOCHS_INSTRUCTIONS, EpochsInstructions);
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS, COVDB_EPOCHS_BLOCKS, EpochsBlocks);
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS, COVDB_EPOCHS_NEW, EpochsNew);
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS, COVDB_EPOCHS_DATA, EpochsData);
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS, COVDB_EPOCHS_SIZE, EpochsSize);
+
+        DATABASE_COLUMN(COVDB_TABLE_EPOCHS_DATA, COVDB_EPOCHS_DATA_DATA, EpochsBitmaps);
+    }
+
+    COVDB_HEADER Header;
+
+    memset(&Header, 0, sizeof(Header));
+    Header.ColumnsCount = (COVDB_UINT32)Columns.size();
+    Header.ProcessId = m_ProcessId;
+    Header.Threads = (COVDB_UINT32)m_ThreadCount;
+    Header.Time = Time;
+    Header.CommandLine = 0;
+
+    // columns layout and file format details are handled by covdb library
+    if (lpszLogName)
+    {
+        return CovDbWrite(lpszLogName, &Header, &Columns[0], &Data[0]);
     }
+
+    return (*Image = CovDbBuild(&Header, &Columns[0], &Data[0], Size)) != NULL;
 }
 //--------------------------------------------------------------------------------------
-VOID PrintLogFileHeader(FILE *f)
+VOID DatabaseWrite(const char *lpszLogName, UINT64 Time, const std::vector<UINT64> *Counts)
 {
-    fprintf(f, "#\r\n");
-    fprintf(f, APP_NAME);
-    fprintf(f, "#\r\n");
-    fprintf(f, "# Program command line: %s\r\n", m_CommandLine.c_str());
-    fprintf(f, "# Process ID: %d\r\n", m_ProcessId);
-    fprintf(f, "#\r\n");
+    if (!DatabaseConvert(lpszLogName, Time, Counts, NULL, NULL))
+    {
+        cerr << "WARNING: Unable to write coverage database \"" << lpszLogName << "\"" << endl;
+    }
 }
 //--------------------------------------------------------------------------------------
-VOID ThreadStart(THREADID ThreadIndex, CONTEXT *Context, INT32 Flags, VOID *v)
+/**
+ *  Build binary coverage database image in the memory, it must be freed with free().
+ */
+COVDB_UINT8 *DatabaseBuild(UINT64 Time, const std::vector<UINT64> *Counts, COVDB_UINT64 *Size)
 {
-    if (KnobLogCallTree.Value())
+    COVDB_UINT8 *Image = NULL;
+
+    if (!DatabaseConvert(NULL, Time, Counts, &Image, Size))
     {
-        CALL_TREE_PARAMS Params;
-        char szLogName[MAX_PATH];
+        return NULL;
+    }
+
+    return Image;
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Merge threads counters chunks that were swapped by the previous snapshot 
+ *  into the global ones. Threads are not using them since then, so they can 
+ *  be reused. Must be called with m_ThreadsLock acquired.
+ */
+VOID SnapshotMergeRetired(VOID)
+{
+    for (UINT32 i = 0; i < m_SnapshotRetired.size(); i++)
+    {
+        UINT32 Chunk = m_SnapshotRetired[i].first;
+        UINT32 *Counters = m_SnapshotRetired[i].second;
+
+        for (UINT32 n = 0; n < COUNTERS_CHUNK_SIZE; n++)
+        {
+            m_Counters[Chunk][n] += Counters[n];
+        }
+
+        memset(Counters, 0, COUNTERS_CHUNK_SIZE * sizeof(UINT32));
+        CountersChunkFree(Counters);
+    }
+
+    m_SnapshotRetired.clear();
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Get current basic blocks counters including the ones of running threads.
+ *  Counters chunks of all of the threads are swapped with the fresh ones at
+ *  once, so the snapshot doesn't depend on the time that summing takes and
+ *  the threads don't need to be stopped. Swapped chunks are merged into the
+ *  global counters by the next snapshot or Fini(). Must be called with client 
+ *  lock and m_ThreadsLock acquired.
+ */
+VOID SnapshotCounters(std::vector<UINT64> &Counts)
+{
+    UINT32 SlotsCount = (UINT32)m_BasicBlocksSlots.size();
+
+    SnapshotMergeRetired();
+
+    if (!KnobHitOnly.Value())
+    {
+        std::vector<UINT32 *> Fresh;
+
+        // allocate new chunks before the swap to keep it short
+        for (THREADS_LIST::iterator it = m_ThreadsList.begin(); it != m_ThreadsList.end(); it++)
+        {
+            for (UINT32 i = 0; i < COUNTERS_MAX_CHUNKS && (*it).second->Counters[i]; i++)
+            {
+                Fresh.push_back((UINT32 *)CountersChunkAlloc(sizeof(UINT32), COVLIVE_CHUNK_COUNTERS, i));
+            }
+        }
+
+        UINT32 Next = 0;
+
+        // analysis routines are using the new chunks after the pointer swap
+        for (THREADS_LIST::iterator it = m_ThreadsList.begin(); it != m_ThreadsList.end(); it++)
+        {
+            PTHREAD_PARAMS Thread = (*it).second;
+
+            for (UINT32 i = 0; i < COUNTERS_MAX_CHUNKS && Thread->Counters[i]; i++)
+            {
+                m_SnapshotRetired.push_back(std::make_pair(i, Thread->Counters[i]));
+                Thread->Counters[i] = Fresh[Next++];
+            }
+        }
+    }
 
-        std::string LogCommon = KnobOutputDir.Value();
-        LogCommon += "/";        
-        LogCommon += KnobOutputFile.Value();
+    Counts.assign(SlotsCount, 0);
 
-        sprintf(szLogName, "%s.%d", LogCommon.c_str(), ThreadIndex);
+    for (UINT32 i = 0; i < SlotsCount; i++)
+    {
+        Counts[i] = BasicBlockCalls(i);
+    }
 
-        // create call tree log file for this thread
-        Params.f = fopen(szLogName, "wb+");
-        if (Params.f)
-        {
-            PrintLogFileHeader(Params.f);
-            fprintf(Params.f, "# Call tree log file for thread %d\r\n#\r\n", ThreadIndex);
+    for (UINT32 i = 0; i < m_SnapshotRetired.size(); i++)
+    {
+        UINT32 First = m_SnapshotRetired[i].first * COUNTERS_CHUNK_SIZE;
 
-            Params.Address.push(0);
-            m_ThreadCalls[ThreadIndex] = Params;
+        for (UINT32 n = 0; n < COUNTERS_CHUNK_SIZE && First + n < SlotsCount; n++)
+        {
+            Counts[First + n] += m_SnapshotRetired[i].second[n];
         }
-    }    
-
-    m_ThreadCount += 1;
+    }
 }
 //--------------------------------------------------------------------------------------
-VOID ThreadEnd(THREADID ThreadIndex, const CONTEXT *Context, INT32 Code, VOID *v)
+VOID SnapshotWrite(VOID)
 {
-    THREAD_CALLS::iterator it = m_ThreadCalls.find(ThreadIndex);
-    if (it != m_ThreadCalls.end())
+    char szLogName[MAX_PATH];
+    std::vector<UINT64> Counts;
+    COVDB_UINT64 Size = 0;
+
+    time_t Now;
+    time(&Now);
+
+    _snprintf(
+        szLogName, sizeof(szLogName) - 1, "%s/%s.snapshot.%d.db", 
+        KnobOutputDir.Value().c_str(), KnobOutputFile.Value().c_str(), m_SnapshotsCount
+    );
+
+    szLogName[sizeof(szLogName) - 1] = '\0';
+
+    // prevent basic blocks instrumentation and modules loading
+    PIN_LockClient();
+    PIN_GetLock(&m_ThreadsLock, PIN_ThreadId() + 1);
+
+    SnapshotCounters(Counts);
+
+    // merged routines and call edges are protected by m_ThreadsLock
+    COVDB_UINT8 *Image = DatabaseBuild(Now - m_StartTime, &Counts, &Size);
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+    PIN_UnlockClient();
+
+    if (Image == NULL)
     {
-        // close call tree log file
-        fclose(it->second.f);
-        m_ThreadCalls.erase(it);
+        cerr << "WARNING: Unable to build coverage snapshot " << m_SnapshotsCount << endl;
+        return;
     }
-}
-//--------------------------------------------------------------------------------------
-std::string NameFromPath(std::string &Path)
-{
-    size_t Pos = Path.rfind("\\");
-    return std::string(Path.substr(Pos + 1));
-}
-//--------------------------------------------------------------------------------------
-VOID ImageLoad(IMG Image, VOID *v)
-{
-    // get image characteristics
-    ADDRINT	AddrStart = IMG_LowAddress(Image);
-    ADDRINT	AddrEnd = IMG_HighAddress(Image);
-    std::string ImagePath = std::string(IMG_Name(Image));
 
-    // save full image path for module 
-    m_ModulePathList.push_back(ImagePath);
+    // write the file without blocking instrumentation and threads termination
+    FILE *f = fopen(szLogName, "wb+");
+    if (f)
+    {
+        if (fwrite(Image, 1, (size_t)Size, f) == Size)
+        {
+            cerr << "Coverage snapshot " << m_SnapshotsCount << " was written into the \"" << szLogName << "\"" << endl;
+        }
 
-    // get image file name from full path
-    std::string ImageName = NameFromPath(ImagePath);
+        fclose(f);
+    }
+    else
+    {
+        cerr << "WARNING: Unable to create \"" << szLogName << "\"" << endl;
+    }
 
-    // add image information into the list
-    m_ModuleList[ImageName] = std::make_pair(AddrStart, AddrEnd);
+    free(Image);
+
+    m_SnapshotsCount += 1;
 }
 //--------------------------------------------------------------------------------------
-const string *LookupSymbol(ADDRINT Address)
+VOID SnapshotThread(VOID *Param)
 {
-    bool Found = false;
-    char RetName[MAX_PATH];
+    std::string LogControl = KnobOutputDir.Value();
+    LogControl += "/";
+    LogControl += KnobOutputFile.Value();
+    LogControl += ".snapshot";
 
-    // have to do this whole thing because the IMG_* functions don't work here
-    for (MODULES_LIST::iterator it = m_ModuleList.begin(); it != m_ModuleList.end(); it++) 
+    while (!m_SnapshotStop)
     {
-        if ((Address > (*it).second.first) && (Address < (*it).second.second))
-        {
-            ADDRINT Offset = Address - (*it).second.first;
-            std::string Name = (*it).first;
+        PIN_SemaphoreTimedWait(&m_SnapshotEvent, KnobSnapshot.Value());
 
-            sprintf(RetName, "%s+%x", Name.c_str(), Offset);
-            Found = true;
+        if (m_SnapshotStop)
+        {
             break;
         }
+
+        // check for the control file
+        FILE *f = fopen(LogControl.c_str(), "rb");
+        if (f == NULL)
+        {
+            continue;
+        }
+
+        fclose(f);
+
+        if (remove(LogControl.c_str()) == 0)
+        {
+            SnapshotWrite();
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+/**
+ *  Called when the application is about to exit, internal threads must be 
+ *  terminated here: PIN might kill them before Fini() call.
+ */
+VOID PrepareForFini(VOID *v)
+{
+    if (m_EpochMap)
+    {
+        // stop epochs thread
+        m_EpochStop = true;
+        PIN_SemaphoreSet(&m_EpochEvent);
+        PIN_WaitForThreadTermination(m_EpochThreadId, PIN_INFINITE_TIMEOUT, NULL);
     }
 
-    if (!Found) 
+    if (KnobSnapshot.Value() > 0)
     {
-        sprintf(RetName, "?%#x", Address);
+        // stop snapshot writer thread
+        m_SnapshotStop = true;
+        PIN_SemaphoreSet(&m_SnapshotEvent);
+        PIN_WaitForThreadTermination(m_SnapshotThreadId, PIN_INFINITE_TIMEOUT, NULL);
     }
 
-    return new string(RetName);
+    if (KnobLogCallTree.Value() && !KnobCallEdges.Value())
+    {
+        // stop call tree log writer thread
+        m_CallLogStop = true;
+        PIN_SemaphoreSet(&m_CallLogEvent);
+        m_CallLogStopped = PIN_WaitForThreadTermination(m_CallLogThreadId, PIN_INFINITE_TIMEOUT, NULL);
+    }
 }
 //--------------------------------------------------------------------------------------
 VOID Fini(INT32 ExitCode, VOID *v)
@@ -350,115 +3627,337 @@ VOID Fini(INT32 ExitCode, VOID *v)
     std::string LogBlocks   = LogCommon + std::string(".blocks");
     std::string LogRoutines = LogCommon + std::string(".routines");
     std::string LogModules  = LogCommon + std::string(".modules");
+    std::string LogEdges    = LogCommon + std::string(".edges");
+    std::string LogBitmap   = LogCommon + std::string(".bitmap");
+    std::string LogCct      = LogCommon + std::string(".cct");
+    std::string LogDatabase = LogCommon + std::string(".db");
+
+    if (m_EpochMap)
+    {
+        // finish the last epoch
+        EpochFini();
+    }
+
+    PIN_GetLock(&m_ThreadsLock, PIN_ThreadId() + 1);
+
+    // merge counters chunks swapped by the last snapshot
+    SnapshotMergeRetired();
+
+    // merge counters of the threads that are still alive
+    for (THREADS_LIST::iterator it = m_ThreadsList.begin(); it != m_ThreadsList.end(); it++)
+    {
+        MergeThreadCounters((*it).second);
+
+        if ((*it).second->CallTree.f)
+        {
+            CallBufferFlush(&(*it).second->CallTree, true);
+        }
+    }
+
+    PIN_ReleaseLock(&m_ThreadsLock);
+
+    // write aggregated call tree logs of the threads that are still alive
+    for (THREADS_LIST::iterator it = m_ThreadsList.begin(); it != m_ThreadsList.end(); it++)
+    {
+        if ((*it).second->CallTree.Edges)
+        {
+            CallEdgesWrite(&(*it).second->CallTree, (*it).first);
+        }
+
+        if ((*it).second->CctCurrent)
+        {
+            CctThreadEnd((*it).second);
+        }
+
+        if (KnobCallgrind.Value())
+        {
+            CallgrindThreadEnd((*it).second);
+        }
+    }
+
+    if (m_CallLogStopped)
+    {
+        // writer thread is terminated, write the rest of buffers
+        CallLogDrain();
+    }
+    else if (KnobLogCallTree.Value() && !KnobCallEdges.Value())
+    {
+        cerr << "WARNING: Call tree log writer thread was not terminated, the rest of records are lost" << endl;
+    }
+
+    time_t Now;
+    time(&Now); 
 
     // create common log
     FILE *f = fopen(LogCommon.c_str(), "wb+");
     if (f)
     {
-        UINT32 CoverageSize = 0;
+        UINT32 CoverageSize = 0, BlocksCount = 0;
 
         // enumerate loged basic blocks
         for (BASIC_BLOCKS::iterator it = m_BasicBlocks.begin(); it != m_BasicBlocks.end(); it++)
         {
-            // calculate total coverage size
-            CoverageSize += (*it).first.second;
-        }
+            UINT32 Slot = (*it).second;
 
-        time_t Now;
-        time(&Now); 
+            // skip instrumented but not executed blocks
+            if (BasicBlockCalls(Slot) > 0)
+            {
+                // calculate total coverage size
+                CoverageSize += m_BasicBlocksSlots[Slot].Size;
+                BlocksCount += 1;
+            }
+        }
 
         fprintf(f, APP_NAME_INI);
         fprintf(f, "; =============================================\r\n");
         fprintf(f, "[coverager]\r\n");
         fprintf(f, "cmdline = %s ; program command line\r\n", m_CommandLine.c_str());
         fprintf(f, "pid = %d ; process ID\r\n", m_ProcessId);
-        fprintf(f, "threads = %d ; number of threads\r\n", m_ThreadCount);
-        fprintf(f, "modules = %d ; number of modules\r\n", m_ModuleList.size());
-        fprintf(f, "routines = %d ; number of routines\r\n", m_RoutinesList.size());
-        fprintf(f, "blocks = %d ; number of basic blocks\r\n", m_BasicBlocks.size());
+        fprintf(f, "threads = %llu ; number of threads\r\n", (unsigned long long)m_ThreadCount);
+        fprintf(f, "modules = %u ; number of modules\r\n", (UINT32)m_ModuleList.size());
+        fprintf(f, "unloads = %d ; number of modules unloads\r\n", m_ModuleUnloads);
+        fprintf(f, "routines = %u ; number of routines\r\n", (UINT32)m_RoutinesList.size());
+        fprintf(f, "blocks = %d ; number of basic blocks\r\n", BlocksCount);
+
+        if (KnobEdges.Value())
+        {
+            fprintf(f, "edges = %u ; number of edges\r\n", (UINT32)m_Edges.size());
+        }
+
+        if (KnobCct.Value())
+        {
+            fprintf(f, "cct_nodes = %d ; number of calling context tree nodes\r\n", m_Cct.NodesCount);
+        }
+
+        if (KnobLogCallTree.Value() && KnobCallEdges.Value())
+        {
+            fprintf(f, "call_edges = %llu ; number of unique call tree edges\r\n", (unsigned long long)m_CallEdgesCount);
+        }
+        else if (KnobLogCallTree.Value())
+        {
+            fprintf(f, "call_records = %llu ; number of call tree log records\r\n", (unsigned long long)m_CallRecordsCount);
+            fprintf(f, "call_buffers = %d ; number of allocated call tree log buffers\r\n", m_CallBuffersCount);
+            fprintf(f, "call_stalls = %llu ; number of waits for free call tree log buffer\r\n", (unsigned long long)m_CallBuffersStalls);
+        }
+
+        if (KnobLogCallTree.Value() || KnobCct.Value() || KnobCallgrind.Value())
+        {
+            fprintf(f, "stack_unwound = %llu ; number of frames unwound without return\r\n", (unsigned long long)m_ShadowStats.Unwound);
+            fprintf(f, "stack_mismatches = %llu ; number of returns to unexpected address\r\n", (unsigned long long)m_ShadowStats.Mismatches);
+            fprintf(f, "stack_unmatched = %llu ; number of returns without call\r\n", (unsigned long long)m_ShadowStats.Unmatched);
+            fprintf(f, "stack_overflows = %llu ; number of calls above max. stack depth\r\n", (unsigned long long)m_ShadowStats.Overflows);
+        }
+
+        if (m_EpochMap)
+        {
+            fprintf(f, "epochs = %d ; number of coverage epochs\r\n", (UINT32)m_Epochs.size());
+        }
+
+        if (KnobSnapshot.Value() > 0)
+        {
+            fprintf(f, "snapshots = %d ; number of written coverage snapshots\r\n", m_SnapshotsCount);
+        }
+
+        if (m_Live)
+        {
+            fprintf(f, "live_chunks = %d ; number of chunks in the live counters file\r\n", m_Live->ChunksCount);
+            fprintf(f, "live_used = %llu ; used size of the live counters file\r\n", (unsigned long long)m_Live->Used);
+            fprintf(f, "live_overflows = %d ; number of chunks that didn't fit into the live counters file\r\n", m_LiveOverflows);
+        }
+
         fprintf(f, "total_size = %d ; Total coverage size\r\n", CoverageSize);
-        fprintf(f, "time = %d ; Execution time in seconds\r\n", Now - m_StartTime);
+        fprintf(f, "time = %u ; Execution time in seconds\r\n", (UINT32)(Now - m_StartTime));
+
+        if (m_EpochMap)
+        {
+            fprintf(f, "; =============================================\r\n");
+            fprintf(f, "[epochs]\r\n");
+            fprintf(f, "; <epoch> = <start_ms>,<end_ms>,<instructions>,<blocks>,<new_blocks>\r\n");
+
+            for (UINT32 i = 0; i < m_Epochs.size(); i++)
+            {
+                PEPOCH_INFO Epoch = &m_Epochs[i];
+
+                fprintf(
+                    f, "%u = %llu,%llu,%llu,%u,%u\r\n", i, 
+                    (unsigned long long)Epoch->Start, (unsigned long long)Epoch->End, 
+                    (unsigned long long)Epoch->Instructions, Epoch->Blocks, Epoch->NewBlocks
+                );
+            }
+        }
+
         fprintf(f, "; =============================================\r\n");        
 
         fclose(f);
     }   
 
+    ADDRINT Offset = 0;
+
+    if (KnobDatabase.Value())
+    {
+        // create binary coverage database
+        DatabaseWrite(LogDatabase.c_str(), Now - m_StartTime, NULL);
+    }
+
     // create basic blocks log
-    f = fopen(LogBlocks.c_str(), "wb+");
+    f = KnobText.Value() ? fopen(LogBlocks.c_str(), "wb+") : NULL;
     if (f)
     {
         PrintLogFileHeader(f);
         fprintf(f, "# Basic blocks log file\r\n#\r\n");
-        fprintf(f, "# <address>:<size>:<instructions>:<name>:<calls>\r\n#\r\n");
+        fprintf(f, "# <address>:<size>:<instructions>:<module>:<offset>:<calls>\r\n#\r\n");
 
         // enumerate loged basic blocks
         for (BASIC_BLOCKS::iterator it = m_BasicBlocks.begin(); it != m_BasicBlocks.end(); it++)
         {
-            const string *Symbol = LookupSymbol((*it).first.first);
+            UINT32 Slot = (*it).second;
+            UINT32 Calls = BasicBlockCalls(Slot);
+            PBASIC_BLOCK_PARAMS Params = &m_BasicBlocksSlots[Slot];
+
+            if (Calls == 0)
+            {
+                // basic block was instrumented but not executed
+                continue;
+            }
+
+            // unknown module blocks are using absolute address
+            Offset = Params->Address;
+
+            if (Params->Module != MODULE_UNKNOWN)
+            {
+                Offset -= m_ModuleList[Params->Module].Start;
+            }
 
             // dump single basic block information
             fprintf(
-                f, "0x%.8x:0x%.8x:%d:%s:%d\r\n", 
-                (*it).first.first, (*it).first.second, (*it).second.Instructions, Symbol->c_str(), (*it).second.Calls
+                f, "0x%.8x:0x%.8x:%d:%d:%x:%d\r\n", 
+                Params->Address, Params->Size, Params->Instructions, Params->Module, Offset, Calls
             );
-
-            delete Symbol;
         }
 
         fclose(f);
     }
 
     // create routines log
-    f = fopen(LogRoutines.c_str(), "wb+");
+    f = KnobText.Value() ? fopen(LogRoutines.c_str(), "wb+") : NULL;
     if (f)
     {
         PrintLogFileHeader(f);
         fprintf(f, "# Routines log file\r\n#\r\n");
-        fprintf(f, "# <address>:<name>:<calls>\r\n#\r\n");
+        fprintf(f, "# <address>:<module>:<offset>:<calls>\r\n#\r\n");
 
         // enumerate loged routines
         for (ROUTINES_LIST::iterator it = m_RoutinesList.begin(); it != m_RoutinesList.end(); it++)
         {
-            const string *Symbol = LookupSymbol((*it).first);
+            UINT32 ModuleId = (*it).first.first;
+            ADDRINT Address = (*it).first.second;
 
-            // dump single routine information
-            fprintf(f, "0x%.8x:%s:%d\r\n", (*it).first, Symbol->c_str(), (*it).second);
+            // unknown module routines are using absolute address
+            Offset = Address;
+
+            if (ModuleId != MODULE_UNKNOWN)
+            {
+                Offset -= m_ModuleList[ModuleId].Start;
+            }
 
-            delete Symbol;
+            // dump single routine information
+            fprintf(f, "0x%.8x:%d:%x:%d\r\n", Address, ModuleId, Offset, (*it).second);
         }
 
         fclose(f);
     }
 
     // create modules log
-    f = fopen(LogModules.c_str(), "wb+");
+    f = KnobText.Value() ? fopen(LogModules.c_str(), "wb+") : NULL;
     if (f)
     {
         PrintLogFileHeader(f);
         fprintf(f, "# Modules log file\r\n#\r\n");
-        fprintf(f, "# <address>:<size>:<name>\r\n#\r\n");
+        fprintf(f, "# <module>:<address>:<high_address>:<load>:<unload>:<path>\r\n#\r\n");
 
-        // have to do this whole thing because the IMG_* functions don't work here
-        for (std::list<std::string>::iterator it = m_ModulePathList.begin(); it != m_ModulePathList.end(); it++) 
+        // enumerate modules in ID order
+        for (UINT32 i = 0; i < m_ModuleList.size(); i++) 
         {
-            // get image file name from full path
-            std::string ModuleName = NameFromPath((*it));
+            PMODULE_INFO Module = &m_ModuleList[i];
 
-            // lookup for module information
-            if (m_ModuleList.find(ModuleName) != m_ModuleList.end())
-            {
-                // dump single routine information
-                fprintf(
-                    f, "0x%.8x:0x%.8x:%s\r\n",
-                    m_ModuleList[ModuleName].first, 
-                    m_ModuleList[ModuleName].second,
-                    (*it).c_str()
-                );            
-            }            
+            // dump single module information
+            fprintf(
+                f, "%d:0x%.8x:0x%.8x:%d:%d:%s\r\n", i,
+                Module->Start, Module->End, Module->Load, Module->Unload, Module->Path.c_str()
+            );            
         }
 
         fclose(f);
     }
+
+    if (KnobEdges.Value())
+    {
+        // create edges log
+        f = fopen(LogEdges.c_str(), "wb+");
+        if (f)
+        {
+            PrintLogFileHeader(f);
+            fprintf(f, "# Edges log file\r\n#\r\n");
+            fprintf(f, "# <from_address>:<to_address>:<calls>\r\n#\r\n");
+
+            // enumerate loged edges
+            for (EDGES_LIST::iterator it = m_Edges.begin(); it != m_Edges.end(); it++)
+            {
+                PBASIC_BLOCK_PARAMS From = &m_BasicBlocksSlots[EDGE_KEY_FROM((*it).first)];
+                PBASIC_BLOCK_PARAMS To = &m_BasicBlocksSlots[EDGE_KEY_TO((*it).first)];
+
+                // dump single edge information
+                fprintf(f, "0x%.8x:0x%.8x:%d\r\n", From->Address, To->Address, (*it).second);
+            }
+
+            fclose(f);
+        }
+
+        // create AFL-compatible edges bitmap
+        f = fopen(LogBitmap.c_str(), "wb+");
+        if (f)
+        {
+            UINT8 *Bitmap = (UINT8 *)malloc(EDGE_BITMAP_SIZE);
+            if (Bitmap)
+            {
+                memset(Bitmap, 0, EDGE_BITMAP_SIZE);
+
+                for (EDGES_LIST::iterator it = m_Edges.begin(); it != m_Edges.end(); it++)
+                {
+                    UINT32 Index = EDGE_LOCATION(EDGE_KEY_TO((*it).first), EDGE_BITMAP_BITS) ^ 
+                                  (EDGE_LOCATION(EDGE_KEY_FROM((*it).first), EDGE_BITMAP_BITS) >> 1);
+
+                    // saturating hit counter
+                    UINT32 Count = Bitmap[Index] + (*it).second;
+                    Bitmap[Index] = (UINT8)(Count > 0xff ? 0xff : Count);
+                }
+
+                fwrite(Bitmap, 1, EDGE_BITMAP_SIZE, f);
+                free(Bitmap);
+            }
+
+            fclose(f);
+        }
+    }
+
+    if (KnobCct.Value())
+    {
+        // create calling context tree log
+        CctWrite(&m_Cct, LogCct.c_str(), "Calling context tree log file");
+    }
+
+    if (KnobCallgrind.Value())
+    {
+        char szLogName[MAX_PATH];
+
+        sprintf(szLogName, "%s/callgrind.out.%d", KnobOutputDir.Value().c_str(), m_ProcessId);
+
+        // create callgrind profile
+        CallgrindWrite(szLogName);
+    }
+
+    // all of the counters are merged, live counters file is consistent now
+    LiveClose();
 }
 //--------------------------------------------------------------------------------------
 int main(int argc, char *argv[])
@@ -482,19 +3981,186 @@ int main(int argc, char *argv[])
 
     m_ProcessId = PIN_GetPid();
 
+    // parse list of the modules to instrument
+    std::string Modules = KnobModules.Value();
+    while (Modules.length() > 0)
+    {
+        size_t Pos = Modules.find(",");
+        std::string Name = Modules.substr(0, Pos);
+
+        Modules = (Pos == std::string::npos) ? "" : Modules.substr(Pos + 1);
+
+        // remove leading and trailing spaces
+        Name.erase(0, Name.find_first_not_of(" "));
+        Name.erase(Name.find_last_not_of(" ") + 1);
+
+        for (size_t i = 0; i < Name.length(); i++)
+        {
+            Name[i] = (char)tolower((unsigned char)Name[i]);
+        }
+
+        if (Name.length() == 0)
+        {
+            // empty list item
+            continue;
+        }
+
+        if (Name == "?")
+        {
+            m_ModuleFilterUnknown = true;
+        }
+        else
+        {
+            m_ModuleFilter.push_back(Name);
+        }
+
+        cerr << "Filtering by module name \"" << Name << "\"" << endl;
+    }
+
+    if (KnobEdges.Value() && KnobHitOnly.Value())
+    {
+        cerr << "ERROR: -e and -hitonly options can't be used together" << endl;
+        return -1;
+    }
+
+    if (KnobCct.Value() && KnobHitOnly.Value())
+    {
+        cerr << "ERROR: -cct and -hitonly options can't be used together" << endl;
+        return -1;
+    }
+
+    if (KnobCallgrind.Value() && KnobHitOnly.Value())
+    {
+        cerr << "ERROR: -callgrind and -hitonly options can't be used together" << endl;
+        return -1;
+    }
+
+    if ((KnobEpoch.Value() > 0 || KnobEpochIns.Value() > 0) && KnobHitOnly.Value())
+    {
+        cerr << "ERROR: -epoch and -hitonly options can't be used together" << endl;
+        return -1;
+    }
+
+    if ((KnobEpoch.Value() > 0 || KnobEpochIns.Value() > 0) && !KnobDatabase.Value())
+    {
+        cerr << "ERROR: -epoch option requires -db" << endl;
+        return -1;
+    }
+
+    if (KnobEpoch.Value() > 0 && KnobEpochIns.Value() > 0)
+    {
+        cerr << "ERROR: -epoch and -epoch_ins options can't be used together" << endl;
+        return -1;
+    }
+
+    if (KnobEpoch.Value() > 0 || KnobEpochIns.Value() > 0)
+    {
+        m_EpochClockStart = EpochClock();
+        m_EpochNextSwap = (UINT64)KnobEpochIns.Value() * 1000000;
+
+        // map of the first epoch and the one for the next epoch
+        m_EpochMap = EpochMapAlloc();
+        m_EpochFlags = m_EpochMap->Flags;
+        m_EpochSpare = EpochMapAlloc();
+    }
+
+    if (KnobCct.Value())
+    {
+        CctInit(&m_Cct);
+    }
+
+    if (KnobCallgrind.Value())
+    {
+        // initialize symbols support for routines names
+        PIN_InitSymbols();
+    }
+
+    PIN_InitLock(&m_ThreadsLock);
+    PIN_InitLock(&m_CallBuffersLock);
+    PIN_InitLock(&m_CallLogWriteLock);
+    PIN_SemaphoreInit(&m_CallLogEvent);
+    PIN_SemaphoreInit(&m_SnapshotEvent);
+    PIN_InitLock(&m_EpochLock);
+    PIN_SemaphoreInit(&m_EpochEvent);
+
+    if (KnobLive.Value())
+    {
+        std::string LogLive = KnobOutputDir.Value();
+        LogLive += "/";
+        LogLive += KnobOutputFile.Value();
+        LogLive += ".live";
+
+        UINT64 Size = (UINT64)KnobLiveSize.Value() * 0x100000;
+
+        // live counters file is holding the header and the arena
+        if (!LiveOpen(LogLive.c_str(), Size + sizeof(COVLIVE_HEADER)))
+        {
+            cerr << "ERROR: Unable to create live counters file \"" << LogLive << "\"" << endl;
+            return -1;
+        }
+    }
+
+    // allocate TLS key and tool register for per-thread information
+    m_ThreadKey = PIN_CreateThreadDataKey(NULL);
+    m_ThreadReg = PIN_ClaimToolRegister();
+
+    if (m_ThreadKey == -1 || !REG_valid(m_ThreadReg))
+    {
+        cerr << "ERROR: Unable to allocate thread local storage" << endl;
+        return -1;
+    }
+
     // Register function to be called to instrument traces
     TRACE_AddInstrumentFunction(Trace, 0);
 
     // Register function to be called for every loaded module
     IMG_AddInstrumentFunction(ImageLoad, 0);
+    IMG_AddUnloadFunction(ImageUnload, 0);
 
     // Register functions to be called for every thread starting and termination
     PIN_AddThreadStartFunction(ThreadStart, 0);
     PIN_AddThreadFiniFunction(ThreadEnd, 0);
 
-    // Register function to be called when the application exits
+    // Register functions to be called when the application exits
+    PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
     PIN_AddFiniFunction(Fini, 0);
     
+    if (KnobCallEdges.Value() && !KnobLogCallTree.Value())
+    {
+        cerr << "ERROR: -a option can be used only with -c" << endl;
+        return -1;
+    }
+
+    if (KnobLogCallTree.Value() && !KnobCallEdges.Value())
+    {
+        // start call tree log writer thread
+        if (PIN_SpawnInternalThread(CallLogWriterThread, NULL, 0, &m_CallLogThreadId) == INVALID_THREADID)
+        {
+            cerr << "ERROR: Unable to start call tree log writer thread" << endl;
+            return -1;
+        }
+    }
+
+    if (m_EpochMap)
+    {
+        // start epochs swapping and compression thread
+        if (PIN_SpawnInternalThread(EpochThread, NULL, 0, &m_EpochThreadId) == INVALID_THREADID)
+        {
+            cerr << "ERROR: Unable to start epochs thread" << endl;
+            return -1;
+        }
+    }
+
+    if (KnobSnapshot.Value() > 0)
+    {
+        // start snapshot writer thread
+        if (PIN_SpawnInternalThread(SnapshotThread, NULL, 0, &m_SnapshotThreadId) == INVALID_THREADID)
+        {
+            cerr << "ERROR: Unable to start snapshot writer thread" << endl;
+            return -1;
+        }
+    }
+
     cerr << "Starting application..." << endl;
 
     // Start the program, never returns
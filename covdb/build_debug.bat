@@ -0,0 +1,3 @@
+@echo off
+nmake /f makefile_i386_debug
+nmake /f makefile_i386_debug clean
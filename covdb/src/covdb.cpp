@@ -0,0 +1,404 @@
+#include "stdafx.h"
+//--------------------------------------------------------------------------------------
+bool CovDbMap(PCOVDB Db, const char *lpszPath)
+{
+#ifdef _WIN32
+
+    HANDLE hFile = CreateFileA(
+        lpszPath, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(hFile, &Size) || Size.QuadPart == 0 ||
+        (COVDB_UINT64)Size.QuadPart > (SIZE_T)-1)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    const COVDB_UINT8 *Data = (const COVDB_UINT8 *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (Data == NULL)
+    {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+
+    Db->hFile = hFile;
+    Db->hMapping = hMapping;
+    Db->Data = Data;
+    Db->Size = Size.QuadPart;
+
+#else
+
+    int fd = open(lpszPath, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat Stat;
+    if (fstat(fd, &Stat) != 0 || Stat.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *Data = mmap(NULL, Stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (Data == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    Db->fd = fd;
+    Db->Data = (const COVDB_UINT8 *)Data;
+    Db->Size = Stat.st_size;
+
+#endif
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+void CovDbUnmap(PCOVDB Db)
+{
+    if (Db->bMemory)
+    {
+        // database image is owned by the caller
+        Db->Data = NULL;
+        Db->Size = 0;
+        Db->bMemory = false;
+        return;
+    }
+
+#ifdef _WIN32
+
+    if (Db->Data)
+    {
+        UnmapViewOfFile(Db->Data);
+    }
+
+    if (Db->hMapping)
+    {
+        CloseHandle((HANDLE)Db->hMapping);
+    }
+
+    if (Db->hFile)
+    {
+        CloseHandle((HANDLE)Db->hFile);
+    }
+
+#else
+
+    if (Db->Data)
+    {
+        munmap((void *)Db->Data, (size_t)Db->Size);
+    }
+
+    if (Db->fd >= 0)
+    {
+        close(Db->fd);
+    }
+
+#endif
+
+    Db->hFile = Db->hMapping = NULL;
+    Db->fd = -1;
+    Db->Data = NULL;
+    Db->Size = 0;
+}
+//--------------------------------------------------------------------------------------
+static bool CovDbValidate(PCOVDB Db)
+{
+    if (Db->Size < sizeof(COVDB_HEADER))
+    {
+        DbgMsg(__FILE__, __LINE__, "Database file is too small\n");
+        return false;
+    }
+
+    PCOVDB_HEADER Header = (PCOVDB_HEADER)Db->Data;
+
+    if (memcmp(Header->Signature, COVDB_SIGNATURE, sizeof(Header->Signature)) ||
+        Header->Version != COVDB_VERSION)
+    {
+        DbgMsg(__FILE__, __LINE__, "Invalid database signature or version\n");
+        return false;
+    }
+
+    if ((Db->Size - sizeof(COVDB_HEADER)) / sizeof(COVDB_COLUMN) < Header->ColumnsCount)
+    {
+        DbgMsg(__FILE__, __LINE__, "Invalid columns count\n");
+        return false;
+    }
+
+    PCOVDB_COLUMN Columns = (PCOVDB_COLUMN)(Db->Data + sizeof(COVDB_HEADER));
+
+    // number of rows of each table, readers are taking it from any of the table columns
+    COVDB_UINT64 Rows[COVDB_TABLES_MAX];
+    bool bRows[COVDB_TABLES_MAX];
+
+    memset(bRows, 0, sizeof(bRows));
+
+    for (COVDB_UINT32 i = 0; i < Header->ColumnsCount; i++)
+    {
+        PCOVDB_COLUMN Column = &Columns[i];
+
+        if (Column->Table >= COVDB_TABLES_MAX ||
+            (bRows[Column->Table] && Rows[Column->Table] != Column->Count))
+        {
+            DbgMsg(__FILE__, __LINE__, "Invalid rows count of column %d of the table %d\n", Column->Column, Column->Table);
+            return false;
+        }
+
+        Rows[Column->Table] = Column->Count;
+        bRows[Column->Table] = true;
+
+        // column data must be aligned and must be inside of the file
+        if (Column->ElementSize == 0 ||
+            Column->Offset % COVDB_ALIGN != 0 ||
+            Column->Offset > Db->Size ||
+            (Db->Size - Column->Offset) / Column->ElementSize < Column->Count)
+        {
+            DbgMsg(__FILE__, __LINE__, "Invalid column %d of the table %d\n", Column->Column, Column->Table);
+            return false;
+        }
+
+        if (Column->Table == COVDB_TABLE_STRINGS && Column->Column == COVDB_STRINGS_DATA &&
+            Column->Count > 0 && Db->Data[Column->Offset + Column->Count - 1] != '\0')
+        {
+            DbgMsg(__FILE__, __LINE__, "String pool is not terminated\n");
+            return false;
+        }
+    }
+
+    Db->Header = Header;
+    Db->Columns = Columns;
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+bool CovDbOpen(PCOVDB Db, const char *lpszPath)
+{
+    memset(Db, 0, sizeof(COVDB));
+    Db->fd = -1;
+
+    if (!CovDbMap(Db, lpszPath))
+    {
+        DbgMsg(__FILE__, __LINE__, "Unable to map \"%s\"\n", lpszPath);
+        return false;
+    }
+
+    if (!CovDbValidate(Db))
+    {
+        CovDbUnmap(Db);
+        return false;
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+bool CovDbOpenMemory(PCOVDB Db, const void *Data, COVDB_UINT64 Size)
+{
+    memset(Db, 0, sizeof(COVDB));
+    Db->fd = -1;
+
+    // there's no mapping, CovDbUnmap() will not touch the data
+    Db->Data = (const COVDB_UINT8 *)Data;
+    Db->Size = Size;
+    Db->bMemory = true;
+
+    if (!CovDbValidate(Db))
+    {
+        memset(Db, 0, sizeof(COVDB));
+        Db->fd = -1;
+        return false;
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+void CovDbClose(PCOVDB Db)
+{
+    CovDbUnmap(Db);
+
+    Db->Header = NULL;
+    Db->Columns = NULL;
+}
+//--------------------------------------------------------------------------------------
+const void *CovDbColumn(PCOVDB Db, COVDB_UINT32 Table, COVDB_UINT32 Column, COVDB_UINT32 ElementSize, COVDB_UINT64 *Count)
+{
+    for (COVDB_UINT32 i = 0; i < Db->Header->ColumnsCount; i++)
+    {
+        PCOVDB_COLUMN Entry = &Db->Columns[i];
+
+        if (Entry->Table == Table && Entry->Column == Column)
+        {
+            if (Entry->ElementSize != ElementSize)
+            {
+                DbgMsg(__FILE__, __LINE__, "Invalid element size of column %d of the table %d\n", Column, Table);
+                break;
+            }
+
+            if (Count)
+            {
+                *Count = Entry->Count;
+            }
+
+            return Db->Data + Entry->Offset;
+        }
+    }
+
+    if (Count)
+    {
+        *Count = 0;
+    }
+
+    return NULL;
+}
+//--------------------------------------------------------------------------------------
+COVDB_UINT64 CovDbRows(PCOVDB Db, COVDB_UINT32 Table)
+{
+    // all columns of the table have the same number of elements
+    for (COVDB_UINT32 i = 0; i < Db->Header->ColumnsCount; i++)
+    {
+        if (Db->Columns[i].Table == Table)
+        {
+            return Db->Columns[i].Count;
+        }
+    }
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+const char *CovDbString(PCOVDB Db, COVDB_UINT32 Offset)
+{
+    COVDB_UINT64 Count = 0;
+    const char *Strings = COVDB_COLUMN_DATA(Db, COVDB_TABLE_STRINGS, COVDB_STRINGS_DATA, char, &Count);
+
+    if (Strings == NULL || Offset >= Count)
+    {
+        return "";
+    }
+
+    return Strings + Offset;
+}
+//--------------------------------------------------------------------------------------
+static COVDB_UINT64 CovDbLayout(PCOVDB_HEADER Header, PCOVDB_COLUMN Columns)
+{
+    // calculate aligned offsets of the columns data
+    COVDB_UINT64 Offset = sizeof(COVDB_HEADER) + Header->ColumnsCount * sizeof(COVDB_COLUMN);
+
+    for (COVDB_UINT32 i = 0; i < Header->ColumnsCount; i++)
+    {
+        Offset = (Offset + COVDB_ALIGN - 1) & ~((COVDB_UINT64)COVDB_ALIGN - 1);
+        Columns[i].Offset = Offset;
+        Offset += Columns[i].Count * Columns[i].ElementSize;
+    }
+
+    memcpy(Header->Signature, COVDB_SIGNATURE, sizeof(Header->Signature));
+    Header->Version = COVDB_VERSION;
+
+    // total size of the database
+    return Offset;
+}
+//--------------------------------------------------------------------------------------
+bool CovDbWrite(const char *lpszPath, PCOVDB_HEADER Header, PCOVDB_COLUMN Columns, const void **Data)
+{
+    COVDB_UINT64 Offset = 0;
+
+    CovDbLayout(Header, Columns);
+
+    FILE *f = fopen(lpszPath, "wb+");
+    if (f == NULL)
+    {
+        DbgMsg(__FILE__, __LINE__, "Unable to create \"%s\"\n", lpszPath);
+        return false;
+    }
+
+    bool bRet = false;
+
+    if (fwrite(Header, sizeof(COVDB_HEADER), 1, f) != 1 ||
+        fwrite(Columns, sizeof(COVDB_COLUMN), Header->ColumnsCount, f) != Header->ColumnsCount)
+    {
+        goto end;
+    }
+
+    Offset = sizeof(COVDB_HEADER) + Header->ColumnsCount * sizeof(COVDB_COLUMN);
+
+    for (COVDB_UINT32 i = 0; i < Header->ColumnsCount; i++)
+    {
+        static const char Padding[COVDB_ALIGN] = { 0 };
+        size_t PaddingSize = (size_t)(Columns[i].Offset - Offset);
+
+        if (fwrite(Padding, 1, PaddingSize, f) != PaddingSize)
+        {
+            goto end;
+        }
+
+        if (Data[i] && Columns[i].Count > 0 &&
+            fwrite(Data[i], Columns[i].ElementSize, (size_t)Columns[i].Count, f) != Columns[i].Count)
+        {
+            goto end;
+        }
+
+        Offset = Columns[i].Offset + Columns[i].Count * Columns[i].ElementSize;
+    }
+
+    bRet = true;
+
+end:
+
+    if (!bRet)
+    {
+        DbgMsg(__FILE__, __LINE__, "Error while writing \"%s\"\n", lpszPath);
+    }
+
+    fclose(f);
+
+    return bRet;
+}
+//--------------------------------------------------------------------------------------
+COVDB_UINT8 *CovDbBuild(PCOVDB_HEADER Header, PCOVDB_COLUMN Columns, const void **Data, COVDB_UINT64 *Size)
+{
+    *Size = CovDbLayout(Header, Columns);
+
+    if (*Size > (size_t)-1)
+    {
+        return NULL;
+    }
+
+    // padding must be zeroed
+    COVDB_UINT8 *Image = (COVDB_UINT8 *)calloc(1, (size_t)*Size);
+    if (Image == NULL)
+    {
+        DbgMsg(__FILE__, __LINE__, "calloc() fails\n");
+        return NULL;
+    }
+
+    memcpy(Image, Header, sizeof(COVDB_HEADER));
+    memcpy(Image + sizeof(COVDB_HEADER), Columns, Header->ColumnsCount * sizeof(COVDB_COLUMN));
+
+    for (COVDB_UINT32 i = 0; i < Header->ColumnsCount; i++)
+    {
+        if (Data[i] && Columns[i].Count > 0)
+        {
+            memcpy(Image + Columns[i].Offset, Data[i], (size_t)(Columns[i].Count * Columns[i].ElementSize));
+        }
+    }
+
+    return Image;
+}
+//--------------------------------------------------------------------------------------
+// EoF
@@ -0,0 +1,220 @@
+/*
+=========================================================================
+
+    Code coverage analysis tool:
+    Binary coverage database format and reader.
+
+    Database file starts with COVDB_HEADER, that is followed by the
+    table of COVDB_COLUMN entries. Data of each column is a plain array
+    of fixed size elements, that is aligned on COVDB_ALIGN bytes boundary,
+    so the reader can use it straight from the mapped file without any
+    parsing or copying.
+
+    All rows of the table are stored in the columns with the same table ID,
+    row N of the table consists of the N-th elements of its columns, so all
+    of them must have the same number of elements. Table IDs are below
+    COVDB_TABLES_MAX. Readers must ignore unknown tables and columns, new
+    columns can be added without the version change.
+
+    Addresses are stored as (module ID, offset) pairs, where module ID is the
+    row number in the modules table, or COVDB_MODULE_UNKNOWN for the code that
+    doesn't belong to any module (offset is absolute address in this case).
+    Blocks, routines and calls tables are sorted by module ID and offset.
+
+=========================================================================
+*/
+
+#ifndef _COVDB_H_
+#define _COVDB_H_
+
+#ifdef _MSC_VER
+typedef unsigned __int64 COVDB_UINT64;
+#else
+typedef unsigned long long COVDB_UINT64;
+#endif
+
+typedef unsigned int COVDB_UINT32;
+typedef unsigned char COVDB_UINT8;
+
+// database file signature (8 bytes with terminating zeros) and version
+#define COVDB_SIGNATURE "COVDB\0\0"
+#define COVDB_VERSION 1
+
+// alignment of the columns data
+#define COVDB_ALIGN 8
+
+// upper bound of the table IDs
+#define COVDB_TABLES_MAX 0x100
+
+#define COVDB_MODULE_UNKNOWN 0xffffffff
+
+// string pool: zero terminated strings, referenced by offset
+#define COVDB_TABLE_STRINGS             0
+#define COVDB_STRINGS_DATA              0   // COVDB_UINT8
+
+// modules table, row number is module ID
+#define COVDB_TABLE_MODULES             1
+#define COVDB_MODULES_START             0   // COVDB_UINT64, image start address
+#define COVDB_MODULES_END               1   // COVDB_UINT64, image end address (inclusive)
+#define COVDB_MODULES_LOAD              2   // COVDB_UINT32, load event sequence number (0 in merged database)
+#define COVDB_MODULES_UNLOAD            3   // COVDB_UINT32, unload event sequence number or 0
+#define COVDB_MODULES_PATH              4   // COVDB_UINT32, offset of full image path in the string pool
+
+// executed basic blocks table
+#define COVDB_TABLE_BLOCKS              2
+#define COVDB_BLOCKS_MODULE             0   // COVDB_UINT32
+#define COVDB_BLOCKS_OFFSET             1   // COVDB_UINT64
+#define COVDB_BLOCKS_SIZE               2   // COVDB_UINT32
+#define COVDB_BLOCKS_INSTRUCTIONS       3   // COVDB_UINT32
+#define COVDB_BLOCKS_COUNT              4   // COVDB_UINT64
+#define COVDB_BLOCKS_RUNS_DATA          5   // COVDB_UINT64, offset of the runs bitmap in the runs bitmaps pool (merged database only)
+#define COVDB_BLOCKS_RUNS_SIZE          6   // COVDB_UINT32, size of the runs bitmap
+
+// called routines table
+#define COVDB_TABLE_ROUTINES            3
+#define COVDB_ROUTINES_MODULE           0   // COVDB_UINT32
+#define COVDB_ROUTINES_OFFSET           1   // COVDB_UINT64
+#define COVDB_ROUTINES_COUNT            2   // COVDB_UINT64
+
+// call edges table
+#define COVDB_TABLE_CALLS               4
+#define COVDB_CALLS_CALLER_MODULE       0   // COVDB_UINT32
+#define COVDB_CALLS_CALLER_OFFSET       1   // COVDB_UINT64
+#define COVDB_CALLS_CALLEE_MODULE       2   // COVDB_UINT32
+#define COVDB_CALLS_CALLEE_OFFSET       3   // COVDB_UINT64
+#define COVDB_CALLS_COUNT               4   // COVDB_UINT64
+
+// coverage epochs (-epoch and -epoch_ins options)
+#define COVDB_TABLE_EPOCHS              5
+#define COVDB_EPOCHS_START              0   // COVDB_UINT64, milliseconds since the process start
+#define COVDB_EPOCHS_END                1   // COVDB_UINT64, milliseconds since the process start
+#define COVDB_EPOCHS_INSTRUCTIONS       2   // COVDB_UINT64, executed instructions at the epoch end (-epoch_ins only)
+#define COVDB_EPOCHS_BLOCKS             3   // COVDB_UINT32, number of blocks executed in the epoch
+#define COVDB_EPOCHS_NEW                4   // COVDB_UINT32, number of blocks that were not executed before
+#define COVDB_EPOCHS_DATA               5   // COVDB_UINT64, offset of the epoch bitmap in the bitmaps pool
+#define COVDB_EPOCHS_SIZE               6   // COVDB_UINT32, size of the epoch bitmap
+
+/*
+    Compressed bitmaps of blocks executed in each epoch: ascending row numbers
+    of the blocks table, every row number is encoded as the difference with the
+    previous one (0 for the first) with zigzag and 7 bits per byte varint encoding.
+*/
+#define COVDB_TABLE_EPOCHS_DATA         6
+#define COVDB_EPOCHS_DATA_DATA          0   // COVDB_UINT8
+
+// input runs of the merged database (coverage_merge.exe), row number is run number
+#define COVDB_TABLE_RUNS                7
+#define COVDB_RUNS_PATH                 0   // COVDB_UINT32, offset of the input path in the string pool
+
+/*
+    Compressed bitmaps of runs that executed each block (coverage_merge.exe
+    "--runs" option), encoded just like the epochs bitmaps, but with the row
+    numbers of the runs table.
+*/
+#define COVDB_TABLE_RUNS_DATA           8
+#define COVDB_RUNS_DATA_DATA            0   // COVDB_UINT8
+
+typedef struct _COVDB_HEADER
+{
+    char Signature[8];
+    COVDB_UINT32 Version;
+
+    // number of entries in the columns table that follows the header
+    COVDB_UINT32 ColumnsCount;
+
+    // traced process information
+    COVDB_UINT32 ProcessId;
+    COVDB_UINT32 Threads;
+    COVDB_UINT64 Time;
+
+    // offset of the process command line in the string pool
+    COVDB_UINT32 CommandLine;
+    COVDB_UINT32 Reserved;
+
+} COVDB_HEADER,
+*PCOVDB_HEADER;
+
+typedef struct _COVDB_COLUMN
+{
+    COVDB_UINT32 Table;
+    COVDB_UINT32 Column;
+
+    // size of the single element and number of elements
+    COVDB_UINT32 ElementSize;
+    COVDB_UINT32 Reserved;
+    COVDB_UINT64 Count;
+
+    // offset of the column data from the beginning of the file
+    COVDB_UINT64 Offset;
+
+} COVDB_COLUMN,
+*PCOVDB_COLUMN;
+
+typedef struct _COVDB
+{
+    // mapped file
+    void *hFile;
+    void *hMapping;
+    int fd;
+
+    // database image is in the memory owned by the caller (CovDbOpenMemory)
+    bool bMemory;
+
+    const COVDB_UINT8 *Data;
+    COVDB_UINT64 Size;
+
+    PCOVDB_HEADER Header;
+    PCOVDB_COLUMN Columns;
+
+} COVDB,
+*PCOVDB;
+
+/**
+ * Map the database file into the memory and validate its structure.
+ */
+bool CovDbOpen(PCOVDB Db, const char *lpszPath);
+
+/**
+ * Validate and use the database image from the memory, it must stay valid
+ * until CovDbClose() call.
+ */
+bool CovDbOpenMemory(PCOVDB Db, const void *Data, COVDB_UINT64 Size);
+
+/**
+ * Unmap the database file.
+ */
+void CovDbClose(PCOVDB Db);
+
+/**
+ * Get pointer to the data and number of elements of the column, returns
+ * NULL if there is no such column or its element size doesn't match.
+ */
+const void *CovDbColumn(PCOVDB Db, COVDB_UINT32 Table, COVDB_UINT32 Column, COVDB_UINT32 ElementSize, COVDB_UINT64 *Count);
+
+/**
+ * Get number of rows in the table.
+ */
+COVDB_UINT64 CovDbRows(PCOVDB Db, COVDB_UINT32 Table);
+
+/**
+ * Get string from the string pool by its offset, returns empty string for invalid offsets.
+ */
+const char *CovDbString(PCOVDB Db, COVDB_UINT32 Offset);
+
+/**
+ * Write the database file, Data[i] is pointing to the elements of Columns[i].
+ * Function fills signature, version and columns offsets by itself.
+ */
+bool CovDbWrite(const char *lpszPath, PCOVDB_HEADER Header, PCOVDB_COLUMN Columns, const void **Data);
+
+/**
+ * Build the database image in the memory, just like CovDbWrite() does. Returned
+ * buffer must be freed with free().
+ */
+COVDB_UINT8 *CovDbBuild(PCOVDB_HEADER Header, PCOVDB_COLUMN Columns, const void **Data, COVDB_UINT64 *Size);
+
+// typed column access
+#define COVDB_COLUMN_DATA(_db_, _table_, _column_, _type_, _count_) \
+    ((const _type_ *)CovDbColumn((_db_), (_table_), (_column_), sizeof(_type_), (_count_)))
+
+#endif // _COVDB_H_
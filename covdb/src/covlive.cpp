@@ -0,0 +1,265 @@
+#include "stdafx.h"
+//--------------------------------------------------------------------------------------
+typedef struct _LIVE_BLOCK
+{
+    COVDB_UINT32 Module;
+    COVDB_UINT64 Offset;
+    COVDB_UINT32 Size;
+    COVDB_UINT32 Instructions;
+    COVDB_UINT64 Count;
+
+} LIVE_BLOCK,
+*PLIVE_BLOCK;
+
+static bool LiveBlockLess(const LIVE_BLOCK &First, const LIVE_BLOCK &Second)
+{
+    if (First.Module != Second.Module)
+    {
+        return First.Module < Second.Module;
+    }
+
+    return First.Offset < Second.Offset;
+}
+//--------------------------------------------------------------------------------------
+static void *LiveChunk(PCOVDB Live, PCOVLIVE_CHUNK Chunk, COVDB_UINT64 Size)
+{
+    // chunk data must be inside of the file
+    if (Chunk->Offset < sizeof(COVLIVE_HEADER) ||
+        Chunk->Offset > Live->Size || Live->Size - Chunk->Offset < Size)
+    {
+        DbgMsg(__FILE__, __LINE__, "Invalid chunk at offset 0x%llx\n", (unsigned long long)Chunk->Offset);
+        return NULL;
+    }
+
+    return (void *)(Live->Data + Chunk->Offset);
+}
+//--------------------------------------------------------------------------------------
+static bool LiveConvert(
+    const char *lpszLivePath, const char *lpszDbPath,
+    COVDB_UINT8 **Image, COVDB_UINT64 *Size, COVDB_UINT32 *State)
+{
+    bool bRet = false;
+    COVDB Live;
+
+    memset(&Live, 0, sizeof(COVDB));
+    Live.fd = -1;
+
+    if (!CovDbMap(&Live, lpszLivePath))
+    {
+        DbgMsg(__FILE__, __LINE__, "Unable to map \"%s\"\n", lpszLivePath);
+        return false;
+    }
+
+    PCOVLIVE_HEADER Header = (PCOVLIVE_HEADER)Live.Data;
+
+    if (Live.Size < sizeof(COVLIVE_HEADER) ||
+        memcmp(Header->Signature, COVLIVE_SIGNATURE, sizeof(Header->Signature)) ||
+        Header->Version != COVLIVE_VERSION ||
+        Header->ChunkSlots == 0 || Header->ChunkSlots > COVLIVE_MAX_CHUNK_SLOTS)
+    {
+        DbgMsg(__FILE__, __LINE__, "Invalid live counters file signature or version\n");
+        CovDbUnmap(&Live);
+        return false;
+    }
+
+    if (State)
+    {
+        *State = Header->State;
+    }
+
+    // use only committed entries, file might be truncated by the crash
+    COVDB_UINT32 ModulesCount = std::min((COVDB_UINT32)Header->ModulesCount, (COVDB_UINT32)COVLIVE_MAX_MODULES);
+    COVDB_UINT32 ChunksCount = std::min((COVDB_UINT32)Header->ChunksCount, (COVDB_UINT32)COVLIVE_MAX_CHUNKS);
+    COVDB_UINT32 ChunkSlots = Header->ChunkSlots;
+    COVDB_UINT64 MaxSlots = (COVDB_UINT64)ChunksCount * ChunkSlots;
+
+    // every committed slot has its block entry inside of the arena
+    MaxSlots = std::min(MaxSlots, (Live.Size - sizeof(COVLIVE_HEADER)) / sizeof(COVLIVE_BLOCK));
+
+    COVDB_UINT32 SlotsCount = (COVDB_UINT32)std::min((COVDB_UINT64)Header->SlotsCount, MaxSlots);
+
+    std::vector<PCOVLIVE_BLOCK> Blocks(SlotsCount / ChunkSlots + (SlotsCount % ChunkSlots ? 1 : 0), (PCOVLIVE_BLOCK)NULL);
+    std::vector<COVDB_UINT64> Counts(SlotsCount, 0);
+
+    for (COVDB_UINT32 i = 0; i < ChunksCount; i++)
+    {
+        PCOVLIVE_CHUNK Chunk = &Header->Chunks[i];
+
+        // index of reused chunk might be changed by the running process
+        COVDB_UINT32 Index = Chunk->Index;
+
+        if (Index >= Blocks.size())
+        {
+            // chunk of uncommitted slots
+            continue;
+        }
+
+        COVDB_UINT32 First = Index * ChunkSlots;
+        COVDB_UINT32 Count = std::min(ChunkSlots, SlotsCount - First);
+
+        if (Chunk->Type == COVLIVE_CHUNK_BLOCKS)
+        {
+            Blocks[Index] = (PCOVLIVE_BLOCK)LiveChunk(&Live, Chunk, (COVDB_UINT64)ChunkSlots * sizeof(COVLIVE_BLOCK));
+        }
+        else if (Chunk->Type == COVLIVE_CHUNK_COUNTERS)
+        {
+            // global and per-thread counters of the same slots must be summed
+            COVDB_UINT32 *Counters = (COVDB_UINT32 *)LiveChunk(&Live, Chunk, (COVDB_UINT64)ChunkSlots * sizeof(COVDB_UINT32));
+            if (Counters)
+            {
+                for (COVDB_UINT32 n = 0; n < Count; n++)
+                {
+                    Counts[First + n] += Counters[n];
+                }
+            }
+        }
+        else if (Chunk->Type == COVLIVE_CHUNK_HITS)
+        {
+            COVDB_UINT8 *Hits = (COVDB_UINT8 *)LiveChunk(&Live, Chunk, (COVDB_UINT64)ChunkSlots * sizeof(COVDB_UINT8));
+            if (Hits)
+            {
+                for (COVDB_UINT32 n = 0; n < Count; n++)
+                {
+                    Counts[First + n] += Hits[n];
+                }
+            }
+        }
+    }
+
+    std::vector<LIVE_BLOCK> Executed;
+
+    for (COVDB_UINT32 i = 0; i < SlotsCount; i++)
+    {
+        PCOVLIVE_BLOCK Block = Blocks[i / ChunkSlots];
+
+        if (Counts[i] == 0 || Block == NULL)
+        {
+            continue;
+        }
+
+        Block += i % ChunkSlots;
+
+        LIVE_BLOCK Entry;
+        Entry.Module = Block->Module;
+        Entry.Offset = Block->Address;
+        Entry.Size = Block->Size;
+        Entry.Instructions = Block->Instructions;
+        Entry.Count = Counts[i];
+
+        if (Entry.Module < ModulesCount)
+        {
+            Entry.Offset -= Header->Modules[Entry.Module].Start;
+        }
+        else
+        {
+            // module information is not available, keep the absolute address
+            Entry.Module = COVDB_MODULE_UNKNOWN;
+        }
+
+        Executed.push_back(Entry);
+    }
+
+    std::sort(Executed.begin(), Executed.end(), LiveBlockLess);
+
+    // empty command line is the first string in the pool
+    std::vector<char> Strings(1, '\0');
+
+    std::vector<COVDB_UINT64> ModulesStart, ModulesEnd;
+    std::vector<COVDB_UINT32> ModulesLoad, ModulesUnload, ModulesPath;
+
+    for (COVDB_UINT32 i = 0; i < ModulesCount; i++)
+    {
+        PCOVLIVE_MODULE Module = &Header->Modules[i];
+        size_t PathLength = strnlen(Module->Path, COVLIVE_PATH_SIZE);
+
+        ModulesStart.push_back(Module->Start);
+        ModulesEnd.push_back(Module->End);
+        ModulesLoad.push_back(Module->Load);
+        ModulesUnload.push_back((COVDB_UINT32)Module->Unload);
+        ModulesPath.push_back((COVDB_UINT32)Strings.size());
+
+        Strings.insert(Strings.end(), Module->Path, Module->Path + PathLength);
+        Strings.push_back('\0');
+    }
+
+    std::vector<COVDB_UINT32> BlocksModule, BlocksSize, BlocksInstructions;
+    std::vector<COVDB_UINT64> BlocksOffset, BlocksCount;
+
+    for (size_t i = 0; i < Executed.size(); i++)
+    {
+        BlocksModule.push_back(Executed[i].Module);
+        BlocksOffset.push_back(Executed[i].Offset);
+        BlocksSize.push_back(Executed[i].Size);
+        BlocksInstructions.push_back(Executed[i].Instructions);
+        BlocksCount.push_back(Executed[i].Count);
+    }
+
+    COVDB_COLUMN Columns[11];
+    const void *Data[11];
+    COVDB_UINT32 ColumnsCount = 0;
+
+#define LIVE_COLUMN(_table_, _column_, _vector_)                                \
+                                                                                \
+    memset(&Columns[ColumnsCount], 0, sizeof(COVDB_COLUMN));                    \
+    Columns[ColumnsCount].Table = (_table_);                                    \
+    Columns[ColumnsCount].Column = (_column_);                                  \
+    Columns[ColumnsCount].ElementSize = sizeof((_vector_)[0]);                  \
+    Columns[ColumnsCount].Count = (_vector_).size();                            \
+    Data[ColumnsCount] = (_vector_).size() > 0 ? &(_vector_)[0] : NULL;         \
+    ColumnsCount += 1;
+
+    LIVE_COLUMN(COVDB_TABLE_STRINGS, COVDB_STRINGS_DATA, Strings);
+
+    LIVE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_START, ModulesStart);
+    LIVE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_END, ModulesEnd);
+    LIVE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_LOAD, ModulesLoad);
+    LIVE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_UNLOAD, ModulesUnload);
+    LIVE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_PATH, ModulesPath);
+
+    LIVE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_MODULE, BlocksModule);
+    LIVE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_OFFSET, BlocksOffset);
+    LIVE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_SIZE, BlocksSize);
+    LIVE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_INSTRUCTIONS, BlocksInstructions);
+    LIVE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_COUNT, BlocksCount);
+
+#undef LIVE_COLUMN
+
+    COVDB_HEADER DbHeader;
+
+    memset(&DbHeader, 0, sizeof(DbHeader));
+    DbHeader.ColumnsCount = ColumnsCount;
+    DbHeader.ProcessId = Header->ProcessId;
+    DbHeader.CommandLine = 0;
+
+    if (lpszDbPath)
+    {
+        bRet = CovDbWrite(lpszDbPath, &DbHeader, Columns, Data);
+    }
+    else
+    {
+        bRet = (*Image = CovDbBuild(&DbHeader, Columns, Data, Size)) != NULL;
+    }
+
+    CovDbUnmap(&Live);
+
+    return bRet;
+}
+//--------------------------------------------------------------------------------------
+bool CovLiveRecover(const char *lpszLivePath, const char *lpszDbPath, COVDB_UINT32 *State)
+{
+    return LiveConvert(lpszLivePath, lpszDbPath, NULL, NULL, State);
+}
+//--------------------------------------------------------------------------------------
+COVDB_UINT8 *CovLiveRecoverMemory(const char *lpszLivePath, COVDB_UINT64 *Size, COVDB_UINT32 *State)
+{
+    COVDB_UINT8 *Image = NULL;
+
+    if (!LiveConvert(lpszLivePath, NULL, &Image, Size, State))
+    {
+        return NULL;
+    }
+
+    return Image;
+}
+//--------------------------------------------------------------------------------------
+// EoF
@@ -0,0 +1,132 @@
+/*
+=========================================================================
+
+    Code coverage analysis tool:
+    Live counters file format.
+
+    Instrumentation module started with "-live" option keeps its basic
+    blocks counters, blocks information and modules list inside of the
+    memory mapped file, so the data is persisted by the OS even if the
+    target process crashes or gets killed.
+
+    File starts with COVLIVE_HEADER, that is followed by the arena of
+    counters and blocks chunks, that are described by the chunks directory
+    in the header. Each counters chunk is holding the counters of the
+    COVLIVE_HEADER::ChunkSlots consecutive slots starting from the slot
+    Index * ChunkSlots, there might be several counters chunks with the same
+    index (global counters and per-thread ones), the reader must sum them.
+
+    Commit protocol: writer fills the module, chunk or block entry first,
+    and then increments corresponding count field of the header and Commit
+    field. Reader must use only the entries below of the counts, committed
+    slots might have no blocks chunk when the file is full. State field
+    is COVLIVE_STATE_RUNNING until the normal process termination.
+
+=========================================================================
+*/
+
+#ifndef _COVLIVE_H_
+#define _COVLIVE_H_
+
+#include "covdb.h"
+
+// live counters file signature (8 bytes with terminating zero) and version
+#define COVLIVE_SIGNATURE "COVLIVE"
+#define COVLIVE_VERSION 1
+
+#define COVLIVE_STATE_RUNNING   1
+#define COVLIVE_STATE_FINISHED  2
+
+#define COVLIVE_MAX_MODULES     0x400
+#define COVLIVE_MAX_CHUNKS      0x4000
+#define COVLIVE_PATH_SIZE       0x200
+
+// max. number of slots in the single chunk
+#define COVLIVE_MAX_CHUNK_SLOTS 0x100000
+
+// alignment of the arena and chunks
+#define COVLIVE_ALIGN           0x1000
+
+// chunk types
+#define COVLIVE_CHUNK_COUNTERS  1   // COVDB_UINT32 counters
+#define COVLIVE_CHUNK_HITS      2   // COVDB_UINT8 hit flags
+#define COVLIVE_CHUNK_BLOCKS    3   // COVLIVE_BLOCK entries
+
+typedef struct _COVLIVE_MODULE
+{
+    COVDB_UINT64 Start;
+    COVDB_UINT64 End;
+    COVDB_UINT32 Load;
+    volatile COVDB_UINT32 Unload;
+    char Path[COVLIVE_PATH_SIZE];
+
+} COVLIVE_MODULE,
+*PCOVLIVE_MODULE;
+
+typedef struct _COVLIVE_BLOCK
+{
+    COVDB_UINT64 Address;
+    COVDB_UINT32 Module;
+    COVDB_UINT32 Size;
+    COVDB_UINT32 Instructions;
+    COVDB_UINT32 Reserved;
+
+} COVLIVE_BLOCK,
+*PCOVLIVE_BLOCK;
+
+typedef struct _COVLIVE_CHUNK
+{
+    COVDB_UINT32 Type;
+
+    // chunk number, first slot of the chunk is Index * ChunkSlots
+    volatile COVDB_UINT32 Index;
+
+    // offset of the chunk data from the beginning of the file
+    COVDB_UINT64 Offset;
+
+} COVLIVE_CHUNK,
+*PCOVLIVE_CHUNK;
+
+typedef struct _COVLIVE_HEADER
+{
+    char Signature[8];
+    COVDB_UINT32 Version;
+    volatile COVDB_UINT32 State;
+
+    COVDB_UINT32 ProcessId;
+
+    // number of slots in the single chunk
+    COVDB_UINT32 ChunkSlots;
+
+    // file size and offset of the arena free space
+    COVDB_UINT64 Size;
+    volatile COVDB_UINT64 Used;
+
+    // number of committed entries
+    volatile COVDB_UINT32 ModulesCount;
+    volatile COVDB_UINT32 ChunksCount;
+    volatile COVDB_UINT32 SlotsCount;
+
+    // incremented on every commit
+    volatile COVDB_UINT32 Commit;
+
+    COVLIVE_MODULE Modules[COVLIVE_MAX_MODULES];
+    COVLIVE_CHUNK Chunks[COVLIVE_MAX_CHUNKS];
+
+} COVLIVE_HEADER,
+*PCOVLIVE_HEADER;
+
+/**
+ * Convert live counters file of the running, finished or crashed process into the
+ * binary coverage database with modules and executed basic blocks tables. State 
+ * of the live counters file is returned in the optional State argument.
+ */
+bool CovLiveRecover(const char *lpszLivePath, const char *lpszDbPath, COVDB_UINT32 *State);
+
+/**
+ * The same as CovLiveRecover(), but database image is built in the memory, it
+ * can be used with CovDbOpenMemory() and must be freed with free().
+ */
+COVDB_UINT8 *CovLiveRecoverMemory(const char *lpszLivePath, COVDB_UINT64 *Size, COVDB_UINT32 *State);
+
+#endif // _COVLIVE_H_
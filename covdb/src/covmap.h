@@ -0,0 +1,10 @@
+/**
+ * Map the whole file into the memory for reading, mapping information
+ * is stored in hFile, hMapping, fd, Data and Size fields of the COVDB.
+ */
+bool CovDbMap(PCOVDB Db, const char *lpszPath);
+
+/**
+ * Unmap the file that was mapped by CovDbMap().
+ */
+void CovDbUnmap(PCOVDB Db);
@@ -0,0 +1,38 @@
+#include "stdafx.h"
+//--------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("USAGE: covrecover.exe <live_file_path> <database_path>\n");
+        return -1;
+    }
+
+    COVDB_UINT32 State = 0;
+
+    if (!CovLiveRecover(argv[1], argv[2], &State))
+    {
+        printf("ERROR: Unable to recover coverage from \"%s\"\n", argv[1]);
+        return -1;
+    }
+
+    COVDB Db;
+    if (CovDbOpen(&Db, argv[2]))
+    {
+        printf(
+            "%d modules, %d executed basic blocks\n", 
+            (int)CovDbRows(&Db, COVDB_TABLE_MODULES), (int)CovDbRows(&Db, COVDB_TABLE_BLOCKS)
+        );
+
+        CovDbClose(&Db);
+    }
+
+    if (State != COVLIVE_STATE_FINISHED)
+    {
+        printf("WARNING: Process was not terminated normally\n");
+    }
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+// EoF
@@ -0,0 +1,18 @@
+#include "stdafx.h"
+//--------------------------------------------------------------------------------------
+#ifdef DBG
+//--------------------------------------------------------------------------------------
+void DbgMsg(const char *lpszFile, int iLine, const char *lpszMsg, ...)
+{
+    va_list mylist;
+    va_start(mylist, lpszMsg);
+
+    fprintf(stderr, "COVDB: %s(%d) : ", lpszFile, iLine);
+    vfprintf(stderr, lpszMsg, mylist);
+
+    va_end(mylist);
+}
+//--------------------------------------------------------------------------------------
+#endif // DBG
+//--------------------------------------------------------------------------------------
+// EoF
@@ -0,0 +1,113 @@
+import sys, os, subprocess
+
+# PIN toolkit root directory, the same as in execute_pin.bat
+pin_path = "D:\\pin-2.12-56759-msvc9-windows"
+
+test_lib = "kernel32"
+test_cmd = [ "cmd.exe", "/c", "exit" ]
+test_dir = ".\\logs_filter_test"
+
+MODULE_UNKNOWN = -1
+
+if len(sys.argv) >= 2:
+
+    pin_path = sys.argv[1]
+
+# if end
+
+if len(sys.argv) >= 3:
+
+    test_lib = sys.argv[2]
+
+# if end
+
+def run_pin(modules):
+
+    if not os.path.isdir(test_dir):
+
+        os.mkdir(test_dir)
+
+    # if end
+
+    pin = os.path.join(pin_path, "ia32", "bin", "pin.exe")
+    tool = os.path.join(pin_path, "coverager.dll")
+
+    cmd = [ pin, "-t", tool, "-d", test_dir, "-db", "0", "-m", modules, "--" ] + test_cmd
+    if subprocess.call(cmd) != 0:
+
+        print "ERROR: Unable to execute %s" % " ".join(cmd)
+        sys.exit(-1)
+
+    # if end
+
+# def end
+
+def read_log(name):
+
+    # skip comments and parse <field>:<field>:... lines
+    log = open(os.path.join(test_dir, "coverager.log" + name), "rb")
+    entries = [ line.strip().split(":") for line in log if line.strip() and not line.startswith("#") ]
+    log.close()
+
+    return entries
+
+# def end
+
+def blocks_modules():
+
+    # module ID is the 4-th field of the basic block entry
+    return set([ int(entry[3]) for entry in read_log(".blocks") ])
+
+# def end
+
+def modules_ids(name):
+
+    # module path is the last field, it contains ':' after the drive letter
+    return set([ int(entry[0]) for entry in read_log(".modules")
+                 if ":".join(entry[5:]).split("\\")[-1].lower().startswith(name.lower()) ])
+
+# def end
+
+print "[+] Testing \"-m ?\" filter..."
+
+# step 1: only the code that doesn't belong to any module must be instrumented
+run_pin("?")
+
+modules = blocks_modules()
+if len(modules - set([ MODULE_UNKNOWN ])) > 0:
+
+    print "ERROR: Blocks of the modules %s were logged with \"-m ?\"" % str(list(modules - set([ MODULE_UNKNOWN ])))
+    print "[-] Test failed"
+    sys.exit(-1)
+
+# if end
+
+print "[+] Testing \"-m %s\" filter..." % test_lib
+
+# step 2: only the specified module must be instrumented
+run_pin(test_lib)
+
+modules = blocks_modules()
+if len(modules) == 0 or len(modules - modules_ids(test_lib)) > 0:
+
+    print "ERROR: Unexpected modules %s were logged with \"-m %s\"" % (str(list(modules)), test_lib)
+    print "[-] Test failed"
+    sys.exit(-1)
+
+# if end
+
+print "[+] Testing \"-m %s,?\" filter..." % test_lib
+
+# step 3: empty list items are ignored, unknown code is allowed in addition to the module
+run_pin(",%s, ,?" % test_lib)
+
+modules = blocks_modules()
+if len(modules - modules_ids(test_lib) - set([ MODULE_UNKNOWN ])) > 0:
+
+    print "ERROR: Unexpected modules %s were logged with \"-m %s,?\"" % (str(list(modules)), test_lib)
+    print "[-] Test failed"
+    sys.exit(-1)
+
+# if end
+
+print "[+] Test passed"
@@ -105,6 +105,7 @@ def sortproc_calls(a, b):
 # def end  
 
 m_modules_list = {}
+m_modules_by_id = {}
 m_logfile = None
 m_sortproc = sortproc_names
 m_modules_to_process = []
@@ -124,9 +125,31 @@ def log_write(text):
 
 # def end    
 
+def module_is_skipped(module_name):
+
+    global m_modules_to_process
+
+    if len(m_modules_to_process) == 0:
+
+        return False
+
+    for module_flt in m_modules_to_process:
+
+        if module_name.find(module_flt) >= 0:
+
+            # don't skip this module
+            return False
+
+        # if end
+    # for end
+
+    return True
+
+# def end
+
 def read_modules_list(file_name):
 
-    global m_modules_list
+    global m_modules_list, m_modules_by_id
 
     # open input file
     f = open(file_name)
@@ -135,15 +158,20 @@ def read_modules_list(file_name):
     # read file contents line by line
     while content != "":
         
-        content = content.replace("\n", "")
+        content = content.replace("\r", "").replace("\n", "")
         entry = content.split(":") 
 
-        if content[:1] != "#" and len(entry) >= 3:
+        if content[:1] != "#" and len(entry) >= 6:
+
+            module_id = int(entry[0])
+            module_path = ":".join(entry[5:])
+            module_name = os.path.basename(module_path)
 
-            module_path = ":".join(entry[2:])
-            module_name = os.path.basename(module_path).lower()
+            module = { 'path': module_path, 'name': module_name, 'processed_items': 0, \
+                'skip': module_is_skipped(module_name.lower()) }
 
-            m_modules_list[module_name] = { 'path': module_path, 'processed_items': 0 }
+            m_modules_list[module_name.lower()] = module
+            m_modules_by_id[module_id] = module
 
         # if end
 
@@ -156,79 +184,82 @@ def read_modules_list(file_name):
 
 # def end    
 
-def parse_symbol(string):
+def parse_symbol(module_id, offset):
 
-    global m_modules_list, m_modules_to_process, m_skip_symbols
+    global m_modules_by_id, m_modules_to_process
 
-    # parse 'name+offset' string
-    info = string.split("+")
-    if len(info) >= 2:
+    if not m_modules_by_id.has_key(module_id):
 
-        info[1] = int(info[1], 16)
-        module_path = info[0].lower()
+        # address doesn't belong to any known module
+        if len(m_modules_to_process) > 0 and "?" not in m_modules_to_process:
 
-        if m_modules_list.has_key(module_path):
+            return False
 
-            m_modules_list[module_path]['processed_items'] += 1            
+        return "?0x%x" % offset
 
-        # if end        
+    # if end
 
-        skip_module = False
+    module = m_modules_by_id[module_id]
+    module['processed_items'] += 1
 
-        if len(m_modules_to_process) > 0:
+    if module['skip']:
 
-            skip_module = True
+        return False
 
-            for module_flt in m_modules_to_process:
+    # debug symbols are looked up later for all of the entries at once
+    return "%s+%x" % (module['name'], offset)
 
-                if module_path.find(module_flt) >= 0:
+# def end    
 
-                    # don't skip this module
-                    skip_module = False
+def lookup_symbols(info_list):
 
-                # if end
-            # for end        
-        # if end
+    global m_modules_by_id, m_skip_symbols
 
-        if skip_module:
+    if m_skip_symbols:
 
-            return False
+        return
 
-        if m_skip_symbols:
+    # group entries by module
+    entries_by_module = {}
 
-            return string
-                
-        if m_modules_list.has_key(module_path):
+    for entry in info_list:
+
+        if m_modules_by_id.has_key(entry['module_id']):
 
-            module_path = m_modules_list[module_path]['path']
+            entries_by_module.setdefault(entry['module_id'], []).append(entry)
 
         # if end
+    # for end
 
-        # lookup debug symbol for address
-        symbol = bestbyaddr(module_path, info[1])
-        if symbol != None:
+    for module_id in entries_by_module:
 
-            addr_s = "%s!%s" % (info[0], symbol[0])
+        module = m_modules_by_id[module_id]
+        entries = entries_by_module[module_id]
 
-            if symbol[1] > 0:
+        # lookup debug symbols for all of the module entries at once
+        symbols = bestbyaddr_multi([ module['path'] ] * len(entries), [ entry['offset'] for entry in entries ])
+        if symbols != None:
 
-                addr_s += "+0x%x" % symbol[1]
+            names, deltas = symbols
 
-            return addr_s
+            for i in range(0, len(entries)):
 
-        # if end
+                if names[i] != None:
 
-    elif string[0] == "?" and len(m_modules_to_process) > 0:
+                    addr_s = "%s!%s" % (module['name'], names[i])
 
-        if "?" not in m_modules_to_process:
+                    if deltas[i] > 0:
 
-            return False
+                        addr_s += "+0x%x" % deltas[i]
 
-    # if end
+                    entries[i]['name'] = addr_s
 
-    return string
+                # if end
+            # for end
+        # if end
+    # for end
 
-# def end    
+# def end
 
 def print_routines(file_name):
 
@@ -253,17 +284,20 @@ def print_routines(file_name):
         content = content.replace("\n", "")        
         entry = content.split(":") 
 
-        if content[:1] != "#" and len(entry) >= 3:
+        if content[:1] != "#" and len(entry) >= 4:
 
             rtn_addr = int(entry[0], 16) # routinr virtual address
-            rtn_calls = int(entry[2])
+            rtn_calls = int(entry[3])
+            rtn_module = int(entry[1])
+            rtn_offset = int(entry[2], 16)
             
             # parse symbol name
-            rtn_name = parse_symbol(entry[1])
+            rtn_name = parse_symbol(rtn_module, rtn_offset)
 
             if rtn_name != False:
 
-                info_list.append({'addr': rtn_addr, 'name': rtn_name, 'calls': rtn_calls })
+                info_list.append({'addr': rtn_addr, 'name': rtn_name, 'calls': rtn_calls, \
+                    'module_id': rtn_module, 'offset': rtn_offset })
 
         # if end
 
@@ -272,6 +306,8 @@ def print_routines(file_name):
 
     # while end    
 
+    lookup_symbols(info_list)
+
     # sort entries list
     info_list.sort(m_sortproc)
 
@@ -314,20 +350,23 @@ def print_blocks(file_name):
         content = content.replace("\n", "")
         entry = content.split(":")        
 
-        if content[:1] != "#" and len(entry) >= 4:
+        if content[:1] != "#" and len(entry) >= 6:
 
             # parse log entry
             bb_addr = int(entry[0], 16) # block virtual address
             bb_size = int(entry[1], 16) # block size
-            bb_calls = int(entry[4]) # calls count
+            bb_calls = int(entry[5]) # calls count
             bb_insts = int(entry[2]) # instructions count
+            bb_module = int(entry[3]) # module ID
+            bb_offset = int(entry[4], 16) # offset inside the module
 
             # parse symbol name
-            bb_name = parse_symbol(entry[3])
+            bb_name = parse_symbol(bb_module, bb_offset)
 
             if bb_name != False:
 
-                info_list.append({'addr': bb_addr, 'name': bb_name, 'calls': bb_calls, 'size': bb_size }) 
+                info_list.append({'addr': bb_addr, 'name': bb_name, 'calls': bb_calls, 'size': bb_size, \
+                    'module_id': bb_module, 'offset': bb_offset }) 
                 instructions += bb_insts * bb_calls
 
         # if end
@@ -337,6 +376,8 @@ def print_blocks(file_name):
 
     # while end   
 
+    lookup_symbols(info_list)
+
     # sort entries list
     info_list.sort(m_sortproc)
     
@@ -514,10 +555,20 @@ if __name__ == "__main__":
     
     print "#"
 
-    for module_name in m_modules_list:
+    modules_items = {}
+
+    # module might be loaded a several times, sum items of all its instances
+    for module_id in m_modules_by_id:
+
+        module_name = m_modules_by_id[module_id]['name'].lower()
+        modules_items[module_name] = modules_items.get(module_name, 0) + \
+            m_modules_by_id[module_id]['processed_items']
+
+    # for end
+
+    for module_name in modules_items:
 
-        count = m_modules_list[module_name]['processed_items']
-        print "%15d -- %s" % (count, module_name)
+        print "%15d -- %s" % (modules_items[module_name], module_name)
 
     # for end
 
@@ -0,0 +1,3 @@
+@echo off
+nmake /f makefile_i386
+nmake /f makefile_i386 clean
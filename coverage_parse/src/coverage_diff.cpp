@@ -0,0 +1,442 @@
+#include "stdafx.h"
+
+#define APP_NAME "\nCode Coverage Analysis Tool for PIN\nby Oleksiuk Dmitry, eSage Lab (dmitry@esagelab.com)\n"
+
+typedef struct _DIFF_ENTRY
+{
+    // '+' (added), '-' (removed) or '~' (counter changed)
+    char Type;
+    bool bRoutine;
+
+    COVDB_UINT64 Offset;
+    COVDB_UINT64 OldCount;
+    COVDB_UINT64 NewCount;
+
+} DIFF_ENTRY,
+*PDIFF_ENTRY;
+
+typedef struct _DIFF_STATS
+{
+    size_t Old;
+    size_t New;
+    size_t Added;
+    size_t Removed;
+    size_t Changed;
+
+} DIFF_STATS,
+*PDIFF_STATS;
+
+typedef struct _DIFF_MODULE
+{
+    // module ID or COVDB_MODULE_UNKNOWN
+    COVDB_UINT32 Module;
+
+    DIFF_STATS Blocks;
+    DIFF_STATS Routines;
+
+    // blocks followed by routines, both parts are sorted by offset
+    std::vector<DIFF_ENTRY> Entries;
+
+} DIFF_MODULE,
+*PDIFF_MODULE;
+
+typedef struct _DIFF_PARAMS
+{
+    const char *lpszPaths[2];
+    bool bLoaded[2];
+
+    // old and new coverage with the same module IDs
+    INPUT_MODULES Modules;
+    INPUT_COVERAGE Coverage[2];
+    std::vector<COVDB_UINT32> Map;
+
+    // min. counter delta to report, 0 to report only added and removed items
+    COVDB_UINT64 Threshold;
+
+    std::vector<DIFF_MODULE> Results;
+
+} DIFF_PARAMS,
+*PDIFF_PARAMS;
+
+// --modules option values
+std::vector<std::string> m_ModulesToProcess;
+//--------------------------------------------------------------------------------------
+static void DiffLoad(void *Param, unsigned int Index, unsigned int /* Count */)
+{
+    PDIFF_PARAMS Params = (PDIFF_PARAMS)Param;
+
+    // old coverage is the run 0, so its module paths are preferred
+    Params->bLoaded[Index] = InputLoad(&Params->Modules, Index, Params->lpszPaths[Index], &Params->Coverage[Index]);
+}
+//--------------------------------------------------------------------------------------
+static void DiffRemap(void *Param, unsigned int Index, unsigned int /* Count */)
+{
+    PDIFF_PARAMS Params = (PDIFF_PARAMS)Param;
+
+    // order of the tables must match the sorted modules list
+    InputRemap(&Params->Coverage[Index], Params->Map);
+}
+//--------------------------------------------------------------------------------------
+template <class T>
+static void DiffRange(const std::vector<T> &Items, COVDB_UINT32 Module, const T **Begin, const T **End)
+{
+    T Key;
+
+    memset(&Key, 0, sizeof(Key));
+    Key.Module = Module;
+
+    bool (* Less)(const T &, const T &) = InputLess;
+
+    // items of the module are following each other
+    *Begin = *End = NULL;
+
+    if (Items.size() > 0)
+    {
+        const T *First = &Items[0], *Last = First + Items.size();
+
+        *Begin = std::lower_bound(First, Last, Key, Less);
+
+        if (Module == COVDB_MODULE_UNKNOWN)
+        {
+            *End = Last;
+        }
+        else
+        {
+            Key.Module += 1;
+            *End = std::lower_bound(*Begin, Last, Key, Less);
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+template <class T>
+static void DiffItems(
+    PDIFF_PARAMS Params, COVDB_UINT32 Module, const std::vector<T> &Old, const std::vector<T> &New,
+    bool bRoutines, PDIFF_STATS Stats, std::vector<DIFF_ENTRY> &Entries)
+{
+    const T *OldPtr = NULL, *OldEnd = NULL, *NewPtr = NULL, *NewEnd = NULL;
+
+    DiffRange(Old, Module, &OldPtr, &OldEnd);
+    DiffRange(New, Module, &NewPtr, &NewEnd);
+
+    Stats->Old = OldEnd - OldPtr;
+    Stats->New = NewEnd - NewPtr;
+
+    // single merge pass over the offsets of both sorted lists
+    while (OldPtr < OldEnd || NewPtr < NewEnd)
+    {
+        DIFF_ENTRY Entry;
+        Entry.bRoutine = bRoutines;
+
+        if (NewPtr == NewEnd || (OldPtr < OldEnd && OldPtr->Offset < NewPtr->Offset))
+        {
+            Entry.Type = '-';
+            Entry.Offset = OldPtr->Offset;
+            Entry.OldCount = OldPtr->Count;
+            Entry.NewCount = 0;
+
+            Stats->Removed += 1;
+            OldPtr += 1;
+        }
+        else if (OldPtr == OldEnd || NewPtr->Offset < OldPtr->Offset)
+        {
+            Entry.Type = '+';
+            Entry.Offset = NewPtr->Offset;
+            Entry.OldCount = 0;
+            Entry.NewCount = NewPtr->Count;
+
+            Stats->Added += 1;
+            NewPtr += 1;
+        }
+        else
+        {
+            COVDB_UINT64 Delta = OldPtr->Count > NewPtr->Count ?
+                OldPtr->Count - NewPtr->Count : NewPtr->Count - OldPtr->Count;
+
+            Entry.Type = '~';
+            Entry.Offset = OldPtr->Offset;
+            Entry.OldCount = OldPtr->Count;
+            Entry.NewCount = NewPtr->Count;
+
+            OldPtr += 1;
+            NewPtr += 1;
+
+            if (Params->Threshold == 0 || Delta < Params->Threshold)
+            {
+                continue;
+            }
+
+            Stats->Changed += 1;
+        }
+
+        Entries.push_back(Entry);
+    }
+}
+//--------------------------------------------------------------------------------------
+static void DiffModules(void *Param, unsigned int Index, unsigned int Count)
+{
+    PDIFF_PARAMS Params = (PDIFF_PARAMS)Param;
+
+    // modules are distributed between the workers one by one
+    for (size_t i = Index; i < Params->Results.size(); i += Count)
+    {
+        PDIFF_MODULE Result = &Params->Results[i];
+
+        DiffItems(
+            Params, Result->Module, Params->Coverage[0].Blocks, Params->Coverage[1].Blocks,
+            false, &Result->Blocks, Result->Entries
+        );
+
+        DiffItems(
+            Params, Result->Module, Params->Coverage[0].Routines, Params->Coverage[1].Routines,
+            true, &Result->Routines, Result->Entries
+        );
+    }
+}
+//--------------------------------------------------------------------------------------
+static std::string ModuleName(PDIFF_PARAMS Params, COVDB_UINT32 Module)
+{
+    if (Module >= Params->Modules.List.size())
+    {
+        return "?";
+    }
+
+    std::string Path = Params->Modules.List[Module].Path;
+    size_t Pos = Path.find_last_of("\\/");
+
+    return Pos == std::string::npos ? Path : Path.substr(Pos + 1);
+}
+//--------------------------------------------------------------------------------------
+static bool ModuleSkip(PDIFF_PARAMS Params, COVDB_UINT32 Module)
+{
+    if (m_ModulesToProcess.size() == 0)
+    {
+        return false;
+    }
+
+    // module name must contain one of the --modules strings
+    std::string Name = LogStringLower(ModuleName(Params, Module));
+
+    for (size_t i = 0; i < m_ModulesToProcess.size(); i++)
+    {
+        if (Name.find(m_ModulesToProcess[i]) != std::string::npos)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static void PrintStats(FILE *f, const char *lpszName, PDIFF_STATS Stats, bool bChanged)
+{
+    fprintf(
+        f, "  %-10s %8d -> %-8d added: %d, removed: %d",
+        lpszName, (int)Stats->Old, (int)Stats->New, (int)Stats->Added, (int)Stats->Removed
+    );
+
+    if (bChanged)
+    {
+        fprintf(f, ", changed: %d", (int)Stats->Changed);
+    }
+
+    fprintf(f, "\r\n");
+}
+//--------------------------------------------------------------------------------------
+static void PrintDiff(FILE *f, PDIFF_PARAMS Params)
+{
+    DIFF_STATS Blocks, Routines;
+
+    memset(&Blocks, 0, sizeof(Blocks));
+    memset(&Routines, 0, sizeof(Routines));
+
+#define DIFF_STATS_ADD(_total_, _stats_)        \
+                                                \
+    (_total_).Old += (_stats_).Old;             \
+    (_total_).New += (_stats_).New;             \
+    (_total_).Added += (_stats_).Added;         \
+    (_total_).Removed += (_stats_).Removed;     \
+    (_total_).Changed += (_stats_).Changed;
+
+    for (size_t i = 0; i < Params->Results.size(); i++)
+    {
+        if (!ModuleSkip(Params, Params->Results[i].Module))
+        {
+            DIFF_STATS_ADD(Blocks, Params->Results[i].Blocks);
+            DIFF_STATS_ADD(Routines, Params->Results[i].Routines);
+        }
+    }
+
+#undef DIFF_STATS_ADD
+
+    fprintf(f, "Old: %s\r\nNew: %s\r\n\r\nTotal:\r\n", Params->lpszPaths[0], Params->lpszPaths[1]);
+
+    PrintStats(f, "Blocks:", &Blocks, Params->Threshold > 0);
+    PrintStats(f, "Routines:", &Routines, Params->Threshold > 0);
+
+    for (size_t i = 0; i < Params->Results.size(); i++)
+    {
+        PDIFF_MODULE Result = &Params->Results[i];
+
+        if (Result->Entries.size() == 0 || ModuleSkip(Params, Result->Module))
+        {
+            continue;
+        }
+
+        std::string Name = ModuleName(Params, Result->Module);
+
+        fprintf(
+            f, "\r\nModule: %s\r\n",
+            Result->Module < Params->Modules.List.size() ? Params->Modules.List[Result->Module].Path.c_str() : "?"
+        );
+
+        PrintStats(f, "Blocks:", &Result->Blocks, Params->Threshold > 0);
+        PrintStats(f, "Routines:", &Result->Routines, Params->Threshold > 0);
+
+        fprintf(f, "\r\n");
+
+        for (size_t n = 0; n < Result->Entries.size(); n++)
+        {
+            PDIFF_ENTRY Entry = &Result->Entries[n];
+
+            fprintf(
+                f, "%c %-8s %s+%llx %llu -> %llu",
+                Entry->Type, Entry->bRoutine ? "routine" : "block", Name.c_str(),
+                (unsigned long long)Entry->Offset,
+                (unsigned long long)Entry->OldCount, (unsigned long long)Entry->NewCount
+            );
+
+            if (Entry->Type == '~')
+            {
+                fprintf(
+                    f, " (%c%llu)", Entry->NewCount > Entry->OldCount ? '+' : '-',
+                    (unsigned long long)(Entry->NewCount > Entry->OldCount ?
+                        Entry->NewCount - Entry->OldCount : Entry->OldCount - Entry->NewCount)
+                );
+            }
+
+            fprintf(f, "\r\n");
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    const char *lpszOutFile = NULL;
+    bool bByPath = false;
+
+    printf("%s\n", APP_NAME);
+
+    if (argc < 3)
+    {
+        printf("USAGE: coverage_diff.exe <old_input_path> <new_input_path> [options]\n");
+        return 0;
+    }
+
+    DIFF_PARAMS Params;
+    Params.lpszPaths[0] = argv[1];
+    Params.lpszPaths[1] = argv[2];
+    Params.Threshold = 0;
+
+    // parse command line arguments
+    for (int i = 3; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--outfile") && i < argc - 1)
+        {
+            // save information into the logfile
+            lpszOutFile = argv[i + 1];
+        }
+        else if (!strcmp(argv[i], "--modules") && i < argc - 1)
+        {
+            // filter by module name is specified
+            LogModulesFilter(argv[i + 1], m_ModulesToProcess);
+        }
+        else if (!strcmp(argv[i], "--threshold") && i < argc - 1)
+        {
+            // report counters that were changed at least by this value
+            const char *lpszValue = argv[i + 1];
+
+            Params.Threshold = (COVDB_UINT64)LogParseDec(lpszValue, lpszValue + strlen(lpszValue));
+        }
+        else if (!strcmp(argv[i], "--by-path"))
+        {
+            // match modules by the full path instead of the file name
+            bByPath = true;
+        }
+    }
+
+    time_t ExecTime = time(NULL);
+
+    printf("[+] Loading coverage, please wait...\n");
+
+    InputModulesInit(&Params.Modules, !bByPath);
+
+    // both of the inputs are loaded in parallel
+    WorkersRun(DiffLoad, &Params, 2);
+
+    InputModulesDestroy(&Params.Modules);
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (!Params.bLoaded[i])
+        {
+            printf("[!] Error while reading \"%s\"\n", Params.lpszPaths[i]);
+            return -1;
+        }
+    }
+
+    InputModulesSort(&Params.Modules, Params.Map);
+
+    WorkersRun(DiffRemap, &Params, 2);
+
+    // diff each module separately, code outside of the known modules goes last
+    Params.Results.resize(Params.Modules.List.size() + 1);
+
+    for (size_t i = 0; i < Params.Results.size(); i++)
+    {
+        PDIFF_MODULE Result = &Params.Results[i];
+
+        memset(&Result->Blocks, 0, sizeof(DIFF_STATS));
+        memset(&Result->Routines, 0, sizeof(DIFF_STATS));
+
+        Result->Module = i < Params.Modules.List.size() ? (COVDB_UINT32)i : COVDB_MODULE_UNKNOWN;
+    }
+
+    unsigned int Workers = std::min(WorkersCount(), (unsigned int)Params.Results.size());
+
+    WorkersRun(DiffModules, &Params, Workers);
+
+    FILE *f = stdout;
+
+    if (lpszOutFile)
+    {
+        // create output file
+        if ((f = fopen(lpszOutFile, "wb+")) == NULL)
+        {
+            printf("[!] Error while creating output file\n");
+            return -1;
+        }
+
+        setvbuf(f, NULL, _IOFBF, 0x100000);
+        printf("[+] Output file: \"%s\"\n", lpszOutFile);
+    }
+
+    if (f == stdout)
+    {
+        printf("\n");
+    }
+
+    PrintDiff(f, &Params);
+
+    if (f != stdout)
+    {
+        fclose(f);
+    }
+
+    ExecTime = time(NULL) - ExecTime;
+
+    printf("\n[+] DONE (%d mins., %d secs.)\n\n", (int)(ExecTime / 60), (int)(ExecTime % 60));
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+// EoF
@@ -0,0 +1,718 @@
+#include "stdafx.h"
+
+#define APP_NAME "\nCode Coverage Analysis Tool for PIN\nby Oleksiuk Dmitry, eSage Lab (dmitry@esagelab.com)\n"
+
+// LastRun value of the block without runs bitmap
+#define MERGE_RUN_NONE 0xffffffff
+
+typedef struct _MERGE_BLOCK
+{
+    COVDB_UINT32 Module;
+    COVDB_UINT64 Offset;
+    COVDB_UINT32 Size;
+    COVDB_UINT32 Instructions;
+    COVDB_UINT64 Count;
+
+    // runs bitmap location in MERGE_RESULT::RunsPool and the last run of the bitmap
+    COVDB_UINT64 RunsOffset;
+    COVDB_UINT32 RunsSize;
+    COVDB_UINT32 LastRun;
+
+} MERGE_BLOCK,
+*PMERGE_BLOCK;
+
+typedef struct _MERGE_RESULT
+{
+    // tables sorted by module ID and offset
+    std::vector<MERGE_BLOCK> Blocks;
+    std::vector<INPUT_ROUTINE> Routines;
+    std::vector<INPUT_CALL> Calls;
+
+    // runs bitmaps of the blocks
+    std::vector<COVDB_UINT8> RunsPool;
+
+    // number of runs merged into this result
+    unsigned int Runs;
+
+} MERGE_RESULT,
+*PMERGE_RESULT;
+
+typedef struct _MERGE_PARAMS
+{
+    std::vector<std::string> Inputs;
+    bool bRuns;
+
+    // modules of all runs
+    INPUT_MODULES Modules;
+
+    // merged result of each worker and then of the each reduction pass
+    std::vector<MERGE_RESULT> Results;
+
+    // inputs that can't be read
+    volatile long Errors;
+
+} MERGE_PARAMS,
+*PMERGE_PARAMS;
+//--------------------------------------------------------------------------------------
+static bool BlockLess(const MERGE_BLOCK &First, const MERGE_BLOCK &Second)
+{
+    if (First.Module != Second.Module)
+    {
+        return First.Module < Second.Module;
+    }
+
+    return First.Offset < Second.Offset;
+}
+//--------------------------------------------------------------------------------------
+template <class T>
+static void ItemsMerge(std::vector<T> &First, std::vector<T> &Second, std::vector<T> &Result)
+{
+    size_t i = 0, n = 0;
+
+    Result.clear();
+    Result.reserve(std::max(First.size(), Second.size()));
+
+    // both lists are sorted, counters of the same items are summed
+    while (i < First.size() || n < Second.size())
+    {
+        if (n == Second.size() || (i < First.size() && InputLess(First[i], Second[n])))
+        {
+            Result.push_back(First[i++]);
+        }
+        else if (i == First.size() || InputLess(Second[n], First[i]))
+        {
+            Result.push_back(Second[n++]);
+        }
+        else
+        {
+            Result.push_back(First[i++]);
+            Result.back().Count += Second[n++].Count;
+        }
+    }
+
+    std::vector<T>().swap(First);
+    std::vector<T>().swap(Second);
+}
+//--------------------------------------------------------------------------------------
+static void RunsPack(std::vector<COVDB_UINT8> &Pool, COVDB_UINT64 Delta)
+{
+    // zigzag encoding of always positive delta, 7 bits per byte
+    COVDB_UINT64 Value = Delta << 1;
+
+    while (Value >= 0x80)
+    {
+        Pool.push_back((COVDB_UINT8)(Value | 0x80));
+        Value >>= 7;
+    }
+
+    Pool.push_back((COVDB_UINT8)Value);
+}
+//--------------------------------------------------------------------------------------
+static COVDB_UINT64 RunsUnpack(const COVDB_UINT8 *Data, COVDB_UINT32 Size, COVDB_UINT32 *Pos)
+{
+    COVDB_UINT64 Value = 0;
+    unsigned int Shift = 0;
+
+    while (*Pos < Size && Shift < 64)
+    {
+        COVDB_UINT8 Byte = Data[*Pos];
+        *Pos += 1;
+
+        Value |= (COVDB_UINT64)(Byte & 0x7f) << Shift;
+        Shift += 7;
+
+        if (Byte < 0x80)
+        {
+            break;
+        }
+    }
+
+    return (Value >> 1) ^ (COVDB_UINT64)(-(long long)(Value & 1));
+}
+//--------------------------------------------------------------------------------------
+static void RunsAppend(
+    std::vector<COVDB_UINT8> &Pool, PMERGE_BLOCK Block,
+    const std::vector<COVDB_UINT8> &SourcePool, const MERGE_BLOCK &Source)
+{
+    if (Source.RunsSize == 0)
+    {
+        return;
+    }
+
+    const COVDB_UINT8 *Data = &SourcePool[(size_t)Source.RunsOffset];
+    COVDB_UINT32 Pos = 0;
+
+    if (Block->RunsSize == 0)
+    {
+        Block->RunsOffset = Pool.size();
+    }
+
+    if (Block->LastRun != MERGE_RUN_NONE)
+    {
+        // runs of the source are following the runs of the block, first delta must be changed
+        COVDB_UINT64 First = RunsUnpack(Data, Source.RunsSize, &Pos);
+
+        RunsPack(Pool, First - Block->LastRun);
+    }
+
+    Pool.insert(Pool.end(), Data + Pos, Data + Source.RunsSize);
+
+    Block->RunsSize = (COVDB_UINT32)(Pool.size() - Block->RunsOffset);
+    Block->LastRun = Source.LastRun;
+}
+//--------------------------------------------------------------------------------------
+static void BlocksMerge(PMERGE_RESULT First, PMERGE_RESULT Second, PMERGE_RESULT Result)
+{
+    size_t i = 0, n = 0;
+
+    Result->Blocks.clear();
+    Result->Blocks.reserve(std::max(First->Blocks.size(), Second->Blocks.size()));
+    Result->RunsPool.clear();
+    Result->RunsPool.reserve(First->RunsPool.size() + Second->RunsPool.size());
+
+    // all runs of the first result are preceding the runs of the second one
+    while (i < First->Blocks.size() || n < Second->Blocks.size())
+    {
+        PMERGE_BLOCK Left = i < First->Blocks.size() ? &First->Blocks[i] : NULL;
+        PMERGE_BLOCK Right = n < Second->Blocks.size() ? &Second->Blocks[n] : NULL;
+
+        if (Left && Right)
+        {
+            if (BlockLess(*Left, *Right))
+            {
+                Right = NULL;
+            }
+            else if (BlockLess(*Right, *Left))
+            {
+                Left = NULL;
+            }
+        }
+
+        MERGE_BLOCK Block = Left ? *Left : *Right;
+        Block.Count = 0;
+        Block.RunsOffset = 0;
+        Block.RunsSize = 0;
+        Block.LastRun = MERGE_RUN_NONE;
+
+        if (Left)
+        {
+            Block.Count += Left->Count;
+            RunsAppend(Result->RunsPool, &Block, First->RunsPool, *Left);
+            i += 1;
+        }
+
+        if (Right)
+        {
+            // block size might be unknown in some of the runs
+            Block.Size = std::max(Block.Size, Right->Size);
+            Block.Instructions = std::max(Block.Instructions, Right->Instructions);
+            Block.Count += Right->Count;
+            RunsAppend(Result->RunsPool, &Block, Second->RunsPool, *Right);
+            n += 1;
+        }
+
+        Result->Blocks.push_back(Block);
+    }
+
+    std::vector<MERGE_BLOCK>().swap(First->Blocks);
+    std::vector<MERGE_BLOCK>().swap(Second->Blocks);
+    std::vector<COVDB_UINT8>().swap(First->RunsPool);
+    std::vector<COVDB_UINT8>().swap(Second->RunsPool);
+}
+//--------------------------------------------------------------------------------------
+static void ResultsMerge(PMERGE_RESULT First, PMERGE_RESULT Second, PMERGE_RESULT Result)
+{
+    MERGE_RESULT Merged;
+
+    BlocksMerge(First, Second, &Merged);
+    ItemsMerge(First->Routines, Second->Routines, Merged.Routines);
+    ItemsMerge(First->Calls, Second->Calls, Merged.Calls);
+
+    Merged.Runs = First->Runs + Second->Runs;
+
+    // result might be the same object as one of the arguments
+    Result->Blocks.swap(Merged.Blocks);
+    Result->Routines.swap(Merged.Routines);
+    Result->Calls.swap(Merged.Calls);
+    Result->RunsPool.swap(Merged.RunsPool);
+    Result->Runs = Merged.Runs;
+}
+//--------------------------------------------------------------------------------------
+static bool RunLoad(PMERGE_PARAMS Params, unsigned int Run, PMERGE_RESULT Result)
+{
+    INPUT_COVERAGE Coverage;
+
+    bool bRet = InputLoad(&Params->Modules, Run, Params->Inputs[Run].c_str(), &Coverage);
+
+    Result->Blocks.resize(Coverage.Blocks.size());
+
+    for (size_t i = 0; i < Coverage.Blocks.size(); i++)
+    {
+        PMERGE_BLOCK Block = &Result->Blocks[i];
+
+        Block->Module = Coverage.Blocks[i].Module;
+        Block->Offset = Coverage.Blocks[i].Offset;
+        Block->Size = Coverage.Blocks[i].Size;
+        Block->Instructions = Coverage.Blocks[i].Instructions;
+        Block->Count = Coverage.Blocks[i].Count;
+        Block->RunsOffset = 0;
+        Block->RunsSize = 0;
+        Block->LastRun = MERGE_RUN_NONE;
+
+        if (Params->bRuns)
+        {
+            // every block of the run has the same bitmap
+            if (i == 0)
+            {
+                RunsPack(Result->RunsPool, Run);
+            }
+
+            Block->RunsSize = (COVDB_UINT32)Result->RunsPool.size();
+            Block->LastRun = Run;
+        }
+    }
+
+    Result->Routines.swap(Coverage.Routines);
+    Result->Calls.swap(Coverage.Calls);
+    Result->Runs = 1;
+
+    return bRet;
+}
+//--------------------------------------------------------------------------------------
+static void MergeLoad(PMERGE_PARAMS Params, unsigned int Run, MERGE_RESULT &Result)
+{
+    if (!RunLoad(Params, Run, &Result))
+    {
+        printf("[!] Error while reading \"%s\"\n", Params->Inputs[Run].c_str());
+
+        WorkersLockAcquire(&Params->Modules.Lock);
+        Params->Errors += 1;
+        WorkersLockRelease(&Params->Modules.Lock);
+    }
+}
+//--------------------------------------------------------------------------------------
+static void MergeAppend(MERGE_RESULT &First, MERGE_RESULT &Second)
+{
+    ResultsMerge(&First, &Second, &First);
+}
+//--------------------------------------------------------------------------------------
+static void MergeInputs(void *Param, unsigned int Index, unsigned int Count)
+{
+    PMERGE_PARAMS Params = (PMERGE_PARAMS)Param;
+
+    // each worker merges its own range of runs, so the runs bitmaps can be just concatenated
+    unsigned int First = (unsigned int)(Params->Inputs.size() * Index / Count);
+    unsigned int Last = (unsigned int)(Params->Inputs.size() * (Index + 1) / Count);
+
+    InputReduce(Params, First, Last, MergeLoad, MergeAppend, Params->Results[Index]);
+}
+//--------------------------------------------------------------------------------------
+static void MergeResults(void *Param, unsigned int Index, unsigned int /* Count */)
+{
+    PMERGE_PARAMS Params = (PMERGE_PARAMS)Param;
+
+    // merge results 2*Index and 2*Index+1, odd result at the end stays as is
+    if (Index * 2 + 1 < Params->Results.size())
+    {
+        ResultsMerge(&Params->Results[Index * 2], &Params->Results[Index * 2 + 1], &Params->Results[Index * 2]);
+    }
+}
+//--------------------------------------------------------------------------------------
+static void ModulesRemap(PMERGE_PARAMS Params, PMERGE_RESULT Result)
+{
+    std::vector<COVDB_UINT32> Map;
+
+    // sort modules by path, so the output doesn't depend on the threads timing
+    InputModulesSort(&Params->Modules, Map);
+
+    for (size_t i = 0; i < Result->Blocks.size(); i++)
+    {
+        if (Result->Blocks[i].Module < Map.size())
+        {
+            Result->Blocks[i].Module = Map[Result->Blocks[i].Module];
+        }
+    }
+
+    std::sort(Result->Blocks.begin(), Result->Blocks.end(), BlockLess);
+
+    INPUT_COVERAGE Coverage;
+
+    Coverage.Routines.swap(Result->Routines);
+    Coverage.Calls.swap(Result->Calls);
+
+    InputRemap(&Coverage, Map);
+
+    Result->Routines.swap(Coverage.Routines);
+    Result->Calls.swap(Coverage.Calls);
+}
+//--------------------------------------------------------------------------------------
+static bool ResultWrite(PMERGE_PARAMS Params, PMERGE_RESULT Result, const char *lpszPath)
+{
+    // empty command line is the first string in the pool
+    std::vector<char> Strings(1, '\0');
+
+    std::vector<COVDB_UINT64> ModulesStart, ModulesEnd;
+    std::vector<COVDB_UINT32> ModulesLoad, ModulesUnload, ModulesPath, RunsPath;
+
+    for (size_t i = 0; i < Params->Modules.List.size(); i++)
+    {
+        ModulesStart.push_back(Params->Modules.List[i].Start);
+        ModulesEnd.push_back(Params->Modules.List[i].End);
+
+        // load events of different runs are not comparable
+        ModulesLoad.push_back(0);
+        ModulesUnload.push_back(0);
+        ModulesPath.push_back((COVDB_UINT32)Strings.size());
+
+        Strings.insert(Strings.end(), Params->Modules.List[i].Path.begin(), Params->Modules.List[i].Path.end());
+        Strings.push_back('\0');
+    }
+
+    for (size_t i = 0; i < Params->Inputs.size(); i++)
+    {
+        RunsPath.push_back((COVDB_UINT32)Strings.size());
+
+        Strings.insert(Strings.end(), Params->Inputs[i].begin(), Params->Inputs[i].end());
+        Strings.push_back('\0');
+    }
+
+    std::vector<COVDB_UINT32> BlocksModule, BlocksSize, BlocksInstructions, BlocksRunsSize;
+    std::vector<COVDB_UINT64> BlocksOffset, BlocksCount, BlocksRunsData;
+
+    // bitmaps are stored in the blocks order, pool layout depends on the merge order
+    std::vector<COVDB_UINT8> RunsPool;
+
+    for (size_t i = 0; i < Result->Blocks.size(); i++)
+    {
+        PMERGE_BLOCK Block = &Result->Blocks[i];
+
+        BlocksModule.push_back(Block->Module);
+        BlocksOffset.push_back(Block->Offset);
+        BlocksSize.push_back(Block->Size);
+        BlocksInstructions.push_back(Block->Instructions);
+        BlocksCount.push_back(Block->Count);
+        BlocksRunsData.push_back(RunsPool.size());
+        BlocksRunsSize.push_back(Block->RunsSize);
+
+        if (Block->RunsSize > 0)
+        {
+            RunsPool.insert(
+                RunsPool.end(),
+                Result->RunsPool.begin() + (size_t)Block->RunsOffset,
+                Result->RunsPool.begin() + (size_t)(Block->RunsOffset + Block->RunsSize)
+            );
+        }
+    }
+
+    std::vector<COVDB_UINT32> RoutinesModule;
+    std::vector<COVDB_UINT64> RoutinesOffset, RoutinesCount;
+
+    for (size_t i = 0; i < Result->Routines.size(); i++)
+    {
+        RoutinesModule.push_back(Result->Routines[i].Module);
+        RoutinesOffset.push_back(Result->Routines[i].Offset);
+        RoutinesCount.push_back(Result->Routines[i].Count);
+    }
+
+    std::vector<COVDB_UINT32> CallerModule, CalleeModule;
+    std::vector<COVDB_UINT64> CallerOffset, CalleeOffset, CallsCount;
+
+    for (size_t i = 0; i < Result->Calls.size(); i++)
+    {
+        CallerModule.push_back(Result->Calls[i].CallerModule);
+        CallerOffset.push_back(Result->Calls[i].CallerOffset);
+        CalleeModule.push_back(Result->Calls[i].CalleeModule);
+        CalleeOffset.push_back(Result->Calls[i].CalleeOffset);
+        CallsCount.push_back(Result->Calls[i].Count);
+    }
+
+    COVDB_COLUMN Columns[23];
+    const void *Data[23];
+    COVDB_UINT32 ColumnsCount = 0;
+
+#define MERGE_COLUMN(_table_, _column_, _vector_)                               \
+                                                                                \
+    memset(&Columns[ColumnsCount], 0, sizeof(COVDB_COLUMN));                    \
+    Columns[ColumnsCount].Table = (_table_);                                    \
+    Columns[ColumnsCount].Column = (_column_);                                  \
+    Columns[ColumnsCount].ElementSize = sizeof((_vector_)[0]);                  \
+    Columns[ColumnsCount].Count = (_vector_).size();                            \
+    Data[ColumnsCount] = (_vector_).size() > 0 ? &(_vector_)[0] : NULL;         \
+    ColumnsCount += 1;
+
+    MERGE_COLUMN(COVDB_TABLE_STRINGS, COVDB_STRINGS_DATA, Strings);
+
+    MERGE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_START, ModulesStart);
+    MERGE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_END, ModulesEnd);
+    MERGE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_LOAD, ModulesLoad);
+    MERGE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_UNLOAD, ModulesUnload);
+    MERGE_COLUMN(COVDB_TABLE_MODULES, COVDB_MODULES_PATH, ModulesPath);
+
+    MERGE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_MODULE, BlocksModule);
+    MERGE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_OFFSET, BlocksOffset);
+    MERGE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_SIZE, BlocksSize);
+    MERGE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_INSTRUCTIONS, BlocksInstructions);
+    MERGE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_COUNT, BlocksCount);
+
+    MERGE_COLUMN(COVDB_TABLE_ROUTINES, COVDB_ROUTINES_MODULE, RoutinesModule);
+    MERGE_COLUMN(COVDB_TABLE_ROUTINES, COVDB_ROUTINES_OFFSET, RoutinesOffset);
+    MERGE_COLUMN(COVDB_TABLE_ROUTINES, COVDB_ROUTINES_COUNT, RoutinesCount);
+
+    MERGE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLER_MODULE, CallerModule);
+    MERGE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLER_OFFSET, CallerOffset);
+    MERGE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLEE_MODULE, CalleeModule);
+    MERGE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_CALLEE_OFFSET, CalleeOffset);
+    MERGE_COLUMN(COVDB_TABLE_CALLS, COVDB_CALLS_COUNT, CallsCount);
+
+    MERGE_COLUMN(COVDB_TABLE_RUNS, COVDB_RUNS_PATH, RunsPath);
+
+    if (Params->bRuns)
+    {
+        MERGE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_RUNS_DATA, BlocksRunsData);
+        MERGE_COLUMN(COVDB_TABLE_BLOCKS, COVDB_BLOCKS_RUNS_SIZE, BlocksRunsSize);
+        MERGE_COLUMN(COVDB_TABLE_RUNS_DATA, COVDB_RUNS_DATA_DATA, RunsPool);
+    }
+
+#undef MERGE_COLUMN
+
+    COVDB_HEADER Header;
+
+    memset(&Header, 0, sizeof(Header));
+    Header.ColumnsCount = ColumnsCount;
+    Header.CommandLine = 0;
+
+    return CovDbWrite(lpszPath, &Header, Columns, Data);
+}
+//--------------------------------------------------------------------------------------
+static int Query(const char *lpszPath, const char *lpszBlock)
+{
+    // <module_name>+<offset>
+    const char *lpszOffset = strrchr(lpszBlock, '+');
+    if (lpszOffset == NULL)
+    {
+        printf("[!] Error: block must be specified as <module_name>+<offset>\n");
+        return -1;
+    }
+
+    std::string ModuleName = LogStringLower(std::string(lpszBlock, lpszOffset - lpszBlock));
+    COVDB_UINT64 Offset = LogParseHex(lpszOffset + 1, lpszOffset + strlen(lpszOffset));
+
+    COVDB Db;
+
+    if (!CovDbOpen(&Db, lpszPath))
+    {
+        printf("[!] Error while opening coverage database\n");
+        return -1;
+    }
+
+    COVDB_UINT64 ModulesCount = 0, BlocksCount = 0, RunsCount = 0, PoolSize = 0;
+
+    const COVDB_UINT32 *ModulesPath = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_MODULES, COVDB_MODULES_PATH, COVDB_UINT32, &ModulesCount);
+    const COVDB_UINT32 *BlocksModule = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_MODULE, COVDB_UINT32, &BlocksCount);
+    const COVDB_UINT64 *BlocksOffset = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_OFFSET, COVDB_UINT64, NULL);
+    const COVDB_UINT32 *BlocksSize = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_SIZE, COVDB_UINT32, NULL);
+    const COVDB_UINT64 *Counts = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_COUNT, COVDB_UINT64, NULL);
+    const COVDB_UINT64 *RunsData = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_RUNS_DATA, COVDB_UINT64, NULL);
+    const COVDB_UINT32 *RunsSize = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_RUNS_SIZE, COVDB_UINT32, NULL);
+    const COVDB_UINT32 *RunsPath = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_RUNS, COVDB_RUNS_PATH, COVDB_UINT32, &RunsCount);
+    const COVDB_UINT8 *Pool = COVDB_COLUMN_DATA(&Db, COVDB_TABLE_RUNS_DATA, COVDB_RUNS_DATA_DATA, COVDB_UINT8, &PoolSize);
+
+    if (ModulesPath == NULL || BlocksModule == NULL || BlocksOffset == NULL || BlocksSize == NULL ||
+        Counts == NULL || RunsData == NULL || RunsSize == NULL || RunsPath == NULL || Pool == NULL)
+    {
+        printf("[!] Error: database was merged without \"--runs\" option\n");
+        CovDbClose(&Db);
+        return -1;
+    }
+
+    bool bFound = false;
+
+    for (COVDB_UINT32 Module = 0; Module < ModulesCount; Module++)
+    {
+        std::string Path = CovDbString(&Db, ModulesPath[Module]);
+        size_t NamePos = Path.find_last_of("\\/");
+
+        if (LogStringLower(NamePos == std::string::npos ? Path : Path.substr(NamePos + 1)) != ModuleName)
+        {
+            continue;
+        }
+
+        // blocks table is sorted by module and offset, find the last block that starts before the offset
+        COVDB_UINT64 Left = 0, Right = BlocksCount;
+
+        while (Left < Right)
+        {
+            COVDB_UINT64 Middle = Left + (Right - Left) / 2;
+
+            if (BlocksModule[Middle] < Module ||
+                (BlocksModule[Middle] == Module && BlocksOffset[Middle] <= Offset))
+            {
+                Left = Middle + 1;
+            }
+            else
+            {
+                Right = Middle;
+            }
+        }
+
+        if (Left == 0)
+        {
+            continue;
+        }
+
+        COVDB_UINT64 Row = Left - 1;
+
+        if (BlocksModule[Row] != Module || Offset >= BlocksOffset[Row] + std::max(BlocksSize[Row], (COVDB_UINT32)1))
+        {
+            continue;
+        }
+
+        printf(
+            "[+] Block %s+%llx was executed %llu times by:\n\n",
+            Path.c_str(), (unsigned long long)BlocksOffset[Row], (unsigned long long)Counts[Row]
+        );
+
+        COVDB_UINT32 Pos = 0, Size = RunsSize[Row];
+        COVDB_UINT64 Run = 0;
+
+        if (RunsData[Row] > PoolSize || Size > PoolSize - RunsData[Row])
+        {
+            printf("[!] Error: invalid runs bitmap\n");
+            break;
+        }
+
+        while (Pos < Size)
+        {
+            Run += RunsUnpack(Pool + RunsData[Row], Size, &Pos);
+
+            if (Run < RunsCount)
+            {
+                printf("%s\n", CovDbString(&Db, RunsPath[Run]));
+            }
+        }
+
+        bFound = true;
+    }
+
+    if (!bFound)
+    {
+        printf("[!] Block was not executed\n");
+    }
+
+    CovDbClose(&Db);
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    printf("%s\n", APP_NAME);
+
+    if (argc >= 4 && !strcmp(argv[1], "--query"))
+    {
+        return Query(argv[2], argv[3]);
+    }
+
+    if (argc < 3)
+    {
+        printf("USAGE: coverage_merge.exe <output_db_path> <input_path> [<input_path> ...] [options]\n");
+        printf("       coverage_merge.exe --query <merged_db_path> <module_name>+<offset>\n");
+        return 0;
+    }
+
+    const char *lpszOutput = argv[1];
+
+    MERGE_PARAMS Params;
+    Params.bRuns = false;
+    Params.Errors = 0;
+
+    // parse command line arguments
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--list") && i < argc - 1)
+        {
+            // read inputs list from the file
+            if (!InputReadList(argv[i + 1], Params.Inputs))
+            {
+                printf("[!] Error while opening inputs list\n");
+                return -1;
+            }
+
+            i += 1;
+        }
+        else if (!strcmp(argv[i], "--runs"))
+        {
+            // keep bitmap of runs for each block
+            Params.bRuns = true;
+        }
+        else
+        {
+            Params.Inputs.push_back(argv[i]);
+        }
+    }
+
+    if (Params.Inputs.size() == 0)
+    {
+        printf("[!] Error: no inputs specified\n");
+        return -1;
+    }
+
+    time_t ExecTime = time(NULL);
+    unsigned int Workers = std::max(1u, std::min(WorkersCount(), (unsigned int)Params.Inputs.size()));
+
+    printf("[+] Merging %d runs using %d threads, please wait...\n", (int)Params.Inputs.size(), Workers);
+
+    InputModulesInit(&Params.Modules, false);
+    Params.Results.resize(Workers);
+
+    // each worker reads and merges its own range of inputs
+    WorkersRun(MergeInputs, &Params, Workers);
+
+    // merge results of the workers pairwise in parallel
+    while (Params.Results.size() > 1)
+    {
+        unsigned int Count = (unsigned int)Params.Results.size();
+
+        WorkersRun(MergeResults, &Params, (Count + 1) / 2);
+
+        for (unsigned int i = 1; i < (Count + 1) / 2; i++)
+        {
+            std::swap(Params.Results[i], Params.Results[i * 2]);
+        }
+
+        Params.Results.resize((Count + 1) / 2);
+    }
+
+    InputModulesDestroy(&Params.Modules);
+
+    MERGE_RESULT &Result = Params.Results[0];
+
+    ModulesRemap(&Params, &Result);
+
+    if (!ResultWrite(&Params, &Result, lpszOutput))
+    {
+        printf("[!] Error while writing output file\n");
+        return -1;
+    }
+
+    printf(
+        "[+] %d modules, %d blocks, %d routines, %d call edges\n",
+        (int)Params.Modules.List.size(), (int)Result.Blocks.size(),
+        (int)Result.Routines.size(), (int)Result.Calls.size()
+    );
+
+    if (Params.Errors > 0)
+    {
+        printf("[!] %d inputs can't be read\n", (int)Params.Errors);
+    }
+
+    printf("[+] Output file: %s\n", lpszOutput);
+
+    ExecTime = time(NULL) - ExecTime;
+
+    printf("\n[+] DONE (%d mins., %d secs.)\n\n", (int)(ExecTime / 60), (int)(ExecTime % 60));
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+// EoF
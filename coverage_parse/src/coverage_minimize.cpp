@@ -0,0 +1,438 @@
+#include "stdafx.h"
+
+#define APP_NAME "\nCode Coverage Analysis Tool for PIN\nby Oleksiuk Dmitry, eSage Lab (dmitry@esagelab.com)\n"
+
+// number of candidates that are evaluated in parallel by each worker
+#define MIN_BATCH_PER_WORKER 4
+
+// module ID is stored in the high bits of the element key, offset in the low ones
+#define MIN_OFFSET_BITS 40
+#define MIN_KEY(_module_, _offset_) (((COVDB_UINT64)(_module_) << MIN_OFFSET_BITS) | (_offset_))
+
+typedef struct _MIN_ELEMENT
+{
+    // block key and 0 for basic blocks, caller key and callee key + 1 for call edges
+    COVDB_UINT64 First;
+    COVDB_UINT64 Second;
+
+} MIN_ELEMENT,
+*PMIN_ELEMENT;
+
+typedef std::vector<MIN_ELEMENT> MIN_ELEMENTS;
+
+typedef struct _MIN_CANDIDATE
+{
+    // upper bound of the new elements number and the run index
+    COVDB_UINT32 Gain;
+    COVDB_UINT32 Run;
+
+} MIN_CANDIDATE,
+*PMIN_CANDIDATE;
+
+typedef struct _MIN_PARAMS
+{
+    std::vector<std::string> Inputs;
+    bool bCalls;
+
+    INPUT_MODULES Modules;
+
+    // elements of all runs, element ID is index in the list
+    std::vector<MIN_ELEMENTS> Universes;
+    MIN_ELEMENTS Universe;
+
+    // elements of each run
+    std::vector<SET_BITMAP> Sets;
+    std::vector<char> Loaded;
+
+    // elements of the selected runs
+    std::vector<COVDB_UINT64> Covered;
+
+    // candidates that are evaluated by the workers
+    std::vector<MIN_CANDIDATE> Batch;
+
+} MIN_PARAMS,
+*PMIN_PARAMS;
+//--------------------------------------------------------------------------------------
+static bool ElementLess(const MIN_ELEMENT &First, const MIN_ELEMENT &Second)
+{
+    if (First.First != Second.First)
+    {
+        return First.First < Second.First;
+    }
+
+    return First.Second < Second.Second;
+}
+//--------------------------------------------------------------------------------------
+static bool ElementEqual(const MIN_ELEMENT &First, const MIN_ELEMENT &Second)
+{
+    return First.First == Second.First && First.Second == Second.Second;
+}
+//--------------------------------------------------------------------------------------
+static bool CandidateLess(const MIN_CANDIDATE &First, const MIN_CANDIDATE &Second)
+{
+    // heap order: bigger gain first, then lower run index
+    if (First.Gain != Second.Gain)
+    {
+        return First.Gain < Second.Gain;
+    }
+
+    return First.Run > Second.Run;
+}
+//--------------------------------------------------------------------------------------
+static bool RunElements(PMIN_PARAMS Params, unsigned int Run, MIN_ELEMENTS &Elements)
+{
+    INPUT_COVERAGE Coverage;
+
+    Elements.clear();
+
+    if (!InputLoad(&Params->Modules, Run, Params->Inputs[Run].c_str(), &Coverage))
+    {
+        return false;
+    }
+
+    // code outside of the known modules has different addresses in every run
+    for (size_t i = 0; i < Coverage.Blocks.size(); i++)
+    {
+        PINPUT_BLOCK Block = &Coverage.Blocks[i];
+
+        if (Block->Module != COVDB_MODULE_UNKNOWN && (Block->Offset >> MIN_OFFSET_BITS) == 0)
+        {
+            MIN_ELEMENT Element;
+            Element.First = MIN_KEY(Block->Module, Block->Offset);
+            Element.Second = 0;
+
+            Elements.push_back(Element);
+        }
+    }
+
+    size_t BlocksCount = Elements.size();
+
+    if (Params->bCalls)
+    {
+        for (size_t i = 0; i < Coverage.Calls.size(); i++)
+        {
+            PINPUT_CALL Call = &Coverage.Calls[i];
+
+            if (Call->CallerModule != COVDB_MODULE_UNKNOWN && (Call->CallerOffset >> MIN_OFFSET_BITS) == 0 &&
+                Call->CalleeModule != COVDB_MODULE_UNKNOWN && (Call->CalleeOffset >> MIN_OFFSET_BITS) == 0)
+            {
+                MIN_ELEMENT Element;
+                Element.First = MIN_KEY(Call->CallerModule, Call->CallerOffset);
+                Element.Second = MIN_KEY(Call->CalleeModule, Call->CalleeOffset) + 1;
+
+                Elements.push_back(Element);
+            }
+        }
+    }
+
+    // both parts are sorted already
+    std::inplace_merge(Elements.begin(), Elements.begin() + BlocksCount, Elements.end(), ElementLess);
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static void ElementsUnion(MIN_ELEMENTS &First, MIN_ELEMENTS &Second)
+{
+    if (First.empty())
+    {
+        First.swap(Second);
+        return;
+    }
+
+    MIN_ELEMENTS Result;
+
+    Result.reserve(std::max(First.size(), Second.size()));
+
+    std::set_union(First.begin(), First.end(), Second.begin(), Second.end(), std::back_inserter(Result), ElementLess);
+
+    First.swap(Result);
+    MIN_ELEMENTS().swap(Second);
+}
+//--------------------------------------------------------------------------------------
+static void CollectLoad(PMIN_PARAMS Params, unsigned int Run, MIN_ELEMENTS &Elements)
+{
+    if (!RunElements(Params, Run, Elements))
+    {
+        printf("[!] Error while reading \"%s\"\n", Params->Inputs[Run].c_str());
+    }
+}
+//--------------------------------------------------------------------------------------
+static void CollectElements(void *Param, unsigned int Index, unsigned int Count)
+{
+    PMIN_PARAMS Params = (PMIN_PARAMS)Param;
+
+    unsigned int First = (unsigned int)(Params->Inputs.size() * Index / Count);
+    unsigned int Last = (unsigned int)(Params->Inputs.size() * (Index + 1) / Count);
+
+    InputReduce(Params, First, Last, CollectLoad, ElementsUnion, Params->Universes[Index]);
+}
+//--------------------------------------------------------------------------------------
+static void CollectUniverses(void *Param, unsigned int Index, unsigned int /* Count */)
+{
+    PMIN_PARAMS Params = (PMIN_PARAMS)Param;
+
+    // merge sets 2*Index and 2*Index+1, odd set at the end stays as is
+    if (Index * 2 + 1 < Params->Universes.size())
+    {
+        ElementsUnion(Params->Universes[Index * 2], Params->Universes[Index * 2 + 1]);
+    }
+}
+//--------------------------------------------------------------------------------------
+static void BuildSets(void *Param, unsigned int Index, unsigned int Count)
+{
+    PMIN_PARAMS Params = (PMIN_PARAMS)Param;
+
+    unsigned int First = (unsigned int)(Params->Inputs.size() * Index / Count);
+    unsigned int Last = (unsigned int)(Params->Inputs.size() * (Index + 1) / Count);
+
+    MIN_ELEMENTS Elements;
+    std::vector<COVDB_UINT32> Ids;
+
+    for (unsigned int i = First; i < Last; i++)
+    {
+        // inputs are read once again, keeping elements of all runs needs too much memory
+        if (!RunElements(Params, i, Elements))
+        {
+            continue;
+        }
+
+        Ids.clear();
+
+        // both lists are sorted, so the search continues from the previous element
+        MIN_ELEMENTS::iterator Pos = Params->Universe.begin();
+
+        for (size_t n = 0; n < Elements.size(); n++)
+        {
+            Pos = std::lower_bound(Pos, Params->Universe.end(), Elements[n], ElementLess);
+
+            if (Pos != Params->Universe.end() && ElementEqual(*Pos, Elements[n]))
+            {
+                Ids.push_back((COVDB_UINT32)(Pos - Params->Universe.begin()));
+            }
+        }
+
+        SetBuild(&Params->Sets[i], Ids.size() > 0 ? &Ids[0] : NULL, Ids.size());
+
+        Params->Loaded[i] = 1;
+    }
+}
+//--------------------------------------------------------------------------------------
+static void EvaluateBatch(void *Param, unsigned int Index, unsigned int Count)
+{
+    PMIN_PARAMS Params = (PMIN_PARAMS)Param;
+
+    // candidates are distributed between the workers one by one
+    for (size_t i = Index; i < Params->Batch.size(); i += Count)
+    {
+        PMIN_CANDIDATE Candidate = &Params->Batch[i];
+
+        Candidate->Gain = SetCountNew(&Params->Sets[Candidate->Run], &Params->Covered[0]);
+    }
+}
+//--------------------------------------------------------------------------------------
+static void Minimize(PMIN_PARAMS Params, std::vector<COVDB_UINT32> &Selected)
+{
+    unsigned int Workers = WorkersCount();
+    std::vector<MIN_CANDIDATE> Heap;
+
+    // bitset of the whole elements space, aligned on the chunk size
+    Params->Covered.assign((Params->Universe.size() + SET_CHUNK_SIZE - 1) / SET_CHUNK_SIZE * SET_BITSET_WORDS, 0);
+
+    // initial gain of the each run is just its number of elements
+    for (COVDB_UINT32 i = 0; i < Params->Sets.size(); i++)
+    {
+        if (Params->Loaded[i] && Params->Sets[i].Cardinality > 0)
+        {
+            MIN_CANDIDATE Candidate;
+            Candidate.Gain = Params->Sets[i].Cardinality;
+            Candidate.Run = i;
+
+            Heap.push_back(Candidate);
+        }
+    }
+
+    std::make_heap(Heap.begin(), Heap.end(), CandidateLess);
+
+    /*
+        Lazy greedy set cover: gain of the run can only decrease when more runs are selected,
+        so the old gains of the heap are upper bounds. Fresh gains of the top candidates are
+        calculated in parallel, the best one is selected when it's not worse than the upper
+        bound of any other candidate.
+    */
+    while (Heap.size() > 0)
+    {
+        Params->Batch.clear();
+
+        while (Heap.size() > 0 && Params->Batch.size() < Workers * MIN_BATCH_PER_WORKER)
+        {
+            std::pop_heap(Heap.begin(), Heap.end(), CandidateLess);
+
+            Params->Batch.push_back(Heap.back());
+            Heap.pop_back();
+        }
+
+        WorkersRun(EvaluateBatch, Params, std::min(Workers, (unsigned int)Params->Batch.size()));
+
+        size_t Best = 0;
+
+        for (size_t i = 1; i < Params->Batch.size(); i++)
+        {
+            if (CandidateLess(Params->Batch[Best], Params->Batch[i]))
+            {
+                Best = i;
+            }
+        }
+
+        if (Params->Batch[Best].Gain == 0)
+        {
+            // none of the batch candidates have new elements
+            continue;
+        }
+
+        if (Heap.size() == 0 || !CandidateLess(Params->Batch[Best], Heap.front()))
+        {
+            SetAddTo(&Params->Sets[Params->Batch[Best].Run], &Params->Covered[0]);
+            Selected.push_back(Params->Batch[Best].Run);
+
+            Params->Batch[Best].Gain = 0;
+        }
+
+        // return the rest of candidates with fresh gains
+        for (size_t i = 0; i < Params->Batch.size(); i++)
+        {
+            if (Params->Batch[i].Gain > 0)
+            {
+                Heap.push_back(Params->Batch[i]);
+                std::push_heap(Heap.begin(), Heap.end(), CandidateLess);
+            }
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    printf("%s\n", APP_NAME);
+
+    if (argc < 3)
+    {
+        printf("USAGE: coverage_minimize.exe <output_list_path> <input_path> [<input_path> ...] [options]\n");
+        return 0;
+    }
+
+    const char *lpszOutput = argv[1];
+
+    MIN_PARAMS Params;
+    Params.bCalls = false;
+
+    // parse command line arguments
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--list") && i < argc - 1)
+        {
+            // read inputs list from the file
+            if (!InputReadList(argv[i + 1], Params.Inputs))
+            {
+                printf("[!] Error while opening inputs list\n");
+                return -1;
+            }
+
+            i += 1;
+        }
+        else if (!strcmp(argv[i], "--calls"))
+        {
+            // call edges must be covered as well
+            Params.bCalls = true;
+        }
+        else
+        {
+            Params.Inputs.push_back(argv[i]);
+        }
+    }
+
+    if (Params.Inputs.size() == 0)
+    {
+        printf("[!] Error: no inputs specified\n");
+        return -1;
+    }
+
+    FILE *f = fopen(lpszOutput, "wb+");
+    if (f == NULL)
+    {
+        printf("[!] Error while creating output file\n");
+        return -1;
+    }
+
+    time_t ExecTime = time(NULL);
+    unsigned int Workers = std::max(1u, std::min(WorkersCount(), (unsigned int)Params.Inputs.size()));
+
+    printf("[+] Reading %d runs using %d threads, please wait...\n", (int)Params.Inputs.size(), Workers);
+
+    InputModulesInit(&Params.Modules, false);
+
+    // collect elements of all runs
+    Params.Universes.resize(Workers);
+
+    WorkersRun(CollectElements, &Params, Workers);
+
+    while (Params.Universes.size() > 1)
+    {
+        unsigned int Count = (unsigned int)Params.Universes.size();
+
+        WorkersRun(CollectUniverses, &Params, (Count + 1) / 2);
+
+        for (unsigned int i = 1; i < (Count + 1) / 2; i++)
+        {
+            Params.Universes[i].swap(Params.Universes[i * 2]);
+        }
+
+        Params.Universes.resize((Count + 1) / 2);
+    }
+
+    Params.Universe.swap(Params.Universes[0]);
+
+    printf("[+] %d unique elements, building sets...\n", (int)Params.Universe.size());
+
+    // build compressed set of element IDs for each run
+    Params.Sets.resize(Params.Inputs.size());
+    Params.Loaded.resize(Params.Inputs.size(), 0);
+
+    WorkersRun(BuildSets, &Params, Workers);
+
+    InputModulesDestroy(&Params.Modules);
+
+    size_t SetsSize = 0;
+
+    for (size_t i = 0; i < Params.Sets.size(); i++)
+    {
+        SetsSize += SetSize(&Params.Sets[i]);
+    }
+
+    printf("[+] %d KB of sets data, selecting runs...\n", (int)(SetsSize / 1024));
+
+    std::vector<COVDB_UINT32> Selected;
+
+    Minimize(&Params, Selected);
+
+    // runs are listed in the order of selection, most valuable ones go first
+    for (size_t i = 0; i < Selected.size(); i++)
+    {
+        fprintf(f, "%s\r\n", Params.Inputs[Selected[i]].c_str());
+    }
+
+    fclose(f);
+
+    printf(
+        "[+] %d of %d runs are covering all of the %d elements\n",
+        (int)Selected.size(), (int)Params.Inputs.size(), (int)Params.Universe.size()
+    );
+
+    printf("[+] Output file: %s\n", lpszOutput);
+
+    ExecTime = time(NULL) - ExecTime;
+
+    printf("\n[+] DONE (%d mins., %d secs.)\n\n", (int)(ExecTime / 60), (int)(ExecTime % 60));
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+// EoF
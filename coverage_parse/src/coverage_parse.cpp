@@ -0,0 +1,322 @@
+#include "stdafx.h"
+
+#define APP_NAME "\nCode Coverage Analysis Tool for PIN\nby Oleksiuk Dmitry, eSage Lab (dmitry@esagelab.com)\n"
+
+LOG_MODULES m_ModulesList;
+std::vector<std::string> m_ModulesToProcess;
+bool m_bSkipSymbols = false, m_bOrderByCalls = false;
+FILE *m_OutFile = NULL;
+//--------------------------------------------------------------------------------------
+static void LogWrite(const char *lpszFormat, ...)
+{
+    va_list mylist;
+    va_start(mylist, lpszFormat);
+
+    if (m_OutFile)
+    {
+        vfprintf(m_OutFile, lpszFormat, mylist);
+        fputs("\r\n", m_OutFile);
+    }
+    else
+    {
+        vprintf(lpszFormat, mylist);
+        putchar('\n');
+    }
+
+    va_end(mylist);
+}
+//--------------------------------------------------------------------------------------
+static void ResolveEntries(LOG_ENTRIES &Entries)
+{
+    std::map<int, MODULE_ENTRIES> Modules;
+    bool bUnknownAllowed = m_ModulesToProcess.size() == 0 ||
+        std::find(m_ModulesToProcess.begin(), m_ModulesToProcess.end(), "?") != m_ModulesToProcess.end();
+
+    for (size_t i = 0; i < Entries.size(); i++)
+    {
+        PLOG_ENTRY Entry = &Entries[i];
+        LOG_MODULES::iterator it = m_ModulesList.find(Entry->Module);
+
+        if (it == m_ModulesList.end())
+        {
+            // address doesn't belong to any known module
+            if (bUnknownAllowed)
+            {
+                Modules[LOG_MODULE_UNKNOWN].Entries.push_back(Entry);
+            }
+
+            continue;
+        }
+
+        it->second.Processed += 1;
+
+        if (!it->second.bSkip)
+        {
+            MODULE_ENTRIES &Module = Modules[Entry->Module];
+            Module.Module = &it->second;
+            Module.Entries.push_back(Entry);
+        }
+    }
+
+    MODULE_ENTRIES_LIST List;
+    List.reserve(Modules.size());
+
+    std::vector<SYMBOLS_TABLE> Symbols(Modules.size());
+
+    for (std::map<int, MODULE_ENTRIES>::iterator it = Modules.begin(); it != Modules.end(); ++it)
+    {
+        if (it->first == LOG_MODULE_UNKNOWN || m_ModulesList.find(it->first) == m_ModulesList.end())
+        {
+            it->second.Module = NULL;
+        }
+
+        List.push_back(MODULE_ENTRIES());
+        List.back().Module = it->second.Module;
+        List.back().Symbols = &Symbols[List.size() - 1];
+        List.back().Entries.swap(it->second.Entries);
+
+        if (List.back().Module && !m_bSkipSymbols)
+        {
+            SymbolsLoad(List.back().Module->Path.c_str(), Symbols[List.size() - 1]);
+        }
+    }
+
+    SymbolsResolveModules(List, !m_bOrderByCalls);
+
+    // remove entries of the skipped modules
+    size_t Count = 0;
+
+    for (size_t i = 0; i < Entries.size(); i++)
+    {
+        if (Entries[i].Name.size() > 0)
+        {
+            if (Count != i)
+            {
+                Entries[Count] = Entries[i];
+            }
+
+            Count += 1;
+        }
+    }
+
+    Entries.resize(Count);
+}
+//--------------------------------------------------------------------------------------
+static bool ParseLog(const char *lpszPath, LOG_TYPE Type, LOG_ENTRIES &Entries)
+{
+    LOG_FILE Log;
+
+    if (!LogOpen(&Log, lpszPath))
+    {
+        return false;
+    }
+
+    LogParse(&Log, Type, Entries);
+    LogClose(&Log);
+
+    ResolveEntries(Entries);
+
+    // sort entries list
+    LogSort(Entries, m_bOrderByCalls);
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static void PrintRoutines(LOG_ENTRIES &Entries)
+{
+    LogWrite("#");
+    LogWrite("# %13s -- %s", "Calls count", "Function Name");
+    LogWrite("#");
+
+    for (size_t i = 0; i < Entries.size(); i++)
+    {
+        // print single log file entry information
+        LogWrite("%15lld -- %s", (long long)Entries[i].Calls, Entries[i].Name.c_str());
+    }
+}
+//--------------------------------------------------------------------------------------
+static void PrintBlocks(LOG_ENTRIES &Entries)
+{
+    LOG_INT64 Instructions = 0;
+
+    LogWrite("#");
+    LogWrite("# %13s -- Block Size -- %s", "Calls count", "Function Name");
+    LogWrite("#");
+
+    for (size_t i = 0; i < Entries.size(); i++)
+    {
+        // print single log file entry information
+        LogWrite(
+            "%15lld -- 0x%.8x -- %s", 
+            (long long)Entries[i].Calls, Entries[i].Size, Entries[i].Name.c_str()
+        );
+
+        Instructions += (LOG_INT64)Entries[i].Instructions * Entries[i].Calls;
+    }
+
+    LogWrite("#");
+    LogWrite("# %lld total instructions executed in given basic blocks", (long long)Instructions);
+    LogWrite("#");
+}
+//--------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    bool bDumpBlocks = false, bDumpRoutines = false;
+    const char *lpszOutFile = NULL;
+
+    printf("%s\n", APP_NAME);
+
+    if (argc < 2)
+    {
+        printf("USAGE: coverage_parse.exe <LogFilePath> [options]\n");
+        return 0;
+    }
+
+    std::string LogPath = argv[1];
+    std::string BlocksPath = LogPath + ".blocks";
+    std::string RoutinesPath = LogPath + ".routines";
+    std::string ModulesPath = LogPath + ".modules";
+
+    // parse command line arguments
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--outfile") && i < argc - 1)
+        {
+            // save information into the logfile
+            lpszOutFile = argv[i + 1];
+        }
+        else if (!strcmp(argv[i], "--modules") && i < argc - 1)
+        {
+            // filter by module name is specified
+            LogModulesFilter(argv[i + 1], m_ModulesToProcess);
+        }
+        else if (!strcmp(argv[i], "--dump-blocks"))
+        {
+            // parse basic blocks log file
+            bDumpBlocks = true;
+        }
+        else if (!strcmp(argv[i], "--dump-routines"))
+        {
+            // parse routines log file
+            bDumpRoutines = true;
+        }
+        else if (!strcmp(argv[i], "--order-by-names"))
+        {
+            printf("[+] Ordering list by symbol name\n");
+            m_bOrderByCalls = false;
+        }
+        else if (!strcmp(argv[i], "--order-by-calls"))
+        {
+            printf("[+] Ordering list by number of calls\n");
+            m_bOrderByCalls = true;
+        }
+        else if (!strcmp(argv[i], "--skip-symbols"))
+        {
+            m_bSkipSymbols = true;
+        }
+    }
+
+    if (!bDumpBlocks && !bDumpRoutines)
+    {
+        printf("[!] You must specify '--dump-blocks' or '--dump-routines' option\n");
+        return 0;
+    }
+
+    if (bDumpBlocks && bDumpRoutines)
+    {
+        printf("[!] You must specify only '--dump-blocks' or '--dump-routines' option (not both)\n");
+        return 0;
+    }
+
+    FILE *f = fopen(LogPath.c_str(), "rb");
+    if (f == NULL)
+    {
+        printf("[!] Error while opening input file\n");
+        return -1;
+    }
+
+    fclose(f);
+
+    // read target application modules list
+    if (!LogReadModules(ModulesPath.c_str(), m_ModulesToProcess, m_ModulesList))
+    {
+        printf("[!] Error while opening modules log\n");
+        return -1;
+    }
+
+    if (lpszOutFile)
+    {
+        // create output file
+        if ((m_OutFile = fopen(lpszOutFile, "wb+")) == NULL)
+        {
+            printf("[!] Error while creating output file\n");
+            return -1;
+        }
+
+        setvbuf(m_OutFile, NULL, _IOFBF, 0x100000);
+        printf("[+] Output file: \"%s\"\n", lpszOutFile);
+    }
+
+    if (!m_bSkipSymbols && !SymbolsInit())
+    {
+        DbgMsg(__FILE__, __LINE__, "Debug symbols are not available\n");
+    }
+
+    LOG_ENTRIES Entries;
+
+    if (bDumpBlocks)
+    {
+        printf("[+] Parsing basic blocks list, please wait...\n\n");
+
+        if (!ParseLog(BlocksPath.c_str(), LOG_BLOCKS, Entries))
+        {
+            printf("[!] Error while opening basic blocks log\n");
+            return -1;
+        }
+
+        PrintBlocks(Entries);
+    }
+    else if (bDumpRoutines)
+    {
+        printf("[+] Parsing routines list, please wait...\n\n");
+
+        if (!ParseLog(RoutinesPath.c_str(), LOG_ROUTINES, Entries))
+        {
+            printf("[!] Error while opening routines log\n");
+            return -1;
+        }
+
+        PrintRoutines(Entries);
+    }
+
+    if (m_OutFile)
+    {
+        fclose(m_OutFile);
+        m_OutFile = NULL;
+    }
+
+    // print processed modules information
+    printf("\n[+] Processed modules list:\n\n");
+    printf("#\n");
+    printf("# %13s -- %s\n", bDumpRoutines ? "Routines count" : "Basic blocks count", "Module Name");
+    printf("#\n");
+
+    std::map<std::string, unsigned int> ModulesItems;
+
+    // module might be loaded a several times, sum items of all its instances
+    for (LOG_MODULES::iterator it = m_ModulesList.begin(); it != m_ModulesList.end(); ++it)
+    {
+        ModulesItems[LogStringLower(it->second.Name)] += it->second.Processed;
+    }
+
+    for (std::map<std::string, unsigned int>::iterator it = ModulesItems.begin(); it != ModulesItems.end(); ++it)
+    {
+        printf("%15d -- %s\n", it->second, it->first.c_str());
+    }
+
+    printf("\n[+] DONE\n\n");
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+// EoF
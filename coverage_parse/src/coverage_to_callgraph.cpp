@@ -0,0 +1,764 @@
+#include "stdafx.h"
+
+#define APP_NAME "\nCode Coverage Analysis Tool for PIN\nby Oleksiuk Dmitry, eSage Lab (dmitry@esagelab.com)\n"
+
+// binary call tree log file signature and supported version
+#define CALL_LOG_MAGIC "CCTLOG"
+#define CALL_LOG_VERSION 1
+
+// size of the output file buffer
+#define OUT_BUFFER_SIZE 0x400000
+
+// per-worker edges list is compacted when it grows above this number of records
+#define CALL_EDGES_COMPACT 0x100000
+
+typedef struct _CALL_EDGE
+{
+    LOG_UINT64 Caller;
+    LOG_UINT64 Callee;
+    LOG_UINT64 Calls;
+
+} CALL_EDGE,
+*PCALL_EDGE;
+
+typedef std::vector<CALL_EDGE> CALL_EDGES;
+
+typedef struct _CALLS_PARAMS
+{
+    std::vector<std::string> Files;
+
+    // edges read by each worker
+    std::vector<CALL_EDGES> Edges;
+
+} CALLS_PARAMS,
+*PCALLS_PARAMS;
+
+typedef struct _NAME_ALIAS
+{
+    unsigned int Alias;
+    bool bAccessed;
+
+} NAME_ALIAS,
+*PNAME_ALIAS;
+
+typedef struct _OUT_FILE
+{
+    FILE *f;
+    std::vector<char> Buffer;
+    size_t Used;
+
+} OUT_FILE,
+*POUT_FILE;
+
+LOG_MODULES m_ModulesList;
+std::vector<std::string> m_ModulesToProcess;
+bool m_bSkipSymbols = false;
+//--------------------------------------------------------------------------------------
+static bool EdgeLess(const CALL_EDGE &First, const CALL_EDGE &Second)
+{
+    if (First.Caller != Second.Caller)
+    {
+        return First.Caller < Second.Caller;
+    }
+
+    return First.Callee < Second.Callee;
+}
+//--------------------------------------------------------------------------------------
+static bool EntryLessByAddress(const LOG_ENTRY &First, const LOG_ENTRY &Second)
+{
+    return First.Address < Second.Address;
+}
+//--------------------------------------------------------------------------------------
+static void EdgesCompact(CALL_EDGES &Edges)
+{
+    std::sort(Edges.begin(), Edges.end(), EdgeLess);
+
+    size_t Count = 0;
+
+    // sum calls of the same edges
+    for (size_t i = 0; i < Edges.size(); i++)
+    {
+        if (Count > 0 &&
+            Edges[Count - 1].Caller == Edges[i].Caller &&
+            Edges[Count - 1].Callee == Edges[i].Callee)
+        {
+            Edges[Count - 1].Calls += Edges[i].Calls;
+        }
+        else
+        {
+            Edges[Count++] = Edges[i];
+        }
+    }
+
+    Edges.resize(Count);
+}
+//--------------------------------------------------------------------------------------
+static void EdgeAdd(CALL_EDGES &Edges, size_t &Compacted, LOG_UINT64 Caller, LOG_UINT64 Callee, LOG_UINT64 Calls)
+{
+    if (Caller == 0)
+    {
+        return;
+    }
+
+    CALL_EDGE Edge;
+    Edge.Caller = Caller;
+    Edge.Callee = Callee;
+    Edge.Calls = Calls;
+
+    Edges.push_back(Edge);
+
+    if (Edges.size() >= Compacted * 2 + CALL_EDGES_COMPACT)
+    {
+        // merge duplicate edges to keep the memory usage low
+        EdgesCompact(Edges);
+        Compacted = Edges.size();
+    }
+}
+//--------------------------------------------------------------------------------------
+static bool UnpackValue(const unsigned char *Data, size_t Size, size_t *Pos, LOG_UINT64 *Value)
+{
+    // decode 7-bit variable length integer
+    LOG_UINT64 Packed = 0;
+    unsigned int Shift = 0;
+
+    while (true)
+    {
+        if (*Pos >= Size || Shift >= 64)
+        {
+            return false;
+        }
+
+        unsigned char Byte = Data[*Pos];
+        *Pos += 1;
+
+        Packed |= (LOG_UINT64)(Byte & 0x7f) << Shift;
+        Shift += 7;
+
+        if (Byte < 0x80)
+        {
+            break;
+        }
+    }
+
+    // decode zigzag'ed signed value and add it to the previous one
+    *Value += (Packed >> 1) ^ (LOG_UINT64)(-(LOG_INT64)(Packed & 1));
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static bool ReadCallsBinary(PLOG_FILE Log, CALL_EDGES &Edges, size_t &Compacted)
+{
+    const unsigned char *Data = (const unsigned char *)Log->Data;
+    unsigned int Version = 0;
+
+    // skip file signature and check the version
+    size_t Pos = sizeof(CALL_LOG_MAGIC) - 1;
+
+    if (Log->Size < Pos + sizeof(unsigned int))
+    {
+        DbgMsg(__FILE__, __LINE__, "Truncated calls log header\n");
+        return false;
+    }
+
+    memcpy(&Version, Data + Pos, sizeof(unsigned int));
+
+    if (Version != CALL_LOG_VERSION)
+    {
+        DbgMsg(__FILE__, __LINE__, "Unknown calls log version %d\n", Version);
+        return false;
+    }
+
+    Pos += sizeof(unsigned int);
+
+    while (Pos + sizeof(unsigned int) * 2 <= Log->Size)
+    {
+        // read chunk header
+        unsigned int Count = 0, Size = 0;
+        memcpy(&Count, Data + Pos, sizeof(unsigned int));
+        memcpy(&Size, Data + Pos + sizeof(unsigned int), sizeof(unsigned int));
+
+        Pos += sizeof(unsigned int) * 2;
+
+        if (Size > Log->Size - Pos)
+        {
+            DbgMsg(__FILE__, __LINE__, "Truncated chunk at offset 0x%x\n", (unsigned int)Pos);
+            break;
+        }
+
+        const unsigned char *Chunk = Data + Pos;
+        LOG_UINT64 Caller = 0, Callee = 0;
+        size_t ChunkPos = 0;
+
+        for (unsigned int i = 0; i < Count; i++)
+        {
+            // addresses are stored as delta from the previous record
+            if (!UnpackValue(Chunk, Size, &ChunkPos, &Caller) ||
+                !UnpackValue(Chunk, Size, &ChunkPos, &Callee))
+            {
+                DbgMsg(__FILE__, __LINE__, "Invalid chunk at offset 0x%x\n", (unsigned int)Pos);
+                break;
+            }
+
+            EdgeAdd(Edges, Compacted, Caller, Callee, 1);
+        }
+
+        Pos += Size;
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static void ReadCallsText(PLOG_FILE Log, CALL_EDGES &Edges, size_t &Compacted)
+{
+    const char *Ptr = Log->Data, *End = Log->Data + Log->Size;
+
+    while (Ptr < End)
+    {
+        const char *Line = Ptr;
+        const char *LineEnd = (const char *)memchr(Ptr, '\n', End - Ptr);
+
+        if (LineEnd == NULL)
+        {
+            LineEnd = End;
+        }
+
+        Ptr = LineEnd + 1;
+
+        if (*Line == '#')
+        {
+            // comment line
+            continue;
+        }
+
+        // <caller>:<callee>[:<calls>]
+        const char *Callee = (const char *)memchr(Line, ':', LineEnd - Line);
+        if (Callee == NULL)
+        {
+            continue;
+        }
+
+        Callee += 1;
+
+        const char *Calls = (const char *)memchr(Callee, ':', LineEnd - Callee);
+
+        EdgeAdd(
+            Edges, Compacted,
+            LogParseHex(Line, Callee - 1),
+            LogParseHex(Callee, Calls ? Calls : LineEnd),
+            Calls ? (LOG_UINT64)LogParseDec(Calls + 1, LineEnd) : 1
+        );
+    }
+}
+//--------------------------------------------------------------------------------------
+static void ReadCallsFiles(void *Param, unsigned int Index, unsigned int Count)
+{
+    PCALLS_PARAMS Params = (PCALLS_PARAMS)Param;
+    CALL_EDGES &Edges = Params->Edges[Index];
+    size_t Compacted = 0;
+
+    // each worker reads its own subset of the input files
+    for (size_t i = Index; i < Params->Files.size(); i += Count)
+    {
+        LOG_FILE Log;
+
+        if (!LogOpen(&Log, Params->Files[i].c_str()))
+        {
+            printf("[!] Error while opening calls log \"%s\"\n", Params->Files[i].c_str());
+            continue;
+        }
+
+        if (Log.Size >= sizeof(CALL_LOG_MAGIC) - 1 &&
+            !memcmp(Log.Data, CALL_LOG_MAGIC, sizeof(CALL_LOG_MAGIC) - 1))
+        {
+            if (!ReadCallsBinary(&Log, Edges, Compacted))
+            {
+                printf("[!] Unsupported calls log \"%s\"\n", Params->Files[i].c_str());
+            }
+        }
+        else
+        {
+            ReadCallsText(&Log, Edges, Compacted);
+        }
+
+        LogClose(&Log);
+    }
+
+    EdgesCompact(Edges);
+}
+//--------------------------------------------------------------------------------------
+static void ResolveRoutines(std::vector<PLOG_ENTRY> &Routines)
+{
+    std::map<int, MODULE_ENTRIES> Modules;
+    std::map<std::string, SYMBOLS_TABLE> Symbols;
+
+    for (size_t i = 0; i < Routines.size(); i++)
+    {
+        LOG_MODULES::iterator it = m_ModulesList.find(Routines[i]->Module);
+        MODULE_ENTRIES &Module = Modules[it == m_ModulesList.end() ? LOG_MODULE_UNKNOWN : Routines[i]->Module];
+
+        Module.Module = it == m_ModulesList.end() ? NULL : &it->second;
+        Module.Entries.push_back(Routines[i]);
+    }
+
+    MODULE_ENTRIES_LIST List;
+    List.reserve(Modules.size());
+
+    for (std::map<int, MODULE_ENTRIES>::iterator it = Modules.begin(); it != Modules.end(); ++it)
+    {
+        PLOG_MODULE Module = it->second.Module;
+
+        List.push_back(MODULE_ENTRIES());
+        List.back().Module = Module;
+        List.back().Entries.swap(it->second.Entries);
+
+        // the same module might be loaded several times, load its symbols only once
+        std::string Path = Module ? LogStringLower(Module->Path) : std::string();
+        std::map<std::string, SYMBOLS_TABLE>::iterator Table = Symbols.find(Path);
+
+        if (Table == Symbols.end())
+        {
+            Table = Symbols.insert(std::make_pair(Path, SYMBOLS_TABLE())).first;
+
+            if (Module && !Module->bSkip && !m_bSkipSymbols)
+            {
+                SymbolsLoad(Module->Path.c_str(), Table->second);
+            }
+        }
+
+        List.back().Symbols = &Table->second;
+    }
+
+    SymbolsResolveModules(List, false);
+}
+//--------------------------------------------------------------------------------------
+static void OutWrite(POUT_FILE Out, const char *Data, size_t Size)
+{
+    if (Out->Used + Size > Out->Buffer.size())
+    {
+        fwrite(&Out->Buffer[0], 1, Out->Used, Out->f);
+        Out->Used = 0;
+    }
+
+    if (Size > Out->Buffer.size())
+    {
+        fwrite(Data, 1, Size, Out->f);
+        return;
+    }
+
+    memcpy(&Out->Buffer[Out->Used], Data, Size);
+    Out->Used += Size;
+}
+//--------------------------------------------------------------------------------------
+static void OutString(POUT_FILE Out, const char *lpszData)
+{
+    OutWrite(Out, lpszData, strlen(lpszData));
+}
+//--------------------------------------------------------------------------------------
+static void OutName(POUT_FILE Out, const char *lpszKey, PNAME_ALIAS Alias, const std::string &Name)
+{
+    char szAlias[0x20];
+
+    sprintf(szAlias, "=(%d)", Alias->Alias);
+
+    OutString(Out, lpszKey);
+    OutString(Out, szAlias);
+
+    if (!Alias->bAccessed)
+    {
+        // write full name only for the first reference, alias is enough for the rest
+        OutString(Out, " ");
+        OutWrite(Out, Name.data(), Name.size());
+
+        Alias->bAccessed = true;
+    }
+
+    OutString(Out, "\r\n");
+}
+//--------------------------------------------------------------------------------------
+static void OutFlush(POUT_FILE Out)
+{
+    if (Out->Used > 0)
+    {
+        fwrite(&Out->Buffer[0], 1, Out->Used, Out->f);
+        Out->Used = 0;
+    }
+}
+//--------------------------------------------------------------------------------------
+static bool ListCallsFiles(const std::string &LogPath, std::vector<std::string> &Files)
+{
+    size_t NamePos = LogPath.find_last_of("\\/");
+    std::string Dir = NamePos == std::string::npos ? std::string() : LogPath.substr(0, NamePos + 1);
+    std::string Prefix = (NamePos == std::string::npos ? LogPath : LogPath.substr(NamePos + 1)) + ".";
+    std::vector<std::pair<unsigned int, std::string> > Found;
+
+#ifdef _WIN32
+
+    WIN32_FIND_DATAA FindData;
+    HANDLE hFind = FindFirstFileA((Dir + Prefix + "*").c_str(), &FindData);
+    if (hFind == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    do
+    {
+        std::string Name = FindData.cFileName;
+
+#else
+
+    DIR *Directory = opendir(Dir.size() > 0 ? Dir.c_str() : ".");
+    if (Directory == NULL)
+    {
+        return false;
+    }
+
+    struct dirent *DirEntry = NULL;
+
+    while ((DirEntry = readdir(Directory)) != NULL)
+    {
+        std::string Name = DirEntry->d_name;
+
+#endif
+
+        // match <log_file_name>.<thread_number>
+        if (Name.size() > Prefix.size() &&
+            !LogStringLower(Name.substr(0, Prefix.size())).compare(LogStringLower(Prefix)) &&
+            Name.find_first_not_of("0123456789", Prefix.size()) == std::string::npos)
+        {
+            Found.push_back(std::make_pair((unsigned int)atoi(Name.c_str() + Prefix.size()), Dir + Name));
+        }
+
+#ifdef _WIN32
+
+    } while (FindNextFileA(hFind, &FindData));
+
+    FindClose(hFind);
+
+#else
+
+    }
+
+    closedir(Directory);
+
+#endif
+
+    // sort files by the thread number
+    std::sort(Found.begin(), Found.end());
+
+    for (size_t i = 0; i < Found.size(); i++)
+    {
+        Files.push_back(Found[i].second);
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    printf("%s\n", APP_NAME);
+
+    if (argc < 3)
+    {
+        printf("USAGE: coverage_to_callgraph.exe <LogFilePath> <thread_id> [options]\n");
+        return 0;
+    }
+
+    std::string ThreadId = argv[2];
+
+    if (ThreadId != "*" &&
+        (ThreadId.size() == 0 || ThreadId.find_first_not_of("0123456789") != std::string::npos))
+    {
+        printf("[!] Error: invalid thread id specified\n");
+        return -1;
+    }
+
+    std::string OutPath = "Callgrind.out";
+
+    if (ThreadId != "*")
+    {
+        OutPath += "." + ThreadId;
+    }
+
+    std::string LogPath = argv[1];
+    std::string RoutinesPath = LogPath + ".routines";
+    std::string ModulesPath = LogPath + ".modules";
+
+    // parse command line arguments
+    for (int i = 3; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--modules") && i < argc - 1)
+        {
+            // filter by module name is specified
+            LogModulesFilter(argv[i + 1], m_ModulesToProcess);
+        }
+        else if (!strcmp(argv[i], "--skip-symbols"))
+        {
+            m_bSkipSymbols = true;
+        }
+    }
+
+    FILE *f = fopen(LogPath.c_str(), "rb");
+    if (f == NULL)
+    {
+        printf("[!] Error while opening input file\n");
+        return -1;
+    }
+
+    fclose(f);
+
+    CALLS_PARAMS Params;
+
+    if (ThreadId != "*")
+    {
+        // process single input file
+        std::string CallsPath = LogPath + "." + ThreadId;
+
+        if ((f = fopen(CallsPath.c_str(), "rb")) == NULL)
+        {
+            printf("[!] Error while opening calls log\n");
+            return -1;
+        }
+
+        fclose(f);
+
+        Params.Files.push_back(CallsPath);
+    }
+    else
+    {
+        // use call tree log files for all threads
+        ListCallsFiles(LogPath, Params.Files);
+    }
+
+    printf("[+] Input file(s): ");
+
+    for (size_t i = 0; i < Params.Files.size(); i++)
+    {
+        printf("%s%s", i > 0 ? ", " : "", Params.Files[i].c_str());
+    }
+
+    printf("\n");
+
+    OUT_FILE Out;
+    Out.Used = 0;
+    Out.Buffer.resize(OUT_BUFFER_SIZE);
+
+    // create output file
+    if ((Out.f = fopen(OutPath.c_str(), "wb+")) == NULL)
+    {
+        printf("[!] Error while creating output file\n");
+        return -1;
+    }
+
+    printf("[+] Output file: %s\n", OutPath.c_str());
+
+    time_t ExecTime = time(NULL);
+
+    // read target application modules list
+    if (!LogReadModules(ModulesPath.c_str(), m_ModulesToProcess, m_ModulesList))
+    {
+        printf("[!] Error while opening modules log\n");
+        return -1;
+    }
+
+    printf("[+] %d modules readed\n", (int)m_ModulesList.size());
+    printf("[+] Parsing routines list, please wait...\n\n");
+
+    // read target application routines list
+    LOG_FILE Log;
+    LOG_ENTRIES Routines;
+
+    if (!LogOpen(&Log, RoutinesPath.c_str()))
+    {
+        printf("[!] Error while opening routines log\n");
+        return -1;
+    }
+
+    LogParse(&Log, LOG_ROUTINES, Routines);
+    LogClose(&Log);
+
+    // the last entry wins for the duplicate addresses
+    std::stable_sort(Routines.begin(), Routines.end(), EntryLessByAddress);
+
+    size_t Count = 0;
+
+    for (size_t i = 0; i < Routines.size(); i++)
+    {
+        if (Count > 0 && Routines[Count - 1].Address == Routines[i].Address)
+        {
+            Count -= 1;
+        }
+
+        if (Count != i)
+        {
+            Routines[Count] = Routines[i];
+        }
+
+        Count += 1;
+    }
+
+    Routines.resize(Count);
+
+    printf("[+] %d routines readed\n", (int)Routines.size());
+    printf("[+] Parsing call tree, please wait...\n\n");
+
+    // read all of the input files in parallel
+    unsigned int Workers = std::max(1u, std::min(WorkersCount(), (unsigned int)Params.Files.size()));
+    Params.Edges.resize(Workers);
+
+    WorkersRun(ReadCallsFiles, &Params, Workers);
+
+    CALL_EDGES Edges;
+
+    // merge edges of all workers
+    for (unsigned int i = 0; i < Workers; i++)
+    {
+        Edges.insert(Edges.end(), Params.Edges[i].begin(), Params.Edges[i].end());
+        CALL_EDGES().swap(Params.Edges[i]);
+    }
+
+    EdgesCompact(Edges);
+
+    printf("[+] %d call edges readed\n", (int)Edges.size());
+
+    // find routines of the call edges
+    LOG_ENTRY Key;
+    std::vector<PLOG_ENTRY> EdgeCaller(Edges.size()), EdgeCallee(Edges.size());
+    std::vector<bool> RoutineUsed(Routines.size(), false);
+    std::vector<PLOG_ENTRY> Used;
+
+    for (size_t i = 0; i < Edges.size(); i++)
+    {
+        PLOG_ENTRY *Entry[] = { &EdgeCaller[i], &EdgeCallee[i] };
+        LOG_UINT64 Address[] = { Edges[i].Caller, Edges[i].Callee };
+
+        for (int n = 0; n < 2; n++)
+        {
+            Key.Address = Address[n];
+
+            LOG_ENTRIES::iterator it = std::lower_bound(Routines.begin(), Routines.end(), Key, EntryLessByAddress);
+            if (it == Routines.end() || it->Address != Address[n])
+            {
+                // unknown routine
+                *Entry[n] = NULL;
+                continue;
+            }
+
+            size_t Index = it - Routines.begin();
+
+            if (!RoutineUsed[Index])
+            {
+                RoutineUsed[Index] = true;
+                Used.push_back(&Routines[Index]);
+            }
+
+            *Entry[n] = &Routines[Index];
+        }
+    }
+
+    // symbolize each of the used routines only once
+    ResolveRoutines(Used);
+
+    std::vector<NAME_ALIAS> RoutineAlias(Routines.size());
+    std::map<std::string, NAME_ALIAS> ModuleAlias;
+    unsigned int RoutinesAliases = 0;
+
+    // alias 1 is reserved for the unknown module
+    ModuleAlias["?"].Alias = 1;
+    ModuleAlias["?"].bAccessed = false;
+
+    for (size_t i = 0; i < Used.size(); i++)
+    {
+        PLOG_ENTRY Entry = Used[i];
+        NAME_ALIAS &Alias = RoutineAlias[Entry - &Routines[0]];
+
+        Alias.Alias = ++RoutinesAliases;
+        Alias.bAccessed = false;
+
+        LOG_MODULES::iterator it = m_ModulesList.find(Entry->Module);
+        if (it != m_ModulesList.end())
+        {
+            std::string Name = LogStringLower(it->second.Name);
+
+            if (ModuleAlias.find(Name) == ModuleAlias.end())
+            {
+                NAME_ALIAS Alias;
+                Alias.Alias = (unsigned int)ModuleAlias.size() + 1;
+                Alias.bAccessed = false;
+
+                ModuleAlias[Name] = Alias;
+            }
+        }
+    }
+
+    OutString(&Out, "#\r\n");
+    OutString(&Out, "# Generated by Code Coverage Analysis Tool for PIN\r\n");
+    OutString(&Out, "#\r\n\r\n");
+
+    // write call tree information into the callgrind file
+    OutString(&Out, "events: Ir\r\n\r\n");
+
+    // edges are sorted by caller, so all of the calls of the function are written together
+    PLOG_ENTRY Current = NULL;
+
+    for (size_t i = 0; i < Edges.size(); i++)
+    {
+        PLOG_ENTRY Caller = EdgeCaller[i], Callee = EdgeCallee[i];
+
+        if (Caller == NULL || Callee == NULL)
+        {
+            continue;
+        }
+
+        PLOG_ENTRY Entries[] = { Caller, Callee };
+        std::string ModuleNames[2];
+        PNAME_ALIAS ModuleAliases[2];
+
+        for (int n = 0; n < 2; n++)
+        {
+            LOG_MODULES::iterator it = m_ModulesList.find(Entries[n]->Module);
+
+            ModuleNames[n] = it == m_ModulesList.end() ? std::string("?") : it->second.Name;
+            ModuleAliases[n] = &ModuleAlias[LogStringLower(ModuleNames[n])];
+        }
+
+        if (Caller != Current)
+        {
+            if (Current)
+            {
+                // end of the previous function calls
+                OutString(&Out, "\r\n\r\n");
+            }
+
+            OutName(&Out, "ob", ModuleAliases[0], ModuleNames[0]);
+            OutName(&Out, "fn", &RoutineAlias[Caller - &Routines[0]], Caller->Name);
+            OutString(&Out, "0 1\r\n");
+
+            Current = Caller;
+        }
+
+        char szCalls[0x40];
+        sprintf(szCalls, "calls=%llu 0\r\n", (unsigned long long)Edges[i].Calls);
+
+        // call from the current function to the other one
+        OutName(&Out, "cob", ModuleAliases[1], ModuleNames[1]);
+        OutName(&Out, "cfn", &RoutineAlias[Callee - &Routines[0]], Callee->Name);
+        OutString(&Out, szCalls);
+        OutString(&Out, "0 1\r\n");
+    }
+
+    if (Current)
+    {
+        OutString(&Out, "\r\n\r\n");
+    }
+
+    OutFlush(&Out);
+    fclose(Out.f);
+
+    ExecTime = time(NULL) - ExecTime;
+
+    printf("\n[+] DONE (%d mins., %d secs.)\n\n", (int)(ExecTime / 60), (int)(ExecTime % 60));
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+// EoF
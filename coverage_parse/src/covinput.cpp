@@ -0,0 +1,372 @@
+#include "stdafx.h"
+//--------------------------------------------------------------------------------------
+void InputModulesInit(PINPUT_MODULES Modules, bool bByName)
+{
+    WorkersLockInit(&Modules->Lock);
+
+    Modules->List.clear();
+    Modules->ByKey.clear();
+    Modules->bByName = bByName;
+}
+//--------------------------------------------------------------------------------------
+void InputModulesDestroy(PINPUT_MODULES Modules)
+{
+    WorkersLockDestroy(&Modules->Lock);
+}
+//--------------------------------------------------------------------------------------
+COVDB_UINT32 InputModuleId(
+    PINPUT_MODULES Modules, unsigned int Run,
+    const std::string &Path, COVDB_UINT64 Start, COVDB_UINT64 End)
+{
+    // module is identified by its path or name, load address might be different in every run
+    std::string Key = LogStringLower(Path);
+
+    if (Modules->bByName && Key.find_last_of("\\/") != std::string::npos)
+    {
+        Key = Key.substr(Key.find_last_of("\\/") + 1);
+    }
+    COVDB_UINT32 Id = 0;
+
+    WorkersLockAcquire(&Modules->Lock);
+
+    std::map<std::string, COVDB_UINT32>::iterator it = Modules->ByKey.find(Key);
+    if (it == Modules->ByKey.end())
+    {
+        INPUT_MODULE Module;
+        Module.Path = Path;
+        Module.Start = Start;
+        Module.End = End;
+        Module.PathRun = Run;
+        Module.AddressRun = Start == 0 && End == 0 ? INPUT_RUN_NONE : Run;
+
+        Id = (COVDB_UINT32)Modules->List.size();
+
+        Modules->List.push_back(Module);
+        Modules->ByKey[Key] = Id;
+    }
+    else
+    {
+        PINPUT_MODULE Module = &Modules->List[Id = it->second];
+
+        // use information from the first run, so the output doesn't depend on the threads timing
+        if (Run < Module->PathRun)
+        {
+            Module->Path = Path;
+            Module->PathRun = Run;
+        }
+
+        // text logs doesn't have module address
+        if ((Start != 0 || End != 0) && (Module->AddressRun == INPUT_RUN_NONE || Run < Module->AddressRun))
+        {
+            Module->Start = Start;
+            Module->End = End;
+            Module->AddressRun = Run;
+        }
+    }
+
+    WorkersLockRelease(&Modules->Lock);
+
+    return Id;
+}
+//--------------------------------------------------------------------------------------
+static bool InputLoadDb(PINPUT_MODULES Modules, unsigned int Run, PCOVDB Db, PINPUT_COVERAGE Coverage)
+{
+    COVDB_UINT64 ModulesCount = 0, Count = 0;
+
+    const COVDB_UINT64 *ModulesStart = COVDB_COLUMN_DATA(Db, COVDB_TABLE_MODULES, COVDB_MODULES_START, COVDB_UINT64, &ModulesCount);
+    const COVDB_UINT64 *ModulesEnd = COVDB_COLUMN_DATA(Db, COVDB_TABLE_MODULES, COVDB_MODULES_END, COVDB_UINT64, NULL);
+    const COVDB_UINT32 *ModulesPath = COVDB_COLUMN_DATA(Db, COVDB_TABLE_MODULES, COVDB_MODULES_PATH, COVDB_UINT32, NULL);
+
+    if (ModulesCount > 0 && (ModulesStart == NULL || ModulesEnd == NULL || ModulesPath == NULL))
+    {
+        DbgMsg(__FILE__, __LINE__, "Invalid modules table\n");
+        return false;
+    }
+
+    // run module ID -> global module ID
+    std::vector<COVDB_UINT32> ModulesMap((size_t)ModulesCount);
+
+    for (COVDB_UINT64 i = 0; i < ModulesCount; i++)
+    {
+        ModulesMap[(size_t)i] = InputModuleId(Modules, Run, CovDbString(Db, ModulesPath[i]), ModulesStart[i], ModulesEnd[i]);
+    }
+
+#define INPUT_MODULE_ID(_id_) ((_id_) < ModulesCount ? ModulesMap[(size_t)(_id_)] : COVDB_MODULE_UNKNOWN)
+
+    const COVDB_UINT32 *BlocksModule = COVDB_COLUMN_DATA(Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_MODULE, COVDB_UINT32, &Count);
+    const COVDB_UINT64 *BlocksOffset = COVDB_COLUMN_DATA(Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_OFFSET, COVDB_UINT64, NULL);
+    const COVDB_UINT32 *BlocksSize = COVDB_COLUMN_DATA(Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_SIZE, COVDB_UINT32, NULL);
+    const COVDB_UINT32 *BlocksInstructions = COVDB_COLUMN_DATA(Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_INSTRUCTIONS, COVDB_UINT32, NULL);
+    const COVDB_UINT64 *BlocksCount = COVDB_COLUMN_DATA(Db, COVDB_TABLE_BLOCKS, COVDB_BLOCKS_COUNT, COVDB_UINT64, NULL);
+
+    if (BlocksModule && BlocksOffset && BlocksCount)
+    {
+        Coverage->Blocks.resize((size_t)Count);
+
+        for (COVDB_UINT64 i = 0; i < Count; i++)
+        {
+            PINPUT_BLOCK Block = &Coverage->Blocks[(size_t)i];
+
+            Block->Module = INPUT_MODULE_ID(BlocksModule[i]);
+            Block->Offset = BlocksOffset[i];
+            Block->Size = BlocksSize ? BlocksSize[i] : 0;
+            Block->Instructions = BlocksInstructions ? BlocksInstructions[i] : 0;
+            Block->Count = BlocksCount[i];
+        }
+    }
+
+    const COVDB_UINT32 *RoutinesModule = COVDB_COLUMN_DATA(Db, COVDB_TABLE_ROUTINES, COVDB_ROUTINES_MODULE, COVDB_UINT32, &Count);
+    const COVDB_UINT64 *RoutinesOffset = COVDB_COLUMN_DATA(Db, COVDB_TABLE_ROUTINES, COVDB_ROUTINES_OFFSET, COVDB_UINT64, NULL);
+    const COVDB_UINT64 *RoutinesCount = COVDB_COLUMN_DATA(Db, COVDB_TABLE_ROUTINES, COVDB_ROUTINES_COUNT, COVDB_UINT64, NULL);
+
+    if (RoutinesModule && RoutinesOffset && RoutinesCount)
+    {
+        Coverage->Routines.resize((size_t)Count);
+
+        for (COVDB_UINT64 i = 0; i < Count; i++)
+        {
+            PINPUT_ROUTINE Routine = &Coverage->Routines[(size_t)i];
+
+            Routine->Module = INPUT_MODULE_ID(RoutinesModule[i]);
+            Routine->Offset = RoutinesOffset[i];
+            Routine->Count = RoutinesCount[i];
+        }
+    }
+
+    const COVDB_UINT32 *CallerModule = COVDB_COLUMN_DATA(Db, COVDB_TABLE_CALLS, COVDB_CALLS_CALLER_MODULE, COVDB_UINT32, &Count);
+    const COVDB_UINT64 *CallerOffset = COVDB_COLUMN_DATA(Db, COVDB_TABLE_CALLS, COVDB_CALLS_CALLER_OFFSET, COVDB_UINT64, NULL);
+    const COVDB_UINT32 *CalleeModule = COVDB_COLUMN_DATA(Db, COVDB_TABLE_CALLS, COVDB_CALLS_CALLEE_MODULE, COVDB_UINT32, NULL);
+    const COVDB_UINT64 *CalleeOffset = COVDB_COLUMN_DATA(Db, COVDB_TABLE_CALLS, COVDB_CALLS_CALLEE_OFFSET, COVDB_UINT64, NULL);
+    const COVDB_UINT64 *CallsCount = COVDB_COLUMN_DATA(Db, COVDB_TABLE_CALLS, COVDB_CALLS_COUNT, COVDB_UINT64, NULL);
+
+    if (CallerModule && CallerOffset && CalleeModule && CalleeOffset && CallsCount)
+    {
+        Coverage->Calls.resize((size_t)Count);
+
+        for (COVDB_UINT64 i = 0; i < Count; i++)
+        {
+            PINPUT_CALL Call = &Coverage->Calls[(size_t)i];
+
+            Call->CallerModule = INPUT_MODULE_ID(CallerModule[i]);
+            Call->CallerOffset = CallerOffset[i];
+            Call->CalleeModule = INPUT_MODULE_ID(CalleeModule[i]);
+            Call->CalleeOffset = CalleeOffset[i];
+            Call->Count = CallsCount[i];
+        }
+    }
+
+#undef INPUT_MODULE_ID
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static bool InputLoadText(PINPUT_MODULES Modules, unsigned int Run, const std::string &Path, PINPUT_COVERAGE Coverage)
+{
+    LOG_MODULES LogModules;
+    std::vector<std::string> Filter;
+
+    if (!LogReadModules((Path + ".modules").c_str(), Filter, LogModules))
+    {
+        DbgMsg(__FILE__, __LINE__, "Unable to read modules log of \"%s\"\n", Path.c_str());
+        return false;
+    }
+
+    // run module ID -> global module ID
+    std::map<int, COVDB_UINT32> ModulesMap;
+
+    for (LOG_MODULES::iterator it = LogModules.begin(); it != LogModules.end(); ++it)
+    {
+        ModulesMap[it->first] = InputModuleId(Modules, Run, it->second.Path, 0, 0);
+    }
+
+    LOG_FILE Log;
+    LOG_ENTRIES Entries;
+
+    // both of the logs are optional
+    if (LogOpen(&Log, (Path + ".blocks").c_str()))
+    {
+        LogParse(&Log, LOG_BLOCKS, Entries);
+        LogClose(&Log);
+
+        Coverage->Blocks.resize(Entries.size());
+
+        for (size_t i = 0; i < Entries.size(); i++)
+        {
+            PINPUT_BLOCK Block = &Coverage->Blocks[i];
+            std::map<int, COVDB_UINT32>::iterator it = ModulesMap.find(Entries[i].Module);
+
+            Block->Module = it == ModulesMap.end() ? COVDB_MODULE_UNKNOWN : it->second;
+            Block->Offset = Entries[i].Offset;
+            Block->Size = Entries[i].Size;
+            Block->Instructions = Entries[i].Instructions;
+            Block->Count = (COVDB_UINT64)Entries[i].Calls;
+        }
+    }
+
+    if (LogOpen(&Log, (Path + ".routines").c_str()))
+    {
+        LogParse(&Log, LOG_ROUTINES, Entries);
+        LogClose(&Log);
+
+        Coverage->Routines.resize(Entries.size());
+
+        for (size_t i = 0; i < Entries.size(); i++)
+        {
+            PINPUT_ROUTINE Routine = &Coverage->Routines[i];
+            std::map<int, COVDB_UINT32>::iterator it = ModulesMap.find(Entries[i].Module);
+
+            Routine->Module = it == ModulesMap.end() ? COVDB_MODULE_UNKNOWN : it->second;
+            Routine->Offset = Entries[i].Offset;
+            Routine->Count = (COVDB_UINT64)Entries[i].Calls;
+        }
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+bool InputLoad(PINPUT_MODULES Modules, unsigned int Run, const char *lpszPath, PINPUT_COVERAGE Coverage)
+{
+    std::string Path = lpszPath;
+    char Signature[8];
+    bool bRet = false;
+
+    memset(Signature, 0, sizeof(Signature));
+
+    FILE *f = fopen(Path.c_str(), "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    fread(Signature, 1, sizeof(Signature), f);
+    fclose(f);
+
+    if (!memcmp(Signature, COVDB_SIGNATURE, sizeof(Signature)))
+    {
+        // coverage database or snapshot
+        COVDB Db;
+
+        if (CovDbOpen(&Db, Path.c_str()))
+        {
+            bRet = InputLoadDb(Modules, Run, &Db, Coverage);
+            CovDbClose(&Db);
+        }
+    }
+    else if (!memcmp(Signature, COVLIVE_SIGNATURE, sizeof(Signature)))
+    {
+        // live counters file, it's converted into the database image first
+        COVDB_UINT64 Size = 0;
+        COVDB_UINT8 *Image = CovLiveRecoverMemory(Path.c_str(), &Size, NULL);
+
+        if (Image)
+        {
+            COVDB Db;
+
+            if (CovDbOpenMemory(&Db, Image, Size))
+            {
+                bRet = InputLoadDb(Modules, Run, &Db, Coverage);
+                CovDbClose(&Db);
+            }
+
+            free(Image);
+        }
+    }
+    else
+    {
+        // text logs: <log>.modules, <log>.blocks and <log>.routines
+        bRet = InputLoadText(Modules, Run, Path, Coverage);
+    }
+
+    InputSort(Coverage->Blocks);
+    InputSort(Coverage->Routines);
+    InputSort(Coverage->Calls);
+
+    return bRet;
+}
+//--------------------------------------------------------------------------------------
+void InputModulesSort(PINPUT_MODULES Modules, std::vector<COVDB_UINT32> &Map)
+{
+    std::vector<std::pair<std::string, COVDB_UINT32> > Order;
+
+    for (COVDB_UINT32 i = 0; i < Modules->List.size(); i++)
+    {
+        Order.push_back(std::make_pair(LogStringLower(Modules->List[i].Path), i));
+    }
+
+    std::sort(Order.begin(), Order.end());
+
+    std::vector<INPUT_MODULE> List;
+
+    Map.resize(Modules->List.size());
+
+    for (COVDB_UINT32 i = 0; i < Order.size(); i++)
+    {
+        Map[Order[i].second] = i;
+        List.push_back(Modules->List[Order[i].second]);
+    }
+
+    Modules->List.swap(List);
+
+    for (std::map<std::string, COVDB_UINT32>::iterator it = Modules->ByKey.begin(); it != Modules->ByKey.end(); ++it)
+    {
+        it->second = Map[it->second];
+    }
+}
+//--------------------------------------------------------------------------------------
+void InputRemap(PINPUT_COVERAGE Coverage, const std::vector<COVDB_UINT32> &Map)
+{
+
+#define INPUT_MODULE_REMAP(_id_) (_id_) = ((_id_) < Map.size() ? Map[(_id_)] : (_id_))
+
+    for (size_t i = 0; i < Coverage->Blocks.size(); i++)
+    {
+        INPUT_MODULE_REMAP(Coverage->Blocks[i].Module);
+    }
+
+    for (size_t i = 0; i < Coverage->Routines.size(); i++)
+    {
+        INPUT_MODULE_REMAP(Coverage->Routines[i].Module);
+    }
+
+    for (size_t i = 0; i < Coverage->Calls.size(); i++)
+    {
+        INPUT_MODULE_REMAP(Coverage->Calls[i].CallerModule);
+        INPUT_MODULE_REMAP(Coverage->Calls[i].CalleeModule);
+    }
+
+#undef INPUT_MODULE_REMAP
+
+    InputSort(Coverage->Blocks);
+    InputSort(Coverage->Routines);
+    InputSort(Coverage->Calls);
+}
+//--------------------------------------------------------------------------------------
+bool InputReadList(const char *lpszPath, std::vector<std::string> &Inputs)
+{
+    FILE *f = fopen(lpszPath, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    char szLine[0x1000];
+
+    // one input path per line
+    while (fgets(szLine, sizeof(szLine), f))
+    {
+        std::string Line = szLine;
+
+        Line.erase(Line.find_last_not_of(" \t\r\n") + 1);
+
+        if (Line.size() > 0 && Line[0] != '#')
+        {
+            Inputs.push_back(Line);
+        }
+    }
+
+    fclose(f);
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+// EoF
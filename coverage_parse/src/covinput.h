@@ -0,0 +1,226 @@
+
+// AddressRun of the module that was loaded only from the text logs without address
+#define INPUT_RUN_NONE 0xffffffff
+
+typedef struct _INPUT_MODULE
+{
+    std::string Path;
+    COVDB_UINT64 Start;
+    COVDB_UINT64 End;
+
+    // runs where the path and the address were taken from
+    unsigned int PathRun;
+    unsigned int AddressRun;
+
+} INPUT_MODULE,
+*PINPUT_MODULE;
+
+typedef struct _INPUT_MODULES
+{
+    // modules of all runs, module ID is index in the list
+    WORKERS_LOCK Lock;
+    std::vector<INPUT_MODULE> List;
+    std::map<std::string, COVDB_UINT32> ByKey;
+
+    // modules are identified by the file name instead of the full path
+    bool bByName;
+
+} INPUT_MODULES,
+*PINPUT_MODULES;
+
+typedef struct _INPUT_BLOCK
+{
+    COVDB_UINT32 Module;
+    COVDB_UINT64 Offset;
+    COVDB_UINT32 Size;
+    COVDB_UINT32 Instructions;
+    COVDB_UINT64 Count;
+
+} INPUT_BLOCK,
+*PINPUT_BLOCK;
+
+typedef struct _INPUT_ROUTINE
+{
+    COVDB_UINT32 Module;
+    COVDB_UINT64 Offset;
+    COVDB_UINT64 Count;
+
+} INPUT_ROUTINE,
+*PINPUT_ROUTINE;
+
+typedef struct _INPUT_CALL
+{
+    COVDB_UINT32 CallerModule;
+    COVDB_UINT64 CallerOffset;
+    COVDB_UINT32 CalleeModule;
+    COVDB_UINT64 CalleeOffset;
+    COVDB_UINT64 Count;
+
+} INPUT_CALL,
+*PINPUT_CALL;
+
+typedef struct _INPUT_COVERAGE
+{
+    // tables sorted by module ID and offset, each item is unique
+    std::vector<INPUT_BLOCK> Blocks;
+    std::vector<INPUT_ROUTINE> Routines;
+    std::vector<INPUT_CALL> Calls;
+
+} INPUT_COVERAGE,
+*PINPUT_COVERAGE;
+
+inline bool InputLess(const INPUT_BLOCK &First, const INPUT_BLOCK &Second)
+{
+    if (First.Module != Second.Module)
+    {
+        return First.Module < Second.Module;
+    }
+
+    return First.Offset < Second.Offset;
+}
+
+inline bool InputLess(const INPUT_ROUTINE &First, const INPUT_ROUTINE &Second)
+{
+    if (First.Module != Second.Module)
+    {
+        return First.Module < Second.Module;
+    }
+
+    return First.Offset < Second.Offset;
+}
+
+inline bool InputLess(const INPUT_CALL &First, const INPUT_CALL &Second)
+{
+    if (First.CallerModule != Second.CallerModule)
+    {
+        return First.CallerModule < Second.CallerModule;
+    }
+
+    if (First.CallerOffset != Second.CallerOffset)
+    {
+        return First.CallerOffset < Second.CallerOffset;
+    }
+
+    if (First.CalleeModule != Second.CalleeModule)
+    {
+        return First.CalleeModule < Second.CalleeModule;
+    }
+
+    return First.CalleeOffset < Second.CalleeOffset;
+}
+
+/**
+ * Sort the table by module ID and offset and sum counters of the same items.
+ */
+template <class T>
+void InputSort(std::vector<T> &Items)
+{
+    bool (* Less)(const T &, const T &) = InputLess;
+    size_t Count = 0;
+
+    // coverage database tables are already sorted
+    for (size_t i = 1; i < Items.size(); i++)
+    {
+        if (Less(Items[i], Items[i - 1]))
+        {
+            std::sort(Items.begin(), Items.end(), Less);
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < Items.size(); i++)
+    {
+        if (Count > 0 && !Less(Items[Count - 1], Items[i]))
+        {
+            Items[Count - 1].Count += Items[i].Count;
+        }
+        else
+        {
+            Items[Count++] = Items[i];
+        }
+    }
+
+    Items.resize(Count);
+}
+
+/**
+ * Load items of the inputs [First, Last) and reduce them with the binary counter
+ * of partial results: results of the same number of inputs are merged, so every
+ * item takes part in O(log N) merges only. Merge(First, Second) must merge Second
+ * into First (Second may be destroyed), the whole reduction is merged into Result.
+ */
+template <class T, class CONTEXT>
+void InputReduce(
+    CONTEXT Context, unsigned int First, unsigned int Last,
+    void (* Load)(CONTEXT, unsigned int, T &), void (* Merge)(T &, T &), T &Result)
+{
+    std::vector<T> Stack;
+    std::vector<unsigned int> Levels;
+
+    for (unsigned int i = First; i < Last; i++)
+    {
+        Stack.push_back(T());
+        Levels.push_back(1);
+
+        Load(Context, i, Stack.back());
+
+        while (Stack.size() > 1 && Levels[Levels.size() - 2] == Levels.back())
+        {
+            Merge(Stack[Stack.size() - 2], Stack.back());
+            Stack.pop_back();
+            Levels.pop_back();
+            Levels.back() *= 2;
+        }
+    }
+
+    // merge the rest of partial results, older results are on the bottom
+    while (Stack.size() > 1)
+    {
+        Merge(Stack[Stack.size() - 2], Stack.back());
+        Stack.pop_back();
+    }
+
+    if (Stack.size() > 0)
+    {
+        Merge(Result, Stack[0]);
+    }
+}
+
+/**
+ * Initialize or destroy modules list that is shared by the worker threads.
+ */
+void InputModulesInit(PINPUT_MODULES Modules, bool bByName);
+void InputModulesDestroy(PINPUT_MODULES Modules);
+
+/**
+ * Get module ID by its path, information of the run with the lowest index
+ * is kept, so the modules list doesn't depend on the threads timing.
+ */
+COVDB_UINT32 InputModuleId(
+    PINPUT_MODULES Modules, unsigned int Run,
+    const std::string &Path, COVDB_UINT64 Start, COVDB_UINT64 End
+);
+
+/**
+ * Sort modules list by path, Map receives old module ID -> new module ID.
+ */
+void InputModulesSort(PINPUT_MODULES Modules, std::vector<COVDB_UINT32> &Map);
+
+/**
+ * Remap module IDs of the coverage tables and sort them again.
+ */
+void InputRemap(PINPUT_COVERAGE Coverage, const std::vector<COVDB_UINT32> &Map);
+
+/**
+ * Load coverage of the single run: binary coverage database or snapshot, live
+ * counters file or base path of the text logs (<path>.modules, <path>.blocks
+ * and <path>.routines). Module IDs are allocated in Modules, that can be shared
+ * between the threads that are loading different runs.
+ */
+bool InputLoad(PINPUT_MODULES Modules, unsigned int Run, const char *lpszPath, PINPUT_COVERAGE Coverage);
+
+/**
+ * Read list of the input paths (one per line) from the text file, empty lines
+ * and lines that are starting from '#' are ignored.
+ */
+bool InputReadList(const char *lpszPath, std::vector<std::string> &Inputs);
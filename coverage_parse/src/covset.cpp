@@ -0,0 +1,254 @@
+#include "stdafx.h"
+
+// 64-bit constant from the repeated 32-bit pattern
+#define SET_PATTERN(_x_) (((COVDB_UINT64)(_x_) << 32) | (COVDB_UINT64)(_x_))
+
+#define SET_ONES ((COVDB_UINT64)-1)
+//--------------------------------------------------------------------------------------
+static inline unsigned int SetPopCount(COVDB_UINT64 Value)
+{
+
+#ifdef __GNUC__
+
+    return (unsigned int)__builtin_popcountll(Value);
+
+#else
+
+    // count bits of the whole 64-bit word in parallel
+    Value = Value - ((Value >> 1) & SET_PATTERN(0x55555555));
+    Value = (Value & SET_PATTERN(0x33333333)) + ((Value >> 2) & SET_PATTERN(0x33333333));
+    Value = (Value + (Value >> 4)) & SET_PATTERN(0x0f0f0f0f);
+
+    return (unsigned int)((Value * SET_PATTERN(0x01010101)) >> 56);
+
+#endif
+
+}
+//--------------------------------------------------------------------------------------
+static unsigned int SetCountRange(const COVDB_UINT64 *Words, unsigned int First, unsigned int Last)
+{
+    // count bits that are set in [First, Last] range
+    unsigned int FirstWord = First >> 6, LastWord = Last >> 6;
+    COVDB_UINT64 FirstMask = SET_ONES << (First & 63);
+    COVDB_UINT64 LastMask = SET_ONES >> (63 - (Last & 63));
+
+    if (FirstWord == LastWord)
+    {
+        return SetPopCount(Words[FirstWord] & FirstMask & LastMask);
+    }
+
+    unsigned int Count = SetPopCount(Words[FirstWord] & FirstMask) + SetPopCount(Words[LastWord] & LastMask);
+
+    for (unsigned int i = FirstWord + 1; i < LastWord; i++)
+    {
+        Count += SetPopCount(Words[i]);
+    }
+
+    return Count;
+}
+//--------------------------------------------------------------------------------------
+static void SetFillRange(COVDB_UINT64 *Words, unsigned int First, unsigned int Last)
+{
+    unsigned int FirstWord = First >> 6, LastWord = Last >> 6;
+    COVDB_UINT64 FirstMask = SET_ONES << (First & 63);
+    COVDB_UINT64 LastMask = SET_ONES >> (63 - (Last & 63));
+
+    if (FirstWord == LastWord)
+    {
+        Words[FirstWord] |= FirstMask & LastMask;
+        return;
+    }
+
+    Words[FirstWord] |= FirstMask;
+    Words[LastWord] |= LastMask;
+
+    for (unsigned int i = FirstWord + 1; i < LastWord; i++)
+    {
+        Words[i] = SET_ONES;
+    }
+}
+//--------------------------------------------------------------------------------------
+void SetBuild(PSET_BITMAP Set, const COVDB_UINT32 *Ids, size_t Count)
+{
+    Set->Containers.clear();
+    Set->Data.clear();
+    Set->Cardinality = (COVDB_UINT32)Count;
+
+    size_t i = 0;
+
+    while (i < Count)
+    {
+        SET_CONTAINER Container;
+        size_t n = i, Ranges = 0;
+
+        // find IDs of the current chunk and count ranges of the sequential IDs
+        while (n < Count && (Ids[n] >> 16) == (Ids[i] >> 16))
+        {
+            if (n == i || Ids[n] != Ids[n - 1] + 1)
+            {
+                Ranges += 1;
+            }
+
+            n += 1;
+        }
+
+        Container.Key = Ids[i] >> 16;
+        Container.Cardinality = (COVDB_UINT32)(n - i);
+        Container.Offset = (COVDB_UINT32)Set->Data.size();
+
+        // choose the smallest container
+        size_t ArraySize = Container.Cardinality * sizeof(SET_UINT16);
+        size_t RangesSize = Ranges * sizeof(SET_UINT16) * 2;
+        size_t BitsetSize = SET_BITSET_WORDS * sizeof(COVDB_UINT64);
+
+        if (RangesSize <= ArraySize && RangesSize < BitsetSize)
+        {
+            Container.Type = SET_CONTAINER_RANGES;
+            Container.Count = (COVDB_UINT32)Ranges;
+
+            Set->Data.resize(Container.Offset + (RangesSize + sizeof(COVDB_UINT64) - 1) / sizeof(COVDB_UINT64), 0);
+
+            SET_UINT16 *Values = (SET_UINT16 *)&Set->Data[Container.Offset];
+            size_t Range = 0;
+
+            for (size_t k = i; k < n; k++)
+            {
+                if (k == i || Ids[k] != Ids[k - 1] + 1)
+                {
+                    Values[Range * 2] = (SET_UINT16)Ids[k];
+                    Values[Range * 2 + 1] = 0;
+                    Range += 1;
+                }
+                else
+                {
+                    Values[Range * 2 - 1] += 1;
+                }
+            }
+        }
+        else if (ArraySize < BitsetSize)
+        {
+            Container.Type = SET_CONTAINER_ARRAY;
+            Container.Count = Container.Cardinality;
+
+            Set->Data.resize(Container.Offset + (ArraySize + sizeof(COVDB_UINT64) - 1) / sizeof(COVDB_UINT64), 0);
+
+            SET_UINT16 *Values = (SET_UINT16 *)&Set->Data[Container.Offset];
+
+            for (size_t k = i; k < n; k++)
+            {
+                Values[k - i] = (SET_UINT16)Ids[k];
+            }
+        }
+        else
+        {
+            Container.Type = SET_CONTAINER_BITSET;
+            Container.Count = SET_BITSET_WORDS;
+
+            Set->Data.resize(Container.Offset + SET_BITSET_WORDS, 0);
+
+            COVDB_UINT64 *Words = &Set->Data[Container.Offset];
+
+            for (size_t k = i; k < n; k++)
+            {
+                Words[(Ids[k] & 0xffff) >> 6] |= (COVDB_UINT64)1 << (Ids[k] & 63);
+            }
+        }
+
+        Set->Containers.push_back(Container);
+
+        i = n;
+    }
+
+    // release unused memory of the vectors
+    std::vector<SET_CONTAINER>(Set->Containers).swap(Set->Containers);
+    std::vector<COVDB_UINT64>(Set->Data).swap(Set->Data);
+}
+//--------------------------------------------------------------------------------------
+COVDB_UINT32 SetCountNew(PSET_BITMAP Set, const COVDB_UINT64 *Bitset)
+{
+    COVDB_UINT32 Count = 0;
+
+    for (size_t i = 0; i < Set->Containers.size(); i++)
+    {
+        PSET_CONTAINER Container = &Set->Containers[i];
+
+        // bitset words of the same chunk
+        const COVDB_UINT64 *Words = Bitset + (size_t)Container->Key * SET_BITSET_WORDS;
+
+        if (Container->Type == SET_CONTAINER_BITSET)
+        {
+            const COVDB_UINT64 *Data = &Set->Data[Container->Offset];
+
+            for (unsigned int n = 0; n < SET_BITSET_WORDS; n++)
+            {
+                Count += SetPopCount(Data[n] & ~Words[n]);
+            }
+        }
+        else if (Container->Type == SET_CONTAINER_ARRAY)
+        {
+            const SET_UINT16 *Values = (const SET_UINT16 *)&Set->Data[Container->Offset];
+
+            for (COVDB_UINT32 n = 0; n < Container->Count; n++)
+            {
+                Count += (COVDB_UINT32)(~Words[Values[n] >> 6] >> (Values[n] & 63)) & 1;
+            }
+        }
+        else
+        {
+            const SET_UINT16 *Values = (const SET_UINT16 *)&Set->Data[Container->Offset];
+
+            for (COVDB_UINT32 n = 0; n < Container->Count; n++)
+            {
+                unsigned int First = Values[n * 2], Last = First + Values[n * 2 + 1];
+
+                Count += Last - First + 1 - SetCountRange(Words, First, Last);
+            }
+        }
+    }
+
+    return Count;
+}
+//--------------------------------------------------------------------------------------
+void SetAddTo(PSET_BITMAP Set, COVDB_UINT64 *Bitset)
+{
+    for (size_t i = 0; i < Set->Containers.size(); i++)
+    {
+        PSET_CONTAINER Container = &Set->Containers[i];
+        COVDB_UINT64 *Words = Bitset + (size_t)Container->Key * SET_BITSET_WORDS;
+
+        if (Container->Type == SET_CONTAINER_BITSET)
+        {
+            const COVDB_UINT64 *Data = &Set->Data[Container->Offset];
+
+            for (unsigned int n = 0; n < SET_BITSET_WORDS; n++)
+            {
+                Words[n] |= Data[n];
+            }
+        }
+        else if (Container->Type == SET_CONTAINER_ARRAY)
+        {
+            const SET_UINT16 *Values = (const SET_UINT16 *)&Set->Data[Container->Offset];
+
+            for (COVDB_UINT32 n = 0; n < Container->Count; n++)
+            {
+                Words[Values[n] >> 6] |= (COVDB_UINT64)1 << (Values[n] & 63);
+            }
+        }
+        else
+        {
+            const SET_UINT16 *Values = (const SET_UINT16 *)&Set->Data[Container->Offset];
+
+            for (COVDB_UINT32 n = 0; n < Container->Count; n++)
+            {
+                SetFillRange(Words, Values[n * 2], Values[n * 2] + Values[n * 2 + 1]);
+            }
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+size_t SetSize(PSET_BITMAP Set)
+{
+    return Set->Containers.size() * sizeof(SET_CONTAINER) + Set->Data.size() * sizeof(COVDB_UINT64);
+}
+//--------------------------------------------------------------------------------------
+// EoF
@@ -0,0 +1,63 @@
+
+/*
+    Compressed sets of 32-bit element IDs (basic blocks, call edges, etc.),
+    IDs are splitted into the 64K chunks by their high 16 bits, each chunk
+    is stored in the smallest of the containers: sorted array of the low 16
+    bits, bitset or the list of ID ranges.
+*/
+
+#define SET_CONTAINER_ARRAY     0   // SET_UINT16 sorted values
+#define SET_CONTAINER_BITSET    1   // SET_BITSET_WORDS of COVDB_UINT64
+#define SET_CONTAINER_RANGES    2   // SET_UINT16 pairs of the first value and length - 1
+
+#define SET_CHUNK_SIZE          0x10000
+#define SET_BITSET_WORDS        (SET_CHUNK_SIZE / 64)
+
+typedef unsigned short SET_UINT16;
+
+typedef struct _SET_CONTAINER
+{
+    // high 16 bits of the container IDs
+    COVDB_UINT32 Key;
+
+    COVDB_UINT32 Type;
+    COVDB_UINT32 Cardinality;
+
+    // location in SET_BITMAP::Data (in 64-bit words) and number of array values or ranges
+    COVDB_UINT32 Offset;
+    COVDB_UINT32 Count;
+
+} SET_CONTAINER,
+*PSET_CONTAINER;
+
+typedef struct _SET_BITMAP
+{
+    std::vector<SET_CONTAINER> Containers;
+    std::vector<COVDB_UINT64> Data;
+
+    // total number of IDs
+    COVDB_UINT32 Cardinality;
+
+} SET_BITMAP,
+*PSET_BITMAP;
+
+/**
+ * Build the set from the sorted list of unique IDs.
+ */
+void SetBuild(PSET_BITMAP Set, const COVDB_UINT32 *Ids, size_t Count);
+
+/**
+ * Count IDs of the set that are not present in the plain bitset of the whole
+ * IDs space, bitset size must be multiple of SET_CHUNK_SIZE bits.
+ */
+COVDB_UINT32 SetCountNew(PSET_BITMAP Set, const COVDB_UINT64 *Bitset);
+
+/**
+ * Add all of the set IDs into the plain bitset of the whole IDs space.
+ */
+void SetAddTo(PSET_BITMAP Set, COVDB_UINT64 *Bitset);
+
+/**
+ * Get size of the set data in bytes.
+ */
+size_t SetSize(PSET_BITMAP Set);
@@ -0,0 +1,9 @@
+#ifdef DBG
+
+void DbgMsg(const char *lpszFile, int Line, const char *lpszMsg, ...);
+
+#else
+
+#define DbgMsg
+
+#endif
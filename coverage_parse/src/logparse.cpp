@@ -0,0 +1,722 @@
+#include "stdafx.h"
+
+typedef struct _WORKER_PARAMS
+{
+    WORKER_ROUTINE Routine;
+    void *Param;
+    unsigned int Index;
+    unsigned int Count;
+
+} WORKER_PARAMS,
+*PWORKER_PARAMS;
+
+typedef struct _PARSE_PARAMS
+{
+    PLOG_FILE Log;
+    LOG_TYPE Type;
+
+    // chunks boundaries and parsed entries of each chunk
+    std::vector<size_t> Bounds;
+    std::vector<LOG_ENTRIES> Chunks;
+
+} PARSE_PARAMS,
+*PPARSE_PARAMS;
+
+typedef struct _SORT_PARAMS
+{
+    // entries are not copied during the sort, only the pointers to them
+    std::vector<PLOG_ENTRY> Entries;
+    bool bByCalls;
+
+    // sorted ranges boundaries, ranges 2*i and 2*i+1 are merged at each pass
+    std::vector<size_t> Bounds;
+
+} SORT_PARAMS,
+*PSORT_PARAMS;
+
+// hex digit values, -1 for invalid characters
+static const signed char m_HexDigits[0x100] =
+{
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+//--------------------------------------------------------------------------------------
+unsigned int WorkersCount(void)
+{
+    unsigned int Count = 1;
+
+#ifdef _WIN32
+
+    SYSTEM_INFO Info;
+    GetSystemInfo(&Info);
+    Count = Info.dwNumberOfProcessors;
+
+#else
+
+    long Processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (Processors > 0)
+    {
+        Count = (unsigned int)Processors;
+    }
+
+#endif
+
+    return std::max(1u, std::min(Count, (unsigned int)LOG_MAX_THREADS));
+}
+//--------------------------------------------------------------------------------------
+#ifdef _WIN32
+
+static DWORD WINAPI WorkerThread(LPVOID lpParam)
+
+#else
+
+static void *WorkerThread(void *lpParam)
+
+#endif
+{
+    PWORKER_PARAMS Params = (PWORKER_PARAMS)lpParam;
+
+    Params->Routine(Params->Param, Params->Index, Params->Count);
+
+    return 0;
+}
+//--------------------------------------------------------------------------------------
+void WorkersRun(WORKER_ROUTINE Routine, void *Param, unsigned int Count)
+{
+    WORKER_PARAMS Params[LOG_MAX_THREADS];
+    bool bStarted[LOG_MAX_THREADS];
+
+    Count = std::min(Count, (unsigned int)LOG_MAX_THREADS);
+
+#ifdef _WIN32
+
+    HANDLE hThreads[LOG_MAX_THREADS];
+
+#else
+
+    pthread_t Threads[LOG_MAX_THREADS];
+
+#endif
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        Params[i].Routine = Routine;
+        Params[i].Param = Param;
+        Params[i].Index = i;
+        Params[i].Count = Count;
+
+        // the first worker runs in the current thread
+        bStarted[i] = false;
+
+        if (i == 0)
+        {
+            continue;
+        }
+
+#ifdef _WIN32
+
+        hThreads[i] = CreateThread(NULL, 0, WorkerThread, &Params[i], 0, NULL);
+        bStarted[i] = (hThreads[i] != NULL);
+
+#else
+
+        bStarted[i] = (pthread_create(&Threads[i], NULL, WorkerThread, &Params[i]) == 0);
+
+#endif
+
+        if (!bStarted[i])
+        {
+            DbgMsg(__FILE__, __LINE__, "Unable to start worker thread\n");
+        }
+    }
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        if (!bStarted[i])
+        {
+            // run this worker in the current thread
+            WorkerThread(&Params[i]);
+        }
+    }
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        if (!bStarted[i])
+        {
+            continue;
+        }
+
+#ifdef _WIN32
+
+        WaitForSingleObject(hThreads[i], INFINITE);
+        CloseHandle(hThreads[i]);
+
+#else
+
+        pthread_join(Threads[i], NULL);
+
+#endif
+
+    }
+}
+//--------------------------------------------------------------------------------------
+void WorkersLockInit(PWORKERS_LOCK Lock)
+{
+#ifdef _WIN32
+
+    InitializeCriticalSection(&Lock->Section);
+
+#else
+
+    pthread_mutex_init(&Lock->Mutex, NULL);
+
+#endif
+}
+//--------------------------------------------------------------------------------------
+void WorkersLockDestroy(PWORKERS_LOCK Lock)
+{
+#ifdef _WIN32
+
+    DeleteCriticalSection(&Lock->Section);
+
+#else
+
+    pthread_mutex_destroy(&Lock->Mutex);
+
+#endif
+}
+//--------------------------------------------------------------------------------------
+void WorkersLockAcquire(PWORKERS_LOCK Lock)
+{
+#ifdef _WIN32
+
+    EnterCriticalSection(&Lock->Section);
+
+#else
+
+    pthread_mutex_lock(&Lock->Mutex);
+
+#endif
+}
+//--------------------------------------------------------------------------------------
+void WorkersLockRelease(PWORKERS_LOCK Lock)
+{
+#ifdef _WIN32
+
+    LeaveCriticalSection(&Lock->Section);
+
+#else
+
+    pthread_mutex_unlock(&Lock->Mutex);
+
+#endif
+}
+//--------------------------------------------------------------------------------------
+std::string LogStringLower(const std::string &Str)
+{
+    std::string Ret(Str);
+
+    for (size_t i = 0; i < Ret.size(); i++)
+    {
+        Ret[i] = (char)tolower((unsigned char)Ret[i]);
+    }
+
+    return Ret;
+}
+//--------------------------------------------------------------------------------------
+void LogModulesFilter(const char *lpszList, std::vector<std::string> &Filter)
+{
+    std::string List = lpszList;
+    size_t Pos = 0;
+
+    while (Pos != std::string::npos)
+    {
+        size_t Next = List.find(',', Pos);
+        std::string Name = List.substr(Pos, Next == std::string::npos ? Next : Next - Pos);
+
+        Name.erase(0, Name.find_first_not_of(" \t\r\n"));
+        Filter.push_back(LogStringLower(Name));
+
+        printf("Filtering by module name \"%s\"\n", Name.c_str());
+
+        Pos = Next == std::string::npos ? Next : Next + 1;
+    }
+}
+//--------------------------------------------------------------------------------------
+static bool ModuleIsSkipped(const std::string &ModuleName, const std::vector<std::string> &Filter)
+{
+    if (Filter.size() == 0)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < Filter.size(); i++)
+    {
+        if (ModuleName.find(Filter[i]) != std::string::npos)
+        {
+            // don't skip this module
+            return false;
+        }
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+bool LogReadModules(const char *lpszPath, const std::vector<std::string> &Filter, LOG_MODULES &Modules)
+{
+    FILE *f = fopen(lpszPath, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    std::string Line;
+    char szBuff[0x1000];
+
+    // read file contents line by line
+    while (fgets(szBuff, sizeof(szBuff), f))
+    {
+        Line += szBuff;
+
+        if (Line.size() == 0 || (Line[Line.size() - 1] != '\n' && !feof(f)))
+        {
+            // read the rest of the long line
+            continue;
+        }
+
+        Line.erase(std::remove(Line.begin(), Line.end(), '\r'), Line.end());
+        Line.erase(std::remove(Line.begin(), Line.end(), '\n'), Line.end());
+
+        // <id>:<start>:<end>:<load>:<unload>:<path>, path might contain ':'
+        size_t Pos = 0;
+
+        for (int i = 0; i < 5 && Pos != std::string::npos; i++)
+        {
+            Pos = Line.find(':', Pos);
+            Pos = Pos == std::string::npos ? Pos : Pos + 1;
+        }
+
+        if (Line.size() > 0 && Line[0] != '#' && Pos != std::string::npos)
+        {
+            LOG_MODULE Module;
+            Module.Path = Line.substr(Pos);
+
+            size_t NamePos = Module.Path.find_last_of("\\/");
+            Module.Name = NamePos == std::string::npos ? Module.Path : Module.Path.substr(NamePos + 1);
+
+            Module.bSkip = ModuleIsSkipped(LogStringLower(Module.Name), Filter);
+            Module.Processed = 0;
+
+            Modules[atoi(Line.c_str())] = Module;
+        }
+
+        Line.clear();
+    }
+
+    fclose(f);
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+bool LogOpen(PLOG_FILE Log, const char *lpszPath)
+{
+    memset(Log, 0, sizeof(LOG_FILE));
+    Log->fd = -1;
+
+#ifdef _WIN32
+
+    HANDLE hFile = CreateFileA(
+        lpszPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER Size;
+    if (!GetFileSizeEx(hFile, &Size) || (LOG_UINT64)Size.QuadPart > (SIZE_T)-1)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    Log->hFile = hFile;
+    Log->Size = (size_t)Size.QuadPart;
+
+    if (Log->Size == 0)
+    {
+        // empty files can't be mapped
+        return true;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    const char *Data = (const char *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (Data == NULL)
+    {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+
+    Log->hMapping = hMapping;
+    Log->Data = Data;
+
+#else
+
+    int fd = open(lpszPath, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat Stat;
+    if (fstat(fd, &Stat) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    Log->fd = fd;
+    Log->Size = (size_t)Stat.st_size;
+
+    if (Log->Size == 0)
+    {
+        // empty files can't be mapped
+        return true;
+    }
+
+    void *Data = mmap(NULL, Log->Size, PROT_READ, MAP_SHARED, fd, 0);
+    if (Data == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    Log->Data = (const char *)Data;
+
+#endif
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+void LogClose(PLOG_FILE Log)
+{
+#ifdef _WIN32
+
+    if (Log->Data)
+    {
+        UnmapViewOfFile(Log->Data);
+    }
+
+    if (Log->hMapping)
+    {
+        CloseHandle((HANDLE)Log->hMapping);
+    }
+
+    if (Log->hFile)
+    {
+        CloseHandle((HANDLE)Log->hFile);
+    }
+
+#else
+
+    if (Log->Data)
+    {
+        munmap((void *)Log->Data, Log->Size);
+    }
+
+    if (Log->fd >= 0)
+    {
+        close(Log->fd);
+    }
+
+#endif
+
+    memset(Log, 0, sizeof(LOG_FILE));
+    Log->fd = -1;
+}
+//--------------------------------------------------------------------------------------
+LOG_UINT64 LogParseHex(const char *Ptr, const char *End)
+{
+    LOG_UINT64 Value = 0;
+
+    if (End - Ptr > 2 && Ptr[0] == '0' && (Ptr[1] == 'x' || Ptr[1] == 'X'))
+    {
+        Ptr += 2;
+    }
+
+    for (; Ptr < End; Ptr++)
+    {
+        int Digit = m_HexDigits[(unsigned char)*Ptr];
+        if (Digit < 0)
+        {
+            break;
+        }
+
+        Value = (Value << 4) | Digit;
+    }
+
+    return Value;
+}
+//--------------------------------------------------------------------------------------
+LOG_INT64 LogParseDec(const char *Ptr, const char *End)
+{
+    LOG_INT64 Value = 0;
+    bool bNegative = false;
+
+    if (Ptr < End && *Ptr == '-')
+    {
+        bNegative = true;
+        Ptr += 1;
+    }
+
+    for (; Ptr < End && *Ptr >= '0' && *Ptr <= '9'; Ptr++)
+    {
+        Value = Value * 10 + (*Ptr - '0');
+    }
+
+    return bNegative ? -Value : Value;
+}
+//--------------------------------------------------------------------------------------
+static void ParseChunk(void *Param, unsigned int Index, unsigned int /* Count */)
+{
+    PPARSE_PARAMS Params = (PPARSE_PARAMS)Param;
+    LOG_ENTRIES &Entries = Params->Chunks[Index];
+
+    const char *Ptr = Params->Log->Data + Params->Bounds[Index];
+    const char *End = Params->Log->Data + Params->Bounds[Index + 1];
+
+    // number of fields in the log line
+    const unsigned int FieldsCount = Params->Type == LOG_BLOCKS ? 6 : 4;
+
+    while (Ptr < End)
+    {
+        const char *Line = Ptr;
+        const char *LineEnd = (const char *)memchr(Ptr, '\n', End - Ptr);
+
+        if (LineEnd == NULL)
+        {
+            LineEnd = End;
+        }
+
+        Ptr = LineEnd + 1;
+
+        if (*Line == '#')
+        {
+            // comment line
+            continue;
+        }
+
+        const char *Fields[6 + 1];
+        unsigned int Found = 0;
+
+        // split line by ':' characters
+        Fields[Found++] = Line;
+
+        for (const char *p = Line; p < LineEnd && Found <= FieldsCount; p++)
+        {
+            if (*p == ':')
+            {
+                Fields[Found++] = p + 1;
+            }
+        }
+
+        if (Found < FieldsCount)
+        {
+            continue;
+        }
+
+        // end of the last used field
+        Fields[FieldsCount] = Found > FieldsCount ? Fields[FieldsCount] - 1 : LineEnd;
+
+        LOG_ENTRY Entry;
+
+        Entry.Address = LogParseHex(Fields[0], Fields[1] - 1);
+
+        if (Params->Type == LOG_BLOCKS)
+        {
+            Entry.Size = (unsigned int)LogParseHex(Fields[1], Fields[2] - 1);
+            Entry.Instructions = (unsigned int)LogParseDec(Fields[2], Fields[3] - 1);
+            Entry.Module = (int)LogParseDec(Fields[3], Fields[4] - 1);
+            Entry.Offset = LogParseHex(Fields[4], Fields[5] - 1);
+            Entry.Calls = LogParseDec(Fields[5], Fields[6]);
+        }
+        else
+        {
+            Entry.Size = Entry.Instructions = 0;
+            Entry.Module = (int)LogParseDec(Fields[1], Fields[2] - 1);
+            Entry.Offset = LogParseHex(Fields[2], Fields[3] - 1);
+            Entry.Calls = LogParseDec(Fields[3], Fields[4]);
+        }
+
+        Entries.push_back(Entry);
+    }
+}
+//--------------------------------------------------------------------------------------
+void LogParse(PLOG_FILE Log, LOG_TYPE Type, LOG_ENTRIES &Entries)
+{
+    PARSE_PARAMS Params;
+
+    // small logs are not worth of splitting
+    unsigned int Count = std::max(1u, std::min(WorkersCount(), (unsigned int)(Log->Size / LOG_MIN_CHUNK)));
+
+    Params.Log = Log;
+    Params.Type = Type;
+    Params.Chunks.resize(Count);
+    Params.Bounds.push_back(0);
+
+    for (unsigned int i = 1; i < Count; i++)
+    {
+        size_t Bound = std::max(Params.Bounds.back(), Log->Size / Count * i);
+
+        // move chunk boundary to the beginning of the next line
+        while (Bound > 0 && Bound < Log->Size && Log->Data[Bound - 1] != '\n')
+        {
+            Bound += 1;
+        }
+
+        Params.Bounds.push_back(Bound);
+    }
+
+    Params.Bounds.push_back(Log->Size);
+
+    WorkersRun(ParseChunk, &Params, Count);
+
+    size_t Total = 0;
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        Total += Params.Chunks[i].size();
+    }
+
+    Entries.clear();
+    Entries.reserve(Total);
+
+    // join chunks in the file order
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        Entries.insert(Entries.end(), Params.Chunks[i].begin(), Params.Chunks[i].end());
+        LOG_ENTRIES().swap(Params.Chunks[i]);
+    }
+}
+//--------------------------------------------------------------------------------------
+static bool EntryLessByName(const PLOG_ENTRY First, const PLOG_ENTRY Second)
+{
+    return First->SortKey < Second->SortKey;
+}
+//--------------------------------------------------------------------------------------
+static bool EntryLessByCalls(const PLOG_ENTRY First, const PLOG_ENTRY Second)
+{
+    return First->Calls > Second->Calls;
+}
+//--------------------------------------------------------------------------------------
+static void SortRange(void *Param, unsigned int Index, unsigned int /* Count */)
+{
+    PSORT_PARAMS Params = (PSORT_PARAMS)Param;
+    std::vector<PLOG_ENTRY>::iterator Begin = Params->Entries.begin();
+
+    std::stable_sort(
+        Begin + Params->Bounds[Index], Begin + Params->Bounds[Index + 1],
+        Params->bByCalls ? EntryLessByCalls : EntryLessByName
+    );
+}
+//--------------------------------------------------------------------------------------
+static void MergeRanges(void *Param, unsigned int Index, unsigned int /* Count */)
+{
+    PSORT_PARAMS Params = (PSORT_PARAMS)Param;
+    std::vector<PLOG_ENTRY>::iterator Begin = Params->Entries.begin();
+
+    // merge ranges 2*Index and 2*Index+1, odd range at the end stays as is
+    if (Index * 2 + 2 < Params->Bounds.size())
+    {
+        std::inplace_merge(
+            Begin + Params->Bounds[Index * 2],
+            Begin + Params->Bounds[Index * 2 + 1],
+            Begin + Params->Bounds[Index * 2 + 2],
+            Params->bByCalls ? EntryLessByCalls : EntryLessByName
+        );
+    }
+}
+//--------------------------------------------------------------------------------------
+void LogSort(LOG_ENTRIES &Entries, bool bByCalls)
+{
+    SORT_PARAMS Params;
+    unsigned int Count = std::max(1u, std::min(WorkersCount(), (unsigned int)(Entries.size() / 0x1000)));
+
+    Params.bByCalls = bByCalls;
+    Params.Entries.reserve(Entries.size());
+
+    for (size_t i = 0; i < Entries.size(); i++)
+    {
+        Params.Entries.push_back(&Entries[i]);
+    }
+
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        Params.Bounds.push_back(Entries.size() / Count * i);
+    }
+
+    Params.Bounds.push_back(Entries.size());
+
+    // sort the ranges in parallel
+    WorkersRun(SortRange, &Params, Count);
+
+    // merge sorted ranges pairwise until the single range left
+    while (Params.Bounds.size() > 2)
+    {
+        unsigned int Ranges = (unsigned int)Params.Bounds.size() - 1;
+
+        WorkersRun(MergeRanges, &Params, (Ranges + 1) / 2);
+
+        std::vector<size_t> Bounds;
+
+        for (unsigned int i = 0; i < Ranges; i += 2)
+        {
+            Bounds.push_back(Params.Bounds[i]);
+        }
+
+        Bounds.push_back(Entries.size());
+        Params.Bounds.swap(Bounds);
+    }
+
+    LOG_ENTRIES Sorted(Entries.size());
+
+    // move entries into the sorted order, strings are swapped instead of copying
+    for (size_t i = 0; i < Sorted.size(); i++)
+    {
+        PLOG_ENTRY Entry = Params.Entries[i];
+
+        Sorted[i].Module = Entry->Module;
+        Sorted[i].Offset = Entry->Offset;
+        Sorted[i].Calls = Entry->Calls;
+        Sorted[i].Size = Entry->Size;
+        Sorted[i].Instructions = Entry->Instructions;
+        Sorted[i].Name.swap(Entry->Name);
+        Sorted[i].SortKey.swap(Entry->SortKey);
+    }
+
+    Entries.swap(Sorted);
+}
+//--------------------------------------------------------------------------------------
+// EoF
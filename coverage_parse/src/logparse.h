@@ -0,0 +1,156 @@
+
+#ifdef _MSC_VER
+typedef unsigned __int64 LOG_UINT64;
+typedef __int64 LOG_INT64;
+#else
+typedef unsigned long long LOG_UINT64;
+typedef long long LOG_INT64;
+#endif
+
+// module ID of the entries that doesn't belong to any known module
+#define LOG_MODULE_UNKNOWN -1
+
+// max. number of worker threads
+#define LOG_MAX_THREADS 0x40
+
+// min. size of the log file chunk that is parsed by the single thread
+#define LOG_MIN_CHUNK 0x100000
+
+typedef struct _LOG_FILE
+{
+    // mapped file
+    void *hFile;
+    void *hMapping;
+    int fd;
+
+    const char *Data;
+    size_t Size;
+
+} LOG_FILE,
+*PLOG_FILE;
+
+typedef struct _LOG_MODULE
+{
+    std::string Path;
+    std::string Name;
+
+    // module doesn't match the --modules filter
+    bool bSkip;
+
+    // number of log entries that belongs to the module
+    unsigned int Processed;
+
+} LOG_MODULE,
+*PLOG_MODULE;
+
+typedef std::map<int, LOG_MODULE> LOG_MODULES;
+
+typedef struct _LOG_ENTRY
+{
+    // parsed log fields
+    LOG_UINT64 Address;
+    int Module;
+    LOG_UINT64 Offset;
+    LOG_INT64 Calls;
+    unsigned int Size;
+    unsigned int Instructions;
+
+    // symbol name and its lower case version for sorting
+    std::string Name;
+    std::string SortKey;
+
+} LOG_ENTRY,
+*PLOG_ENTRY;
+
+typedef std::vector<LOG_ENTRY> LOG_ENTRIES;
+
+typedef enum _LOG_TYPE
+{
+    LOG_BLOCKS,     // <address>:<size>:<instructions>:<module>:<offset>:<calls>
+    LOG_ROUTINES    // <address>:<module>:<offset>:<calls>
+
+} LOG_TYPE;
+
+typedef struct _WORKERS_LOCK
+{
+
+#ifdef _WIN32
+
+    CRITICAL_SECTION Section;
+
+#else
+
+    pthread_mutex_t Mutex;
+
+#endif
+
+} WORKERS_LOCK,
+*PWORKERS_LOCK;
+
+typedef void (* WORKER_ROUTINE)(void *Param, unsigned int Index, unsigned int Count);
+
+/**
+ * Get number of worker threads to use.
+ */
+unsigned int WorkersCount(void);
+
+/**
+ * Call Routine(Param, Index, Count) for every Index in [0, Count)
+ * in separate threads and wait for their termination.
+ */
+void WorkersRun(WORKER_ROUTINE Routine, void *Param, unsigned int Count);
+
+/**
+ * Lock to synchronize worker threads.
+ */
+void WorkersLockInit(PWORKERS_LOCK Lock);
+void WorkersLockDestroy(PWORKERS_LOCK Lock);
+void WorkersLockAcquire(PWORKERS_LOCK Lock);
+void WorkersLockRelease(PWORKERS_LOCK Lock);
+
+/**
+ * Convert the string to lower case.
+ */
+std::string LogStringLower(const std::string &Str);
+
+/**
+ * Parse comma separated list of the --modules option, names are stored
+ * in lower case.
+ */
+void LogModulesFilter(const char *lpszList, std::vector<std::string> &Filter);
+
+/**
+ * Read modules log, module is skipped when the filter is not empty and
+ * the module name doesn't contain any of the filter strings.
+ */
+bool LogReadModules(const char *lpszPath, const std::vector<std::string> &Filter, LOG_MODULES &Modules);
+
+/**
+ * Decode hexadecimal (with optional 0x prefix) or decimal number, parsing
+ * stops at the first invalid character or at the End.
+ */
+LOG_UINT64 LogParseHex(const char *Ptr, const char *End);
+LOG_INT64 LogParseDec(const char *Ptr, const char *End);
+
+/**
+ * Map the whole log file into the memory.
+ */
+bool LogOpen(PLOG_FILE Log, const char *lpszPath);
+
+/**
+ * Unmap the log file.
+ */
+void LogClose(PLOG_FILE Log);
+
+/**
+ * Parse basic blocks or routines log, the file is splitted into the chunks
+ * at lines boundaries, that are parsed in parallel. Entries are returned in
+ * the log file order.
+ */
+void LogParse(PLOG_FILE Log, LOG_TYPE Type, LOG_ENTRIES &Entries);
+
+/**
+ * Stable parallel sort of the log entries by the symbol name (case
+ * insensitive) or by the number of calls (descending).
+ */
+void LogSort(LOG_ENTRIES &Entries, bool bByCalls);
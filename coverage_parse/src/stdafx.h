@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <DbgHelp.h>
+
+#else
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#endif
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iterator>
+
+#include "../../covdb/src/covdb.h"
+#include "../../covdb/src/covlive.h"
+
+#include "logparse.h"
+#include "symbols.h"
+#include "covinput.h"
+#include "covset.h"
+#include "debug.h"
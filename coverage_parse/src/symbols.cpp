@@ -0,0 +1,218 @@
+#include "stdafx.h"
+
+// fake load address of the module symbols
+#define SYMBOLS_MODULE_BASE 0x10000000
+//--------------------------------------------------------------------------------------
+static bool SymbolLess(const SYMBOL &First, const SYMBOL &Second)
+{
+    if (First.Offset != Second.Offset)
+    {
+        return First.Offset < Second.Offset;
+    }
+
+    return strcmp(First.Name.c_str(), Second.Name.c_str()) < 0;
+}
+//--------------------------------------------------------------------------------------
+static bool SymbolSameOffset(const SYMBOL &First, const SYMBOL &Second)
+{
+    return First.Offset == Second.Offset;
+}
+//--------------------------------------------------------------------------------------
+static bool EntryLessByOffset(const PLOG_ENTRY First, const PLOG_ENTRY Second)
+{
+    return First->Offset < Second->Offset;
+}
+//--------------------------------------------------------------------------------------
+#ifdef _WIN32
+
+static BOOL CALLBACK SymbolsEnumHandler(
+    PSYMBOL_INFO pSymInfo,
+    ULONG SymbolSize,
+    PVOID UserContext)
+{
+    SYMBOLS_TABLE *Symbols = (SYMBOLS_TABLE *)UserContext;
+
+    if (pSymInfo->Address > SYMBOLS_MODULE_BASE)
+    {
+        SYMBOL Symbol;
+        Symbol.Offset = pSymInfo->Address - SYMBOLS_MODULE_BASE;
+        Symbol.Name = std::string(pSymInfo->Name);
+
+        Symbols->push_back(Symbol);
+    }
+
+    return TRUE;
+}
+
+#endif
+//--------------------------------------------------------------------------------------
+bool SymbolsInit(void)
+{
+
+#ifdef _WIN32
+
+    char szSymbolsPath[MAX_PATH * 3], szSymbolsDir[MAX_PATH];
+    GetCurrentDirectoryA(MAX_PATH - 1, szSymbolsDir);
+    strcat(szSymbolsDir, "\\symbols");
+
+    // create directory for debug symbols
+    CreateDirectoryA(szSymbolsDir, NULL);
+
+    sprintf(
+        szSymbolsPath,
+        "%s;SRV*%s*http://msdl.microsoft.com/download/symbols",
+        szSymbolsDir, szSymbolsDir
+    );
+
+    // set symbol path and initialize symbol server client
+    if (!SymInitialize(GetCurrentProcess(), szSymbolsPath, FALSE))
+    {
+        DbgMsg(__FILE__, __LINE__, "SymInitialize() ERROR %d\n", GetLastError());
+        return false;
+    }
+
+    DbgMsg(__FILE__, __LINE__, "Symbols path is \"%s\"\n", szSymbolsPath);
+
+    return true;
+
+#else
+
+    // debug symbols are supported only on Windows
+    return false;
+
+#endif
+
+}
+//--------------------------------------------------------------------------------------
+bool SymbolsLoad(const char *lpszPath, SYMBOLS_TABLE &Symbols)
+{
+    Symbols.clear();
+
+#ifdef _WIN32
+
+    HANDLE hProcess = GetCurrentProcess();
+
+    if (!SymLoadModuleEx(hProcess, NULL, lpszPath, NULL, SYMBOLS_MODULE_BASE, 0, NULL, 0))
+    {
+        DbgMsg(__FILE__, __LINE__, "SymLoadModuleEx() ERROR %d\n", GetLastError());
+        return false;
+    }
+
+    if (!SymEnumSymbols(hProcess, SYMBOLS_MODULE_BASE, NULL, SymbolsEnumHandler, &Symbols))
+    {
+        DbgMsg(__FILE__, __LINE__, "SymEnumSymbols() ERROR %d\n", GetLastError());
+    }
+
+    // all of the modules are using the same base address
+    SymUnloadModule64(hProcess, SYMBOLS_MODULE_BASE);
+
+    DbgMsg(__FILE__, __LINE__, "%d symbols loaded for \"%s\"\n", Symbols.size(), lpszPath);
+
+#else
+
+    // debug symbols are supported only on Windows
+    (void)lpszPath;
+
+#endif
+
+    // keep only the first symbol by name for each offset
+    std::sort(Symbols.begin(), Symbols.end(), SymbolLess);
+    Symbols.erase(std::unique(Symbols.begin(), Symbols.end(), SymbolSameOffset), Symbols.end());
+
+    return Symbols.size() > 0;
+}
+//--------------------------------------------------------------------------------------
+void SymbolsResolve(
+    const SYMBOLS_TABLE &Symbols, const char *lpszModule,
+    PLOG_ENTRY *Entries, size_t Count)
+{
+    std::stable_sort(Entries, Entries + Count, EntryLessByOffset);
+
+    // index of the symbol that follows the best one
+    size_t Next = 0;
+
+    for (size_t i = 0; i < Count; i++)
+    {
+        PLOG_ENTRY Entry = Entries[i];
+        char szName[0x20];
+
+        while (Next < Symbols.size() && Symbols[Next].Offset <= Entry->Offset)
+        {
+            Next += 1;
+        }
+
+        if (Next > 0)
+        {
+            const SYMBOL &Symbol = Symbols[Next - 1];
+            unsigned long Delta = (unsigned long)(Entry->Offset - Symbol.Offset);
+
+            Entry->Name = std::string(lpszModule) + "!" + Symbol.Name;
+
+            if (Delta > 0)
+            {
+                sprintf(szName, "+0x%lx", Delta);
+                Entry->Name += szName;
+            }
+        }
+        else
+        {
+            sprintf(szName, "+%llx", (unsigned long long)Entry->Offset);
+            Entry->Name = std::string(lpszModule) + szName;
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+typedef struct _RESOLVE_PARAMS
+{
+    MODULE_ENTRIES_LIST *List;
+    bool bSortKey;
+
+} RESOLVE_PARAMS,
+*PRESOLVE_PARAMS;
+
+static void ResolveModules(void *Param, unsigned int Index, unsigned int Count)
+{
+    PRESOLVE_PARAMS Params = (PRESOLVE_PARAMS)Param;
+    MODULE_ENTRIES_LIST &List = *Params->List;
+
+    for (size_t i = Index; i < List.size(); i += Count)
+    {
+        MODULE_ENTRIES &Module = List[i];
+
+        if (Module.Module)
+        {
+            SymbolsResolve(
+                *Module.Symbols, Module.Module->Name.c_str(),
+                Module.Entries.size() > 0 ? &Module.Entries[0] : NULL, Module.Entries.size()
+            );
+        }
+        else
+        {
+            for (size_t n = 0; n < Module.Entries.size(); n++)
+            {
+                char szName[0x20];
+                sprintf(szName, "?0x%llx", (unsigned long long)Module.Entries[n]->Offset);
+                Module.Entries[n]->Name = szName;
+            }
+        }
+
+        if (Params->bSortKey)
+        {
+            for (size_t n = 0; n < Module.Entries.size(); n++)
+            {
+                Module.Entries[n]->SortKey = LogStringLower(Module.Entries[n]->Name);
+            }
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+void SymbolsResolveModules(MODULE_ENTRIES_LIST &List, bool bSortKey)
+{
+    RESOLVE_PARAMS Params;
+    Params.List = &List;
+    Params.bSortKey = bSortKey;
+
+    WorkersRun(ResolveModules, &Params, WorkersCount());
+}
+//--------------------------------------------------------------------------------------
+// EoF
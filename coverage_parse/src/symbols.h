@@ -0,0 +1,55 @@
+
+typedef struct _SYMBOL
+{
+    LOG_UINT64 Offset;
+    std::string Name;
+
+} SYMBOL,
+*PSYMBOL;
+
+// module symbols sorted by offset, single symbol per offset
+typedef std::vector<SYMBOL> SYMBOLS_TABLE;
+
+typedef struct _MODULE_ENTRIES
+{
+    // NULL for the entries that doesn't belong to any known module
+    PLOG_MODULE Module;
+    const SYMBOLS_TABLE *Symbols;
+    std::vector<PLOG_ENTRY> Entries;
+
+} MODULE_ENTRIES,
+*PMODULE_ENTRIES;
+
+typedef std::vector<MODULE_ENTRIES> MODULE_ENTRIES_LIST;
+
+/**
+ * Initialize debug symbols engine, symbols are downloaded into the
+ * "symbols" subdirectory of the current directory.
+ */
+bool SymbolsInit(void);
+
+/**
+ * Load all of the debug symbols for the executable module. Symbol that
+ * has a lowest name (as strcmp() does) is used for the aliases with the
+ * same offset, symbols at zero offset are ignored, just like symlib does.
+ */
+bool SymbolsLoad(const char *lpszPath, SYMBOLS_TABLE &Symbols);
+
+/**
+ * Set names of the module entries to "<module>!<symbol>+0x<delta>" or
+ * to "<module>+<offset>" when there's no matching symbol. Entries are
+ * sorted by offset, so the whole batch is resolved with a single pass
+ * over the symbols table.
+ */
+void SymbolsResolve(
+    const SYMBOLS_TABLE &Symbols, const char *lpszModule,
+    PLOG_ENTRY *Entries, size_t Count
+);
+
+/**
+ * Resolve entries of the modules list in the worker threads, entries that
+ * doesn't belong to any known module are named "?0x<offset>". Symbols engine
+ * is not thread safe, so symbols tables must be loaded before the call. With
+ * bSortKey lower case names are also stored into the SortKey of the entries.
+ */
+void SymbolsResolveModules(MODULE_ENTRIES_LIST &List, bool bSortKey);
@@ -37,7 +37,7 @@
 =========================================================================
 '''
 
-import sys, os, time, re
+import sys, os, time, re, struct
 
 ver = sys.version[:3]
 
@@ -64,11 +64,15 @@ by Oleksiuk Dmitry, eSage Lab (dmitry@esagelab.com)
 m_logfile = None
 m_routines_list = {}
 m_modules_list = {}
+m_modules_by_id = {}
 m_modules_to_process = []
 m_skip_symbols = False
 
 m_call_tree = {}
 
+# binary call tree log file signature
+CALL_LOG_MAGIC = "CCTLOG"
+
 def log_write(text):
 
     global m_logfile
@@ -85,10 +89,10 @@ def log_write(text):
 
 def read_modules_list(file_name):
 
-    global m_modules_list
+    global m_modules_list, m_modules_by_id, m_modules_to_process
 
-    m_modules_list['?'] = { 'path': '?', 'processed_items': 0, \
-        'symbols_loaded': False, 'alias': 1, 'alias_accessed': False }
+    m_modules_list['?'] = { 'path': '?', 'name': '?', 'processed_items': 0, \
+        'symbols_loaded': False, 'alias': 1, 'alias_accessed': False, 'skip': False }
 
     # open input file
     f = open(file_name)
@@ -97,109 +101,54 @@ def read_modules_list(file_name):
     # read file contents line by line
     while content != "":
         
-        content = content.replace("\n", "")
+        content = content.replace("\r", "").replace("\n", "")
         entry = content.split(":") 
-        
-        if len(entry) > 3:
-        
-            entry[2] = entry[2] + ":" + entry[3]
 
-        if content[:1] != "#" and len(entry) >= 3:
+        if content[:1] != "#" and len(entry) >= 6:
 
             alias = len(m_modules_list) + 1
 
-            module_name = os.path.basename(entry[2]).lower()
-            m_modules_list[module_name] = { 'path': entry[2], 'processed_items': 0, \
-                'symbols_loaded': False, 'alias': alias, 'alias_accessed': False }
-
-        # if end
-
-        # read the next line
-        content = f.readline()        
-
-    # while end    
-
-    f.close()
-
-# def end    
-
-def parse_symbol(string):
-
-    global m_modules_list, m_modules_to_process, m_skip_symbols
-
-    # parse 'name+offset' string
-    info = string.split("+")
-    if len(info) >= 2:
-
-        info[1] = int(info[1], 16)
-        module_path = info[0].lower()
-
-        if m_modules_list.has_key(module_path):
-
-            m_modules_list[module_path]['processed_items'] += 1            
-
-        # if end        
-
-        skip_module = False
-
-        if len(m_modules_to_process) > 0:
-
-            skip_module = True
-
-            for module_flt in m_modules_to_process:
-
-                if module_path.find(module_flt) >= 0:
-
-                    # don't skip this module
-                    skip_module = False
-
-                # if end
-            # for end        
-        # if end
-
-        if skip_module:
+            module_id = int(entry[0])
+            module_path = ":".join(entry[5:])
+            module_name = os.path.basename(module_path)
 
-            return False
+            skip_module = False
 
-        if m_skip_symbols:
+            if len(m_modules_to_process) > 0:
 
-            return string
-                
-        if m_modules_list.has_key(module_path):
-
-            module_path = m_modules_list[module_path]['path']
+                skip_module = True
 
-        # if end
+                for module_flt in m_modules_to_process:
 
-        # lookup debug symbol for address
-        symbol = bestbyaddr(module_path, info[1])
-        if symbol != None:
+                    if module_name.lower().find(module_flt) >= 0:
 
-            addr_s = "%s!%s" % (info[0], symbol[0])
+                        # don't skip this module
+                        skip_module = False
 
-            if symbol[1] > 0:
+                    # if end
+                # for end        
+            # if end
 
-                addr_s += "+0x%x" % symbol[1]
+            module = { 'path': module_path, 'name': module_name, 'processed_items': 0, \
+                'symbols_loaded': False, 'alias': alias, 'alias_accessed': False, 'skip': skip_module }
 
-            return addr_s
+            m_modules_list[module_name.lower()] = module
+            m_modules_by_id[module_id] = module
 
         # if end
 
-    elif string[0] == "?" and len(m_modules_to_process) > 0:
-
-        if "?" not in m_modules_to_process:
-
-            return False
+        # read the next line
+        content = f.readline()        
 
-    # if end
+    # while end    
 
-    return string
+    f.close()
 
 # def end    
 
 def load_symbols(module_name):
 
-    global m_routines_list, m_modules_list, m_skip_symbols
+    global m_routines_list, m_modules_list, m_modules_by_id, m_skip_symbols
 
     if m_skip_symbols:
 
@@ -216,19 +165,53 @@ def load_symbols(module_name):
         # symbols allready loaded for this module
         return
 
-    # update names for all available routines from this module
+    rtn_list = []
+    paths = []
+    offsets = []
+
+    # collect all available routines from this module
     for rtn_addr in m_routines_list:
 
-        if m_routines_list[rtn_addr]['module'].lower() == module_name:
+        rtn = m_routines_list[rtn_addr]
 
-            rtn_name = parse_symbol(m_routines_list[rtn_addr]['name'])
-            if rtn_name != False:
+        if rtn['module'].lower() == module_name and m_modules_by_id.has_key(rtn['module_id']):
 
-                m_routines_list[rtn_addr]['name'] = rtn_name
+            module = m_modules_by_id[rtn['module_id']]
+            module['processed_items'] += 1
 
+            if not module['skip']:
+
+                rtn_list.append(rtn)
+                paths.append(module['path'])
+                offsets.append(rtn['offset'])
+
+            # if end
         # if end
     # for end
 
+    # lookup debug symbols for all of the routines at once
+    symbols = bestbyaddr_multi(paths, offsets)
+    if symbols != None:
+
+        names, deltas = symbols
+
+        # update names of the routines
+        for i in range(0, len(rtn_list)):
+
+            if names[i] != None:
+
+                rtn_name = "%s!%s" % (m_modules_by_id[rtn_list[i]['module_id']]['name'], names[i])
+
+                if deltas[i] > 0:
+
+                    rtn_name += "+0x%x" % deltas[i]
+
+                rtn_list[i]['name'] = rtn_name
+
+            # if end
+        # for end
+    # if end
+
     m_modules_list[module_name]['symbols_loaded'] = True
 
 # def end
@@ -256,21 +239,29 @@ def read_routines_list(file_name):
         content = content.replace("\n", "")        
         entry = content.split(":") 
 
-        if content[:1] != "#" and len(entry) >= 3:
+        if content[:1] != "#" and len(entry) >= 4:
 
             rtn_addr = int(entry[0], 16) # routinr virtual address            
-            rtn_name = entry[1]
-            rtn_calls = int(entry[2])            
+            rtn_module_id = int(entry[1])
+            rtn_offset = int(entry[2], 16)
+            rtn_calls = int(entry[3])            
             rtn_alias = len(m_routines_list) + 1
 
-            rtn_module = "?"
-            name = entry[1].split("+") 
-            if len(name) == 2:
+            if m_modules_by_id.has_key(rtn_module_id):
 
-                rtn_module = name[0]                
+                rtn_module = m_modules_by_id[rtn_module_id]['name']
+                rtn_name = "%s+%x" % (rtn_module, rtn_offset)
+
+            else:
+
+                rtn_module = "?"
+                rtn_name = "?0x%x" % rtn_offset
+
+            # if end
 
             m_routines_list[rtn_addr] = { 'name': rtn_name, \
-                'module': rtn_module, 'calls': rtn_calls,   \
+                'module': rtn_module, 'module_id': rtn_module_id, \
+                'offset': rtn_offset, 'calls': rtn_calls, \
                 'alias': rtn_alias, 'alias_accessed': False }
 
         # if end
@@ -329,42 +320,127 @@ def get_rtn_module_info(rtn):
 
 # def end
 
-def read_calls_list(file_name):
+def add_call(rtn_src, rtn_dst, calls = 1):
 
     global m_call_tree
 
+    if rtn_src != 0:
+    
+        if not m_call_tree.has_key(rtn_src):
+
+            m_call_tree[rtn_src] = {}
+
+        # if end
+
+        if not m_call_tree[rtn_src].has_key(rtn_dst):
+
+            m_call_tree[rtn_src][rtn_dst] = 0
+
+        # if end
+
+        m_call_tree[rtn_src][rtn_dst] += calls
+    
+    # if end
+
+# def end
+
+def unpack_value(data, pos):
+
+    # decode 7-bit variable length integer
+    value = 0
+    shift = 0
+
+    while True:
+
+        byte = ord(data[pos])
+        pos += 1
+
+        value |= (byte & 0x7f) << shift
+        shift += 7
+
+        if byte < 0x80:
+
+            break
+
+    # while end
+
+    # decode zigzag'ed signed value
+    return ((value >> 1) ^ -(value & 1), pos)
+
+# def end
+
+def read_calls_list_binary(f):
+
+    # skip file signature and version
+    f.read(len(CALL_LOG_MAGIC) + 4)
+
+    while True:
+
+        # read chunk header
+        header = f.read(8)
+        if len(header) < 8:
+
+            break
+
+        # if end
+
+        (count, size) = struct.unpack("<II", header)
+        data = f.read(size)
+
+        rtn_src = 0
+        rtn_dst = 0
+        pos = 0
+
+        for i in range(0, count):
+
+            # addresses are stored as delta from the previous record
+            (delta, pos) = unpack_value(data, pos)
+            rtn_src += delta
+
+            (delta, pos) = unpack_value(data, pos)
+            rtn_dst += delta
+
+            add_call(rtn_src, rtn_dst)
+
+        # for end
+    # while end
+
+# def end
+
+def read_calls_list(file_name):
+
     # open input file
-    f = open(file_name)
-    content = f.readline()    
+    f = open(file_name, "rb")
 
-    # read file contents line by line
-    while content != "":
+    if f.read(len(CALL_LOG_MAGIC)) == CALL_LOG_MAGIC:
 
-        content = content.replace("\n", "")        
-        entry = content.split(":") 
+        # binary log file
+        f.seek(0)
+        read_calls_list_binary(f)
+        f.close()
 
-        if content[:1] != "#" and len(entry) >= 2:
+        return
 
-            rtn_src = int(entry[0], 16)
-            rtn_dst = int(entry[1], 16)
+    # if end
 
-            if rtn_src != 0:
-            
-                if not m_call_tree.has_key(rtn_src):
+    f.seek(0)
+    content = f.readline()    
 
-                    m_call_tree[rtn_src] = {}
+    # read file contents line by line
+    while content != "":
 
-                # if end
+        content = content.replace("\r", "").replace("\n", "")
+        entry = content.split(":") 
 
-                if not m_call_tree[rtn_src].has_key(rtn_dst):
+        if content[:1] != "#" and len(entry) >= 3:
 
-                    m_call_tree[rtn_src][rtn_dst] = 0
+            # aggregated call tree log entry
+            add_call(int(entry[0], 16), int(entry[1], 16), int(entry[2]))
 
-                # if end
+        elif content[:1] != "#" and len(entry) >= 2:
+
+            add_call(int(entry[0], 16), int(entry[1], 16))
 
-                m_call_tree[rtn_src][rtn_dst] += 1
-            
-            # if end
         # if end
 
         # read the next line
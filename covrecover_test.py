@@ -0,0 +1,130 @@
+import sys, os, struct, subprocess
+
+# covrecover.exe executable path
+recover_path = "covrecover.exe"
+
+test_dir = ".\\logs_recover_test"
+
+COVLIVE_SIGNATURE = "COVLIVE\0"
+COVLIVE_VERSION = 1
+COVLIVE_STATE_RUNNING = 1
+COVLIVE_MAX_MODULES = 0x400
+COVLIVE_MAX_CHUNKS = 0x4000
+COVLIVE_PATH_SIZE = 0x200
+COVLIVE_ALIGN = 0x1000
+COVLIVE_CHUNK_COUNTERS = 1
+COVLIVE_CHUNK_BLOCKS = 3
+
+# sizes of COVLIVE_HEADER fields, COVLIVE_MODULE, COVLIVE_CHUNK and COVLIVE_BLOCK
+HEADER_FIELDS = "<8sIIIIQQIIII"
+MODULE_SIZE = 8 + 8 + 4 + 4 + COVLIVE_PATH_SIZE
+CHUNK_SIZE = 4 + 4 + 8
+HEADER_SIZE = struct.calcsize(HEADER_FIELDS) + MODULE_SIZE * COVLIVE_MAX_MODULES + CHUNK_SIZE * COVLIVE_MAX_CHUNKS
+
+if len(sys.argv) >= 2:
+
+    recover_path = sys.argv[1]
+
+# if end
+
+def build_live(chunk_slots, slots_count, counts):
+
+    # arena starts after the header, blocks chunk is followed by counters chunk
+    arena = (HEADER_SIZE + COVLIVE_ALIGN - 1) & ~(COVLIVE_ALIGN - 1)
+    blocks_offset = arena
+    counters_offset = blocks_offset + ((chunk_slots * 24 + COVLIVE_ALIGN - 1) & ~(COVLIVE_ALIGN - 1))
+    size = counters_offset + ((chunk_slots * 4 + COVLIVE_ALIGN - 1) & ~(COVLIVE_ALIGN - 1))
+
+    data = struct.pack(HEADER_FIELDS, COVLIVE_SIGNATURE, COVLIVE_VERSION, COVLIVE_STATE_RUNNING, 
+                       1, chunk_slots, size, size, 0, 2, slots_count, 2)
+
+    data += "\0" * (MODULE_SIZE * COVLIVE_MAX_MODULES)
+    data += struct.pack("<IIQ", COVLIVE_CHUNK_BLOCKS, 0, blocks_offset)
+    data += struct.pack("<IIQ", COVLIVE_CHUNK_COUNTERS, 0, counters_offset)
+    data += "\0" * (CHUNK_SIZE * (COVLIVE_MAX_CHUNKS - 2))
+    data += "\0" * (blocks_offset - len(data))
+
+    # blocks of unknown module with absolute addresses
+    for i in range(len(counts)):
+
+        data += struct.pack("<QIIII", 0x1000 + i * 0x10, 0xffffffff, 0x10, 4, 0)
+
+    # for end
+
+    data += "\0" * (counters_offset - len(data))
+
+    for count in counts:
+
+        data += struct.pack("<I", count)
+
+    # for end
+
+    return data + "\0" * (size - len(data))
+
+# def end
+
+def run_recover(name, data):
+
+    if not os.path.isdir(test_dir):
+
+        os.mkdir(test_dir)
+
+    # if end
+
+    live_path = os.path.join(test_dir, name + ".live")
+    db_path = os.path.join(test_dir, name + ".db")
+
+    f = open(live_path, "wb")
+    f.write(data)
+    f.close()
+
+    if os.path.isfile(db_path):
+
+        os.remove(db_path)
+
+    # if end
+
+    # negative exit code or exception code means crash
+    code = subprocess.call([ recover_path, live_path, db_path ])
+    if code != 0 and code != 0xffffffff and code != 255 and code != -1:
+
+        print "ERROR: covrecover crashed on \"%s\" with code 0x%x" % (name, code & 0xffffffff)
+        print "[-] Test failed"
+        sys.exit(-1)
+
+    # if end
+
+    return code == 0
+
+# def end
+
+def check(name, data, expected):
+
+    print "[+] Testing %s..." % name
+
+    if run_recover(name, data) != expected:
+
+        print "ERROR: Unexpected covrecover result for \"%s\"" % name
+        print "[-] Test failed"
+        sys.exit(-1)
+
+    # if end
+
+# def end
+
+valid = build_live(0x100, 3, [ 1, 0, 5 ])
+
+# step 1: well formed live counters file must be recovered
+check("valid file", valid, True)
+
+# step 2: truncated or damaged header must be rejected
+check("truncated header", valid[: HEADER_SIZE / 2], False)
+check("bad signature", "X" + valid[1 :], False)
+check("zero chunk slots", build_live(0, 3, [ 1, 0, 5 ]), False)
+check("oversized chunk slots", valid[: 20] + struct.pack("<I", 0xffffffff) + valid[24 :], False)
+
+# step 3: garbage counts must be clamped to the file contents
+check("garbage slots count", build_live(0x100, 0xffffffff, [ 1, 0, 5 ]), True)
+check("truncated arena", build_live(0x100, 0x100, [ 1, 0, 5 ])[: HEADER_SIZE + 0x20], True)
+
+print "[+] Test passed"
@@ -2,11 +2,13 @@
 //--------------------------------------------------------------------------------------
 #ifdef DBG
 //--------------------------------------------------------------------------------------
-void DbgMsg(char *lpszFile, int iLine, char *lpszMsg, ...)
+void DbgMsg(const char *lpszFile, int iLine, const char *lpszMsg, ...)
 {
     va_list mylist;
     va_start(mylist, lpszMsg);
 
+#ifdef _WIN32
+
     int len = _vscprintf(lpszMsg, mylist) + 0x100;
     
     char *lpszBuff = (char *)malloc(len);
@@ -40,8 +42,18 @@ void DbgMsg(char *lpszFile, int iLine, char *lpszMsg, ...)
         
     free(lpszBuff);
     free(lpszOutBuff);
+
+#else
+
+    fprintf(stderr, "[%.5d] %s(%d) : ", getpid(), lpszFile, iLine);
+    vfprintf(stderr, lpszMsg, mylist);
+
+    va_end(mylist);
+
+#endif
+
 }
 //--------------------------------------------------------------------------------------
-#endif DBG
+#endif // DBG
 //--------------------------------------------------------------------------------------
 // EoF
@@ -1,9 +1,10 @@
 #ifdef DBG
 
-void DbgMsg(char *lpszFile, int Line, char *lpszMsg, ...);
+void DbgMsg(const char *lpszFile, int Line, const char *lpszMsg, ...);
 
 #else
 
-#define DbgMsg
+// arguments are dropped as well, so they don't turn into the unused expressions
+#define DbgMsg(...)
 
 #endif
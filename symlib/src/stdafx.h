@@ -1,10 +1,53 @@
+#ifdef _WIN32
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
 #include <windows.h>
 #include <DbgHelp.h>
 #include <python.h>
 
+#else
+
+// Python.h must be included before the standard headers
+#include <Python.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+typedef int BOOL;
+
+// the same size as unsigned long of Python offsets API
+typedef unsigned long DWORD;
+typedef unsigned long long DWORD64;
+
+#define TRUE 1
+#define FALSE 0
+
+#endif
+
 #include <string>
+#include <vector>
 #include <map>
 #include <list>
+#include <algorithm>
 
 #include "debug.h"
+#include "symlib.h"
+
+#ifndef _WIN32
+
+#include "symelf.h"
+
+#endif
@@ -0,0 +1,1077 @@
+#include "stdafx.h"
+
+#define DW_TAG_subprogram           0x2e
+
+#define DW_AT_name                  0x03
+#define DW_AT_low_pc                0x11
+#define DW_AT_abstract_origin       0x31
+#define DW_AT_specification         0x47
+#define DW_AT_ranges                0x55
+#define DW_AT_linkage_name          0x6e
+#define DW_AT_str_offsets_base      0x72
+#define DW_AT_addr_base             0x73
+#define DW_AT_rnglists_base         0x74
+#define DW_AT_MIPS_linkage_name     0x2007
+#define DW_AT_GNU_addr_base         0x2133
+
+#define DW_FORM_addr                0x01
+#define DW_FORM_block2              0x03
+#define DW_FORM_block4              0x04
+#define DW_FORM_data2               0x05
+#define DW_FORM_data4               0x06
+#define DW_FORM_data8               0x07
+#define DW_FORM_string              0x08
+#define DW_FORM_block               0x09
+#define DW_FORM_block1              0x0a
+#define DW_FORM_data1               0x0b
+#define DW_FORM_flag                0x0c
+#define DW_FORM_sdata               0x0d
+#define DW_FORM_strp                0x0e
+#define DW_FORM_udata               0x0f
+#define DW_FORM_ref_addr            0x10
+#define DW_FORM_ref1                0x11
+#define DW_FORM_ref2                0x12
+#define DW_FORM_ref4                0x13
+#define DW_FORM_ref8                0x14
+#define DW_FORM_ref_udata           0x15
+#define DW_FORM_indirect            0x16
+#define DW_FORM_sec_offset          0x17
+#define DW_FORM_exprloc             0x18
+#define DW_FORM_flag_present        0x19
+#define DW_FORM_strx                0x1a
+#define DW_FORM_addrx               0x1b
+#define DW_FORM_ref_sup4            0x1c
+#define DW_FORM_strp_sup            0x1d
+#define DW_FORM_data16              0x1e
+#define DW_FORM_line_strp           0x1f
+#define DW_FORM_ref_sig8            0x20
+#define DW_FORM_implicit_const      0x21
+#define DW_FORM_loclistx            0x22
+#define DW_FORM_rnglistx            0x23
+#define DW_FORM_ref_sup8            0x24
+#define DW_FORM_strx1               0x25
+#define DW_FORM_strx2               0x26
+#define DW_FORM_strx3               0x27
+#define DW_FORM_strx4               0x28
+#define DW_FORM_addrx1              0x29
+#define DW_FORM_addrx2              0x2a
+#define DW_FORM_addrx3              0x2b
+#define DW_FORM_addrx4              0x2c
+#define DW_FORM_GNU_addr_index      0x1f01
+#define DW_FORM_GNU_str_index       0x1f02
+#define DW_FORM_GNU_ref_alt         0x1f20
+#define DW_FORM_GNU_strp_alt        0x1f21
+
+#define DW_RLE_end_of_list          0x00
+#define DW_RLE_base_addressx        0x01
+#define DW_RLE_startx_endx          0x02
+#define DW_RLE_startx_length        0x03
+#define DW_RLE_offset_pair          0x04
+#define DW_RLE_base_address         0x05
+#define DW_RLE_start_end            0x06
+#define DW_RLE_start_length         0x07
+
+#define DW_UT_type                  0x02
+#define DW_UT_skeleton              0x04
+#define DW_UT_split_compile         0x05
+#define DW_UT_split_type            0x06
+
+// maximum abbreviation code and length of the DW_AT_specification chain
+#define DWARF_MAX_ABBREV_CODE       0x100000
+#define DWARF_MAX_DEPTH             8
+
+// kinds of the attribute values
+#define DWARF_VALUE_NONE            0
+#define DWARF_VALUE_CONSTANT        1
+#define DWARF_VALUE_ADDRESS         2
+#define DWARF_VALUE_ADDRESS_INDEX   3
+#define DWARF_VALUE_STRING          4
+#define DWARF_VALUE_STRING_INDEX    5
+#define DWARF_VALUE_REFERENCE       6
+#define DWARF_VALUE_LIST_INDEX      7
+
+typedef struct _DWARF_SECTION
+{
+    const unsigned char *Data;
+    DWORD64 Size;
+
+} DWARF_SECTION,
+*PDWARF_SECTION;
+
+typedef struct _DWARF_READER
+{
+    const unsigned char *Ptr;
+    const unsigned char *End;
+    bool bError;
+
+} DWARF_READER,
+*PDWARF_READER;
+
+typedef struct _DWARF_ATTRIBUTE
+{
+    DWORD Name;
+    DWORD Form;
+
+    // value of DW_FORM_implicit_const
+    DWORD64 Constant;
+
+} DWARF_ATTRIBUTE,
+*PDWARF_ATTRIBUTE;
+
+typedef struct _DWARF_ABBREV
+{
+    // zero for the unused codes
+    DWORD Tag;
+    std::vector<DWARF_ATTRIBUTE> Attributes;
+
+} DWARF_ABBREV,
+*PDWARF_ABBREV;
+
+// abbreviations table indexed by code
+typedef std::vector<DWARF_ABBREV> DWARF_ABBREVS;
+
+typedef struct _DWARF_UNIT
+{
+    // unit header, first entry and end of the unit in .debug_info
+    const unsigned char *Start;
+    const unsigned char *Entries;
+    const unsigned char *End;
+
+    DWORD Version;
+    DWORD Type;
+    DWORD64 AbbrevOffset;
+    size_t OffsetSize;
+    size_t AddressSize;
+
+    // set from the unit entry when the unit is used for the first time
+    bool bPrepared;
+    DWARF_ABBREVS *Abbrevs;
+    DWORD64 StrOffsetsBase;
+    DWORD64 AddrBase;
+    DWORD64 RnglistsBase;
+
+    // base address for the address ranges
+    DWORD64 LowPc;
+
+} DWARF_UNIT,
+*PDWARF_UNIT;
+
+typedef struct _DWARF_CONTEXT
+{
+    DWARF_SECTION Info;
+    DWARF_SECTION Abbrev;
+    DWARF_SECTION Str;
+    DWARF_SECTION LineStr;
+    DWARF_SECTION StrOffsets;
+    DWARF_SECTION Addr;
+    DWARF_SECTION Ranges;
+    DWARF_SECTION Rnglists;
+
+    // units sorted by offset and parsed abbreviation tables by offset
+    std::vector<DWARF_UNIT> Units;
+    std::map<DWORD64, DWARF_ABBREVS> Abbrevs;
+
+} DWARF_CONTEXT,
+*PDWARF_CONTEXT;
+
+typedef struct _DWARF_VALUE
+{
+    DWORD Type;
+    DWORD64 Value;
+    const char *String;
+
+} DWARF_VALUE,
+*PDWARF_VALUE;
+
+typedef struct _DWARF_ENTRY
+{
+    DWORD Tag;
+
+    // attributes that are needed to get names and addresses of the functions
+    DWARF_VALUE Name;
+    DWARF_VALUE LinkageName;
+    DWARF_VALUE LowPc;
+    DWARF_VALUE Ranges;
+    DWARF_VALUE Reference;
+    DWARF_VALUE StrOffsetsBase;
+    DWARF_VALUE AddrBase;
+    DWARF_VALUE RnglistsBase;
+
+} DWARF_ENTRY,
+*PDWARF_ENTRY;
+//--------------------------------------------------------------------------------------
+static void DwarfReader(PDWARF_READER Reader, PDWARF_SECTION Section, DWORD64 Offset)
+{
+    Reader->Ptr = Section->Data + (Offset < Section->Size ? Offset : Section->Size);
+    Reader->End = Section->Data + Section->Size;
+    Reader->bError = Offset >= Section->Size;
+}
+//--------------------------------------------------------------------------------------
+static void DwarfSkip(PDWARF_READER Reader, DWORD64 Size)
+{
+    if (Reader->bError || Size > (DWORD64)(Reader->End - Reader->Ptr))
+    {
+        Reader->bError = true;
+        Reader->Ptr = Reader->End;
+        return;
+    }
+
+    Reader->Ptr += Size;
+}
+//--------------------------------------------------------------------------------------
+static DWORD64 DwarfRead(PDWARF_READER Reader, size_t Size)
+{
+    const unsigned char *Ptr = Reader->Ptr;
+    DWORD64 Value = 0;
+
+    if (Size > sizeof(DWORD64))
+    {
+        Reader->bError = true;
+    }
+
+    DwarfSkip(Reader, Size);
+
+    if (Reader->bError)
+    {
+        return 0;
+    }
+
+    // all of the supported targets are little endian
+    for (size_t i = 0; i < Size; i++)
+    {
+        Value |= (DWORD64)Ptr[i] << (i * 8);
+    }
+
+    return Value;
+}
+//--------------------------------------------------------------------------------------
+static DWORD64 DwarfReadLeb(PDWARF_READER Reader)
+{
+    DWORD64 Value = 0;
+    unsigned int Shift = 0;
+
+    while (true)
+    {
+        if (Reader->bError || Reader->Ptr >= Reader->End)
+        {
+            Reader->bError = true;
+            return 0;
+        }
+
+        unsigned char Byte = *Reader->Ptr++;
+
+        // high bits of the signed values are not needed
+        if (Shift < 64)
+        {
+            Value |= (DWORD64)(Byte & 0x7f) << Shift;
+        }
+
+        Shift += 7;
+
+        if ((Byte & 0x80) == 0)
+        {
+            break;
+        }
+    }
+
+    return Value;
+}
+//--------------------------------------------------------------------------------------
+static const char *DwarfSectionString(PDWARF_SECTION Section, DWORD64 Offset)
+{
+    if (Section->Data == NULL || Offset >= Section->Size ||
+        memchr(Section->Data + Offset, 0, (size_t)(Section->Size - Offset)) == NULL)
+    {
+        return NULL;
+    }
+
+    return (const char *)Section->Data + Offset;
+}
+//--------------------------------------------------------------------------------------
+static DWARF_ABBREVS *DwarfLoadAbbrevs(PDWARF_CONTEXT Context, DWORD64 Offset)
+{
+    std::map<DWORD64, DWARF_ABBREVS>::iterator it = Context->Abbrevs.find(Offset);
+    if (it != Context->Abbrevs.end())
+    {
+        // units of the same object file are sharing the table
+        return &it->second;
+    }
+
+    DWARF_ABBREVS &Abbrevs = Context->Abbrevs[Offset];
+    DWARF_READER Reader;
+
+    DwarfReader(&Reader, &Context->Abbrev, Offset);
+
+    while (!Reader.bError)
+    {
+        DWORD64 Code = DwarfReadLeb(&Reader);
+        if (Code == 0)
+        {
+            break;
+        }
+
+        if (Code >= DWARF_MAX_ABBREV_CODE)
+        {
+            Reader.bError = true;
+            break;
+        }
+
+        if (Code >= Abbrevs.size())
+        {
+            Abbrevs.resize((size_t)Code + 1);
+        }
+
+        PDWARF_ABBREV Abbrev = &Abbrevs[(size_t)Code];
+
+        Abbrev->Tag = (DWORD)DwarfReadLeb(&Reader);
+        Abbrev->Attributes.clear();
+
+        // skip children flag
+        DwarfSkip(&Reader, 1);
+
+        while (!Reader.bError)
+        {
+            DWARF_ATTRIBUTE Attribute;
+            Attribute.Name = (DWORD)DwarfReadLeb(&Reader);
+            Attribute.Form = (DWORD)DwarfReadLeb(&Reader);
+            Attribute.Constant = 0;
+
+            if (Attribute.Name == 0 && Attribute.Form == 0)
+            {
+                break;
+            }
+
+            if (Attribute.Form == DW_FORM_implicit_const)
+            {
+                Attribute.Constant = DwarfReadLeb(&Reader);
+            }
+
+            Abbrev->Attributes.push_back(Attribute);
+        }
+    }
+
+    if (Reader.bError)
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Invalid abbreviations table at 0x%llx\n", __FUNCTION__, Offset);
+    }
+
+    return &Abbrevs;
+}
+//--------------------------------------------------------------------------------------
+static void DwarfReadUnits(PDWARF_CONTEXT Context)
+{
+    DWARF_READER Reader;
+
+    DwarfReader(&Reader, &Context->Info, 0);
+
+    while (!Reader.bError && Reader.Ptr < Reader.End)
+    {
+        DWARF_UNIT Unit;
+        Unit.Start = Reader.Ptr;
+        Unit.OffsetSize = 4;
+
+        DWORD64 Length = DwarfRead(&Reader, 4);
+
+        if (Length == 0xffffffff)
+        {
+            // 64-bit DWARF format
+            Length = DwarfRead(&Reader, 8);
+            Unit.OffsetSize = 8;
+        }
+        else if (Length >= 0xfffffff0)
+        {
+            break;
+        }
+
+        if (Reader.bError || Length > (DWORD64)(Reader.End - Reader.Ptr))
+        {
+            break;
+        }
+
+        Unit.End = Reader.Ptr + Length;
+        Unit.Version = (DWORD)DwarfRead(&Reader, 2);
+        Unit.Type = 0;
+
+        if (Unit.Version >= 5)
+        {
+            Unit.Type = (DWORD)DwarfRead(&Reader, 1);
+            Unit.AddressSize = (size_t)DwarfRead(&Reader, 1);
+            Unit.AbbrevOffset = DwarfRead(&Reader, Unit.OffsetSize);
+
+            if (Unit.Type == DW_UT_skeleton || Unit.Type == DW_UT_split_compile)
+            {
+                // skip unit ID
+                DwarfSkip(&Reader, 8);
+            }
+            else if (Unit.Type == DW_UT_type || Unit.Type == DW_UT_split_type)
+            {
+                // skip type signature and offset
+                DwarfSkip(&Reader, 8 + Unit.OffsetSize);
+            }
+        }
+        else
+        {
+            Unit.AbbrevOffset = DwarfRead(&Reader, Unit.OffsetSize);
+            Unit.AddressSize = (size_t)DwarfRead(&Reader, 1);
+        }
+
+        Unit.Entries = Reader.Ptr;
+        Unit.bPrepared = false;
+        Unit.Abbrevs = NULL;
+        Unit.StrOffsetsBase = Unit.AddrBase = Unit.RnglistsBase = Unit.LowPc = 0;
+
+        if (!Reader.bError && Unit.Version >= 2 && Unit.Version <= 5 && Unit.Entries <= Unit.End)
+        {
+            Context->Units.push_back(Unit);
+        }
+
+        // go to the next unit
+        Reader.bError = false;
+        Reader.Ptr = Unit.End;
+    }
+}
+//--------------------------------------------------------------------------------------
+static bool DwarfReadValue(
+    PDWARF_CONTEXT Context, PDWARF_UNIT Unit, PDWARF_READER Reader,
+    DWORD Form, DWORD64 Constant, PDWARF_VALUE Value)
+{
+    Value->Type = DWARF_VALUE_NONE;
+    Value->Value = 0;
+    Value->String = NULL;
+
+    switch (Form)
+    {
+    case DW_FORM_addr:
+
+        Value->Type = DWARF_VALUE_ADDRESS;
+        Value->Value = DwarfRead(Reader, Unit->AddressSize);
+        break;
+
+    case DW_FORM_addrx:
+    case DW_FORM_GNU_addr_index:
+
+        Value->Type = DWARF_VALUE_ADDRESS_INDEX;
+        Value->Value = DwarfReadLeb(Reader);
+        break;
+
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+
+        Value->Type = DWARF_VALUE_ADDRESS_INDEX;
+        Value->Value = DwarfRead(Reader, Form - DW_FORM_addrx1 + 1);
+        break;
+
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = DwarfRead(Reader, 1);
+        break;
+
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = DwarfRead(Reader, 2);
+        break;
+
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = DwarfRead(Reader, 4);
+        break;
+
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = DwarfRead(Reader, 8);
+        break;
+
+    case DW_FORM_data16:
+
+        DwarfSkip(Reader, 16);
+        break;
+
+    case DW_FORM_sdata:
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = DwarfReadLeb(Reader);
+        break;
+
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+
+        Value->Type = DWARF_VALUE_LIST_INDEX;
+        Value->Value = DwarfReadLeb(Reader);
+        break;
+
+    case DW_FORM_implicit_const:
+
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = Constant;
+        break;
+
+    case DW_FORM_flag_present:
+
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = 1;
+        break;
+
+    case DW_FORM_sec_offset:
+    case DW_FORM_strp_sup:
+    case DW_FORM_GNU_ref_alt:
+    case DW_FORM_GNU_strp_alt:
+
+        // references to the supplementary files are not supported
+        Value->Type = DWARF_VALUE_CONSTANT;
+        Value->Value = DwarfRead(Reader, Unit->OffsetSize);
+        break;
+
+    case DW_FORM_ref_addr:
+
+        Value->Type = DWARF_VALUE_REFERENCE;
+        Value->Value = DwarfRead(Reader, Unit->Version == 2 ? Unit->AddressSize : Unit->OffsetSize);
+        break;
+
+    case DW_FORM_string:
+
+        Value->Type = DWARF_VALUE_STRING;
+        Value->String = (const char *)Reader->Ptr;
+
+        if (Reader->Ptr < Reader->End)
+        {
+            const unsigned char *End = (const unsigned char *)memchr(Reader->Ptr, 0, Reader->End - Reader->Ptr);
+            if (End)
+            {
+                Reader->Ptr = End + 1;
+                break;
+            }
+        }
+
+        Reader->bError = true;
+        break;
+
+    case DW_FORM_strp:
+
+        Value->Type = DWARF_VALUE_STRING;
+        Value->String = DwarfSectionString(&Context->Str, DwarfRead(Reader, Unit->OffsetSize));
+        break;
+
+    case DW_FORM_line_strp:
+
+        Value->Type = DWARF_VALUE_STRING;
+        Value->String = DwarfSectionString(&Context->LineStr, DwarfRead(Reader, Unit->OffsetSize));
+        break;
+
+    case DW_FORM_strx:
+    case DW_FORM_GNU_str_index:
+
+        Value->Type = DWARF_VALUE_STRING_INDEX;
+        Value->Value = DwarfReadLeb(Reader);
+        break;
+
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4:
+
+        Value->Type = DWARF_VALUE_STRING_INDEX;
+        Value->Value = DwarfRead(Reader, Form - DW_FORM_strx1 + 1);
+        break;
+
+    case DW_FORM_block1:
+
+        DwarfSkip(Reader, DwarfRead(Reader, 1));
+        break;
+
+    case DW_FORM_block2:
+
+        DwarfSkip(Reader, DwarfRead(Reader, 2));
+        break;
+
+    case DW_FORM_block4:
+
+        DwarfSkip(Reader, DwarfRead(Reader, 4));
+        break;
+
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+
+        DwarfSkip(Reader, DwarfReadLeb(Reader));
+        break;
+
+    case DW_FORM_indirect:
+
+        Form = (DWORD)DwarfReadLeb(Reader);
+
+        if (Form == DW_FORM_indirect || Form == DW_FORM_implicit_const)
+        {
+            return false;
+        }
+
+        return DwarfReadValue(Context, Unit, Reader, Form, 0, Value);
+
+    default:
+
+        DbgMsg(__FILE__, __LINE__, "%s(): Unknown form 0x%x\n", __FUNCTION__, Form);
+        return false;
+    }
+
+    // unit relative references
+    if (Form == DW_FORM_ref1 || Form == DW_FORM_ref2 || Form == DW_FORM_ref4 ||
+        Form == DW_FORM_ref8 || Form == DW_FORM_ref_udata)
+    {
+        Value->Type = DWARF_VALUE_REFERENCE;
+        Value->Value += Unit->Start - Context->Info.Data;
+    }
+
+    return !Reader->bError;
+}
+//--------------------------------------------------------------------------------------
+static bool DwarfReadEntry(PDWARF_CONTEXT Context, PDWARF_UNIT Unit, PDWARF_READER Reader, PDWARF_ENTRY Entry)
+{
+    memset(Entry, 0, sizeof(DWARF_ENTRY));
+
+    DWORD64 Code = DwarfReadLeb(Reader);
+    if (Reader->bError)
+    {
+        return false;
+    }
+
+    if (Code == 0)
+    {
+        // end of the children list
+        return true;
+    }
+
+    if (Code >= Unit->Abbrevs->size() || (*Unit->Abbrevs)[(size_t)Code].Tag == 0)
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Unknown abbreviation code %lld\n", __FUNCTION__, Code);
+        return false;
+    }
+
+    PDWARF_ABBREV Abbrev = &(*Unit->Abbrevs)[(size_t)Code];
+
+    Entry->Tag = Abbrev->Tag;
+
+    for (size_t i = 0; i < Abbrev->Attributes.size(); i++)
+    {
+        PDWARF_ATTRIBUTE Attribute = &Abbrev->Attributes[i];
+        DWARF_VALUE Value;
+
+        if (!DwarfReadValue(Context, Unit, Reader, Attribute->Form, Attribute->Constant, &Value))
+        {
+            return false;
+        }
+
+        switch (Attribute->Name)
+        {
+        case DW_AT_name:
+
+            Entry->Name = Value;
+            break;
+
+        case DW_AT_linkage_name:
+        case DW_AT_MIPS_linkage_name:
+
+            Entry->LinkageName = Value;
+            break;
+
+        case DW_AT_low_pc:
+
+            Entry->LowPc = Value;
+            break;
+
+        case DW_AT_ranges:
+
+            Entry->Ranges = Value;
+            break;
+
+        case DW_AT_specification:
+        case DW_AT_abstract_origin:
+
+            Entry->Reference = Value;
+            break;
+
+        case DW_AT_str_offsets_base:
+
+            Entry->StrOffsetsBase = Value;
+            break;
+
+        case DW_AT_addr_base:
+        case DW_AT_GNU_addr_base:
+
+            Entry->AddrBase = Value;
+            break;
+
+        case DW_AT_rnglists_base:
+
+            Entry->RnglistsBase = Value;
+            break;
+        }
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static bool DwarfAddress(PDWARF_CONTEXT Context, PDWARF_UNIT Unit, PDWARF_VALUE Value, DWORD64 *Address)
+{
+    if (Value->Type == DWARF_VALUE_ADDRESS)
+    {
+        *Address = Value->Value;
+        return true;
+    }
+
+    if (Value->Type == DWARF_VALUE_ADDRESS_INDEX)
+    {
+        DWARF_READER Reader;
+
+        // address from .debug_addr
+        DwarfReader(&Reader, &Context->Addr, Unit->AddrBase + Value->Value * Unit->AddressSize);
+
+        *Address = DwarfRead(&Reader, Unit->AddressSize);
+        return !Reader.bError;
+    }
+
+    return false;
+}
+//--------------------------------------------------------------------------------------
+static bool DwarfRangesStart(PDWARF_CONTEXT Context, PDWARF_UNIT Unit, PDWARF_VALUE Value, DWORD64 *Address)
+{
+    DWORD64 Base = Unit->LowPc, Offset = Value->Value;
+    DWARF_READER Reader;
+
+    if (Value->Type != DWARF_VALUE_CONSTANT && Value->Type != DWARF_VALUE_LIST_INDEX)
+    {
+        return false;
+    }
+
+    if (Unit->Version < 5)
+    {
+        // pairs of the start and end addresses relative to the base address
+        DWORD64 MaxAddress = Unit->AddressSize < 8 ? ((DWORD64)1 << (Unit->AddressSize * 8)) - 1 : (DWORD64)-1;
+
+        DwarfReader(&Reader, &Context->Ranges, Offset);
+
+        while (!Reader.bError)
+        {
+            DWORD64 Start = DwarfRead(&Reader, Unit->AddressSize);
+            DWORD64 End = DwarfRead(&Reader, Unit->AddressSize);
+
+            if (Reader.bError || (Start == 0 && End == 0))
+            {
+                break;
+            }
+
+            if (Start == MaxAddress)
+            {
+                Base = End;
+                continue;
+            }
+
+            *Address = Base + Start;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (Value->Type == DWARF_VALUE_LIST_INDEX)
+    {
+        // offset of the list from the offsets table of .debug_rnglists
+        DwarfReader(&Reader, &Context->Rnglists, Unit->RnglistsBase + Offset * Unit->OffsetSize);
+
+        Offset = Unit->RnglistsBase + DwarfRead(&Reader, Unit->OffsetSize);
+
+        if (Reader.bError)
+        {
+            return false;
+        }
+    }
+
+    DwarfReader(&Reader, &Context->Rnglists, Offset);
+
+    // the first range of the list is the function entry
+    while (!Reader.bError)
+    {
+        DWARF_VALUE Index;
+        Index.Type = DWARF_VALUE_ADDRESS_INDEX;
+
+        switch (DwarfRead(&Reader, 1))
+        {
+        case DW_RLE_base_addressx:
+
+            Index.Value = DwarfReadLeb(&Reader);
+
+            if (!DwarfAddress(Context, Unit, &Index, &Base))
+            {
+                return false;
+            }
+
+            break;
+
+        case DW_RLE_startx_endx:
+        case DW_RLE_startx_length:
+
+            Index.Value = DwarfReadLeb(&Reader);
+
+            return !Reader.bError && DwarfAddress(Context, Unit, &Index, Address);
+
+        case DW_RLE_offset_pair:
+
+            *Address = Base + DwarfReadLeb(&Reader);
+            return !Reader.bError;
+
+        case DW_RLE_base_address:
+
+            Base = DwarfRead(&Reader, Unit->AddressSize);
+            break;
+
+        case DW_RLE_start_end:
+        case DW_RLE_start_length:
+
+            *Address = DwarfRead(&Reader, Unit->AddressSize);
+            return !Reader.bError;
+
+        default:
+
+            // DW_RLE_end_of_list or unknown entry
+            return false;
+        }
+    }
+
+    return false;
+}
+//--------------------------------------------------------------------------------------
+static bool DwarfPrepareUnit(PDWARF_CONTEXT Context, PDWARF_UNIT Unit)
+{
+    if (Unit->bPrepared)
+    {
+        return Unit->Abbrevs != NULL;
+    }
+
+    Unit->bPrepared = true;
+    Unit->Abbrevs = DwarfLoadAbbrevs(Context, Unit->AbbrevOffset);
+
+    DWARF_READER Reader = { Unit->Entries, Unit->End, false };
+    DWARF_ENTRY Entry;
+
+    // bases of the string and address indexes are the attributes of the unit entry
+    if (!DwarfReadEntry(Context, Unit, &Reader, &Entry))
+    {
+        Unit->Abbrevs = NULL;
+        return false;
+    }
+
+    if (Entry.StrOffsetsBase.Type == DWARF_VALUE_CONSTANT)
+    {
+        Unit->StrOffsetsBase = Entry.StrOffsetsBase.Value;
+    }
+
+    if (Entry.AddrBase.Type == DWARF_VALUE_CONSTANT)
+    {
+        Unit->AddrBase = Entry.AddrBase.Value;
+    }
+
+    if (Entry.RnglistsBase.Type == DWARF_VALUE_CONSTANT)
+    {
+        Unit->RnglistsBase = Entry.RnglistsBase.Value;
+    }
+
+    if (!DwarfAddress(Context, Unit, &Entry.LowPc, &Unit->LowPc))
+    {
+        Unit->LowPc = 0;
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static bool DwarfUnitLess(const unsigned char *Ptr, const DWARF_UNIT &Unit)
+{
+    return Ptr < Unit.Start;
+}
+//--------------------------------------------------------------------------------------
+static PDWARF_UNIT DwarfFindUnit(PDWARF_CONTEXT Context, DWORD64 Offset)
+{
+    if (Offset >= Context->Info.Size)
+    {
+        return NULL;
+    }
+
+    const unsigned char *Ptr = Context->Info.Data + Offset;
+
+    std::vector<DWARF_UNIT>::iterator it = std::upper_bound(
+        Context->Units.begin(), Context->Units.end(), Ptr, DwarfUnitLess
+    );
+
+    // last unit that starts before the entry
+    if (it == Context->Units.begin() || Ptr < (it - 1)->Entries || Ptr >= (it - 1)->End)
+    {
+        return NULL;
+    }
+
+    return &(*(it - 1));
+}
+//--------------------------------------------------------------------------------------
+static const char *DwarfString(PDWARF_CONTEXT Context, PDWARF_UNIT Unit, PDWARF_VALUE Value)
+{
+    if (Value->Type == DWARF_VALUE_STRING)
+    {
+        return Value->String;
+    }
+
+    if (Value->Type == DWARF_VALUE_STRING_INDEX)
+    {
+        DWARF_READER Reader;
+
+        // offset of the string from .debug_str_offsets
+        DwarfReader(&Reader, &Context->StrOffsets, Unit->StrOffsetsBase + Value->Value * Unit->OffsetSize);
+
+        DWORD64 Offset = DwarfRead(&Reader, Unit->OffsetSize);
+        if (!Reader.bError)
+        {
+            return DwarfSectionString(&Context->Str, Offset);
+        }
+    }
+
+    return NULL;
+}
+//--------------------------------------------------------------------------------------
+static const char *DwarfFunctionName(PDWARF_CONTEXT Context, PDWARF_UNIT Unit, PDWARF_ENTRY Entry, int Depth)
+{
+    // mangled name is the same as in the symbol tables
+    const char *lpszName = DwarfString(Context, Unit, &Entry->LinkageName);
+
+    if (lpszName == NULL && Entry->Reference.Type == DWARF_VALUE_REFERENCE && Depth < DWARF_MAX_DEPTH)
+    {
+        // name of the declaration or of the abstract instance of inlined function
+        PDWARF_UNIT RefUnit = DwarfFindUnit(Context, Entry->Reference.Value);
+
+        if (RefUnit && DwarfPrepareUnit(Context, RefUnit))
+        {
+            DWARF_READER Reader = { Context->Info.Data + Entry->Reference.Value, RefUnit->End, false };
+            DWARF_ENTRY RefEntry;
+
+            if (DwarfReadEntry(Context, RefUnit, &Reader, &RefEntry))
+            {
+                lpszName = DwarfFunctionName(Context, RefUnit, &RefEntry, Depth + 1);
+            }
+        }
+    }
+
+    if (lpszName == NULL)
+    {
+        lpszName = DwarfString(Context, Unit, &Entry->Name);
+    }
+
+    return lpszName;
+}
+//--------------------------------------------------------------------------------------
+static void DwarfSection(PELF_IMAGE Image, const char *lpszName, PDWARF_SECTION Section)
+{
+    PELF_SECTION ElfSection = ElfFindSection(Image, lpszName);
+
+    Section->Data = NULL;
+    Section->Size = 0;
+
+    if (ElfSection && (Section->Data = ElfSectionData(Image, ElfSection)) != NULL)
+    {
+        Section->Size = ElfSection->Size;
+    }
+}
+//--------------------------------------------------------------------------------------
+bool DwarfLoadFunctions(PELF_IMAGE Image, DWORD64 Base, SYMBOLS_LIST &Symbols)
+{
+    DWARF_CONTEXT Context;
+    size_t Count = 0;
+
+    DwarfSection(Image, ".debug_info", &Context.Info);
+    DwarfSection(Image, ".debug_abbrev", &Context.Abbrev);
+
+    if (Context.Info.Data == NULL || Context.Abbrev.Data == NULL)
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): DWARF information is not available\n", __FUNCTION__);
+        return false;
+    }
+
+    DwarfSection(Image, ".debug_str", &Context.Str);
+    DwarfSection(Image, ".debug_line_str", &Context.LineStr);
+    DwarfSection(Image, ".debug_str_offsets", &Context.StrOffsets);
+    DwarfSection(Image, ".debug_addr", &Context.Addr);
+    DwarfSection(Image, ".debug_ranges", &Context.Ranges);
+    DwarfSection(Image, ".debug_rnglists", &Context.Rnglists);
+
+    DwarfReadUnits(&Context);
+
+    for (size_t i = 0; i < Context.Units.size(); i++)
+    {
+        PDWARF_UNIT Unit = &Context.Units[i];
+
+        // type units have no code
+        if (Unit->Type == DW_UT_type || Unit->Type == DW_UT_split_type || !DwarfPrepareUnit(&Context, Unit))
+        {
+            continue;
+        }
+
+        DWARF_READER Reader = { Unit->Entries, Unit->End, false };
+
+        // enumerate all of the unit entries
+        while (Reader.Ptr < Reader.End)
+        {
+            DWARF_ENTRY Entry;
+            DWORD64 Address = 0;
+
+            if (!DwarfReadEntry(&Context, Unit, &Reader, &Entry))
+            {
+                DbgMsg(__FILE__, __LINE__, "%s(): Error while reading unit at 0x%llx\n", __FUNCTION__, (DWORD64)(Unit->Start - Context.Info.Data));
+                break;
+            }
+
+            if (Entry.Tag != DW_TAG_subprogram)
+            {
+                continue;
+            }
+
+            // functions that were splitted into the hot and cold parts have address ranges
+            if (!DwarfAddress(&Context, Unit, &Entry.LowPc, &Address) &&
+                !DwarfRangesStart(&Context, Unit, &Entry.Ranges, &Address))
+            {
+                continue;
+            }
+
+            // functions that were discarded by linker have zero address
+            if (Address == 0 || Address < Base)
+            {
+                continue;
+            }
+
+            const char *lpszName = DwarfFunctionName(&Context, Unit, &Entry, 0);
+            if (lpszName && *lpszName)
+            {
+                SYMLIB_SYMBOL_INFO SymbolInfo;
+                SymbolInfo.Name = std::string(lpszName);
+                SymbolInfo.Offset = Address - Base;
+                SymbolInfo.Rank = ElfSymbolRank(lpszName, false);
+
+                Symbols.push_back(SymbolInfo);
+                Count += 1;
+            }
+        }
+    }
+
+    DbgMsg(__FILE__, __LINE__, "SYMLIB: %u functions loaded from DWARF information\n", (unsigned int)Count);
+
+    return Count > 0;
+}
+//--------------------------------------------------------------------------------------
+// EoF
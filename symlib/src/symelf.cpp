@@ -0,0 +1,591 @@
+#include "stdafx.h"
+
+// page size that is used to align loadable segments address
+#define ELF_PAGE_MASK 0xfff
+//--------------------------------------------------------------------------------------
+static bool ElfRange(PELF_IMAGE Image, DWORD64 Offset, DWORD64 Size)
+{
+    return Offset <= Image->Size && Size <= Image->Size - Offset;
+}
+//--------------------------------------------------------------------------------------
+static bool ElfReadSectionHeader(PELF_IMAGE Image, DWORD64 Offset, PELF_SECTION Section, DWORD *NameOffset)
+{
+    if (Image->b64)
+    {
+        Elf64_Shdr Header;
+
+        if (!ElfRange(Image, Offset, sizeof(Header)))
+        {
+            return false;
+        }
+
+        memcpy(&Header, Image->Data + Offset, sizeof(Header));
+
+        *NameOffset = Header.sh_name;
+        Section->Type = Header.sh_type;
+        Section->Flags = Header.sh_flags;
+        Section->Addr = Header.sh_addr;
+        Section->Offset = Header.sh_offset;
+        Section->Size = Header.sh_size;
+        Section->Link = Header.sh_link;
+        Section->EntrySize = Header.sh_entsize;
+    }
+    else
+    {
+        Elf32_Shdr Header;
+
+        if (!ElfRange(Image, Offset, sizeof(Header)))
+        {
+            return false;
+        }
+
+        memcpy(&Header, Image->Data + Offset, sizeof(Header));
+
+        *NameOffset = Header.sh_name;
+        Section->Type = Header.sh_type;
+        Section->Flags = Header.sh_flags;
+        Section->Addr = Header.sh_addr;
+        Section->Offset = Header.sh_offset;
+        Section->Size = Header.sh_size;
+        Section->Link = Header.sh_link;
+        Section->EntrySize = Header.sh_entsize;
+    }
+
+    Section->Name = "";
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+static bool ElfReadHeaders(PELF_IMAGE Image)
+{
+    DWORD64 SectionsOffset = 0, SegmentsOffset = 0;
+    DWORD SectionSize = 0, SectionsCount = 0, SegmentSize = 0, SegmentsCount = 0, NamesIndex = 0;
+
+    if (Image->b64)
+    {
+        Elf64_Ehdr Header;
+
+        if (!ElfRange(Image, 0, sizeof(Header)))
+        {
+            return false;
+        }
+
+        memcpy(&Header, Image->Data, sizeof(Header));
+
+        SectionsOffset = Header.e_shoff;
+        SectionSize = Header.e_shentsize;
+        SectionsCount = Header.e_shnum;
+        NamesIndex = Header.e_shstrndx;
+        SegmentsOffset = Header.e_phoff;
+        SegmentSize = Header.e_phentsize;
+        SegmentsCount = Header.e_phnum;
+    }
+    else
+    {
+        Elf32_Ehdr Header;
+
+        if (!ElfRange(Image, 0, sizeof(Header)))
+        {
+            return false;
+        }
+
+        memcpy(&Header, Image->Data, sizeof(Header));
+
+        SectionsOffset = Header.e_shoff;
+        SectionSize = Header.e_shentsize;
+        SectionsCount = Header.e_shnum;
+        NamesIndex = Header.e_shstrndx;
+        SegmentsOffset = Header.e_phoff;
+        SegmentSize = Header.e_phentsize;
+        SegmentsCount = Header.e_phnum;
+    }
+
+    // find the lowest address of the loadable segments
+    bool bBase = false;
+
+    for (DWORD i = 0; i < SegmentsCount; i++)
+    {
+        DWORD64 Offset = SegmentsOffset + (DWORD64)i * SegmentSize;
+        DWORD64 Address = 0;
+        DWORD Type = PT_NULL;
+
+        if (Image->b64)
+        {
+            Elf64_Phdr Segment;
+
+            if (SegmentSize < sizeof(Segment) || !ElfRange(Image, Offset, sizeof(Segment)))
+            {
+                break;
+            }
+
+            memcpy(&Segment, Image->Data + Offset, sizeof(Segment));
+
+            Type = Segment.p_type;
+            Address = Segment.p_vaddr;
+        }
+        else
+        {
+            Elf32_Phdr Segment;
+
+            if (SegmentSize < sizeof(Segment) || !ElfRange(Image, Offset, sizeof(Segment)))
+            {
+                break;
+            }
+
+            memcpy(&Segment, Image->Data + Offset, sizeof(Segment));
+
+            Type = Segment.p_type;
+            Address = Segment.p_vaddr;
+        }
+
+        if (Type == PT_LOAD && (!bBase || Address < Image->Base))
+        {
+            Image->Base = Address;
+            bBase = true;
+        }
+    }
+
+    Image->Base &= ~(DWORD64)ELF_PAGE_MASK;
+
+    if (SectionsOffset == 0)
+    {
+        // file has no section headers
+        return true;
+    }
+
+    ELF_SECTION Section;
+    DWORD NameOffset = 0;
+
+    // section 0 keeps the real values when they are not fit into the ELF header
+    if (!ElfReadSectionHeader(Image, SectionsOffset, &Section, &NameOffset))
+    {
+        return false;
+    }
+
+    if (SectionsCount == 0)
+    {
+        SectionsCount = (DWORD)Section.Size;
+    }
+
+    if (NamesIndex == SHN_XINDEX)
+    {
+        NamesIndex = Section.Link;
+    }
+
+    if (SectionSize < (Image->b64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr)) ||
+        !ElfRange(Image, SectionsOffset, (DWORD64)SectionsCount * SectionSize))
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Invalid section headers\n", __FUNCTION__);
+        return false;
+    }
+
+    std::vector<DWORD> Names(SectionsCount, 0);
+
+    Image->Sections.resize(SectionsCount);
+
+    for (DWORD i = 0; i < SectionsCount; i++)
+    {
+        ElfReadSectionHeader(Image, SectionsOffset + (DWORD64)i * SectionSize, &Image->Sections[i], &Names[i]);
+    }
+
+    if (NamesIndex >= SectionsCount)
+    {
+        return true;
+    }
+
+    // set section names
+    PELF_SECTION NamesSection = &Image->Sections[NamesIndex];
+    const char *lpszNames = (const char *)ElfSectionData(Image, NamesSection);
+
+    for (DWORD i = 0; i < SectionsCount && lpszNames; i++)
+    {
+        if (Names[i] < NamesSection->Size &&
+            memchr(lpszNames + Names[i], 0, (size_t)(NamesSection->Size - Names[i])))
+        {
+            Image->Sections[i].Name = lpszNames + Names[i];
+        }
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+bool ElfOpen(PELF_IMAGE Image, const char *lpszPath)
+{
+    struct stat Stat;
+    void *Data = NULL;
+
+    Image->fd = -1;
+    Image->Data = NULL;
+    Image->Size = 0;
+    Image->Base = 0;
+    Image->b64 = false;
+    Image->Sections.clear();
+
+    if ((Image->fd = open(lpszPath, O_RDONLY)) < 0)
+    {
+        DbgMsg(__FILE__, __LINE__, "open() ERROR %d\n", errno);
+        DbgMsg(__FILE__, __LINE__, "Error while opening \"%s\"\n", lpszPath);
+        return false;
+    }
+
+    if (fstat(Image->fd, &Stat) != 0 || Stat.st_size < EI_NIDENT)
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Invalid file \"%s\"\n", __FUNCTION__, lpszPath);
+        ElfClose(Image);
+        return false;
+    }
+
+    // map the whole file, pages of the unused sections are never read
+    if ((Data = mmap(NULL, (size_t)Stat.st_size, PROT_READ, MAP_PRIVATE, Image->fd, 0)) == MAP_FAILED)
+    {
+        DbgMsg(__FILE__, __LINE__, "mmap() ERROR %d\n", errno);
+        ElfClose(Image);
+        return false;
+    }
+
+    Image->Data = (const unsigned char *)Data;
+    Image->Size = (size_t)Stat.st_size;
+
+    if (memcmp(Image->Data, ELFMAG, SELFMAG) || Image->Data[EI_DATA] != ELFDATA2LSB ||
+        (Image->Data[EI_CLASS] != ELFCLASS32 && Image->Data[EI_CLASS] != ELFCLASS64))
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): \"%s\" is not a supported ELF file\n", __FUNCTION__, lpszPath);
+        ElfClose(Image);
+        return false;
+    }
+
+    Image->b64 = Image->Data[EI_CLASS] == ELFCLASS64;
+
+    if (!ElfReadHeaders(Image))
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while reading headers of \"%s\"\n", __FUNCTION__, lpszPath);
+        ElfClose(Image);
+        return false;
+    }
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+void ElfClose(PELF_IMAGE Image)
+{
+    if (Image->Data)
+    {
+        munmap((void *)Image->Data, Image->Size);
+    }
+
+    if (Image->fd >= 0)
+    {
+        close(Image->fd);
+    }
+
+    Image->fd = -1;
+    Image->Data = NULL;
+    Image->Size = 0;
+    Image->Sections.clear();
+}
+//--------------------------------------------------------------------------------------
+PELF_SECTION ElfFindSection(PELF_IMAGE Image, const char *lpszName)
+{
+    for (size_t i = 0; i < Image->Sections.size(); i++)
+    {
+        if (!strcmp(Image->Sections[i].Name, lpszName))
+        {
+            return &Image->Sections[i];
+        }
+    }
+
+    return NULL;
+}
+//--------------------------------------------------------------------------------------
+const unsigned char *ElfSectionData(PELF_IMAGE Image, PELF_SECTION Section)
+{
+    if (Section->Type == SHT_NOBITS)
+    {
+        return NULL;
+    }
+
+    if (Section->Flags & SHF_COMPRESSED)
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Section \"%s\" is compressed\n", __FUNCTION__, Section->Name);
+        return NULL;
+    }
+
+    if (!ElfRange(Image, Section->Offset, Section->Size))
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Section \"%s\" is out of file bounds\n", __FUNCTION__, Section->Name);
+        return NULL;
+    }
+
+    return Image->Data + Section->Offset;
+}
+//--------------------------------------------------------------------------------------
+static bool ElfBuildId(PELF_IMAGE Image, std::string &BuildId)
+{
+    BuildId.clear();
+
+    for (size_t i = 0; i < Image->Sections.size(); i++)
+    {
+        PELF_SECTION Section = &Image->Sections[i];
+
+        if (Section->Type != SHT_NOTE)
+        {
+            continue;
+        }
+
+        const unsigned char *Data = ElfSectionData(Image, Section);
+        DWORD64 Offset = 0;
+
+        // enumerate notes: name size, description size, type, name and description
+        while (Data && Offset + sizeof(Elf32_Nhdr) <= Section->Size)
+        {
+            Elf32_Nhdr Note;
+            memcpy(&Note, Data + Offset, sizeof(Note));
+
+            DWORD64 NameOffset = Offset + sizeof(Note);
+            // sizes are aligned in 64-bit arithmetic, so they can't wrap around to zero
+            DWORD64 DescOffset = NameOffset + (((DWORD64)Note.n_namesz + 3) & ~(DWORD64)3);
+
+            Offset = DescOffset + (((DWORD64)Note.n_descsz + 3) & ~(DWORD64)3);
+
+            if (Offset > Section->Size)
+            {
+                break;
+            }
+
+            if (Note.n_type == NT_GNU_BUILD_ID && Note.n_namesz == sizeof(ELF_NOTE_GNU) &&
+                !memcmp(Data + NameOffset, ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)) && Note.n_descsz > 1)
+            {
+                if (DescOffset + Note.n_descsz > Section->Size)
+                {
+                    break;
+                }
+
+                for (DWORD n = 0; n < Note.n_descsz; n++)
+                {
+                    char szByte[3];
+                    sprintf(szByte, "%.2x", Data[DescOffset + n]);
+                    BuildId += szByte;
+                }
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+//--------------------------------------------------------------------------------------
+static bool ElfOpenDebugFile(PELF_IMAGE Image, PELF_IMAGE Debug)
+{
+    const char *lpszDirs[] = { "symbols", ELF_DEBUG_DIR };
+    std::string BuildId, DebugBuildId;
+
+    if (!ElfBuildId(Image, BuildId))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(lpszDirs) / sizeof(lpszDirs[0]); i++)
+    {
+        // <dir>/.build-id/<first byte>/<other bytes>.debug
+        std::string Path = std::string(lpszDirs[i]) + "/" + ELF_BUILD_ID_DIR + "/" +
+            BuildId.substr(0, 2) + "/" + BuildId.substr(2) + ELF_BUILD_ID_SUFFIX;
+
+        if (access(Path.c_str(), R_OK) != 0)
+        {
+            continue;
+        }
+
+        if (ElfOpen(Debug, Path.c_str()))
+        {
+            if (ElfBuildId(Debug, DebugBuildId) && DebugBuildId == BuildId)
+            {
+                DbgMsg(__FILE__, __LINE__, "SYMLIB: Debug file loaded from \"%s\"\n", Path.c_str());
+                return true;
+            }
+
+            DbgMsg(__FILE__, __LINE__, "%s(): Build ID of \"%s\" doesn't match\n", __FUNCTION__, Path.c_str());
+            ElfClose(Debug);
+        }
+    }
+
+    return false;
+}
+//--------------------------------------------------------------------------------------
+DWORD ElfSymbolRank(const char *lpszName, bool bPrivate)
+{
+    DWORD Rank = bPrivate ? ELF_RANK_PRIVATE : 0;
+
+    // versioned names of .symtab (memcpy@GLIBC_2.2.5) are not default versions
+    if (strchr(lpszName, '@'))
+    {
+        Rank = ELF_RANK_PRIVATE;
+    }
+
+    while (*lpszName == '_')
+    {
+        lpszName += 1;
+        Rank += 1;
+    }
+
+    return Rank;
+}
+//--------------------------------------------------------------------------------------
+static size_t ElfLoadTable(PELF_IMAGE Image, PELF_SECTION Section, DWORD64 Base, SYMBOLS_LIST &Symbols)
+{
+    size_t SymbolSize = Image->b64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym), Count = 0;
+
+    if (Section->Link >= Image->Sections.size())
+    {
+        return 0;
+    }
+
+    PELF_SECTION NamesSection = &Image->Sections[Section->Link];
+
+    const unsigned char *Data = ElfSectionData(Image, Section);
+    const char *lpszNames = (const char *)ElfSectionData(Image, NamesSection);
+
+    if (Data == NULL || lpszNames == NULL)
+    {
+        return 0;
+    }
+
+    if (Section->EntrySize > SymbolSize)
+    {
+        SymbolSize = (size_t)Section->EntrySize;
+    }
+
+    const unsigned char *Versions = NULL;
+    DWORD64 VersionsCount = 0;
+
+    // versions of .dynsym symbols, non-default versions are hidden from the static linker
+    for (size_t i = 0; i < Image->Sections.size(); i++)
+    {
+        PELF_SECTION VersionsSection = &Image->Sections[i];
+
+        if (VersionsSection->Type == SHT_GNU_versym && VersionsSection->Link == (DWORD)(Section - &Image->Sections[0]))
+        {
+            if ((Versions = ElfSectionData(Image, VersionsSection)) != NULL)
+            {
+                VersionsCount = VersionsSection->Size / sizeof(Elf32_Half);
+            }
+
+            break;
+        }
+    }
+
+    for (DWORD64 Offset = 0; Offset + SymbolSize <= Section->Size; Offset += SymbolSize)
+    {
+        DWORD64 Value = 0;
+        DWORD Name = 0, Index = 0, Type = 0, Bind = 0, Visibility = 0;
+
+        if (Image->b64)
+        {
+            Elf64_Sym Symbol;
+            memcpy(&Symbol, Data + Offset, sizeof(Symbol));
+
+            Name = Symbol.st_name;
+            Value = Symbol.st_value;
+            Index = Symbol.st_shndx;
+            Type = ELF64_ST_TYPE(Symbol.st_info);
+            Bind = ELF64_ST_BIND(Symbol.st_info);
+            Visibility = ELF64_ST_VISIBILITY(Symbol.st_other);
+        }
+        else
+        {
+            Elf32_Sym Symbol;
+            memcpy(&Symbol, Data + Offset, sizeof(Symbol));
+
+            Name = Symbol.st_name;
+            Value = Symbol.st_value;
+            Index = Symbol.st_shndx;
+            Type = ELF32_ST_TYPE(Symbol.st_info);
+            Bind = ELF32_ST_BIND(Symbol.st_info);
+            Visibility = ELF32_ST_VISIBILITY(Symbol.st_other);
+        }
+
+        // skip imports, absolute symbols and anything other than code and data
+        if (Index == SHN_UNDEF || (Index >= SHN_LORESERVE && Index != SHN_XINDEX))
+        {
+            continue;
+        }
+
+        if (Type != STT_FUNC && Type != STT_GNU_IFUNC && Type != STT_OBJECT)
+        {
+            continue;
+        }
+
+        if (Name == 0 || Name >= NamesSection->Size || Value < Base ||
+            memchr(lpszNames + Name, 0, (size_t)(NamesSection->Size - Name)) == NULL)
+        {
+            continue;
+        }
+
+        bool bPrivate = Bind == STB_LOCAL || Visibility != STV_DEFAULT;
+        DWORD64 Entry = Offset / SymbolSize;
+
+        if (Versions && Entry < VersionsCount)
+        {
+            Elf32_Half Version = 0;
+            memcpy(&Version, Versions + Entry * sizeof(Elf32_Half), sizeof(Version));
+
+            bPrivate = bPrivate || (Version & ELF_VERSYM_HIDDEN) != 0;
+        }
+
+        SYMLIB_SYMBOL_INFO SymbolInfo;
+        SymbolInfo.Name = std::string(lpszNames + Name);
+        SymbolInfo.Offset = Value - Base;
+        SymbolInfo.Rank = ElfSymbolRank(lpszNames + Name, bPrivate);
+
+        Symbols.push_back(SymbolInfo);
+        Count += 1;
+    }
+
+    DbgMsg(__FILE__, __LINE__, "SYMLIB: %u symbols loaded from \"%s\"\n", (unsigned int)Count, Section->Name);
+
+    return Count;
+}
+//--------------------------------------------------------------------------------------
+bool ElfLoadSymbols(const char *lpszPath, SYMBOLS_LIST &Symbols)
+{
+    ELF_IMAGE Image, Debug;
+    PELF_SECTION Section = NULL;
+    bool bDebug = false;
+
+    if (!ElfOpen(&Image, lpszPath))
+    {
+        return false;
+    }
+
+    if ((Section = ElfFindSection(&Image, ".symtab")) != NULL && Section->Type == SHT_SYMTAB)
+    {
+        ElfLoadTable(&Image, Section, Image.Base, Symbols);
+    }
+    else if ((bDebug = ElfOpenDebugFile(&Image, &Debug)) &&
+             (Section = ElfFindSection(&Debug, ".symtab")) != NULL && Section->Type == SHT_SYMTAB)
+    {
+        // section addresses of the debug file are the same as in the stripped one
+        ElfLoadTable(&Debug, Section, Image.Base, Symbols);
+    }
+    else
+    {
+        // stripped file without .symtab: exported symbols and functions from DWARF
+        if ((Section = ElfFindSection(&Image, ".dynsym")) != NULL && Section->Type == SHT_DYNSYM)
+        {
+            ElfLoadTable(&Image, Section, Image.Base, Symbols);
+        }
+
+        DwarfLoadFunctions(bDebug ? &Debug : &Image, Image.Base, Symbols);
+    }
+
+    if (bDebug)
+    {
+        ElfClose(&Debug);
+    }
+
+    ElfClose(&Image);
+
+    return true;
+}
+//--------------------------------------------------------------------------------------
+// EoF
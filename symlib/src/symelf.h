@@ -0,0 +1,90 @@
+
+/*
+    ELF symbols backend: executable files are mapped into the memory and parsed
+    without loading, symbol offsets are relative to the lowest loadable segment
+    address of the module (the same as module offsets in the coverage logs).
+*/
+
+// subdirectories of the debug files directories for build-id lookup
+#define ELF_BUILD_ID_DIR        ".build-id"
+#define ELF_BUILD_ID_SUFFIX     ".debug"
+
+// system wide directory of the separate debug files
+#define ELF_DEBUG_DIR           "/usr/lib/debug"
+
+// rank of the symbols that are not exported or are not default versions of the exported ones
+#define ELF_RANK_PRIVATE        0x100
+
+// .gnu.version entry flag of the non-default symbol versions
+#define ELF_VERSYM_HIDDEN       0x8000
+
+typedef struct _ELF_SECTION
+{
+    const char *Name;
+    DWORD Type;
+    DWORD64 Flags;
+    DWORD64 Addr;
+    DWORD64 Offset;
+    DWORD64 Size;
+    DWORD Link;
+    DWORD64 EntrySize;
+
+} ELF_SECTION,
+*PELF_SECTION;
+
+typedef struct _ELF_IMAGE
+{
+    int fd;
+    const unsigned char *Data;
+    size_t Size;
+
+    // ELFCLASS64 file
+    bool b64;
+
+    // lowest address of the loadable segments, aligned by page size
+    DWORD64 Base;
+
+    // section headers, contents of the sections are read only when needed
+    std::vector<ELF_SECTION> Sections;
+
+} ELF_IMAGE,
+*PELF_IMAGE;
+
+/**
+ * Map ELF file into the memory and read its section headers.
+ */
+bool ElfOpen(PELF_IMAGE Image, const char *lpszPath);
+void ElfClose(PELF_IMAGE Image);
+
+/**
+ * Find section by name, returns NULL when there's no such section.
+ */
+PELF_SECTION ElfFindSection(PELF_IMAGE Image, const char *lpszName);
+
+/**
+ * Get contents of the section, returns NULL for sections that have no
+ * data in the file (SHT_NOBITS) or are compressed.
+ */
+const unsigned char *ElfSectionData(PELF_IMAGE Image, PELF_SECTION Section);
+
+/**
+ * Get rank of the symbol among the aliases with the same offset: exported
+ * names go first, then names with less leading underscores (malloc goes
+ * before __libc_malloc).
+ */
+DWORD ElfSymbolRank(const char *lpszName, bool bPrivate);
+
+/**
+ * Load symbols of the ELF file: .symtab of the file or of its separate
+ * debug file is used when available, otherwise symbols are loaded from
+ * .dynsym and DWARF functions information. Debug file is looked up by
+ * build-id in the "symbols" subdirectory of the current directory and in
+ * ELF_DEBUG_DIR.
+ */
+bool ElfLoadSymbols(const char *lpszPath, SYMBOLS_LIST &Symbols);
+
+/**
+ * Load names and start addresses of the functions from .debug_info of the
+ * ELF file, Base is subtracted from the function addresses.
+ */
+bool DwarfLoadFunctions(PELF_IMAGE Image, DWORD64 Base, SYMBOLS_LIST &Symbols);
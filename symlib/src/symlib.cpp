@@ -1,43 +1,42 @@
 #include "stdafx.h"
 
-typedef struct _SYMLIB_SYMBOL_INFO
-{
-    std::string Name;
-    DWORD64 Offset;
-
-} SYMLIB_SYMBOL_INFO,
-*PSYMLIB_SYMBOL_INFO;
+// empty slot of the symbols hash table
+#define SYMLIB_HASH_EMPTY 0xffffffff
 
-typedef std::map<std::string, SYMLIB_SYMBOL_INFO> SYMBOLS_LIST;
+// size of the array.array items that are read as raw offsets
+#define SYMLIB_OFFSET_SIZE 4
 
 typedef struct _SYMLIB_MODULE_INFO
 {
+
+#ifdef _WIN32
+
     HMODULE hModule;
+
+#endif
+
     std::string ModuleName;
+
+    // unique symbol names sorted by offset, rank and name
     SYMBOLS_LIST SymbolsList;
 
+    // open addressing hash table of symbol names, holds indexes of SymbolsList
+    std::vector<DWORD> SymbolsHash;
+
 } SYMLIB_MODULE_INFO,
 *PSYMLIB_MODULE_INFO;
 
 typedef std::map<std::string, SYMLIB_MODULE_INFO> MODULES_LIST;
 
-typedef struct _ENUM_CONTEXT
+typedef struct _SYMLIB_LOOKUP
 {
-    DWORD64 dwModuleImageBase;
-
-    DWORD64 dwBestSymbolOffset;
-    DWORD dwBestSymbolDelta;
-
-    DWORD64 dwSymbolOffset;    
-    char *lpszSymbolName;
-
-} ENUM_CONTEXT,
-*PENUM_CONTEXT;
+    // index of the module name and offset in the input sequences
+    size_t Module;
+    DWORD64 Offset;
+    size_t Index;
 
-typedef BOOL (WINAPI * SYMLIB_ENUM_HANDLER)(
-    PSYMLIB_SYMBOL_INFO SymbolInfo, 
-    PENUM_CONTEXT Context
-);
+} SYMLIB_LOOKUP,
+*PSYMLIB_LOOKUP;
 
 #ifdef PYTHON25
 #define PYTHON_MODULE_NAME "symlib25"
@@ -64,59 +63,107 @@ char *GetNameFromFullPath(const char *lpszPath)
     return lpszName;
 }
 //--------------------------------------------------------------------------------------
-BOOL WINAPI FindSymbolByName(
-    PSYMLIB_SYMBOL_INFO SymbolInfo, 
-    PENUM_CONTEXT Context)
+static DWORD SymlibHash(const char *lpszName)
 {
-    // match symbol name
-    if (!strcmp(SymbolInfo->Name.c_str(), Context->lpszSymbolName))
+    // FNV-1a hash of the symbol name
+    DWORD dwHash = 2166136261;
+
+    for (const unsigned char *p = (const unsigned char *)lpszName; *p; p++)
     {
-        // stop enumeration
-        Context->dwSymbolOffset = SymbolInfo->Offset;
-        return FALSE;
+        dwHash = (dwHash ^ *p) * 16777619;
     }
 
-    return TRUE;
+    return dwHash;
+}
+//--------------------------------------------------------------------------------------
+static bool SymlibLessByName(const SYMLIB_SYMBOL_INFO &First, const SYMLIB_SYMBOL_INFO &Second)
+{
+    return First.Name < Second.Name;
 }
 //--------------------------------------------------------------------------------------
-BOOL WINAPI FindBestSymbolByAddress(
-    PSYMLIB_SYMBOL_INFO SymbolInfo, 
-    PENUM_CONTEXT Context)
+static bool SymlibLessByOffset(const SYMLIB_SYMBOL_INFO &First, const SYMLIB_SYMBOL_INFO &Second)
 {
-    if (Context->dwSymbolOffset >= SymbolInfo->Offset)
+    if (First.Offset != Second.Offset)
     {
-        DWORD dwDelta = (DWORD)(Context->dwSymbolOffset - SymbolInfo->Offset);
+        return First.Offset < Second.Offset;
+    }
 
-        if (dwDelta < Context->dwBestSymbolDelta || Context->dwBestSymbolOffset == 0)
-        {
-            Context->dwBestSymbolOffset = SymbolInfo->Offset;
-            Context->dwBestSymbolDelta = dwDelta;
-        }
+    // preferred alias goes first
+    if (First.Rank != Second.Rank)
+    {
+        return First.Rank < Second.Rank;
     }
 
-    return TRUE;
+    return First.Name < Second.Name;
+}
+//--------------------------------------------------------------------------------------
+static bool SymlibLessOffset(const SYMLIB_SYMBOL_INFO &Symbol, DWORD64 Offset)
+{
+    return Symbol.Offset < Offset;
+}
+//--------------------------------------------------------------------------------------
+static bool SymlibLessSymbol(DWORD64 Offset, const SYMLIB_SYMBOL_INFO &Symbol)
+{
+    return Offset < Symbol.Offset;
 }
 //--------------------------------------------------------------------------------------
-BOOL WINAPI FindSymbolByAddress(
-    PSYMLIB_SYMBOL_INFO SymbolInfo, 
-    PENUM_CONTEXT Context)
+static void SymlibBuildIndex(PSYMLIB_MODULE_INFO ModuleInfo)
 {
-    if (Context->dwSymbolOffset == SymbolInfo->Offset)
+    SYMBOLS_LIST &Symbols = ModuleInfo->SymbolsList;
+    size_t Count = 0;
+
+    // keep the last enumerated symbol of each name
+    std::stable_sort(Symbols.begin(), Symbols.end(), SymlibLessByName);
+
+    for (size_t i = 0; i < Symbols.size(); i++)
     {
-        const char *lpszName = SymbolInfo->Name.c_str();
+        if (i + 1 < Symbols.size() && Symbols[i + 1].Name == Symbols[i].Name)
+        {
+            continue;
+        }
 
-        size_t NameLen = strlen(lpszName);
-        if (Context->lpszSymbolName = (char *)malloc(NameLen + 1))
+        if (Count != i)
         {
-            strcpy(Context->lpszSymbolName, lpszName);
+            Symbols[Count].Name.swap(Symbols[i].Name);
+            Symbols[Count].Offset = Symbols[i].Offset;
+            Symbols[Count].Rank = Symbols[i].Rank;
         }
 
-        return FALSE;
+        Count += 1;
     }
 
-    return TRUE;
+    Symbols.resize(Count);
+
+    // release unused memory of the list
+    SYMBOLS_LIST(Symbols).swap(Symbols);
+
+    std::sort(Symbols.begin(), Symbols.end(), SymlibLessByOffset);
+
+    // hash table size is power of two with the load factor under 0.5
+    size_t HashSize = 16;
+
+    while (HashSize < Count * 2)
+    {
+        HashSize *= 2;
+    }
+
+    ModuleInfo->SymbolsHash.assign(HashSize, SYMLIB_HASH_EMPTY);
+
+    for (size_t i = 0; i < Count; i++)
+    {
+        size_t Slot = SymlibHash(Symbols[i].Name.c_str()) & (HashSize - 1);
+
+        while (ModuleInfo->SymbolsHash[Slot] != SYMLIB_HASH_EMPTY)
+        {
+            Slot = (Slot + 1) & (HashSize - 1);
+        }
+
+        ModuleInfo->SymbolsHash[Slot] = (DWORD)i;
+    }
 }
 //--------------------------------------------------------------------------------------
+#ifdef _WIN32
+//--------------------------------------------------------------------------------------
 BOOL CALLBACK SymlibLoadModuleSymbols(
     PSYMBOL_INFO pSymInfo,
     ULONG SymbolSize,
@@ -129,32 +176,35 @@ BOOL CALLBACK SymlibLoadModuleSymbols(
         SYMLIB_SYMBOL_INFO SymbolInfo;
         SymbolInfo.Name = std::string((char *)pSymInfo->Name);
         SymbolInfo.Offset = pSymInfo->Address - (DWORD64)ModuleInfo->hModule;
+        SymbolInfo.Rank = 0;
 
-        // save symbol information
-        ModuleInfo->SymbolsList[SymbolInfo.Name] = SymbolInfo;
+        // save symbol information, index is built after the enumeration
+        ModuleInfo->SymbolsList.push_back(SymbolInfo);
     }        
     catch (...)
     {
-        printf(__FUNCTION__"(): Exception occurs\n");
+        printf("%s(): Exception occurs\n", __FUNCTION__);
     }
 
     return TRUE;
 }
 //--------------------------------------------------------------------------------------
-HMODULE SymlibLoadModule(const char *lpszModuleName)
+#endif // _WIN32
+//--------------------------------------------------------------------------------------
+BOOL SymlibLoadModule(const char *lpszModuleName)
 {
     try
     {
         std::string ModuleName = std::string(lpszModuleName);
 
         // check for the allready loaded module
-        MODULES_LIST::iterator it = m_ModulesList.find(ModuleName);
-        if (it != m_ModulesList.end())
+        if (m_ModulesList.find(ModuleName) != m_ModulesList.end())
         {
-            // return existing module handle
-            return it->second.hModule;
+            return TRUE;
         }
 
+#ifdef _WIN32
+
         // load target module
         HMODULE hModule = LoadLibraryEx(lpszModuleName, NULL, 0);
         if (hModule)
@@ -171,9 +221,10 @@ HMODULE SymlibLoadModule(const char *lpszModuleName)
             // try to load debug symbols for module
             if (SymLoadModuleEx(GetCurrentProcess(), NULL, GetNameFromFullPath(lpszModuleName), NULL, (DWORD64)hModule, 0, NULL, 0))
             {
-                SYMLIB_MODULE_INFO ModuleInfo;
-                ModuleInfo.hModule = hModule;
-                ModuleInfo.ModuleName = ModuleName;
+                // save module information
+                PSYMLIB_MODULE_INFO ModuleInfo = &m_ModulesList[ModuleName];
+                ModuleInfo->hModule = hModule;
+                ModuleInfo->ModuleName = ModuleName;
 
                 // get specified symbol address by name
                 if (SymEnumSymbols(
@@ -181,12 +232,14 @@ HMODULE SymlibLoadModule(const char *lpszModuleName)
                     (DWORD64)hModule,
                     NULL,
                     SymlibLoadModuleSymbols,
-                    (PVOID)&ModuleInfo))
+                    (PVOID)ModuleInfo))
                 {
+                    SymlibBuildIndex(ModuleInfo);
+
                     DbgMsg(
                         __FILE__, __LINE__, 
                         "SYMLIB: %d symbols loaded for \"%s\"\n", 
-                        ModuleInfo.SymbolsList.size(), lpszModuleName
+                        ModuleInfo->SymbolsList.size(), lpszModuleName
                     );
                 }
                 else
@@ -194,10 +247,7 @@ HMODULE SymlibLoadModule(const char *lpszModuleName)
                     DbgMsg(__FILE__, __LINE__, "SymEnumSymbols() ERROR 0x%.8x\n", GetLastError());
                 }
 
-                // save module information
-                m_ModulesList[ModuleName] = ModuleInfo;
-
-                return hModule;
+                return TRUE;
             }
 
             FreeLibrary(hModule);
@@ -207,78 +257,335 @@ HMODULE SymlibLoadModule(const char *lpszModuleName)
             DbgMsg(__FILE__, __LINE__, "LoadLibraryEx() ERROR 0x%.8x\n", GetLastError());
             DbgMsg(__FILE__, __LINE__, "Error while loading \"%s\"\n", lpszModuleName);
         }
+
+#else
+
+        SYMBOLS_LIST Symbols;
+
+        // read symbols from the ELF file without loading it
+        if (ElfLoadSymbols(lpszModuleName, Symbols))
+        {
+            // save module information
+            PSYMLIB_MODULE_INFO ModuleInfo = &m_ModulesList[ModuleName];
+            ModuleInfo->ModuleName = ModuleName;
+            ModuleInfo->SymbolsList.swap(Symbols);
+
+            SymlibBuildIndex(ModuleInfo);
+
+            DbgMsg(
+                __FILE__, __LINE__, 
+                "SYMLIB: %d symbols loaded for \"%s\"\n", 
+                (int)ModuleInfo->SymbolsList.size(), lpszModuleName
+            );
+
+            return TRUE;
+        }
+
+        DbgMsg(__FILE__, __LINE__, "Error while loading \"%s\"\n", lpszModuleName);
+
+#endif // _WIN32
+
     }
     catch (...)
     {
-        printf(__FUNCTION__"(): Exception occurs\n");
+        printf("%s(): Exception occurs\n", __FUNCTION__);
     }   
 
-    return NULL;
+    return FALSE;
 }
 //--------------------------------------------------------------------------------------
-BOOL SymlibEnumerateSymbols(
-    const char *lpszModuleName, 
-    SYMLIB_ENUM_HANDLER Handler, 
-    PENUM_CONTEXT Context)
+PSYMLIB_MODULE_INFO SymlibGetModule(const char *lpszModuleName)
 {
     // load target module
-    HMODULE hModule = SymlibLoadModule(lpszModuleName);
-    if (hModule)
+    if (SymlibLoadModule(lpszModuleName))
     {
-        SYMLIB_MODULE_INFO ModuleInfo = m_ModulesList[std::string(lpszModuleName)];        
+        MODULES_LIST::iterator it = m_ModulesList.find(std::string(lpszModuleName));
+        if (it != m_ModulesList.end())
+        {
+            return &it->second;
+        }
+    }
 
-        // enumerate available symbols
-        SYMBOLS_LIST::iterator it = ModuleInfo.SymbolsList.begin();
-        for (it; it != ModuleInfo.SymbolsList.end(); ++it) 
+    return NULL;
+}
+//--------------------------------------------------------------------------------------
+PSYMLIB_SYMBOL_INFO SymlibFindByName(PSYMLIB_MODULE_INFO ModuleInfo, const char *lpszSymbolName)
+{
+    size_t HashSize = ModuleInfo->SymbolsHash.size();
+
+    if (HashSize == 0)
+    {
+        return NULL;
+    }
+
+    size_t Slot = SymlibHash(lpszSymbolName) & (HashSize - 1);
+
+    while (ModuleInfo->SymbolsHash[Slot] != SYMLIB_HASH_EMPTY)
+    {
+        PSYMLIB_SYMBOL_INFO SymbolInfo = &ModuleInfo->SymbolsList[ModuleInfo->SymbolsHash[Slot]];
+
+        // match symbol name
+        if (!strcmp(SymbolInfo->Name.c_str(), lpszSymbolName))
         {
-            SYMLIB_SYMBOL_INFO SymbolInfo = it->second;
+            return SymbolInfo;
+        }
+
+        Slot = (Slot + 1) & (HashSize - 1);
+    }
+
+    return NULL;
+}
+//--------------------------------------------------------------------------------------
+PSYMLIB_SYMBOL_INFO SymlibFindByAddress(PSYMLIB_MODULE_INFO ModuleInfo, DWORD64 Offset)
+{
+    SYMBOLS_LIST &Symbols = ModuleInfo->SymbolsList;
+
+    // preferred symbol with the exact offset
+    SYMBOLS_LIST::iterator it = std::lower_bound(Symbols.begin(), Symbols.end(), Offset, SymlibLessOffset);
+    if (it != Symbols.end() && it->Offset == Offset)
+    {
+        return &(*it);
+    }
+
+    return NULL;
+}
+//--------------------------------------------------------------------------------------
+PSYMLIB_SYMBOL_INFO SymlibFindBest(PSYMLIB_MODULE_INFO ModuleInfo, DWORD64 Offset)
+{
+    SYMBOLS_LIST &Symbols = ModuleInfo->SymbolsList;
+
+    // last symbol with the offset that is not above the specified one
+    SYMBOLS_LIST::iterator it = std::upper_bound(Symbols.begin(), Symbols.end(), Offset, SymlibLessSymbol);
+    if (it == Symbols.begin())
+    {
+        return NULL;
+    }
+
+    // return the preferred symbol from the symbols with the same offset
+    return SymlibFindByAddress(ModuleInfo, (it - 1)->Offset);
+}
+//--------------------------------------------------------------------------------------
+static bool SymlibLessLookup(const SYMLIB_LOOKUP &First, const SYMLIB_LOOKUP &Second)
+{
+    if (First.Module != Second.Module)
+    {
+        return First.Module < Second.Module;
+    }
 
-            // call caller-specified symbol handler
-            if (!Handler(&SymbolInfo, Context))
+    return First.Offset < Second.Offset;
+}
+//--------------------------------------------------------------------------------------
+void SymlibSortLookups(std::vector<SYMLIB_LOOKUP> &Lookups)
+{
+    // offsets from the coverage logs are often already sorted
+    for (size_t i = 1; i < Lookups.size(); i++)
+    {
+        if (SymlibLessLookup(Lookups[i], Lookups[i - 1]))
+        {
+            std::sort(Lookups.begin(), Lookups.end(), SymlibLessLookup);
+            break;
+        }
+    }
+}
+//--------------------------------------------------------------------------------------
+void SymlibFindBestMany(
+    PSYMLIB_MODULE_INFO ModuleInfo, 
+    PSYMLIB_LOOKUP Lookups, size_t Count, 
+    PSYMLIB_SYMBOL_INFO *Results)
+{
+    SYMBOLS_LIST &Symbols = ModuleInfo->SymbolsList;
+    size_t Symbol = 0, First = 0;
+
+    // single pass over the sorted offsets and symbols
+    for (size_t i = 0; i < Count; i++)
+    {
+        while (Symbol < Symbols.size() && Symbols[Symbol].Offset <= Lookups[i].Offset)
+        {
+            // remember the preferred symbol from the symbols with the same offset
+            if (Symbol == 0 || Symbols[Symbol].Offset != Symbols[Symbol - 1].Offset)
             {
-                // stop enumeration
-                break;
+                First = Symbol;
             }
+
+            Symbol += 1;
+        }
+
+        Results[i] = Symbol > 0 ? &Symbols[First] : NULL;
+    }
+}
+//--------------------------------------------------------------------------------------
+BOOL SymlibIsOffsetsArray(PyObject *Object)
+{
+    if (strcmp(Object->ob_type->tp_name, "array.array"))
+    {
+        return FALSE;
+    }
+
+    // unsigned 32-bit items: typecode depends on the platform ('L' on Windows, 'I' on LP64)
+    PyObject *TypeCode = PyObject_GetAttrString(Object, "typecode");
+    PyObject *ItemSize = PyObject_GetAttrString(Object, "itemsize");
+    BOOL bRet = FALSE;
+
+    if (TypeCode && ItemSize && PyString_Check(TypeCode) && PyInt_Check(ItemSize))
+    {
+        const char *lpszTypeCode = PyString_AsString(TypeCode);
+
+        bRet = (!strcmp(lpszTypeCode, "I") || !strcmp(lpszTypeCode, "L")) &&
+               PyInt_AsLong(ItemSize) == SYMLIB_OFFSET_SIZE;
+    }
+
+    Py_XDECREF(TypeCode);
+    Py_XDECREF(ItemSize);
+
+    PyErr_Clear();
+
+    return bRet;
+}
+//--------------------------------------------------------------------------------------
+BOOL SymlibReadOffsets(PyObject *Object, std::vector<SYMLIB_LOOKUP> &Lookups)
+{
+    const void *Buffer = NULL;
+    Py_ssize_t BufferSize = 0;
+
+    // array of 32-bit offsets can be read directly, any other buffers are not arrays of offsets
+    if (SymlibIsOffsetsArray(Object))
+    {
+        if (PyObject_AsReadBuffer(Object, &Buffer, &BufferSize) != 0)
+        {
+            PyErr_Clear();
+            return FALSE;
+        }
+
+        if (BufferSize % SYMLIB_OFFSET_SIZE != 0)
+        {
+            DbgMsg(__FILE__, __LINE__, "%s(): Invalid buffer size\n", __FUNCTION__);
+            return FALSE;
+        }
+
+        Lookups.resize(BufferSize / SYMLIB_OFFSET_SIZE);
+
+        for (size_t i = 0; i < Lookups.size(); i++)
+        {
+            Lookups[i].Module = 0;
+            Lookups[i].Offset = ((const unsigned int *)Buffer)[i];
+            Lookups[i].Index = i;
         }
 
         return TRUE;
     }
-    
-    return FALSE;
+
+    // list, tuple or any other sequence of numbers
+    PyObject *Sequence = PySequence_Fast(Object, "offsets must be a sequence");
+    if (Sequence == NULL)
+    {
+        PyErr_Clear();
+        return FALSE;
+    }
+
+    Lookups.resize(PySequence_Fast_GET_SIZE(Sequence));
+
+    for (size_t i = 0; i < Lookups.size(); i++)
+    {
+        PyObject *Item = PySequence_Fast_GET_ITEM(Sequence, i);
+
+        Lookups[i].Module = 0;
+        Lookups[i].Offset = (DWORD)PyInt_AsUnsignedLongMask(Item);
+        Lookups[i].Index = i;
+    }
+
+    Py_DECREF(Sequence);
+
+    if (PyErr_Occurred())
+    {
+        PyErr_Clear();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+//--------------------------------------------------------------------------------------
+PyObject *SymlibBestResults(
+    std::vector<SYMLIB_LOOKUP> &Lookups, 
+    std::vector<PSYMLIB_SYMBOL_INFO> &Results)
+{
+    PyObject *Names = PyList_New(Lookups.size());
+    PyObject *Deltas = PyList_New(Lookups.size());
+    PyObject *Name = NULL;
+
+    if (Names == NULL || Deltas == NULL)
+    {
+        Py_XDECREF(Names);
+        Py_XDECREF(Deltas);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < Lookups.size(); i++)
+    {
+        PSYMLIB_SYMBOL_INFO SymbolInfo = Results[i];
+        size_t Index = Lookups[i].Index;
+
+        // symbol at zero offset is not reported, the same as bestbyaddr() does
+        if (SymbolInfo == NULL || SymbolInfo->Offset == 0)
+        {
+            Py_INCREF(Py_None);
+            Py_INCREF(Py_None);
+            PyList_SET_ITEM(Names, Index, Py_None);
+            PyList_SET_ITEM(Deltas, Index, Py_None);
+            continue;
+        }
+
+        // sorted offsets of the same symbol are sharing its name object
+        if (Name == NULL || Results[i - 1] != SymbolInfo)
+        {
+            Name = PyString_FromString(SymbolInfo->Name.c_str());
+        }
+        else
+        {
+            Py_INCREF(Name);
+        }
+
+        PyList_SET_ITEM(Names, Index, Name);
+        PyList_SET_ITEM(Deltas, Index, PyLong_FromUnsignedLong((DWORD)(Lookups[i].Offset - SymbolInfo->Offset)));
+    }
+
+    PyObject *Ret = PyTuple_Pack(2, Names, Deltas);
+
+    Py_DECREF(Names);
+    Py_DECREF(Deltas);
+
+    return Ret;
 }
 //--------------------------------------------------------------------------------------
 PyObject *addrbyname(PyObject* self, PyObject* pArgs)
 {   
     PyObject *Ret = Py_None;
     char *lpszSymbolName = NULL, *lpszModuleName = NULL;
+    PSYMLIB_MODULE_INFO ModuleInfo = NULL;
     
     Py_INCREF(Py_None);
 
     if (!PyArg_ParseTuple(pArgs, "ss", &lpszModuleName, &lpszSymbolName)) 
     {
-        DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Error while parsing input arguments\n");
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing input arguments\n", __FUNCTION__);
         goto end;
     }    
 
-    ENUM_CONTEXT Context;
-    ZeroMemory(&Context, sizeof(Context));
-    Context.lpszSymbolName = lpszSymbolName;
-
-    if (SymlibEnumerateSymbols(lpszModuleName, FindSymbolByName, &Context))
+    if ((ModuleInfo = SymlibGetModule(lpszModuleName)) != NULL)
     {
-        if (Context.dwSymbolOffset > 0)
+        PSYMLIB_SYMBOL_INFO SymbolInfo = SymlibFindByName(ModuleInfo, lpszSymbolName);
+        if (SymbolInfo && SymbolInfo->Offset > 0)
         {
-            Ret = PyLong_FromUnsignedLong((DWORD)Context.dwSymbolOffset);
+            Ret = PyLong_FromUnsignedLong((DWORD)SymbolInfo->Offset);
             Py_DECREF(Py_None);
         }
         else
         {
-            DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Symbol is not found\n");
+            DbgMsg(__FILE__, __LINE__, "%s(): Symbol is not found\n", __FUNCTION__);
         }
     }
     else
     {
-        DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Error while enumerating symbols\n");
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while loading module\n", __FUNCTION__);
     }       
 
 end:  
@@ -290,37 +597,33 @@ PyObject *namebyaddr(PyObject* self, PyObject* pArgs)
 {
     PyObject *Ret = Py_None;
     char *lpszModuleName = NULL;
+    PSYMLIB_MODULE_INFO ModuleInfo = NULL;
     DWORD dwOffset = 0;
     
     Py_INCREF(Py_None);
 
     if (!PyArg_ParseTuple(pArgs, "sk", &lpszModuleName, &dwOffset)) 
     {
-        DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Error while parsing input arguments\n");
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing input arguments\n", __FUNCTION__);
         goto end;
     }    
 
-    ENUM_CONTEXT Context;
-    ZeroMemory(&Context, sizeof(Context));
-    Context.dwSymbolOffset = (DWORD64)dwOffset;
-
-    if (SymlibEnumerateSymbols(lpszModuleName, FindSymbolByAddress, &Context))
+    if ((ModuleInfo = SymlibGetModule(lpszModuleName)) != NULL)
     {
-        if (Context.lpszSymbolName)
+        PSYMLIB_SYMBOL_INFO SymbolInfo = SymlibFindByAddress(ModuleInfo, (DWORD64)dwOffset);
+        if (SymbolInfo)
         {
-            Ret = PyString_FromString((const char *)Context.lpszSymbolName);
-
-            free(Context.lpszSymbolName);
+            Ret = PyString_FromString(SymbolInfo->Name.c_str());
             Py_DECREF(Py_None);
         }
         else
         {
-            DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Symbol is not found\n");
+            DbgMsg(__FILE__, __LINE__, "%s(): Symbol is not found\n", __FUNCTION__);
         }
     }
     else
     {
-        DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Error while enumerating symbols\n");
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while loading module\n", __FUNCTION__);
     }        
 
 end:  
@@ -332,57 +635,207 @@ PyObject *bestbyaddr(PyObject* self, PyObject* pArgs)
 {
     PyObject *Ret = Py_None;
     char *lpszModuleName = NULL;
+    PSYMLIB_MODULE_INFO ModuleInfo = NULL;
     DWORD dwOffset = 0;
 
     Py_INCREF(Py_None);
 
     if (!PyArg_ParseTuple(pArgs, "sk", &lpszModuleName, &dwOffset)) 
     {
-        DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Error while parsing input arguments\n");
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing input arguments\n", __FUNCTION__);
         goto end;
     }    
 
-    ENUM_CONTEXT Context;
-    ZeroMemory(&Context, sizeof(Context));
-    Context.dwSymbolOffset = (DWORD64)dwOffset;
+    if ((ModuleInfo = SymlibGetModule(lpszModuleName)) != NULL)
+    {
+        PSYMLIB_SYMBOL_INFO SymbolInfo = SymlibFindBest(ModuleInfo, (DWORD64)dwOffset);
+        if (SymbolInfo && SymbolInfo->Offset > 0)
+        {
+            Ret = PyList_New(0);
+            PyList_Insert(Ret, 0, PyString_FromString(SymbolInfo->Name.c_str()));
+            PyList_Insert(Ret, 1, PyLong_FromUnsignedLong((DWORD)(dwOffset - SymbolInfo->Offset)));
+
+            Py_DECREF(Py_None);
+        }
+        else
+        {
+            DbgMsg(__FILE__, __LINE__, "%s(): Symbol is not found\n", __FUNCTION__);
+        }
+    }
+    else
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while loading module\n", __FUNCTION__);
+    }        
+
+end:  
+
+    return Ret;
+}
+//--------------------------------------------------------------------------------------
+PyObject *bestbyaddr_many(PyObject* self, PyObject* pArgs)
+{
+    PyObject *Ret = Py_None, *Offsets = NULL;
+    char *lpszModuleName = NULL;
+
+    Py_INCREF(Py_None);
+
+    if (!PyArg_ParseTuple(pArgs, "sO", &lpszModuleName, &Offsets)) 
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing input arguments\n", __FUNCTION__);
+        goto end;
+    }    
 
-    if (SymlibEnumerateSymbols(lpszModuleName, FindBestSymbolByAddress, &Context))
+    try
     {
-        if (Context.dwBestSymbolOffset > 0)
+        std::vector<SYMLIB_LOOKUP> Lookups;
+
+        if (!SymlibReadOffsets(Offsets, Lookups))
+        {
+            DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing offsets\n", __FUNCTION__);
+            goto end;
+        }
+
+        SymlibSortLookups(Lookups);
+
+        std::vector<PSYMLIB_SYMBOL_INFO> Results(Lookups.size(), (PSYMLIB_SYMBOL_INFO)NULL);
+
+        PSYMLIB_MODULE_INFO ModuleInfo = SymlibGetModule(lpszModuleName);
+        if (ModuleInfo == NULL)
+        {
+            DbgMsg(__FILE__, __LINE__, "%s(): Error while loading module\n", __FUNCTION__);
+            goto end;
+        }
+
+        if (Lookups.size() > 0)
         {
-            Context.dwSymbolOffset = Context.dwBestSymbolOffset;
-            if (SymlibEnumerateSymbols(lpszModuleName, FindSymbolByAddress, &Context))
+            SymlibFindBestMany(ModuleInfo, &Lookups[0], Lookups.size(), &Results[0]);
+        }
+
+        PyObject *Best = SymlibBestResults(Lookups, Results);
+        if (Best)
+        {
+            Ret = Best;
+            Py_DECREF(Py_None);
+        }
+        else
+        {
+            PyErr_Clear();
+        }
+    }
+    catch (...)
+    {
+        printf("%s(): Exception occurs\n", __FUNCTION__);
+    }
+
+end:
+
+    return Ret;
+}
+//--------------------------------------------------------------------------------------
+PyObject *bestbyaddr_multi(PyObject* self, PyObject* pArgs)
+{
+    PyObject *Ret = Py_None, *Modules = NULL, *Offsets = NULL, *Sequence = NULL;
+
+    Py_INCREF(Py_None);
+
+    if (!PyArg_ParseTuple(pArgs, "OO", &Modules, &Offsets)) 
+    {
+        DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing input arguments\n", __FUNCTION__);
+        goto end;
+    }    
+
+    try
+    {
+        std::vector<SYMLIB_LOOKUP> Lookups;
+        std::vector<std::string> ModuleNames;
+        std::map<std::string, size_t> ModuleIndexes;
+
+        if (!SymlibReadOffsets(Offsets, Lookups))
+        {
+            DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing offsets\n", __FUNCTION__);
+            goto end;
+        }
+
+        if ((Sequence = PySequence_Fast(Modules, "modules must be a sequence")) == NULL ||
+            PySequence_Fast_GET_SIZE(Sequence) != (Py_ssize_t)Lookups.size())
+        {
+            DbgMsg(__FILE__, __LINE__, "%s(): Modules and offsets must have the same length\n", __FUNCTION__);
+            goto end;
+        }
+
+        // assign module name index to each of the offsets
+        for (size_t i = 0; i < Lookups.size(); i++)
+        {
+            char *lpszModuleName = PyString_AsString(PySequence_Fast_GET_ITEM(Sequence, i));
+            if (lpszModuleName == NULL)
             {
-                if (Context.lpszSymbolName)
-                {                    
-                    Ret = PyList_New(0);
-                    PyList_Insert(Ret, 0, PyString_FromString((const char *)Context.lpszSymbolName));
-                    PyList_Insert(Ret, 1, PyLong_FromUnsignedLong(Context.dwBestSymbolDelta));
-
-                    free(Context.lpszSymbolName);
-                    Py_DECREF(Py_None);
-                }
-                else
-                {
-                    DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Symbol is not found\n");
-                }
+                DbgMsg(__FILE__, __LINE__, "%s(): Error while parsing module names\n", __FUNCTION__);
+                goto end;
             }
-            else
+
+            std::map<std::string, size_t>::iterator it = ModuleIndexes.find(std::string(lpszModuleName));
+            if (it == ModuleIndexes.end())
             {
-                DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Error while enumerating symbols\n");
-            } 
+                it = ModuleIndexes.insert(std::make_pair(std::string(lpszModuleName), ModuleNames.size())).first;
+                ModuleNames.push_back(it->first);
+            }
+
+            Lookups[i].Module = it->second;
+        }
+
+        SymlibSortLookups(Lookups);
+
+        std::vector<PSYMLIB_SYMBOL_INFO> Results(Lookups.size(), (PSYMLIB_SYMBOL_INFO)NULL);
+
+        // resolve offsets of each module with the single pass
+        for (size_t i = 0; i < Lookups.size();)
+        {
+            size_t n = i;
+
+            while (n < Lookups.size() && Lookups[n].Module == Lookups[i].Module)
+            {
+                n += 1;
+            }
+
+            PSYMLIB_MODULE_INFO ModuleInfo = SymlibGetModule(ModuleNames[Lookups[i].Module].c_str());
+            if (ModuleInfo == NULL)
+            {
+                DbgMsg(__FILE__, __LINE__, "%s(): Error while loading module\n", __FUNCTION__);
+                goto end;
+            }
+
+            SymlibFindBestMany(ModuleInfo, &Lookups[i], n - i, &Results[i]);
+
+            i = n;
+        }
+
+        PyObject *Best = SymlibBestResults(Lookups, Results);
+        if (Best)
+        {
+            Ret = Best;
+            Py_DECREF(Py_None);
         }
         else
         {
-            DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Symbol is not found\n");
+            PyErr_Clear();
         }
     }
-    else
+    catch (...)
     {
-        DbgMsg(__FILE__, __LINE__, __FUNCTION__"(): Error while enumerating symbols\n");
-    }        
+        printf("%s(): Exception occurs\n", __FUNCTION__);
+    }
 
-end:  
+end:
+
+    if (Sequence)
+    {
+        Py_DECREF(Sequence);
+    }
+
+    if (PyErr_Occurred())
+    {
+        PyErr_Clear();
+    }
 
     return Ret;
 }
@@ -392,6 +845,10 @@ static PyMethodDef m_Methods[] =
     { "addrbyname", addrbyname, METH_VARARGS, "Get symbol offset by name."                      },
     { "namebyaddr", namebyaddr, METH_VARARGS, "Get symbol name by offset."                      },
     { "bestbyaddr", bestbyaddr, METH_VARARGS, "Get the more suitable symbol name by address."   },
+
+    { "bestbyaddr_many",  bestbyaddr_many,  METH_VARARGS, "Get the more suitable symbol names for the list of module offsets." },
+    { "bestbyaddr_multi", bestbyaddr_multi, METH_VARARGS, "Get the more suitable symbol names for the lists of modules and offsets." },
+
     { NULL,         NULL,       0,            NULL                                              }
 };
 
@@ -410,9 +867,15 @@ BOOL SymlibUninitialize(void)
     // enumerate loaded modules
     for (it; it != m_ModulesList.end(); ++it) 
     {
+
+#ifdef _WIN32
+
         // unload module
         SymUnloadModule64(GetCurrentProcess(), (DWORD64)it->second.hModule);
         FreeLibrary(it->second.hModule);
+
+#endif
+
     }
 
     // flush modules list list
@@ -431,6 +894,8 @@ PyMODINIT_FUNC initsymlib25(void)
     SymlibInitialize();
 }
 //--------------------------------------------------------------------------------------
+#ifdef _WIN32
+//--------------------------------------------------------------------------------------
 BOOL APIENTRY DllMain( 
     HMODULE hModule,
     DWORD ul_reason_for_call,
@@ -480,4 +945,6 @@ BOOL APIENTRY DllMain(
     return TRUE;
 }
 //--------------------------------------------------------------------------------------
+#endif // _WIN32
+//--------------------------------------------------------------------------------------
 // EoF
@@ -0,0 +1,13 @@
+
+typedef struct _SYMLIB_SYMBOL_INFO
+{
+    std::string Name;
+    DWORD64 Offset;
+
+    // preference of the symbol among the aliases with the same offset, lower is better
+    DWORD Rank;
+
+} SYMLIB_SYMBOL_INFO,
+*PSYMLIB_SYMBOL_INFO;
+
+typedef std::vector<SYMLIB_SYMBOL_INFO> SYMBOLS_LIST;
@@ -1,5 +1,6 @@
-import sys
+import sys, struct
 import symlib
+from array import array
 
 test_lib  = "ntoskrnl.exe"
 test_name = "KiDispatchInterrupt"
@@ -60,4 +61,76 @@ if best_symbol[0] != name_1 or best_symbol[1] != test_offset:
     
 # if end
 
+print "[+] Testing bestbyaddr_many()..."
+
+# step 4: query best symbols for the list of offsets at once
+best_symbols = symlib.bestbyaddr_many(test_lib, [ addr_1 + test_offset, addr_1 ])
+if best_symbols == None:
+
+    print "ERROR: Best symbols for offsets 0x%.8x, 0x%.8x are not found" % (addr_1 + test_offset, addr_1)
+    sys.exit(-1)
+
+# if end
+
+if best_symbols[0] != [ name_1, name_1 ] or best_symbols[1] != [ test_offset, 0 ]:
+
+    print "[-] Test failed"
+    sys.exit(-1)
+    
+# if end
+
+print "[+] Testing bestbyaddr_many() with arrays..."
+
+# step 5: arrays of unsigned 32-bit items are read as raw buffers, arrays of other types as sequences
+for typecode in [ "I", "L", "i" ]:
+
+    best_symbols = symlib.bestbyaddr_many(test_lib, array(typecode, [ addr_1 + test_offset, addr_1 ]))
+    if best_symbols == None or best_symbols[0] != [ name_1, name_1 ] or best_symbols[1] != [ test_offset, 0 ]:
+
+        print "ERROR: Unexpected result for array('%s')" % typecode
+        print "[-] Test failed"
+        sys.exit(-1)
+
+    # if end
+
+# for end
+
+print "[+] Testing bestbyaddr_many() with buffers..."
+
+# step 6: strings and other buffers are not arrays of offsets, they must be rejected
+for offsets in [ struct.pack("II", addr_1 + test_offset, addr_1), buffer(struct.pack("II", addr_1 + test_offset, addr_1)) ]:
+
+    if symlib.bestbyaddr_many(test_lib, offsets) != None:
+
+        print "ERROR: Buffer of %d bytes was accepted as offsets" % len(offsets)
+        print "[-] Test failed"
+        sys.exit(-1)
+
+    # if end
+
+# for end
+
+print "[+] Testing batch lookups for missing module..."
+
+# step 7: module that can't be loaded gives None, the same as for bestbyaddr()
+if symlib.bestbyaddr_many(test_lib + ".missing", [ addr_1 ]) != None or \
+   symlib.bestbyaddr_multi([ test_lib, test_lib + ".missing" ], [ addr_1, addr_1 ]) != None:
+
+    print "ERROR: Missing module was resolved"
+    print "[-] Test failed"
+    sys.exit(-1)
+
+# if end
+
+print "[+] Testing bestbyaddr_multi()..."
+
+# step 8: query best symbols for the lists of modules and offsets
+best_symbols = symlib.bestbyaddr_multi([ test_lib ], [ addr_1 + test_offset ])
+if best_symbols == None or best_symbols[0] != [ name_1 ] or best_symbols[1] != [ test_offset ]:
+
+    print "[-] Test failed"
+    sys.exit(-1)
+    
+# if end
+
 print "[+] Test passed"